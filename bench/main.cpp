@@ -19,9 +19,11 @@
  * @date 2014
  * RLP tool.
  */
+#include <atomic>
 #include <clocale>
 #include <fstream>
 #include <iostream>
+#include <thread>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <json_spirit/JsonSpiritHeaders.h>
@@ -32,8 +34,15 @@
 #include <libdevcore/TrieDB.h>
 #include <libdevcrypto/Common.h>
 #include <libdevcrypto/CryptoPP.h>
+#include <libp2p/Host.h>
+#include <libp2p/Capability.h>
+#include <libp2p/HostCapability.h>
+#include <libp2p/RLPXFrameCoder.h>
+#include <libethereum/TransactionQueue.h>
+#include <libethashseal/EthashAux.h>
 using namespace std;
 using namespace dev;
+using namespace dev::eth;
 namespace js = json_spirit;
 
 void help()
@@ -42,6 +51,27 @@ void help()
 		<< "Usage bench <mode> [OPTIONS]" << endl
 		<< "Modes:" << endl
 		<< "    trie  Trie benchmarks." << endl
+		<< "    txqueue  Import signed transactions into a TransactionQueue from many threads." << endl
+		<< "    seal  Verify Ethash seals with the light cache, one at a time and in parallel batches." << endl
+		<< "    p2p  Serve requests from many peers connected over loopback and report their latencies." << endl
+		<< "    rlpx  Encrypt and decrypt RLPx frames of 1 KB to 10 MB." << endl
+		<< endl
+		<< "Transaction queue options:" << endl
+		<< "    --count <n>  Number of transactions to inject (default: 1000000)." << endl
+		<< "    --senders <n>  Number of distinct senders (default: 10000)." << endl
+		<< "    --threads <n>  Number of injecting threads (default: hardware concurrency)." << endl
+		<< endl
+		<< "Seal verification options:" << endl
+		<< "    --headers <n>  Number of headers to verify (default: 4096)." << endl
+		<< "    --threads <n>  Number of verifying threads (default: hardware concurrency)." << endl
+		<< endl
+		<< "Network options:" << endl
+		<< "    --peers <n>  Number of peers sending requests (default: 64)." << endl
+		<< "    --depth <n>  Requests each peer keeps outstanding (default: 4)." << endl
+		<< "    --service <us>  Time spent serving each request, as if reading the database (default: 500)." << endl
+		<< "    --seconds <n>  Duration of the run (default: 10)." << endl
+		<< "    --threads <n>  Number of network threads of the serving host (default: hardware concurrency)." << endl
+		<< "    --handlers <n>  Number of request handler threads of the serving host; 0 serves on the network threads (default: 2)." << endl
 		<< endl
 		<< "General options:" << endl
 		<< "    -h,--help  Print this help message and exit." << endl
@@ -81,7 +111,11 @@ void setDefaultOrCLocale()
 
 enum class Mode {
 	Trie,
-	SHA3
+	SHA3,
+	TxQueue,
+	Seal,
+	P2P,
+	RLPx
 };
 
 enum class Alphabet
@@ -146,10 +180,99 @@ private:
 	}
 };
 
+class BenchHostCapability;
+
+/// One end of a benchmark connection: answers requests after a simulated database read, and times the answers to its own.
+class BenchCapability: public p2p::Capability
+{
+public:
+	BenchCapability(shared_ptr<p2p::SessionFace> _s, p2p::HostCapabilityFace* _h, unsigned _idOffset, p2p::CapDesc const&, uint16_t _capID): p2p::Capability(_s, _h, _idOffset, _capID) {}
+	static string name() { return "bench"; }
+	static u256 version() { return 1; }
+	static unsigned messageCount() { return 2; }
+
+	void request()
+	{
+		RLPStream s;
+		prep(s, RequestPacket, 1) << (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+		sealAndSend(s);
+	}
+
+protected:
+	enum { RequestPacket = 0, ResponsePacket };
+
+	bool interpret(unsigned _id, RLP const& _r) override;
+};
+
+class BenchHostCapability: public p2p::HostCapability<BenchCapability>
+{
+public:
+	explicit BenchHostCapability(unsigned _serviceMicros = 0): m_serviceMicros(_serviceMicros) {}
+
+	/// Has each peer keep @a _depth requests outstanding until stop().
+	void start(unsigned _depth)
+	{
+		m_running = true;
+		for (auto const& i: peerSessions())
+			if (auto p = p2p::capabilityFromSession<BenchCapability>(*i.first))
+				for (unsigned d = 0; d < _depth; ++d)
+					p->request();
+	}
+	void stop() { m_running = false; }
+	bool isRunning() const { return m_running; }
+
+	unsigned serviceMicros() const { return m_serviceMicros; }
+
+	void noteLatency(double _seconds) { DEV_GUARDED(x_latencies) m_latencies.push_back(_seconds); }
+	vector<double> latencies() const { Guard l(x_latencies); return m_latencies; }
+
+private:
+	unsigned m_serviceMicros;
+	atomic<bool> m_running{false};
+	mutable Mutex x_latencies;
+	vector<double> m_latencies;
+};
+
+bool BenchCapability::interpret(unsigned _id, RLP const& _r)
+{
+	auto host = static_cast<BenchHostCapability*>(hostCapability());
+	uint64_t sent = _r[0].toInt<uint64_t>();
+	if (_id == RequestPacket)
+	{
+		auto self = shared_from_this();
+		offload([this, self, host, sent]()
+		{
+			this_thread::sleep_for(chrono::microseconds(host->serviceMicros()));
+			RLPStream s;
+			prep(s, ResponsePacket, 1) << sent;
+			sealAndSend(s);
+		});
+	}
+	else if (_id == ResponsePacket)
+	{
+		auto elapsed = chrono::steady_clock::now().time_since_epoch() - chrono::steady_clock::duration(sent);
+		host->noteLatency(chrono::duration<double>(elapsed).count());
+		if (host->isRunning())
+			request();
+	}
+	else
+		return false;
+	return true;
+}
+
 int main(int argc, char** argv)
 {
 	setDefaultOrCLocale();
 	Mode mode = Mode::Trie;
+	unsigned txCount = 1000000;
+	unsigned txSenders = 10000;
+	unsigned txThreads = max(thread::hardware_concurrency(), 1U);
+	unsigned sealHeaders = 4096;
+	unsigned p2pPeers = 64;
+	unsigned p2pDepth = 4;
+	unsigned p2pService = 500;
+	unsigned p2pSeconds = 10;
+	unsigned p2pHandlers = 2;
 
 	for (int i = 1; i < argc; ++i)
 	{
@@ -160,6 +283,32 @@ int main(int argc, char** argv)
 			mode = Mode::Trie;
 		else if (arg == "sha3")
 			mode = Mode::SHA3;
+		else if (arg == "txqueue")
+			mode = Mode::TxQueue;
+		else if (arg == "seal")
+			mode = Mode::Seal;
+		else if (arg == "p2p")
+			mode = Mode::P2P;
+		else if (arg == "rlpx")
+			mode = Mode::RLPx;
+		else if (arg == "--peers" && i + 1 < argc)
+			p2pPeers = max<unsigned>(stoul(argv[++i]), 1);
+		else if (arg == "--depth" && i + 1 < argc)
+			p2pDepth = max<unsigned>(stoul(argv[++i]), 1);
+		else if (arg == "--service" && i + 1 < argc)
+			p2pService = stoul(argv[++i]);
+		else if (arg == "--seconds" && i + 1 < argc)
+			p2pSeconds = max<unsigned>(stoul(argv[++i]), 1);
+		else if (arg == "--handlers" && i + 1 < argc)
+			p2pHandlers = stoul(argv[++i]);
+		else if (arg == "--headers" && i + 1 < argc)
+			sealHeaders = max<unsigned>(stoul(argv[++i]), 1);
+		else if (arg == "--count" && i + 1 < argc)
+			txCount = stoul(argv[++i]);
+		else if (arg == "--senders" && i + 1 < argc)
+			txSenders = max<unsigned>(stoul(argv[++i]), 1);
+		else if (arg == "--threads" && i + 1 < argc)
+			txThreads = max<unsigned>(stoul(argv[++i]), 1);
 		else if (arg == "-V" || arg == "--version")
 			version();
 	}
@@ -187,7 +336,19 @@ int main(int argc, char** argv)
 					t.insert(&i.first, &i.second);
 			auto e = timer.elapsed() / trials;
 
-			cout << sm.first << ": " << e * 1000000 << " us, root=" << t.root() << endl;
+			size_t seen = 0;
+			timer.restart();
+			for (unsigned i = 0; i < trials; ++i)
+				for (auto const& i: t)
+					seen += i.second.size();
+			auto it = timer.elapsed() / trials;
+
+			timer.restart();
+			for (unsigned i = 0; i < trials; ++i)
+				t.scan(bytesConstRef(), numeric_limits<unsigned>::max(), [&](bytesConstRef, bytesConstRef _v) { seen += _v.size(); return true; });
+			auto sc = timer.elapsed() / trials;
+
+			cout << sm.first << ": " << e * 1000000 << " us, iterate " << it * 1000000 << " us, scan " << sc * 1000000 << " us, root=" << t.root() << endl;
 		}
 	}
 	else if (mode == Mode::SHA3)
@@ -202,6 +363,169 @@ int main(int argc, char** argv)
 		}
 		cout << "sha3 x 1000: " << t.elapsed() / trials * 1000000 << "us " << endl;
 	}
+	else if (mode == Mode::TxQueue)
+	{
+		// Sign the synthetic transactions up front, in parallel; sender s gets nonces s, s + senders, ...
+		vector<KeyPair> keys;
+		for (unsigned i = 0; i < txSenders; ++i)
+			keys.push_back(KeyPair::create());
+		vector<bytes> txs(txCount);
+		Timer timer;
+		auto forEach = [&](function<void(unsigned)> const& _f)
+		{
+			vector<thread> threads;
+			for (unsigned t = 0; t < txThreads; ++t)
+				threads.emplace_back([&, t]() { for (unsigned i = t; i < txCount; i += txThreads) _f(i); });
+			for (auto& t: threads)
+				t.join();
+		};
+		forEach([&](unsigned i)
+		{
+			u256 gasPrice = 20 * szabo + i % 97;
+			txs[i] = Transaction(0, gasPrice, 21000, Address(i), bytes(), i / txSenders, keys[i % txSenders].secret()).rlp();
+		});
+		cout << "signed " << txCount << " transactions from " << txSenders << " senders in " << timer.elapsed() << " s" << endl;
+
+		TransactionQueue tq(txCount, txCount);
+		atomic<unsigned> failed(0);
+		timer.restart();
+		forEach([&](unsigned i)
+		{
+			if (tq.import(txs[i]) != ImportResult::Success)
+				++failed;
+		});
+		double e = timer.elapsed();
+		cout << "imported " << tq.status().current << " (" << failed << " failed) with " << txThreads << " threads in " << e << " s: " << (unsigned)(txCount / e) << " tx/s" << endl;
+
+		timer.restart();
+		Transactions top = tq.topTransactions(10000);
+		cout << "topTransactions(10000): " << timer.elapsed() * 1000 << " ms (" << top.size() << " returned)" << endl;
+	}
+	else if (mode == Mode::Seal)
+	{
+		// Synthetic headers of the first epoch; an invalid seal costs as much to find out as a valid one.
+		h256 seed = EthashAux::seedHash(0);
+		h256s headerHashes;
+		vector<Nonce> nonces;
+		for (unsigned i = 0; i < sealHeaders; ++i)
+		{
+			headerHashes.push_back(sha3(toString(i)));
+			nonces.push_back((Nonce)(u64)i);
+		}
+		Timer timer;
+		EthashAux::light(seed);
+		cout << "light cache built in " << timer.elapsed() << " s" << endl;
+
+		unsigned single = min(sealHeaders, 256U);
+		vector<EthashProofOfWork::Result> expected;
+		timer.restart();
+		for (unsigned i = 0; i < single; ++i)
+			expected.push_back(EthashAux::eval(seed, headerHashes[i], nonces[i]));
+		double e = timer.elapsed();
+		cout << "one at a time: " << (unsigned)(single / e) << " headers/s" << endl;
+
+		timer.restart();
+		vector<EthashProofOfWork::Result> results = EthashAux::eval(seed, headerHashes, nonces, txThreads);
+		e = timer.elapsed();
+		unsigned mismatched = 0;
+		for (unsigned i = 0; i < single; ++i)
+			if (results[i].value != expected[i].value || results[i].mixHash != expected[i].mixHash)
+				++mismatched;
+		cout << "batched on " << txThreads << " threads: " << (unsigned)(sealHeaders / e) << " headers/s (" << mismatched << " mismatched)" << endl;
+	}
+	else if (mode == Mode::P2P)
+	{
+		// One serving host and a host per peer, all on loopback; peers only ever request.
+		p2p::NodeIPEndpoint::test_allowLocal = true;
+		string const localhost = "127.0.0.1";
+		auto prefs = [&](unsigned _ioThreads, unsigned _handlerThreads)
+		{
+			p2p::NetworkPreferences ret(localhost, 0, false);
+			ret.discovery = false;
+			ret.ioThreads = _ioThreads;
+			ret.handlerThreads = _handlerThreads;
+			return ret;
+		};
+		p2p::Host server("bench", prefs(txThreads, p2pHandlers));
+		server.setIdealPeerCount(p2pPeers);
+		server.registerCapability(make_shared<BenchHostCapability>(p2pService));
+		server.start();
+		p2p::NodeIPEndpoint serverEndpoint(bi::address::from_string(localhost), server.listenPort(), server.listenPort());
+
+		vector<unique_ptr<p2p::Host>> peers;
+		vector<shared_ptr<BenchHostCapability>> requesters;
+		for (unsigned i = 0; i < p2pPeers; ++i)
+		{
+			peers.emplace_back(new p2p::Host("bench", prefs(1, 0)));
+			requesters.push_back(peers.back()->registerCapability(make_shared<BenchHostCapability>()));
+			peers.back()->start();
+			peers.back()->requirePeer(server.id(), serverEndpoint);
+		}
+		for (unsigned i = 0; i < 300 && server.peerCount() < p2pPeers; ++i)
+			this_thread::sleep_for(chrono::milliseconds(100));
+		cout << server.peerCount() << " of " << p2pPeers << " peers connected; serving on " << txThreads << " network and " << p2pHandlers << " handler threads" << endl;
+
+		for (auto const& r: requesters)
+			r->start(p2pDepth);
+		this_thread::sleep_for(chrono::seconds(p2pSeconds));
+		for (auto const& r: requesters)
+			r->stop();
+		// Let the outstanding requests be answered.
+		this_thread::sleep_for(chrono::seconds(1));
+
+		vector<double> latencies;
+		for (auto const& r: requesters)
+		{
+			auto l = r->latencies();
+			latencies.insert(latencies.end(), l.begin(), l.end());
+		}
+		if (latencies.empty())
+		{
+			cout << "no requests answered" << endl;
+			return 1;
+		}
+		sort(latencies.begin(), latencies.end());
+		auto percentile = [&](double _p) { return latencies[min<size_t>(latencies.size() * _p, latencies.size() - 1)] * 1000; };
+		cout << latencies.size() << " requests answered: " << (unsigned)(latencies.size() / p2pSeconds) << " requests/s" << endl;
+		cout << "latency p50 " << percentile(0.5) << " ms, p90 " << percentile(0.9) << " ms, p99 " << percentile(0.99) << " ms, max " << latencies.back() * 1000 << " ms" << endl;
+
+		for (auto& p: peers)
+			p->stop();
+		server.stop();
+	}
+	else if (mode == Mode::RLPx)
+	{
+		// Both ends of one connection; the decoder checks every frame the encoder wrote.
+		KeyPair local = KeyPair::create();
+		KeyPair remote = KeyPair::create();
+		h256 localNonce = h256::random();
+		h256 remoteNonce = h256::random();
+		bytes ackCipher{0};
+		bytes authCipher{1};
+		p2p::RLPXFrameCoder encoder(true, remote.pub(), remoteNonce, local, localNonce, &ackCipher, &authCipher);
+		p2p::RLPXFrameCoder decoder(false, local.pub(), localNonce, remote, remoteNonce, &ackCipher, &authCipher);
+
+		for (size_t size: {1024, 16 * 1024, 256 * 1024, 1024 * 1024, 10 * 1024 * 1024})
+		{
+			// About 256 MB of frames for each size.
+			unsigned frames = max<unsigned>(256 * 1024 * 1024 / size, 1);
+			bytes payload(size, 0x42);
+			vector<bytes> out(frames);
+			Timer timer;
+			for (auto& o: out)
+				encoder.writeFrame(0, &payload, o);
+			double e = timer.elapsed();
+			cout << size << " byte frames: encrypt " << (unsigned)(frames / e) << " frames/s, " << (unsigned)(frames * size / e / 1048576) << " MB/s";
+
+			unsigned failed = 0;
+			timer.restart();
+			for (auto& o: out)
+				if (!decoder.authAndDecryptHeader(bytesRef(o.data(), h256::size)) || !decoder.authAndDecryptFrame(bytesRef(&o).cropped(h256::size)))
+					++failed;
+			e = timer.elapsed();
+			cout << "; decrypt " << (unsigned)(frames / e) << " frames/s, " << (unsigned)(frames * size / e / 1048576) << " MB/s" << (failed ? " (" + toString(failed) + " failed)" : "") << endl;
+		}
+	}
 
 	return 0;
 }
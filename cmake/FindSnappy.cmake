@@ -0,0 +1,33 @@
+# Find snappy
+#
+# Find the snappy includes and library
+#
+# if you nee to add a custom library search path, do it via CMAKE_PREFIX_PATH
+#
+# This module defines
+#  SNAPPY_INCLUDE_DIRS, where to find header, etc.
+#  SNAPPY_LIBRARIES, the libraries needed to use snappy.
+#  SNAPPY_FOUND, If false, do not try to use snappy.
+
+# only look in default directories
+find_path(
+	SNAPPY_INCLUDE_DIR
+	NAMES snappy.h
+	DOC "snappy include dir"
+)
+
+find_library(
+	SNAPPY_LIBRARY
+	NAMES snappy
+	DOC "snappy library"
+)
+
+set(SNAPPY_INCLUDE_DIRS ${SNAPPY_INCLUDE_DIR})
+set(SNAPPY_LIBRARIES ${SNAPPY_LIBRARY})
+
+# handle the QUIETLY and REQUIRED arguments and set SNAPPY_FOUND to TRUE
+# if all listed variables are TRUE, hide their existence from configuration view
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(snappy DEFAULT_MSG
+	SNAPPY_LIBRARY SNAPPY_INCLUDE_DIR)
+mark_as_advanced (SNAPPY_INCLUDE_DIR SNAPPY_LIBRARY)
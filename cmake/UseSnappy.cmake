@@ -0,0 +1,11 @@
+function(eth_apply TARGET REQUIRED)
+	find_package (Snappy)
+	eth_show_dependency(SNAPPY snappy)
+	if (SNAPPY_FOUND)
+		target_include_directories(${TARGET} SYSTEM PRIVATE ${SNAPPY_INCLUDE_DIRS})
+		target_link_libraries(${TARGET} ${SNAPPY_LIBRARIES})
+		target_compile_definitions(${TARGET} PUBLIC ETH_SNAPPY)
+	elseif (NOT ${REQUIRED} STREQUAL "OPTIONAL")
+		message(FATAL_ERROR "Snappy library not found")
+	endif()
+endfunction()
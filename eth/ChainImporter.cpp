@@ -0,0 +1,186 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ChainImporter.cpp
+ * @date 2016
+ */
+
+#include "ChainImporter.h"
+#include <libdevcore/Exceptions.h>
+#include <libdevcore/RLP.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// Max number of verified blocks imported into the chain per drain.
+unsigned const c_importBatch = 256;
+
+/// Seconds between two progress reports.
+double const c_reportInterval = 10;
+
+}
+
+void ChainImporter::importFile(string const& _path, ostream& _out)
+{
+	bool const fromStdin = _path.empty() || _path == "--";
+	thread reader([&]()
+	{
+		try
+		{
+			if (fromStdin)
+				readStream(cin);
+			else
+				readMapped(_path);
+		}
+		catch (...)
+		{
+			cerr << "Error reading " << (fromStdin ? "stdin" : _path) << ": " << boost::current_exception_diagnostic_information() << endl;
+		}
+		m_readerDone = true;
+	});
+
+	chrono::steady_clock::time_point t = chrono::steady_clock::now();
+	auto elapsed = [&]() { return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t).count() / 1000.0; };
+
+	auto queueBusy = [&]()
+	{
+		BlockQueueStatus q = m_client.blockQueueStatus();
+		return q.unverified + q.verifying + q.verified > 0;
+	};
+
+	// Drain the queue into the chain for as long as the reader is going or blocks remain queued.
+	bool moreToImport = true;
+	while (!m_readerDone || moreToImport || queueBusy())
+	{
+		unsigned imported;
+		tie(ignore, moreToImport, imported) = m_client.syncQueue(c_importBatch);
+		m_imported += imported;
+		if (!imported)
+			this_thread::sleep_for(chrono::milliseconds(10));
+
+		double e = elapsed();
+		if (e >= m_lastReport + c_reportInterval)
+			report(_out, e, false);
+	}
+	reader.join();
+	report(_out, elapsed(), true);
+}
+
+void ChainImporter::readMapped(string const& _path)
+{
+#if defined(_WIN32)
+	ifstream fin(_path, std::ifstream::binary);
+	readStream(fin);
+#else
+	int fd = ::open(_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Cannot open " + _path));
+	struct stat st;
+	fstat(fd, &st);
+	size_t size = st.st_size;
+	void* map = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	if (map == MAP_FAILED)
+	{
+		::close(fd);
+		// Not mappable (e.g. a pipe); fall back to reading it.
+		ifstream fin(_path, std::ifstream::binary);
+		readStream(fin);
+		return;
+	}
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	bytesConstRef data((byte const*)map, size);
+	while (!data.empty())
+	{
+		size_t blockSize = RLP(data, RLP::LaissezFaire).actualSize();
+		if (!blockSize || blockSize > data.size())
+		{
+			cerr << "Truncated block at offset " << (size - data.size()) << "; stopping." << endl;
+			break;
+		}
+		feed(data.cropped(0, blockSize));
+		data = data.cropped(blockSize);
+	}
+
+	::munmap(map, size);
+	::close(fd);
+#endif
+}
+
+void ChainImporter::readStream(istream& _in)
+{
+	bytes block;
+	while (_in.peek() != -1)
+	{
+		block.resize(8);
+		_in.read((char*)block.data(), 8);
+		block.resize(RLP(block, RLP::LaissezFaire).actualSize());
+		_in.read((char*)block.data() + 8, block.size() - 8);
+		feed(&block);
+	}
+}
+
+void ChainImporter::feed(bytesConstRef _block)
+{
+	++m_framed;
+	m_bytesRead += _block.size();
+	switch (m_client.queueBlock(_block, m_isSafe))
+	{
+	case ImportResult::Success: m_good++; break;
+	case ImportResult::AlreadyKnown: m_alreadyHave++; break;
+	case ImportResult::UnknownParent: m_unknownParent++; break;
+	case ImportResult::FutureTimeUnknown: m_unknownParent++; m_futureTime++; break;
+	case ImportResult::FutureTimeKnown: m_futureTime++; break;
+	default: m_bad++; break;
+	}
+}
+
+void ChainImporter::report(ostream& _out, double _elapsed, bool _final)
+{
+	auto rate = [](double _n, double _t) { return _t > 0 ? round(_n * 10 / _t) / 10 : 0; };
+	double d = _elapsed - m_lastReport;
+	unsigned framed = m_framed;
+	if (!_final)
+	{
+		BlockQueueStatus q = m_client.blockQueueStatus();
+		_out << "read " << (framed - m_lastFramed) << " blocks at " << rate(framed - m_lastFramed, d) << " blocks/s ("
+			<< rate(m_bytesRead / 1048576.0, _elapsed) << " MB/s avg); "
+			<< "queue " << q.unverified << " unverified, " << q.verifying << " verifying, " << q.verified << " verified; "
+			<< "imported " << (m_imported - m_lastImported) << " at " << rate(m_imported - m_lastImported, d) << " blocks/s. "
+			<< m_imported << " imported in " << _elapsed << " seconds at " << rate(m_imported, _elapsed) << " blocks/s (#" << m_client.number() << ")" << endl;
+		m_lastReport = _elapsed;
+		m_lastFramed = framed;
+		m_lastImported = m_imported;
+		return;
+	}
+	_out << m_imported << " imported in " << _elapsed << " seconds at " << rate(m_imported, _elapsed) << " blocks/s (#" << m_client.number() << ")" << endl;
+	_out << framed << " blocks read: " << m_good << " queued, " << m_alreadyHave << " already known, " << m_unknownParent << " with unknown parent, "
+		<< m_futureTime << " in the future, " << m_bad << " bad." << endl;
+}
@@ -0,0 +1,67 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ChainImporter.h
+ * @date 2016
+ */
+#pragma once
+#include <libethereum/Client.h>
+#include <atomic>
+#include <iosfwd>
+#include <string>
+
+/**
+ * Pipelined import of a file of concatenated RLP blocks.
+ *
+ * A reader thread frames blocks straight out of the (memory-mapped, where possible) input and
+ * feeds them to the client's block queue, whose verifier threads check them in parallel; the
+ * calling thread meanwhile keeps draining verified blocks into the chain. The reader backs off
+ * while the queue is full.
+ */
+class ChainImporter
+{
+public:
+	/// @param _isSafe if true, the blocks are trusted and some checks are skipped (--dont-check).
+	ChainImporter(dev::eth::Client& _client, bool _isSafe): m_client(_client), m_isSafe(_isSafe) {}
+
+	/// Imports every block of @a _path ("" or "--" for stdin), reporting throughput of each stage to @a _out.
+	void importFile(std::string const& _path, std::ostream& _out);
+
+private:
+	/// Reader-thread bodies; call feed() for each block found.
+	void readMapped(std::string const& _path);
+	void readStream(std::istream& _in);
+	void feed(dev::bytesConstRef _block);
+
+	void report(std::ostream& _out, double _elapsed, bool _final);
+
+	dev::eth::Client& m_client;
+	bool m_isSafe;
+
+	std::atomic<bool> m_readerDone{false};
+	std::atomic<uint64_t> m_bytesRead{0};
+	std::atomic<unsigned> m_framed{0};
+	std::atomic<unsigned> m_good{0};
+	std::atomic<unsigned> m_alreadyHave{0};
+	std::atomic<unsigned> m_futureTime{0};
+	std::atomic<unsigned> m_unknownParent{0};
+	std::atomic<unsigned> m_bad{0};
+	unsigned m_imported = 0;
+
+	double m_lastReport = 0;
+	unsigned m_lastFramed = 0;
+	unsigned m_lastImported = 0;
+};
@@ -133,6 +133,25 @@ public:
 			}
 		else if (arg == "-C" || arg == "--cpu")
 			m_minerType = "cpu";
+		else if (arg == "--cpu-huge-pages")
+			m_hugePages = true;
+		else if (arg == "--cpu-numa")
+			m_numaReplicas = true;
+		else if (arg == "--dag-dir" && i + 1 < argc)
+			m_dagOptions.sharedDir = argv[++i];
+		else if (arg == "--dag-epochs" && i + 1 < argc)
+			try {
+				m_dagOptions.maxResidentEpochs = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--dag-populate")
+			m_dagOptions.populate = true;
+		else if (arg == "--dag-huge-pages")
+			m_dagOptions.hugePages = true;
 		else if (arg == "--current-block" && i + 1 < argc)
 			m_currentBlock = stol(argv[++i]);
 		else if (arg == "--no-precompute")
@@ -210,8 +229,13 @@ public:
 
 	void execute()
 	{
+		EthashAux::setDAGOptions(m_dagOptions);
 		if (m_minerType == "cpu")
+		{
 			EthashCPUMiner::setNumInstances(m_miningThreads);
+			EthashCPUMiner::setHugePages(m_hugePages);
+			EthashCPUMiner::setNumaReplicas(m_numaReplicas);
+		}
 		if (mode == OperationMode::DAGInit)
 			doInitDAG(m_initDAG);
 		else if (mode == OperationMode::Benchmark)
@@ -233,8 +257,15 @@ public:
 			<< "    --benchmark-trials <n>  Set the number of trials for the benchmark tests (default: 5)." << endl
 			<< "DAG creation mode:" << endl
 			<< "    -D,--create-dag <number>  Create the DAG in preparation for mining on given block and exit." << endl
+			<< "DAG memory:" << endl
+			<< "    --dag-dir <path>  Map DAGs already generated in <path> read-only, sharing them with other processes on this host." << endl
+			<< "    --dag-epochs <n>  Keep at most <n> unused DAGs (and <n> + 1 light caches) loaded (default: 2)." << endl
+			<< "    --dag-populate  Fault the whole DAG into memory when it is mapped." << endl
+			<< "    --dag-huge-pages  Ask for DAG mappings to be backed by huge pages, where the filesystem allows it." << endl
 			<< "Mining configuration:" << endl
 			<< "    -C,--cpu  When mining, use the CPU." << endl
+			<< "    --cpu-huge-pages  When CPU mining, keep a copy of the DAG in huge pages." << endl
+			<< "    --cpu-numa  When CPU mining, keep a copy of the DAG on each NUMA node and pin threads to the nodes." << endl
 			<< "    -t, --mining-threads <n> Limit number of CPU/GPU miners to n (default: use everything available on selected platform)" << endl
 			<< "    --current-block Let the miner know the current block number at configuration time. Will help determine DAG size and required GPU memory." << endl
 			<< "    --disable-submit-hashrate  When mining, don't submit hashrate to node." << endl;
@@ -312,6 +343,9 @@ private:
 	/// Mining options
 	std::string m_minerType = "cpu";
 	unsigned m_miningThreads = UINT_MAX;
+	bool m_hugePages = false;
+	bool m_numaReplicas = false;
+	EthashAux::DAGOptions m_dagOptions;
 	uint64_t m_currentBlock = 0;
 
 	/// DAG initialisation param.
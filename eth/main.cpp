@@ -39,6 +39,7 @@
 #include <libethcore/ICAP.h>
 #include <libethereum/Defaults.h>
 #include <libethereum/BlockChainSync.h>
+#include <libethereum/RollingGasPricer.h>
 #include <libethashseal/EthashClient.h>
 #include <libethashseal/GenesisInfo.h>
 #include <libwebthree/WebThree.h>
@@ -64,6 +65,7 @@
 #include "MinerAux.h"
 #include "BuildInfo.h"
 #include "AccountManager.h"
+#include "ChainImporter.h"
 
 using namespace std;
 using namespace dev;
@@ -104,6 +106,7 @@ void help()
 		<< "    --admin <password>  Specify admin session key for JSON-RPC (default: auto-generated and printed at start-up)." << endl
 		<< "    -K,--kill  Kill the blockchain first." << endl
 		<< "    -R,--rebuild  Rebuild the blockchain from the existing database." << endl
+		<< "    --verify-state  Re-execute the chain in parallel to check every block's state root, then exit." << endl
 		<< "    --rescue  Attempt to rescue a corrupt database." << endl
 		<< endl
 		<< "    --import-presale <file>  Import a pre-sale key; you'll need to specify the password to this key." << endl
@@ -117,6 +120,7 @@ void help()
 		<< "    -P,--priority <0 - 100>  Set the default priority percentage (%) of a transaction (default: 50)." << endl*/
 		<< "    --ask <wei>  Set the minimum ask gas price under which no transaction will be mined (default " << toString(DefaultGasPrice) << " )." << endl
 		<< "    --bid <wei>  Set the bid gas price to pay for transactions (default " << toString(DefaultGasPrice) << " )." << endl
+		<< "    --gas-oracle <n>  Bid the gas prices paid in the last <n> blocks, by transaction priority, rather than the --bid price." << endl
 		<< "    --unsafe-transactions  Allow all transactions to proceed without verification. EXTREMELY UNSAFE."
 		<< endl
 		<< "Client mining:" << endl
@@ -132,6 +136,10 @@ void help()
 		<< "    --no-bootstrap  Do not connect to the default Ethereum peer servers (default only when --no-discovery is used)." << endl
 		<< "    -x,--peers <number>  Attempt to connect to a given number of peers (default: 11)." << endl
 		<< "    --peer-stretch <number>  Give the accepted connection multiplier (default: 7)." << endl
+		<< "    --network-threads <n>  Handle connections on this many threads (default: 2)." << endl
+		<< "    --handler-threads <n>  Serve peers' requests for chain data on this many threads; 0 serves them on the network threads (default: 2)." << endl
+		<< "    --egress-limit <bytes>  Send at most this many bytes per second to all peers together; 0 for no limit (default: 0)." << endl
+		<< "    --peer-egress-limit <bytes>  Send at most this many bytes per second to each peer; 0 for no limit (default: 0)." << endl
 
 		<< "    --public-ip <ip>  Force advertised public IP to the given IP (default: auto)." << endl
 		<< "    --listen-ip <ip>(:<port>)  Listen on the given IP for incoming connections (default: 0.0.0.0)." << endl
@@ -159,10 +167,12 @@ void help()
 		<< "    --from <n>  Export only from block n; n may be a decimal, a '0x' prefixed hash, or 'latest'." << endl
 		<< "    --to <n>  Export only to block n (inclusive); n may be a decimal, a '0x' prefixed hash, or 'latest'." << endl
 		<< "    --only <n>  Equivalent to --export-from n --export-to n." << endl
+		<< "    With --verify-state, --from defaults to just after the last verified checkpoint." << endl
 		<< "    --dont-check  Prevent checking some block aspects. Faster importing, but to apply only when the data is known to be valid." << endl
 		<< endl
 		<< "General Options:" << endl
 		<< "    -d,--db-path,--datadir <path>  Load database from path (default: " << getDataDir() << ")." << endl
+		<< "    --freezer-depth <n>  Move blocks older than n blocks behind the head into the flat-file freezer; 0 disables (default: " << Defaults::freezerDepth() << ")." << endl
 #if ETH_EVMJIT
 		<< "    --vm <vm-kind>  Select VM; options are: interpreter, jit or smart (default: interpreter)." << endl
 #endif // ETH_EVMJIT
@@ -261,7 +271,8 @@ enum class OperationMode
 {
 	Node,
 	Import,
-	Export
+	Export,
+	VerifyState
 };
 
 enum class Format
@@ -332,6 +343,7 @@ int main(int argc, char** argv)
 	/// Hashes/numbers for export range.
 	string exportFrom = "1";
 	string exportTo = "latest";
+	bool exportFromSet = false;
 	Format exportFormat = Format::Binary;
 
 	/// General params for Node operation
@@ -360,6 +372,10 @@ int main(int argc, char** argv)
 
 	unsigned peers = 11;
 	unsigned peerStretch = 7;
+	unsigned networkThreads = 2;
+	unsigned handlerThreads = 2;
+	size_t egressLimit = 0;
+	size_t peerEgressLimit = 0;
 	std::map<NodeID, pair<NodeIPEndpoint,bool>> preferredNodes;
 	bool bootstrap = true;
 	bool disableDiscovery = false;
@@ -381,6 +397,7 @@ int main(int argc, char** argv)
 //	double blockFees = 15.0;
 	u256 askPrice = DefaultGasPrice;
 	u256 bidPrice = DefaultGasPrice;
+	unsigned gasOracleBlocks = 0;
 	bool alwaysConfirm = true;
 
 	/// Wallet password stuff
@@ -493,9 +510,15 @@ int main(int argc, char** argv)
 		else if (arg == "--to" && i + 1 < argc)
 			exportTo = argv[++i];
 		else if (arg == "--from" && i + 1 < argc)
+		{
 			exportFrom = argv[++i];
+			exportFromSet = true;
+		}
 		else if (arg == "--only" && i + 1 < argc)
+		{
 			exportTo = exportFrom = argv[++i];
+			exportFromSet = true;
+		}
 		else if (arg == "--upnp" && i + 1 < argc)
 		{
 			string m = argv[++i];
@@ -543,6 +566,8 @@ int main(int argc, char** argv)
 			withExisting = WithExisting::Verify;
 		else if (arg == "-R" || arg == "--rescue")
 			withExisting = WithExisting::Rescue;
+		else if (arg == "--verify-state")
+			mode = OperationMode::VerifyState;
 		else if (arg == "--client-name" && i + 1 < argc)
 			clientName = argv[++i];
 		else if ((arg == "-a" || arg == "--address" || arg == "--author") && i + 1 < argc)
@@ -573,6 +598,18 @@ int main(int argc, char** argv)
 			setDataDir(argv[++i]);
 		else if (arg == "--ipcpath" && i + 1 < argc )
 			setIpcPath(argv[++i]);
+		else if (arg == "--freezer-depth" && i + 1 < argc)
+		{
+			try
+			{
+				Defaults::setFreezerDepth(stoi(argv[++i]));
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				return -1;
+			}
+		}
 		else if ((arg == "--genesis-json" || arg == "--genesis") && i + 1 < argc)
 		{
 			try
@@ -639,6 +676,18 @@ int main(int argc, char** argv)
 				return -1;
 			}
 		}
+		else if (arg == "--gas-oracle" && i + 1 < argc)
+		{
+			try
+			{
+				gasOracleBlocks = stoul(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				return -1;
+			}
+		}
 		else if ((arg == "-m" || arg == "--mining") && i + 1 < argc)
 		{
 			string m = argv[++i];
@@ -696,6 +745,14 @@ int main(int argc, char** argv)
 			peers = atoi(argv[++i]);
 		else if (arg == "--peer-stretch" && i + 1 < argc)
 			peerStretch = atoi(argv[++i]);
+		else if (arg == "--network-threads" && i + 1 < argc)
+			networkThreads = max(atoi(argv[++i]), 1);
+		else if (arg == "--handler-threads" && i + 1 < argc)
+			handlerThreads = max(atoi(argv[++i]), 0);
+		else if (arg == "--egress-limit" && i + 1 < argc)
+			egressLimit = max(atoll(argv[++i]), 0LL);
+		else if (arg == "--peer-egress-limit" && i + 1 < argc)
+			peerEgressLimit = max(atoll(argv[++i]), 0LL);
 		else if (arg == "--peerset" && i + 1 < argc)
 		{
 			string peerset = argv[++i];
@@ -911,6 +968,11 @@ int main(int argc, char** argv)
 	auto netPrefs = publicIP.empty() ? NetworkPreferences(listenIP, listenPort, upnp) : NetworkPreferences(publicIP, listenIP ,listenPort, upnp);
 	netPrefs.discovery = (privateChain.empty() && !disableDiscovery) || enableDiscovery;
 	netPrefs.pin = (pinning || !privateChain.empty()) && !noPinning;
+	netPrefs.ioThreads = networkThreads;
+	netPrefs.handlerThreads = handlerThreads;
+	netPrefs.egressLimit = egressLimit;
+	netPrefs.peerEgressLimit = peerEgressLimit;
+	netPrefs.peerStore = getDataDir() + "/peers.rlp";
 
 	auto nodesState = contents(getDataDir() + "/network.rlp");
 	auto caps = useWhisper ? set<string>{"eth", "shh"} : set<string>{"eth"};
@@ -955,75 +1017,67 @@ int main(int argc, char** argv)
 		ofstream fout(filename, std::ofstream::binary);
 		ostream& out = (filename.empty() || filename == "--") ? cout : fout;
 
-		unsigned last = toNumber(exportTo);
-		for (unsigned i = toNumber(exportFrom); i <= last; ++i)
+		// Binary output is gathered into large writes rather than one per block.
+		static const size_t c_exportBufferSize = 4 * 1024 * 1024;
+		bytes buffer;
+		buffer.reserve(c_exportBufferSize);
+		try
 		{
-			bytes block = web3.ethereum()->blockChain().block(web3.ethereum()->blockChain().numberHash(i));
-			switch (exportFormat)
+			web3.ethereum()->blockChain().streamBlocks(toNumber(exportFrom), toNumber(exportTo), [&](bytesConstRef _block)
 			{
-			case Format::Binary: out.write((char const*)block.data(), block.size()); break;
-			case Format::Hex: out << toHex(block) << endl; break;
-			case Format::Human: out << RLP(block) << endl; break;
-			default:;
-			}
+				switch (exportFormat)
+				{
+				case Format::Binary:
+					buffer.insert(buffer.end(), _block.begin(), _block.end());
+					if (buffer.size() >= c_exportBufferSize)
+					{
+						out.write((char const*)buffer.data(), buffer.size());
+						buffer.clear();
+					}
+					break;
+				case Format::Hex: out << toHex(_block) << "\n"; break;
+				case Format::Human: out << RLP(_block) << "\n"; break;
+				default:;
+				}
+			});
 		}
+		catch (BlockNotFound const& _e)
+		{
+			cerr << "Export incomplete: " << *boost::get_error_info<errinfo_comment>(_e) << endl;
+			return -1;
+		}
+		out.write((char const*)buffer.data(), buffer.size());
+		out.flush();
 		return 0;
 	}
 
-	if (mode == OperationMode::Import)
+	if (mode == OperationMode::VerifyState)
 	{
-		ifstream fin(filename, std::ifstream::binary);
-		istream& in = (filename.empty() || filename == "--") ? cin : fin;
-		unsigned alreadyHave = 0;
-		unsigned good = 0;
-		unsigned futureTime = 0;
-		unsigned unknownParent = 0;
-		unsigned bad = 0;
-		chrono::steady_clock::time_point t = chrono::steady_clock::now();
-		double last = 0;
-		unsigned lastImported = 0;
-		unsigned imported = 0;
-		while (in.peek() != -1)
+		// Without an explicit --from, resume just after the last verified checkpoint.
+		unsigned from = exportFromSet ? toNumber(exportFrom) : web3.ethereum()->blockChain().verifiedCheckpoint() + 1;
+		unsigned threads = max(thread::hardware_concurrency(), 1u);
+		cout << "Verifying state with " << threads << " threads..." << endl;
+		unsigned lastReported = 0;
+		unsigned bad = web3.ethereum()->verifyState(from, toNumber(exportTo), threads, [&](unsigned _done, unsigned _total)
 		{
-			bytes block(8);
-			in.read((char*)block.data(), 8);
-			block.resize(RLP(block, RLP::LaissezFaire).actualSize());
-			in.read((char*)block.data() + 8, block.size() - 8);
-
-			switch (web3.ethereum()->queueBlock(block, safeImport))
+			if (_done >= lastReported + 1000 || _done == _total)
 			{
-			case ImportResult::Success: good++; break;
-			case ImportResult::AlreadyKnown: alreadyHave++; break;
-			case ImportResult::UnknownParent: unknownParent++; break;
-			case ImportResult::FutureTimeUnknown: unknownParent++; futureTime++; break;
-			case ImportResult::FutureTimeKnown: futureTime++; break;
-			default: bad++; break;
+				cout << _done << " of " << _total << " blocks verified" << endl;
+				lastReported = _done;
 			}
-
-			// sync chain with queue
-			tuple<ImportRoute, bool, unsigned> r = web3.ethereum()->syncQueue(10);
-			imported += get<2>(r);
-
-			double e = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t).count() / 1000.0;
-			if ((unsigned)e >= last + 10)
-			{
-				auto i = imported - lastImported;
-				auto d = e - last;
-				cout << i << " more imported at " << (round(i * 10 / d) / 10) << " blocks/s. " << imported << " imported in " << e << " seconds at " << (round(imported * 10 / e) / 10) << " blocks/s (#" << web3.ethereum()->number() << ")" << endl;
-				last = (unsigned)e;
-				lastImported = imported;
-//				cout << web3.ethereum()->blockQueueStatus() << endl;
-			}
-		}
-
-		bool moreToImport = true;
-		while (moreToImport)
+		});
+		if (bad)
 		{
-			this_thread::sleep_for(chrono::seconds(1));
-			tie(ignore, moreToImport, ignore) = web3.ethereum()->syncQueue(100000);
+			cerr << "State root mismatch at block #" << bad << endl;
+			return -1;
 		}
-		double e = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t).count() / 1000.0;
-		cout << imported << " imported in " << e << " seconds at " << (round(imported * 10 / e) / 10) << " blocks/s (#" << web3.ethereum()->number() << ")" << endl;
+		cout << "All blocks verified up to #" << web3.ethereum()->blockChain().verifiedCheckpoint() << endl;
+		return 0;
+	}
+
+	if (mode == OperationMode::Import)
+	{
+		ChainImporter(*web3.ethereum(), safeImport).importFile(filename, cout);
 		return 0;
 	}
 
@@ -1068,11 +1122,12 @@ int main(int argc, char** argv)
 	web3.setIdealPeerCount(peers);
 	web3.setPeerStretch(peerStretch);
 //	std::shared_ptr<eth::BasicGasPricer> gasPricer = make_shared<eth::BasicGasPricer>(u256(double(ether / 1000) / etherPrice), u256(blockFees * 1000));
-	std::shared_ptr<eth::TrivialGasPricer> gasPricer = make_shared<eth::TrivialGasPricer>(askPrice, bidPrice);
+	std::shared_ptr<eth::TrivialGasPricer> gasPricer = gasOracleBlocks ? make_shared<eth::RollingGasPricer>(askPrice, bidPrice, gasOracleBlocks) : make_shared<eth::TrivialGasPricer>(askPrice, bidPrice);
 	eth::Client* c = nodeMode == NodeMode::Full ? web3.ethereum() : nullptr;
 	if (c)
 	{
 		c->setGasPricer(gasPricer);
+		c->openTransactionJournal();
 		DEV_IGNORE_EXCEPTIONS(asEthashClient(c)->setShouldPrecomputeDAG(m.shouldPrecompute()));
 		c->setSealer(m.minerType());
 		c->setAuthor(author);
@@ -0,0 +1,736 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ArenaTrieDB.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include "TrieDB.h"
+
+namespace dev
+{
+
+/**
+ * @brief Merkle-Patricia trie over a hash-keyed DB which keeps the nodes it changes in memory.
+ *
+ * Has the same interface, database layout and reference counting as GenericTrieDB, so it can be
+ * used wherever that is (e.g. as the base of FatGenericTrieDB). GenericTrieDB re-parses and
+ * re-encodes the RLP of every node on the path of every update. Here the nodes on the path are
+ * loaded once into typed leaf, extension and branch structures taken from per-type pools and
+ * are edited in place; they are only encoded, hashed and written to the DB by commit(), which
+ * root() and the iterators call implicitly. Lookups of nodes not yet loaded go straight to the
+ * DB without loading anything.
+ *
+ * @note Not thread-safe, even for const access.
+ */
+template <class _DB>
+class ArenaTrieDB
+{
+public:
+	using DB = _DB;
+	using ScanCallback = typename GenericTrieDB<DB>::ScanCallback;
+
+	explicit ArenaTrieDB(DB* _db = nullptr): m_db(_db) {}
+	ArenaTrieDB(DB* _db, h256 const& _root, Verification _v = Verification::Normal) { open(_db, _root, _v); }
+	ArenaTrieDB(ArenaTrieDB const& _t): m_db(_t.m_db), m_root(_t.committedRoot()) {}
+	~ArenaTrieDB() { commit(); release(); }
+
+	ArenaTrieDB& operator=(ArenaTrieDB const& _t)
+	{
+		if (&_t != this)
+		{
+			commit();
+			release();
+			m_db = _t.m_db;
+			m_root = _t.committedRoot();
+		}
+		return *this;
+	}
+
+	void open(DB* _db) { commit(); release(); m_db = _db; }
+	void open(DB* _db, h256 const& _root, Verification _v = Verification::Normal) { open(_db); setRoot(_root, _v); }
+
+	void init() { release(); m_root = sha3(RLPNull); m_db->insert(m_root, &RLPNull); }
+
+	void setRoot(h256 const& _root, Verification _v = Verification::Normal)
+	{
+		commit();
+		release();
+		m_root = _root;
+		if (_v == Verification::Normal)
+		{
+			if (m_root == c_shaNull && !m_db->exists(m_root))
+				init();
+		}
+#if ETH_DEBUG
+		if (_v == Verification::Normal)
+#endif
+			if (!node(m_root).size())
+				BOOST_THROW_EXCEPTION(RootNotFound());
+	}
+
+	/// True if the trie is uninitialised (i.e. that the DB doesn't contain the root node).
+	bool isNull() const { return !node(committedRoot()).size(); }
+	/// True if the trie is initialised but empty (i.e. that the DB contains the root node which is empty).
+	bool isEmpty() const { return committedRoot() == c_shaNull && node(m_root).size(); }
+
+	/// Writes out all changes and @returns the root hash.
+	h256 const& root() const { if (node(committedRoot()).empty()) BOOST_THROW_EXCEPTION(BadRoot(m_root)); return m_root; }
+
+	/// Encodes, hashes and writes to the DB every node changed since the last commit.
+	void commit() const;
+
+	std::string at(bytes const& _key) const { return at(&_key); }
+	std::string at(bytesConstRef _key) const;
+	void insert(bytes const& _key, bytes const& _value) { insert(&_key, &_value); }
+	void insert(bytesConstRef _key, bytes const& _value) { insert(_key, &_value); }
+	void insert(bytes const& _key, bytesConstRef _value) { insert(&_key, _value); }
+	void insert(bytesConstRef _key, bytesConstRef _value);
+	void remove(bytes const& _key) { remove(&_key); }
+	void remove(bytesConstRef _key);
+	bool contains(bytes const& _key) { return contains(&_key); }
+	bool contains(bytesConstRef _key) { return !at(_key).empty(); }
+
+	/// Iterates over the committed trie.
+	class iterator: public GenericTrieDB<DB>::iterator
+	{
+	public:
+		using Super = typename GenericTrieDB<DB>::iterator;
+
+		iterator() {}
+		iterator(ArenaTrieDB const* _t): Super(_t->committed()) {}
+		iterator(ArenaTrieDB const* _t, bytesConstRef _key): Super(_t->committed(), _key) {}
+	};
+
+	iterator begin() const { return iterator(this); }
+	iterator end() const { return iterator(); }
+	iterator lower_bound(bytesConstRef _key) const { return iterator(this, _key); }
+
+	unsigned scan(bytesConstRef _start, unsigned _limit, ScanCallback const& _f, std::vector<bytes>* _proof = nullptr) const { return committed()->scan(_start, _limit, _f, _proof); }
+	void parallelScan(ScanCallback const& _f, unsigned _threads) const { committed()->parallelScan(_f, _threads); }
+	void prove(bytesConstRef _key, std::vector<bytes>& o_proof, h256Hash& _seen) const { committed()->prove(_key, o_proof, _seen); }
+
+	/// Used for debugging, scans the whole trie.
+	h256Hash leftOvers(std::ostream* _out = nullptr) const { return committed()->leftOvers(_out); }
+	/// Used for debugging, scans the whole trie.
+	void debugStructure(std::ostream& _out) const { committed()->debugStructure(_out); }
+	/// Used for debugging, scans the whole trie.
+	bool check(bool _requireNoLeftOvers) const { return committed()->check(_requireNoLeftOvers); }
+
+	/// Get the underlying database.
+	DB const* db() const { return m_db; }
+	DB* db() { return m_db; }
+
+private:
+	enum class NodeType: byte { Ref, Leaf, Extension, Branch };
+
+	/// Common part of all nodes; a plain Node is a reference to a node not yet loaded.
+	struct Node
+	{
+		NodeType type;
+		bool dirty;
+		h256 hash;				///< Key of the node in the DB; null if it is inline, dirty or the root.
+	};
+	struct Leaf: Node
+	{
+		bytes key;				///< Remaining key, one nibble per byte.
+		bytes value;
+	};
+	struct Extension: Node
+	{
+		bytes key;				///< Shared key, one nibble per byte.
+		Node* child;
+	};
+	struct Branch: Node
+	{
+		std::array<Node*, 16> children;
+		bytes value;
+	};
+
+	/// Free-list allocator; released nodes keep their buffers for reuse.
+	template <class T>
+	class Pool
+	{
+	public:
+		T* alloc()
+		{
+			if (m_free.empty())
+			{
+				m_chunks.emplace_back(new T[c_chunkSize]);
+				for (unsigned i = 0; i < c_chunkSize; ++i)
+					m_free.push_back(&m_chunks.back()[c_chunkSize - 1 - i]);
+			}
+			T* ret = m_free.back();
+			m_free.pop_back();
+			++m_live;
+			return ret;
+		}
+		void release(T* _n) { m_free.push_back(_n); --m_live; }
+		size_t live() const { return m_live; }
+
+	private:
+		static const unsigned c_chunkSize = 256;
+		std::vector<std::unique_ptr<T[]>> m_chunks;
+		std::vector<T*> m_free;
+		size_t m_live = 0;
+	};
+
+	/// Number of loaded nodes above which the whole tree is dropped after a commit.
+	static const size_t c_maxResidentNodes = 1 << 16;
+
+	h256 const& committedRoot() const { commit(); return m_root; }
+	std::string node(h256 const& _h) const { return m_db->lookup(_h); }
+	GenericTrieDB<DB> const* committed() const { commit(); m_committed.open(m_db, m_root, Verification::Skip); return &m_committed; }
+
+	Node* newRef(h256 const& _h) const { Node* n = m_refs.alloc(); n->type = NodeType::Ref; n->dirty = false; n->hash = _h; return n; }
+	Leaf* newLeaf(NibbleSlice _k, bytesConstRef _v);
+	Extension* newExtension(bytes const& _key, unsigned _end, Node* _child);
+	Branch* newBranch();
+	/// Returns @a _n to its pool; if it was stored in the DB, its entry is released at the next commit.
+	void free(Node* _n) const;
+	/// Frees @a _n and everything loaded below it without touching the DB.
+	void freeTree(Node* _n) const;
+	void release() const { freeTree(m_rootNode); m_rootNode = nullptr; m_loaded = false; m_changed = false; m_killed.clear(); }
+
+	/// Marks @a _n as about to be changed.
+	void touch(Node* _n) { if (!_n->dirty) { if (_n->hash) m_killed.push_back(_n->hash); _n->hash = h256(); _n->dirty = true; } }
+
+	Node* parse(RLP const& _r, h256 const& _hash) const;
+	Node* parseChild(RLP const& _r) const { return _r.isEmpty() ? nullptr : _r.isList() ? parse(_r, h256()) : newRef(_r.toHash<h256>()); }
+	/// Loads the node referenced by @a io_slot if needed. @returns the loaded node.
+	Node* resolve(Node*& io_slot) const;
+	void loadRoot() const;
+
+	Node* insertAt(Node* _n, NibbleSlice _k, bytesConstRef _v);
+	Node* removeAt(Node* _n, NibbleSlice _k, bool& o_changed);
+	/// Restores the canonical form of branch @a _b after one of its entries went.
+	Node* collapse(Branch* _b);
+	/// Merges @a _e with its (just changed) child if that is no longer a branch.
+	Node* collapse(Extension* _e);
+
+	std::string atAux(Node const* _n, NibbleSlice _k) const;
+	std::string atRLP(RLP const& _r, NibbleSlice _k) const;
+
+	/// Appends the RLP of @a _n to @a _s.
+	void encode(Node* _n, RLPStream& _s) const;
+	/// Appends a reference to @a _n (inline RLP, hash or null) to @a _s, writing @a _n to the DB if needed.
+	void encodeChild(Node* _n, RLPStream& _s) const;
+
+	DB* m_db = nullptr;
+	mutable h256 m_root;							///< Root as of the last commit.
+	mutable Node* m_rootNode = nullptr;
+	mutable bool m_loaded = false;					///< True if m_rootNode represents the current root.
+	mutable bool m_changed = false;					///< True if anything was changed since the last commit.
+	mutable std::vector<h256> m_killed;				///< DB entries of stored nodes changed since the last commit.
+	mutable GenericTrieDB<DB> m_committed;			///< View of the committed trie for iteration.
+
+	mutable Pool<Node> m_refs;
+	mutable Pool<Leaf> m_leaves;
+	mutable Pool<Extension> m_extensions;
+	mutable Pool<Branch> m_branches;
+};
+
+template <class DB> void ArenaTrieDB<DB>::commit() const
+{
+	if (!m_changed)
+		return;
+
+	for (auto const& h: m_killed)
+		m_db->kill(h);
+	m_killed.clear();
+	m_db->kill(m_root);
+
+	// The root is always stored by hash, however small it is.
+	RLPStream s;
+	if (m_rootNode)
+		encode(m_rootNode, s);
+	else
+		s.appendRaw(RLPNull);
+	m_root = sha3(s.out());
+	m_db->insert(m_root, &s.out());
+	m_changed = false;
+
+	if (m_refs.live() + m_leaves.live() + m_extensions.live() + m_branches.live() > c_maxResidentNodes)
+		release();
+}
+
+template <class DB> std::string ArenaTrieDB<DB>::at(bytesConstRef _key) const
+{
+	if (!m_loaded)
+		return atRLP(RLP(node(m_root)), NibbleSlice(_key));
+	return atAux(m_rootNode, NibbleSlice(_key));
+}
+
+template <class DB> std::string ArenaTrieDB<DB>::atAux(Node const* _n, NibbleSlice _k) const
+{
+	while (_n)
+	{
+		switch (_n->type)
+		{
+		case NodeType::Ref:
+			return atRLP(RLP(node(_n->hash)), _k);
+		case NodeType::Leaf:
+		{
+			Leaf const* l = static_cast<Leaf const*>(_n);
+			if (_k.size() != l->key.size())
+				return std::string();
+			for (unsigned i = 0; i < _k.size(); ++i)
+				if (_k[i] != l->key[i])
+					return std::string();
+			return asString(l->value);
+		}
+		case NodeType::Extension:
+		{
+			Extension const* e = static_cast<Extension const*>(_n);
+			if (_k.size() < e->key.size())
+				return std::string();
+			for (unsigned i = 0; i < e->key.size(); ++i)
+				if (_k[i] != e->key[i])
+					return std::string();
+			_k = _k.mid(e->key.size());
+			_n = e->child;
+			break;
+		}
+		case NodeType::Branch:
+		{
+			Branch const* b = static_cast<Branch const*>(_n);
+			if (_k.empty())
+				return asString(b->value);
+			_n = b->children[_k[0]];
+			_k = _k.mid(1);
+			break;
+		}
+		}
+	}
+	return std::string();
+}
+
+template <class DB> std::string ArenaTrieDB<DB>::atRLP(RLP const& _r, NibbleSlice _k) const
+{
+	if (_r.isEmpty() || _r.isNull())
+		return std::string();
+	if (_r.itemCount() == 2)
+	{
+		NibbleSlice k = keyOf(_r);
+		if (isLeaf(_r))
+			return _k == k ? _r[1].toString() : std::string();
+		if (!_k.contains(k))
+			return std::string();
+		return _r[1].isList() ? atRLP(_r[1], _k.mid(k.size())) : atRLP(RLP(node(_r[1].toHash<h256>())), _k.mid(k.size()));
+	}
+	if (_k.empty())
+		return _r[16].toString();
+	RLP c = _r[_k[0]];
+	if (c.isEmpty())
+		return std::string();
+	return c.isList() ? atRLP(c, _k.mid(1)) : atRLP(RLP(node(c.toHash<h256>())), _k.mid(1));
+}
+
+template <class DB> void ArenaTrieDB<DB>::insert(bytesConstRef _key, bytesConstRef _value)
+{
+	loadRoot();
+	m_rootNode = insertAt(resolve(m_rootNode), NibbleSlice(_key), _value);
+	m_changed = true;
+}
+
+template <class DB> void ArenaTrieDB<DB>::remove(bytesConstRef _key)
+{
+	loadRoot();
+	bool changed = false;
+	m_rootNode = removeAt(resolve(m_rootNode), NibbleSlice(_key), changed);
+	m_changed = m_changed || changed;
+}
+
+template <class DB> void ArenaTrieDB<DB>::loadRoot() const
+{
+	if (m_loaded)
+		return;
+	std::string r = node(m_root);
+	if (r.empty())
+		BOOST_THROW_EXCEPTION(BadRoot(m_root));
+	// The root's DB entry is released by commit() itself, so it is not tracked through the node.
+	m_rootNode = parse(RLP(r), h256());
+	m_loaded = true;
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Node* ArenaTrieDB<DB>::parse(RLP const& _r, h256 const& _hash) const
+{
+	if (_r.isEmpty() || _r.isNull())
+		return nullptr;
+	if (!_r.isList() || (_r.itemCount() != 2 && _r.itemCount() != 17))
+		BOOST_THROW_EXCEPTION(InvalidTrie());
+
+	Node* ret;
+	if (_r.itemCount() == 2)
+	{
+		NibbleSlice k = keyOf(_r);
+		bytes* key;
+		if (isLeaf(_r))
+		{
+			Leaf* l = m_leaves.alloc();
+			l->type = NodeType::Leaf;
+			bytesConstRef v = _r[1].payload();
+			l->value.assign(v.begin(), v.end());
+			key = &l->key;
+			ret = l;
+		}
+		else
+		{
+			Extension* e = m_extensions.alloc();
+			e->type = NodeType::Extension;
+			e->child = parseChild(_r[1]);
+			key = &e->key;
+			ret = e;
+		}
+		key->resize(k.size());
+		for (unsigned i = 0; i < k.size(); ++i)
+			(*key)[i] = k[i];
+	}
+	else
+	{
+		Branch* b = m_branches.alloc();
+		b->type = NodeType::Branch;
+		for (unsigned i = 0; i < 16; ++i)
+			b->children[i] = parseChild(_r[i]);
+		bytesConstRef v = _r[16].payload();
+		b->value.assign(v.begin(), v.end());
+		ret = b;
+	}
+	ret->dirty = false;
+	ret->hash = _hash;
+	return ret;
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Node* ArenaTrieDB<DB>::resolve(Node*& io_slot) const
+{
+	if (io_slot && io_slot->type == NodeType::Ref)
+	{
+		h256 h = io_slot->hash;
+		std::string n = node(h);
+		if (n.empty())
+			BOOST_THROW_EXCEPTION(InvalidTrie());
+		m_refs.release(io_slot);
+		io_slot = parse(RLP(n), h);
+	}
+	return io_slot;
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Leaf* ArenaTrieDB<DB>::newLeaf(NibbleSlice _k, bytesConstRef _v)
+{
+	Leaf* l = m_leaves.alloc();
+	l->type = NodeType::Leaf;
+	l->dirty = true;
+	l->hash = h256();
+	l->key.resize(_k.size());
+	for (unsigned i = 0; i < _k.size(); ++i)
+		l->key[i] = _k[i];
+	l->value.assign(_v.begin(), _v.end());
+	return l;
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Extension* ArenaTrieDB<DB>::newExtension(bytes const& _key, unsigned _end, Node* _child)
+{
+	Extension* e = m_extensions.alloc();
+	e->type = NodeType::Extension;
+	e->dirty = true;
+	e->hash = h256();
+	e->key.assign(_key.begin(), _key.begin() + _end);
+	e->child = _child;
+	return e;
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Branch* ArenaTrieDB<DB>::newBranch()
+{
+	Branch* b = m_branches.alloc();
+	b->type = NodeType::Branch;
+	b->dirty = true;
+	b->hash = h256();
+	b->children.fill(nullptr);
+	b->value.clear();
+	return b;
+}
+
+template <class DB> void ArenaTrieDB<DB>::free(Node* _n) const
+{
+	if (!_n->dirty && _n->hash)
+		m_killed.push_back(_n->hash);
+	switch (_n->type)
+	{
+	case NodeType::Ref: m_refs.release(_n); break;
+	case NodeType::Leaf: m_leaves.release(static_cast<Leaf*>(_n)); break;
+	case NodeType::Extension: m_extensions.release(static_cast<Extension*>(_n)); break;
+	case NodeType::Branch: m_branches.release(static_cast<Branch*>(_n)); break;
+	}
+}
+
+template <class DB> void ArenaTrieDB<DB>::freeTree(Node* _n) const
+{
+	if (!_n)
+		return;
+	switch (_n->type)
+	{
+	case NodeType::Ref: m_refs.release(_n); break;
+	case NodeType::Leaf: m_leaves.release(static_cast<Leaf*>(_n)); break;
+	case NodeType::Extension:
+		freeTree(static_cast<Extension*>(_n)->child);
+		m_extensions.release(static_cast<Extension*>(_n));
+		break;
+	case NodeType::Branch:
+		for (Node* c: static_cast<Branch*>(_n)->children)
+			freeTree(c);
+		m_branches.release(static_cast<Branch*>(_n));
+		break;
+	}
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Node* ArenaTrieDB<DB>::insertAt(Node* _n, NibbleSlice _k, bytesConstRef _v)
+{
+	if (!_n)
+		return newLeaf(_k, _v);
+
+	if (_n->type == NodeType::Branch)
+	{
+		Branch* b = static_cast<Branch*>(_n);
+		touch(b);
+		if (_k.empty())
+			b->value.assign(_v.begin(), _v.end());
+		else
+			b->children[_k[0]] = insertAt(resolve(b->children[_k[0]]), _k.mid(1), _v);
+		return b;
+	}
+
+	bool leaf = _n->type == NodeType::Leaf;
+	bytes& key = leaf ? static_cast<Leaf*>(_n)->key : static_cast<Extension*>(_n)->key;
+	unsigned shared = 0;
+	while (shared < key.size() && shared < _k.size() && key[shared] == _k[shared])
+		++shared;
+
+	if (leaf && shared == key.size() && shared == _k.size())
+	{
+		touch(_n);
+		static_cast<Leaf*>(_n)->value.assign(_v.begin(), _v.end());
+		return _n;
+	}
+	if (!leaf && shared == key.size())
+	{
+		Extension* e = static_cast<Extension*>(_n);
+		touch(e);
+		e->child = insertAt(resolve(e->child), _k.mid(shared), _v);
+		return e;
+	}
+
+	// The keys diverge (or one ends) at nibble @a shared: put a branch there.
+	Branch* b = newBranch();
+	Extension* top = shared ? newExtension(key, shared, b) : nullptr;
+
+	if (shared == key.size())
+	{
+		// Only a leaf can end here.
+		b->value = std::move(static_cast<Leaf*>(_n)->value);
+		free(_n);
+	}
+	else if (!leaf && shared + 1 == key.size())
+	{
+		b->children[key[shared]] = static_cast<Extension*>(_n)->child;
+		free(_n);
+	}
+	else
+	{
+		touch(_n);
+		byte i = key[shared];
+		key.erase(key.begin(), key.begin() + shared + 1);
+		b->children[i] = _n;
+	}
+
+	if (shared == _k.size())
+		b->value.assign(_v.begin(), _v.end());
+	else
+		b->children[_k[shared]] = newLeaf(_k.mid(shared + 1), _v);
+
+	return top ? static_cast<Node*>(top) : b;
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Node* ArenaTrieDB<DB>::removeAt(Node* _n, NibbleSlice _k, bool& o_changed)
+{
+	if (!_n)
+		return nullptr;
+
+	if (_n->type == NodeType::Leaf)
+	{
+		bytes const& key = static_cast<Leaf*>(_n)->key;
+		if (key.size() != _k.size())
+			return _n;
+		for (unsigned i = 0; i < key.size(); ++i)
+			if (key[i] != _k[i])
+				return _n;
+		free(_n);
+		o_changed = true;
+		return nullptr;
+	}
+
+	if (_n->type == NodeType::Extension)
+	{
+		Extension* e = static_cast<Extension*>(_n);
+		if (_k.size() < e->key.size())
+			return e;
+		for (unsigned i = 0; i < e->key.size(); ++i)
+			if (e->key[i] != _k[i])
+				return e;
+		Node* c = removeAt(resolve(e->child), _k.mid(e->key.size()), o_changed);
+		if (!o_changed)
+			return e;
+		touch(e);
+		e->child = c;
+		return collapse(e);
+	}
+
+	Branch* b = static_cast<Branch*>(_n);
+	if (_k.empty())
+	{
+		if (b->value.empty())
+			return b;
+		touch(b);
+		b->value.clear();
+		o_changed = true;
+		return collapse(b);
+	}
+	Node*& slot = b->children[_k[0]];
+	if (!slot)
+		return b;
+	Node* c = removeAt(resolve(slot), _k.mid(1), o_changed);
+	if (!o_changed)
+		return b;
+	touch(b);
+	slot = c;
+	return collapse(b);
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Node* ArenaTrieDB<DB>::collapse(Branch* _b)
+{
+	unsigned only = 16;
+	unsigned count = _b->value.empty() ? 0 : 1;
+	for (unsigned i = 0; i < 16; ++i)
+		if (_b->children[i])
+		{
+			only = i;
+			++count;
+		}
+	if (count > 1)
+		return _b;
+
+	Node* ret;
+	if (only == 16)
+		// Just the value is left.
+		ret = newLeaf(NibbleSlice(), &_b->value);
+	else
+	{
+		Node* c = resolve(_b->children[only]);
+		if (c->type == NodeType::Branch)
+		{
+			bytes k(1, (byte)only);
+			ret = newExtension(k, 1, c);
+		}
+		else
+		{
+			touch(c);
+			bytes& key = c->type == NodeType::Leaf ? static_cast<Leaf*>(c)->key : static_cast<Extension*>(c)->key;
+			key.insert(key.begin(), (byte)only);
+			ret = c;
+		}
+	}
+	free(_b);
+	return ret;
+}
+
+template <class DB> typename ArenaTrieDB<DB>::Node* ArenaTrieDB<DB>::collapse(Extension* _e)
+{
+	Node* c = _e->child;
+	if (!c)
+	{
+		free(_e);
+		return nullptr;
+	}
+	if (c->type == NodeType::Branch || c->type == NodeType::Ref)
+		return _e;
+
+	touch(c);
+	bytes& key = c->type == NodeType::Leaf ? static_cast<Leaf*>(c)->key : static_cast<Extension*>(c)->key;
+	key.insert(key.begin(), _e->key.begin(), _e->key.end());
+	free(_e);
+	return c;
+}
+
+template <class DB> void ArenaTrieDB<DB>::encode(Node* _n, RLPStream& _s) const
+{
+	switch (_n->type)
+	{
+	case NodeType::Ref:
+		assert(false);
+		break;
+	case NodeType::Leaf:
+	{
+		Leaf* l = static_cast<Leaf*>(_n);
+		_s.appendList(2) << hexPrefixEncode(l->key, true) << l->value;
+		break;
+	}
+	case NodeType::Extension:
+	{
+		Extension* e = static_cast<Extension*>(_n);
+		_s.appendList(2) << hexPrefixEncode(e->key, false);
+		encodeChild(e->child, _s);
+		break;
+	}
+	case NodeType::Branch:
+	{
+		Branch* b = static_cast<Branch*>(_n);
+		_s.appendList(17);
+		for (Node* c: b->children)
+			encodeChild(c, _s);
+		_s << b->value;
+		break;
+	}
+	}
+	_n->dirty = false;
+}
+
+template <class DB> void ArenaTrieDB<DB>::encodeChild(Node* _n, RLPStream& _s) const
+{
+	if (!_n)
+		_s << bytes();
+	else if (_n->hash)
+		// Unchanged and stored; no need to look inside.
+		_s << _n->hash;
+	else
+	{
+		RLPStream s;
+		encode(_n, s);
+		if (s.out().size() < 32)
+			_s.appendRaw(s.out());
+		else
+		{
+			_n->hash = sha3(s.out());
+			m_db->insert(_n->hash, &s.out());
+			_s << _n->hash;
+		}
+	}
+}
+
+}
@@ -0,0 +1,102 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RotatingBloom.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <array>
+#include "FixedHash.h"
+
+namespace dev
+{
+
+/**
+ * Fixed-size approximate set of (uniformly distributed) hashes, which forgets old entries.
+ *
+ * Hashes go into a bloom filter of N bytes, P bits each. Once it holds its capacity it becomes the
+ * previous generation and a new, empty one is started; lookups check both, so a hash is remembered
+ * for at least one full generation. False positives are possible, false negatives only for hashes
+ * older than that.
+ */
+template <unsigned N, unsigned P = 3>
+class RotatingBloom
+{
+public:
+	/// @param _capacity number of hashes inserted into a generation before it is rotated out.
+	explicit RotatingBloom(unsigned _capacity): m_capacity(_capacity) {}
+
+	template <unsigned M> void insert(FixedHash<M> const& _h)
+	{
+		if (m_count >= m_capacity)
+		{
+			m_previous = m_current;
+			m_current = FixedHash<N>();
+			m_count = 0;
+		}
+		for (unsigned b: bits(_h))
+			m_current[N - 1 - b / 8] |= 1 << (b % 8);
+		++m_count;
+	}
+
+	template <unsigned M> bool contains(FixedHash<M> const& _h) const
+	{
+		std::array<unsigned, P> b = bits(_h);
+		return has(m_current, b) || has(m_previous, b);
+	}
+
+	void clear() { m_current = m_previous = FixedHash<N>(); m_count = 0; }
+
+private:
+	/// @returns the indices of the bits @a _h sets; the same as those of FixedHash::bloomPart<P, N>().
+	template <unsigned M> static std::array<unsigned, P> bits(FixedHash<M> const& _h)
+	{
+		unsigned const c_bloomBits = N * 8;
+		unsigned const c_mask = c_bloomBits - 1;
+		unsigned const c_bloomBytes = (StaticLog2<c_bloomBits>::result + 7) / 8;
+
+		static_assert((N & (N - 1)) == 0, "N must be power-of-two");
+		static_assert(P * c_bloomBytes <= M, "out of range");
+
+		std::array<unsigned, P> ret;
+		byte const* p = _h.data();
+		for (unsigned i = 0; i < P; ++i)
+		{
+			unsigned index = 0;
+			for (unsigned j = 0; j < c_bloomBytes; ++j, ++p)
+				index = (index << 8) | *p;
+			ret[i] = index & c_mask;
+		}
+		return ret;
+	}
+
+	static bool has(FixedHash<N> const& _filter, std::array<unsigned, P> const& _bits)
+	{
+		for (unsigned b: _bits)
+			if (!(_filter[N - 1 - b / 8] & (1 << (b % 8))))
+				return false;
+		return true;
+	}
+
+	FixedHash<N> m_current;
+	FixedHash<N> m_previous;
+	unsigned m_count = 0;
+	unsigned m_capacity;
+};
+
+}
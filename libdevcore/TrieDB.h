@@ -21,7 +21,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include "db.h"
 #include "Common.h"
 #include "Log.h"
@@ -98,6 +103,9 @@ public:
 
 	h256 const& root() const { if (node(m_root).empty()) BOOST_THROW_EXCEPTION(BadRoot(m_root)); /*std::cout << "Returning root as " << ret << " (really " << m_root << ")" << std::endl;*/ return m_root; }	// patch the root in the case of the empty trie. TODO: handle this properly.
 
+	/// Nothing to do; changes are written to the DB as they are made. See ArenaTrieDB::commit().
+	void commit() const {}
+
 	std::string at(bytes const& _key) const { return at(&_key); }
 	std::string at(bytesConstRef _key) const;
 	void insert(bytes const& _key, bytes const& _value) { insert(&_key, &_value); }
@@ -158,6 +166,25 @@ public:
 
 	iterator lower_bound(bytesConstRef _key) const { return iterator(this, _key); }
 
+	/// Called for each item visited by scan(). Key and value point into the trie's own node data
+	/// and are only valid during the call. @returns false to end the scan.
+	using ScanCallback = std::function<bool(bytesConstRef _key, bytesConstRef _value)>;
+
+	/// Visits, in key order and without copying them, up to @a _limit items whose keys are not less
+	/// than @a _start. Much cheaper than iterator, which re-encodes its trail on every step.
+	/// @param _proof if given, the nodes proving the range (the paths to @a _start and to the last
+	/// item visited) are appended to it; they are enough to re-derive the root.
+	/// @returns the number of items visited.
+	unsigned scan(bytesConstRef _start, unsigned _limit, ScanCallback const& _f, std::vector<bytes>* _proof = nullptr) const;
+
+	/// Visits every item, handing the subtries below the root's branches to up to @a _threads threads.
+	/// @a _f is called concurrently and, across subtries, not in key order.
+	void parallelScan(ScanCallback const& _f, unsigned _threads) const;
+
+	/// Appends to @a o_proof those nodes on the path to @a _key (which need not be in the trie)
+	/// not already in @a _seen.
+	void prove(bytesConstRef _key, std::vector<bytes>& o_proof, h256Hash& _seen) const;
+
 	/// Used for debugging, scans the whole trie.
 	void descendKey(h256 const& _k, h256Hash& _keyMask, bool _wasExt, std::ostream* _out, int _indent = 0) const
 	{
@@ -287,6 +314,21 @@ private:
 	bool isTwoItemNode(RLP const& _n) const;
 	std::string deref(RLP const& _n) const;
 
+	/// Per-thread bookkeeping for scan() and parallelScan().
+	struct ScanState
+	{
+		bytes start;					///< Lower bound, as nibbles.
+		unsigned limit;
+		unsigned count = 0;
+		ScanCallback const* f;
+		bytes path;						///< Nibbles of the key of the current node.
+		bytes key;						///< Scratch buffer for the key handed to the callback.
+		std::atomic<bool>* stop;
+	};
+	bool scanRef(ScanState& _s, RLP const& _ref, bool _onBound) const;
+	bool scanNode(ScanState& _s, RLP const& _node, bool _onBound) const;
+	bool scanEmit(ScanState& _s, RLP const& _value) const;
+
 	std::string node(h256 const& _h) const { return m_db->lookup(_h); }
 
 	// These are low-level node insertion functions that just go straight through into the DB.
@@ -363,10 +405,10 @@ std::ostream& operator<<(std::ostream& _out, SpecificTrieDB<Generic, KeyType> co
 	return _out;
 }
 
-template <class _DB>
-class HashedGenericTrieDB: private SpecificTrieDB<GenericTrieDB<_DB>, h256>
+template <class _DB, template <class> class _Generic = GenericTrieDB>
+class HashedGenericTrieDB: private SpecificTrieDB<_Generic<_DB>, h256>
 {
-	using Super = SpecificTrieDB<GenericTrieDB<_DB>, h256>;
+	using Super = SpecificTrieDB<_Generic<_DB>, h256>;
 
 public:
 	using DB = _DB;
@@ -384,12 +426,19 @@ public:
 	using Super::isEmpty;
 
 	using Super::root;
+	using Super::commit;
 	using Super::db;
 
 	using Super::leftOvers;
 	using Super::check;
 	using Super::debugStructure;
 
+	// Keys passed to the callback are the hashed keys.
+	using ScanCallback = typename Super::ScanCallback;
+	using Super::scan;
+	using Super::parallelScan;
+	using Super::prove;
+
 	std::string at(bytesConstRef _key) const { return Super::at(sha3(_key)); }
 	bool contains(bytesConstRef _key) { return Super::contains(sha3(_key)); }
 	void insert(bytesConstRef _key, bytesConstRef _value) { Super::insert(sha3(_key), _value); }
@@ -420,10 +469,10 @@ public:
 };
 
 // Hashed & Hash-key mapping
-template <class _DB>
-class FatGenericTrieDB: private SpecificTrieDB<GenericTrieDB<_DB>, h256>
+template <class _DB, template <class> class _Generic = GenericTrieDB>
+class FatGenericTrieDB: private SpecificTrieDB<_Generic<_DB>, h256>
 {
-	using Super = SpecificTrieDB<GenericTrieDB<_DB>, h256>;
+	using Super = SpecificTrieDB<_Generic<_DB>, h256>;
 
 public:
 	using DB = _DB;
@@ -434,6 +483,7 @@ public:
 	using Super::isNull;
 	using Super::isEmpty;
 	using Super::root;
+	using Super::commit;
 	using Super::leftOvers;
 	using Super::check;
 	using Super::open;
@@ -441,6 +491,12 @@ public:
 	using Super::db;
 	using Super::debugStructure;
 
+	// Keys passed to the callback are the hashed keys.
+	using ScanCallback = typename Super::ScanCallback;
+	using Super::scan;
+	using Super::parallelScan;
+	using Super::prove;
+
 	std::string at(bytesConstRef _key) const { return Super::at(sha3(_key)); }
 	bool contains(bytesConstRef _key) { return Super::contains(sha3(_key)); }
 	void insert(bytesConstRef _key, bytesConstRef _value)
@@ -453,22 +509,23 @@ public:
 	void remove(bytesConstRef _key) { Super::remove(sha3(_key)); }
 
 	// iterates over <key, value> pairs
-	class iterator: public GenericTrieDB<_DB>::iterator
+	class iterator: public _Generic<_DB>::iterator
 	{
 	public:
-		using Super = typename GenericTrieDB<_DB>::iterator;
+		using Super = typename _Generic<_DB>::iterator;
 
 		iterator() { }
-		iterator(FatGenericTrieDB const* _trie) : Super(_trie) { }
+		iterator(FatGenericTrieDB const* _trie) : Super(_trie), m_db(_trie->db()) { }
 
 		typename Super::value_type at() const
 		{
 			auto hashed = Super::at();
-			m_key = static_cast<FatGenericTrieDB const*>(Super::m_that)->db()->lookupAux(h256(hashed.first));
+			m_key = m_db->lookupAux(h256(hashed.first));
 			return std::make_pair(&m_key, std::move(hashed.second));
 		}
 
 	private:
+		_DB const* m_db = nullptr;
 		mutable bytes m_key;
 	};
 
@@ -476,19 +533,22 @@ public:
 	iterator end() const { return iterator(); }
 
 	// iterates over <hashedKey, value> pairs
-	class HashedIterator: public GenericTrieDB<_DB>::iterator
+	class HashedIterator: public _Generic<_DB>::iterator
 	{
 	public:
-		using Super = typename GenericTrieDB<_DB>::iterator;
+		using Super = typename _Generic<_DB>::iterator;
 
 		HashedIterator() {}
-		HashedIterator(FatGenericTrieDB const* _trie) : Super(_trie) {}
+		HashedIterator(FatGenericTrieDB const* _trie) : Super(_trie), m_db(_trie->db()) {}
 
 		bytes key() const
 		{
 			auto hashed = Super::at();
-			return static_cast<FatGenericTrieDB const*>(Super::m_that)->db()->lookupAux(h256(hashed.first));
+			return m_db->lookupAux(h256(hashed.first));
 		}
+
+	private:
+		_DB const* m_db = nullptr;
 	};
 
 	HashedIterator hashedBegin() const { return HashedIterator(this); }
@@ -955,6 +1015,199 @@ template <class DB> std::string GenericTrieDB<DB>::deref(RLP const& _n) const
 	return _n.isList() ? _n.data().toString() : node(_n.toHash<h256>());
 }
 
+template <class DB> unsigned GenericTrieDB<DB>::scan(bytesConstRef _start, unsigned _limit, ScanCallback const& _f, std::vector<bytes>* _proof) const
+{
+	std::atomic<bool> stop(false);
+	ScanState s;
+	s.limit = _limit;
+	s.f = &_f;
+	s.stop = &stop;
+	for (unsigned i = 0; i < _start.size() * 2; ++i)
+		s.start.push_back(nibble(_start, i));
+
+	if (s.limit)
+	{
+		std::string root = node(m_root);
+		scanNode(s, RLP(root), true);
+	}
+
+	if (_proof)
+	{
+		h256Hash seen;
+		prove(_start, *_proof, seen);
+		if (s.count)
+			prove(&s.key, *_proof, seen);
+	}
+	return s.count;
+}
+
+template <class DB> void GenericTrieDB<DB>::parallelScan(ScanCallback const& _f, unsigned _threads) const
+{
+	// Walk down to the first branch; only that has subtries which can be scanned independently.
+	std::string top = node(m_root);
+	bytes path;
+	while (true)
+	{
+		RLP r(top);
+		if (!r.isList() || r.itemCount() != 2 || isLeaf(r))
+			break;
+		NibbleSlice k = keyOf(r);
+		for (unsigned i = 0; i < k.size(); ++i)
+			path.push_back(k[i]);
+		top = deref(r[1]);
+	}
+
+	std::atomic<bool> stop(false);
+	ScanState s;
+	s.limit = (unsigned)-1;
+	s.f = &_f;
+	s.stop = &stop;
+	s.path = path;
+
+	RLP r(top);
+	if (!r.isList() || r.itemCount() != 17 || _threads < 2)
+	{
+		scanNode(s, r, false);
+		return;
+	}
+	if (!r[16].isEmpty() && !scanEmit(s, r[16]))
+		return;
+
+	std::atomic<unsigned> nextBranch(0);
+	std::exception_ptr error;
+	std::mutex x_error;
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < std::min(_threads, 16u); ++t)
+		threads.push_back(std::thread([&]()
+		{
+			ScanState ts = s;
+			RLP tr(top);	// RLP caches lookups, so each thread needs its own.
+			try
+			{
+				for (unsigned i = nextBranch++; i < 16 && !stop; i = nextBranch++)
+				{
+					ts.path.push_back(i);
+					scanRef(ts, tr[i], false);
+					ts.path.pop_back();
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> l(x_error);
+				error = std::current_exception();
+				stop = true;
+			}
+		}));
+	for (auto& t: threads)
+		t.join();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+template <class DB> bool GenericTrieDB<DB>::scanRef(ScanState& _s, RLP const& _ref, bool _onBound) const
+{
+	if (_ref.isEmpty())
+		return true;
+	if (_ref.isList())
+		return scanNode(_s, _ref, _onBound);
+	std::string n = node(_ref.toHash<h256>());
+	return scanNode(_s, RLP(n), _onBound);
+}
+
+template <class DB> bool GenericTrieDB<DB>::scanNode(ScanState& _s, RLP const& _node, bool _onBound) const
+{
+	if (_node.isEmpty())
+		return true;
+	if (!_node.isList() || (_node.itemCount() != 2 && _node.itemCount() != 17))
+		BOOST_THROW_EXCEPTION(InvalidTrie());
+
+	size_t depth = _s.path.size();
+	if (_node.itemCount() == 2)
+	{
+		NibbleSlice k = keyOf(_node);
+		for (unsigned i = 0; i < k.size(); ++i)
+			_s.path.push_back(k[i]);
+
+		if (_onBound)
+		{
+			// Everything below sorts before the bound if our path does, and after it if our path does.
+			size_t n = std::min(_s.path.size(), _s.start.size());
+			int c = memcmp(_s.path.data(), _s.start.data(), n);
+			if (c < 0 || (c == 0 && isLeaf(_node) && _s.path.size() < _s.start.size()))
+			{
+				_s.path.resize(depth);
+				return true;
+			}
+			_onBound = c == 0 && _s.path.size() < _s.start.size();
+		}
+
+		bool ret = isLeaf(_node) ? scanEmit(_s, _node[1]) : scanRef(_s, _node[1], _onBound);
+		_s.path.resize(depth);
+		return ret;
+	}
+
+	if (!_node[16].isEmpty() && (!_onBound || depth >= _s.start.size()) && !scanEmit(_s, _node[16]))
+		return false;
+
+	_onBound = _onBound && depth < _s.start.size();
+	for (unsigned i = _onBound ? _s.start[depth] : 0; i < 16; ++i)
+		if (!_node[i].isEmpty())
+		{
+			_s.path.push_back(i);
+			bool more = scanRef(_s, _node[i], _onBound && i == _s.start[depth]);
+			_s.path.pop_back();
+			if (!more)
+				return false;
+		}
+	return true;
+}
+
+template <class DB> bool GenericTrieDB<DB>::scanEmit(ScanState& _s, RLP const& _value) const
+{
+	if (*_s.stop)
+		return false;
+	assert(!(_s.path.size() & 1));
+	_s.key.resize(_s.path.size() / 2);
+	for (size_t i = 0; i < _s.key.size(); ++i)
+		_s.key[i] = (_s.path[i * 2] << 4) | _s.path[i * 2 + 1];
+	if (!(*_s.f)(&_s.key, _value.payload()))
+	{
+		*_s.stop = true;
+		return false;
+	}
+	return ++_s.count < _s.limit;
+}
+
+template <class DB> void GenericTrieDB<DB>::prove(bytesConstRef _key, std::vector<bytes>& o_proof, h256Hash& _seen) const
+{
+	NibbleSlice k(_key);
+	std::string n = node(m_root);
+	h256 h = m_root;
+	while (true)
+	{
+		if (h && _seen.insert(h).second)
+			o_proof.push_back(asBytes(n));
+		RLP r(n);
+		RLP next;
+		if (r.isList() && r.itemCount() == 2 && !isLeaf(r) && k.contains(keyOf(r)))
+		{
+			next = r[1];
+			k = k.mid(keyOf(r).size());
+		}
+		else if (r.isList() && r.itemCount() == 17 && !k.empty() && !r[k[0]].isEmpty())
+		{
+			next = r[k[0]];
+			k = k.mid(1);
+		}
+		else
+			return;
+
+		// Inline nodes are part of their parent and so already proven.
+		h = next.isList() ? h256() : next.toHash<h256>();
+		n = deref(next);
+	}
+}
+
 template <class DB> bytes GenericTrieDB<DB>::deleteAt(RLP const& _orig, NibbleSlice _k)
 {
 #if ETH_PARANOIA
@@ -39,6 +39,7 @@
 #define ETHASH_ACCESSES 64
 #define ETHASH_DAG_MAGIC_NUM_SIZE 8
 #define ETHASH_DAG_MAGIC_NUM 0xFEE1DEADBADDCAFE
+#define ETHASH_BATCH_NONCES 8
 
 #ifdef __cplusplus
 extern "C" {
@@ -93,6 +94,26 @@ ethash_return_value_t ethash_light_compute(
 	ethash_h256_t const header_hash,
 	uint64_t nonce
 );
+/**
+ * Calculate the light client data for several headers at once
+ *
+ * The DAG items each lookup needs are built from the cache together, so that their
+ * cache reads overlap. Faster per header than @ref ethash_light_compute().
+ *
+ * @param light          The light client handler
+ * @param header_hashes  Array of @a count header hashes to pack into the mixes
+ * @param nonces         Array of @a count nonces, one per header hash
+ * @param count          Number of headers, at most ETHASH_BATCH_NONCES
+ * @param ret            Array of @a count results, one per header
+ * @return               true if all went fine and false for invalid parameters
+ */
+bool ethash_light_compute_batch(
+	ethash_light_t light,
+	ethash_h256_t const* header_hashes,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* ret
+);
 
 /**
  * Allocate and initialize a new ethash_full handler
@@ -110,6 +131,26 @@ ethash_return_value_t ethash_light_compute(
  */
 ethash_full_t ethash_full_new(ethash_light_t light, ethash_callback_t callback);
 
+/// Options of @ref ethash_full_new_opts()
+#define ETHASH_FULL_POPULATE 1	///< Read the whole DAG into memory when mapping it, rather than page by page as it is used
+#define ETHASH_FULL_HUGEPAGES 2	///< Ask for transparent huge pages for the DAG, where the file system allows them
+#define ETHASH_FULL_READONLY 4	///< Only map a complete existing DAG file, read-only; never create one
+
+/**
+ * Allocate and initialize a new ethash_full handler, with options
+ *
+ * A DAG file mapped read-only from a directory shared between processes is backed by
+ * a single copy in the page cache, however many processes map it.
+ *
+ * @param light         The light handler containing the cache.
+ * @param dirname       The directory holding the DAG files, or NULL for the default one.
+ * @param flags         Any of the ETHASH_FULL_* options.
+ * @param callback      As for @ref ethash_full_new(). Not called with ETHASH_FULL_READONLY.
+ * @return              Newly allocated ethash_full handler or NULL in case of
+ *                      ERRNOMEM, invalid parameters or, with ETHASH_FULL_READONLY, no complete DAG file
+ */
+ethash_full_t ethash_full_new_opts(ethash_light_t light, char const* dirname, unsigned flags, ethash_callback_t callback);
+
 /**
  * Frees a previously allocated ethash_full handler
  * @param full    The light handler to free
@@ -128,6 +169,44 @@ ethash_return_value_t ethash_full_compute(
 	ethash_h256_t const header_hash,
 	uint64_t nonce
 );
+/**
+ * Calculate the full client data for consecutive nonces at once
+ *
+ * The DAG lookups of all nonces are interleaved so that their memory accesses overlap,
+ * which makes this considerably faster per nonce than @ref ethash_full_compute().
+ *
+ * @param full           The full client handler
+ * @param header_hash    The header hash to pack into the mix
+ * @param start_nonce    The first nonce; the others follow it
+ * @param count          Number of nonces, at most ETHASH_BATCH_NONCES
+ * @param ret            Array of @a count results, one per nonce
+ * @return               true if all went fine and false for invalid parameters
+ */
+bool ethash_full_compute_batch(
+	ethash_full_t full,
+	ethash_h256_t const header_hash,
+	uint64_t start_nonce,
+	unsigned count,
+	ethash_return_value_t* ret
+);
+/**
+ * As @ref ethash_full_compute_batch(), but on any copy of the DAG data
+ *
+ * @param dag            The DAG data, as from @ref ethash_full_dag()
+ * @param dag_size       The size of the DAG data in bytes
+ */
+bool ethash_dag_compute_batch(
+	void const* dag,
+	uint64_t dag_size,
+	ethash_h256_t const header_hash,
+	uint64_t start_nonce,
+	unsigned count,
+	ethash_return_value_t* ret
+);
+/**
+ * Get the name of the instruction set used by @ref ethash_full_compute_batch() on this CPU
+ */
+char const* ethash_batch_isa(void);
 /**
  * Get a pointer to the full DAG data
  */
@@ -41,6 +41,36 @@
 #include "sha3.h"
 #endif // WITH_CRYPTOPP
 
+// Builds of the batch kernel for wider vector units, chosen at run time.
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(__MIC__)
+#define ETHASH_X86_DISPATCH 1
+#include <immintrin.h>
+#else
+#define ETHASH_X86_DISPATCH 0
+#endif
+
+#if defined(__GNUC__)
+#define ETHASH_PREFETCH(p) __builtin_prefetch((p), 0, 0)
+#else
+#define ETHASH_PREFETCH(p) ((void)(p))
+#endif
+
+// DAG generation runs on all cores where there are POSIX threads and GCC-style atomics.
+#if defined(__GNUC__) && !defined(_WIN32)
+#define ETHASH_DAG_THREADS 1
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define ETHASH_ATOMIC_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#define ETHASH_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ETHASH_ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define ETHASH_DAG_THREADS 0
+#define ETHASH_ATOMIC_ADD(p, v) ((*(p) += (v)) - (v))
+#define ETHASH_ATOMIC_LOAD(p) (*(p))
+#define ETHASH_ATOMIC_STORE(p, v) (*(p) = (v))
+#endif
+
 uint64_t ethash_get_datasize(uint64_t const block_number)
 {
 	assert(block_number / ETHASH_EPOCH_LENGTH < 2048);
@@ -153,6 +183,147 @@ void ethash_calculate_dag_item(
 	SHA3_512(ret->bytes, ret->bytes, sizeof(node));
 }
 
+// Number of DAG items ethash_calculate_dag_items() computes together.
+#define ETHASH_DAG_BATCH (ETHASH_BATCH_NONCES * MIX_NODES)
+// Number of DAG items a generating thread takes at a time.
+#define ETHASH_DAG_CHUNK 4096
+
+// The parent loop of ethash_calculate_dag_item() for a batch of items: each round works out and
+// prefetches every item's parent before mixing any, so the random cache reads overlap.
+// MIX_FN mixes one parent node into one item.
+#define ETHASH_DAG_BATCH_BODY(MIX_FN)											\
+	for (uint32_t i = 0; i != ETHASH_DATASET_PARENTS; ++i) {				\
+		node const* parents[ETHASH_DAG_BATCH];								\
+		for (unsigned l = 0; l != count; ++l) {								\
+			uint32_t const parent_index = fnv_hash(indices[l] ^ i, ret[l].words[i % NODE_WORDS]) % num_parent_nodes; \
+			parents[l] = &cache_nodes[parent_index];						\
+			ETHASH_PREFETCH(parents[l]);									\
+		}																	\
+		for (unsigned l = 0; l != count; ++l) {								\
+			MIX_FN(ret[l].words, parents[l]->words);						\
+		}																	\
+	}
+
+static inline void ethash_mix_node(uint32_t* restrict mix, uint32_t const* restrict parent)
+{
+	for (unsigned w = 0; w != NODE_WORDS; ++w) {
+		mix[w] = fnv_hash(mix[w], parent[w]);
+	}
+}
+
+static void ethash_dag_batch(node* ret, uint32_t const* indices, unsigned count, node const* cache_nodes, uint32_t num_parent_nodes)
+{
+	ETHASH_DAG_BATCH_BODY(ethash_mix_node)
+}
+
+#if ETHASH_X86_DISPATCH
+__attribute__((target("avx2")))
+static inline void ethash_mix_node_avx2(uint32_t* restrict mix, uint32_t const* restrict parent)
+{
+	__m256i const fnv_prime = _mm256_set1_epi32(FNV_PRIME);
+	for (unsigned w = 0; w != NODE_WORDS; w += 8) {
+		__m256i m = _mm256_loadu_si256((__m256i const*)(mix + w));
+		m = _mm256_mullo_epi32(m, fnv_prime);
+		m = _mm256_xor_si256(m, _mm256_loadu_si256((__m256i const*)(parent + w)));
+		_mm256_storeu_si256((__m256i*)(mix + w), m);
+	}
+}
+
+__attribute__((target("avx2")))
+static void ethash_dag_batch_avx2(node* ret, uint32_t const* indices, unsigned count, node const* cache_nodes, uint32_t num_parent_nodes)
+{
+	ETHASH_DAG_BATCH_BODY(ethash_mix_node_avx2)
+}
+
+__attribute__((target("avx512f")))
+static inline void ethash_mix_node_avx512(uint32_t* restrict mix, uint32_t const* restrict parent)
+{
+	__m512i m = _mm512_loadu_si512((void const*)mix);
+	m = _mm512_mullo_epi32(m, _mm512_set1_epi32(FNV_PRIME));
+	m = _mm512_xor_si512(m, _mm512_loadu_si512((void const*)parent));
+	_mm512_storeu_si512((void*)mix, m);
+}
+
+__attribute__((target("avx512f")))
+static void ethash_dag_batch_avx512(node* ret, uint32_t const* indices, unsigned count, node const* cache_nodes, uint32_t num_parent_nodes)
+{
+	ETHASH_DAG_BATCH_BODY(ethash_mix_node_avx512)
+}
+#endif
+
+#undef ETHASH_DAG_BATCH_BODY
+
+// Same as calling ethash_calculate_dag_item() for each of the @a count items in @a indices.
+static void ethash_calculate_dag_items(
+	node* const ret,
+	uint32_t const* indices,
+	unsigned count,
+	ethash_light_t const light
+)
+{
+	uint32_t num_parent_nodes = (uint32_t) (light->cache_size / sizeof(node));
+	node const* cache_nodes = (node const *) light->cache;
+	for (unsigned l = 0; l != count; ++l) {
+		memcpy(&ret[l], &cache_nodes[indices[l] % num_parent_nodes], sizeof(node));
+		ret[l].words[0] ^= indices[l];
+		SHA3_512(ret[l].bytes, ret[l].bytes, sizeof(node));
+	}
+#if ETHASH_X86_DISPATCH
+	if (__builtin_cpu_supports("avx512f")) {
+		ethash_dag_batch_avx512(ret, indices, count, cache_nodes, num_parent_nodes);
+	} else if (__builtin_cpu_supports("avx2")) {
+		ethash_dag_batch_avx2(ret, indices, count, cache_nodes, num_parent_nodes);
+	} else
+#endif
+	{
+		ethash_dag_batch(ret, indices, count, cache_nodes, num_parent_nodes);
+	}
+	for (unsigned l = 0; l != count; ++l) {
+		SHA3_512(ret[l].bytes, ret[l].bytes, sizeof(node));
+	}
+}
+
+// A DAG being generated; threads take chunks of it until none are left.
+typedef struct dag_job {
+	node* nodes;
+	uint32_t num_nodes;
+	ethash_light_t light;
+	uint32_t next;	// first item not yet taken
+	uint32_t done;	// items finished
+	int abort;
+} dag_job_t;
+
+// Computes one chunk of @a job; @returns false once there is nothing left to take.
+static bool ethash_dag_job_step(dag_job_t* job)
+{
+	if (ETHASH_ATOMIC_LOAD(&job->abort)) {
+		return false;
+	}
+	uint32_t const start = ETHASH_ATOMIC_ADD(&job->next, ETHASH_DAG_CHUNK);
+	if (start >= job->num_nodes) {
+		return false;
+	}
+	uint32_t const end = job->num_nodes - start < ETHASH_DAG_CHUNK ? job->num_nodes : start + ETHASH_DAG_CHUNK;
+	for (uint32_t n = start; n < end; n += ETHASH_DAG_BATCH) {
+		uint32_t indices[ETHASH_DAG_BATCH];
+		unsigned const count = end - n < ETHASH_DAG_BATCH ? end - n : ETHASH_DAG_BATCH;
+		for (unsigned l = 0; l != count; ++l) {
+			indices[l] = n + l;
+		}
+		ethash_calculate_dag_items(&job->nodes[n], indices, count, job->light);
+	}
+	ETHASH_ATOMIC_ADD(&job->done, end - start);
+	return true;
+}
+
+#if ETHASH_DAG_THREADS
+static void* ethash_dag_job_thread(void* job)
+{
+	while (ethash_dag_job_step((dag_job_t*)job)) {}
+	return NULL;
+}
+#endif
+
 bool ethash_compute_full_data(
 	void* mem,
 	uint64_t full_size,
@@ -164,22 +335,51 @@ bool ethash_compute_full_data(
 		(full_size % sizeof(node)) != 0) {
 		return false;
 	}
-	uint32_t const max_n = (uint32_t)(full_size / sizeof(node));
-	node* full_nodes = mem;
-	double const progress_change = 1.0f / max_n;
-	double progress = 0.0f;
-	// now compute full nodes
-	for (uint32_t n = 0; n != max_n; ++n) {
-		if (callback &&
-			n % (max_n / 100) == 0 &&
-			callback((unsigned int)(ceil(progress * 100.0f))) != 0) {
-
-			return false;
+	dag_job_t job;
+	job.nodes = mem;
+	job.num_nodes = (uint32_t)(full_size / sizeof(node));
+	job.light = light;
+	job.next = 0;
+	job.done = 0;
+	job.abort = 0;
+
+#if ETHASH_X86_DISPATCH
+	__builtin_cpu_init();
+#endif
+
+	// helpers take chunks alongside this thread, which also reports progress
+	unsigned num_helpers = 0;
+#if ETHASH_DAG_THREADS
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t* helpers = cpus > 1 ? malloc(sizeof(pthread_t) * (size_t)(cpus - 1)) : NULL;
+	if (helpers) {
+		for (; num_helpers != (unsigned)(cpus - 1); ++num_helpers) {
+			if (pthread_create(&helpers[num_helpers], NULL, ethash_dag_job_thread, &job) != 0) {
+				break;
+			}
 		}
-		progress += progress_change;
-		ethash_calculate_dag_item(&(full_nodes[n]), n, light);
 	}
-	return true;
+#endif
+
+	unsigned reported = 101;
+	do {
+		unsigned const progress = (unsigned)((uint64_t)ETHASH_ATOMIC_LOAD(&job.done) * 100 / job.num_nodes);
+		if (callback && progress != reported) {
+			reported = progress;
+			if (callback(progress) != 0) {
+				ETHASH_ATOMIC_STORE(&job.abort, 1);
+			}
+		}
+	} while (ethash_dag_job_step(&job));
+
+#if ETHASH_DAG_THREADS
+	for (unsigned i = 0; i != num_helpers; ++i) {
+		pthread_join(helpers[i], NULL);
+	}
+	free(helpers);
+#endif
+	(void)num_helpers;
+	return !job.abort;
 }
 
 static bool ethash_hash(
@@ -293,6 +493,172 @@ static bool ethash_hash(
 	return true;
 }
 
+// The mixing loop of ethash_hash() for a batch of nonces: each round first works out every lane's
+// DAG page and prefetches it, so that up to ETHASH_BATCH_NONCES page fetches are in flight at once
+// instead of one, then folds the pages into the mixes. MIX_FN mixes one page into one lane's mix.
+#define ETHASH_MIX_BATCH_BODY(MIX_FN)											\
+	for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {						\
+		node const* pages[ETHASH_BATCH_NONCES];								\
+		for (unsigned l = 0; l != count; ++l) {								\
+			uint32_t const index = fnv_hash(seeds[l].words[0] ^ i, mixes[l].words[i % MIX_WORDS]) % num_full_pages; \
+			pages[l] = dag + MIX_NODES * (size_t)index;						\
+			ETHASH_PREFETCH(pages[l]);										\
+			ETHASH_PREFETCH(pages[l] + MIX_NODES - 1);						\
+		}																	\
+		for (unsigned l = 0; l != count; ++l) {								\
+			MIX_FN(mixes[l].words, pages[l]->words);						\
+		}																	\
+	}
+
+typedef union mix {
+	uint8_t bytes[MIX_WORDS * 4];
+	uint32_t words[MIX_WORDS];
+} mix_t;
+
+static inline void ethash_mix_page(uint32_t* restrict mix, uint32_t const* restrict page)
+{
+	for (unsigned w = 0; w != MIX_WORDS; ++w) {
+		mix[w] = fnv_hash(mix[w], page[w]);
+	}
+}
+
+static void ethash_mix_batch(
+	mix_t* mixes,
+	node const* seeds,
+	node const* dag,
+	unsigned num_full_pages,
+	unsigned count
+)
+{
+	ETHASH_MIX_BATCH_BODY(ethash_mix_page)
+}
+
+#if ETHASH_X86_DISPATCH
+// Same as ethash_mix_batch(), built for AVX2 and AVX-512 and picked at run time.
+// DAG pages are only 8-byte aligned when mapped from file, hence the unaligned loads.
+__attribute__((target("avx2")))
+static inline void ethash_mix_page_avx2(uint32_t* restrict mix, uint32_t const* restrict page)
+{
+	__m256i const fnv_prime = _mm256_set1_epi32(FNV_PRIME);
+	for (unsigned w = 0; w != MIX_WORDS; w += 8) {
+		__m256i m = _mm256_loadu_si256((__m256i const*)(mix + w));
+		m = _mm256_mullo_epi32(m, fnv_prime);
+		m = _mm256_xor_si256(m, _mm256_loadu_si256((__m256i const*)(page + w)));
+		_mm256_storeu_si256((__m256i*)(mix + w), m);
+	}
+}
+
+__attribute__((target("avx2")))
+static void ethash_mix_batch_avx2(
+	mix_t* mixes,
+	node const* seeds,
+	node const* dag,
+	unsigned num_full_pages,
+	unsigned count
+)
+{
+	ETHASH_MIX_BATCH_BODY(ethash_mix_page_avx2)
+}
+
+__attribute__((target("avx512f")))
+static inline void ethash_mix_page_avx512(uint32_t* restrict mix, uint32_t const* restrict page)
+{
+	__m512i const fnv_prime = _mm512_set1_epi32(FNV_PRIME);
+	for (unsigned w = 0; w != MIX_WORDS; w += 16) {
+		__m512i m = _mm512_loadu_si512((void const*)(mix + w));
+		m = _mm512_mullo_epi32(m, fnv_prime);
+		m = _mm512_xor_si512(m, _mm512_loadu_si512((void const*)(page + w)));
+		_mm512_storeu_si512((void*)(mix + w), m);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void ethash_mix_batch_avx512(
+	mix_t* mixes,
+	node const* seeds,
+	node const* dag,
+	unsigned num_full_pages,
+	unsigned count
+)
+{
+	ETHASH_MIX_BATCH_BODY(ethash_mix_page_avx512)
+}
+#endif
+
+#undef ETHASH_MIX_BATCH_BODY
+
+char const* ethash_batch_isa(void)
+{
+#if ETHASH_X86_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return "avx512";
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return "avx2";
+	}
+#endif
+	return "generic";
+}
+
+bool ethash_dag_compute_batch(
+	void const* dag_data,
+	uint64_t dag_size,
+	ethash_h256_t const header_hash,
+	uint64_t start_nonce,
+	unsigned count,
+	ethash_return_value_t* ret
+)
+{
+	if (dag_size % ETHASH_MIX_BYTES != 0 || count > ETHASH_BATCH_NONCES) {
+		return false;
+	}
+	node const* dag = (node const*)dag_data;
+	unsigned const num_full_pages = (unsigned) (dag_size / ETHASH_MIX_BYTES);
+
+	node seeds[ETHASH_BATCH_NONCES];
+	mix_t mixes[ETHASH_BATCH_NONCES];
+	for (unsigned l = 0; l != count; ++l) {
+		memcpy(seeds[l].bytes, &header_hash, 32);
+		fix_endian64(seeds[l].double_words[4], start_nonce + l);
+		SHA3_512(seeds[l].bytes, seeds[l].bytes, 40);
+		fix_endian_arr32(seeds[l].words, 16);
+		for (uint32_t w = 0; w != MIX_WORDS; ++w) {
+			mixes[l].words[w] = seeds[l].words[w % NODE_WORDS];
+		}
+	}
+
+#if ETHASH_X86_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		ethash_mix_batch_avx512(mixes, seeds, dag, num_full_pages, count);
+	} else if (__builtin_cpu_supports("avx2")) {
+		ethash_mix_batch_avx2(mixes, seeds, dag, num_full_pages, count);
+	} else
+#endif
+	{
+		ethash_mix_batch(mixes, seeds, dag, num_full_pages, count);
+	}
+
+	for (unsigned l = 0; l != count; ++l) {
+		// Keccak-256(s + compressed_mix)
+		uint32_t final[NODE_WORDS + MIX_WORDS / 4];
+		memcpy(final, seeds[l].words, 64);
+		for (uint32_t w = 0; w != MIX_WORDS; w += 4) {
+			uint32_t reduction = mixes[l].words[w + 0];
+			reduction = reduction * FNV_PRIME ^ mixes[l].words[w + 1];
+			reduction = reduction * FNV_PRIME ^ mixes[l].words[w + 2];
+			reduction = reduction * FNV_PRIME ^ mixes[l].words[w + 3];
+			final[NODE_WORDS + w / 4] = reduction;
+		}
+		fix_endian_arr32(final + NODE_WORDS, MIX_WORDS / 4);
+		memcpy(&ret[l].mix_hash, final + NODE_WORDS, 32);
+		SHA3_256(&ret[l].result, (uint8_t*)final, 64 + 32);
+		ret[l].success = true;
+	}
+	return true;
+}
+
 void ethash_quick_hash(
 	ethash_h256_t* return_hash,
 	ethash_h256_t const* header_hash,
@@ -407,30 +773,158 @@ ethash_return_value_t ethash_light_compute(
 	return ethash_light_compute_internal(light, full_size, header_hash, nonce);
 }
 
-static bool ethash_mmap(struct ethash_full* ret, FILE* f)
+bool ethash_light_compute_batch(
+	ethash_light_t light,
+	ethash_h256_t const* header_hashes,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* ret
+)
+{
+	if (count > ETHASH_BATCH_NONCES) {
+		return false;
+	}
+	if (count == 0) {
+		return true;
+	}
+	uint64_t const full_size = ethash_get_datasize(light->block_number);
+	unsigned const num_full_pages = (unsigned) (full_size / ETHASH_MIX_BYTES);
+#if ETHASH_X86_DISPATCH
+	__builtin_cpu_init();
+#endif
+
+	// as in ethash_hash(), s_mix[l][0] is the seed, followed by the mix
+	node s_mix[ETHASH_BATCH_NONCES][MIX_NODES + 1];
+	for (unsigned l = 0; l != count; ++l) {
+		memcpy(s_mix[l][0].bytes, &header_hashes[l], 32);
+		fix_endian64(s_mix[l][0].double_words[4], nonces[l]);
+		SHA3_512(s_mix[l][0].bytes, s_mix[l][0].bytes, 40);
+		fix_endian_arr32(s_mix[l][0].words, 16);
+		for (uint32_t w = 0; w != MIX_WORDS; ++w) {
+			s_mix[l][1 + w / NODE_WORDS].words[w % NODE_WORDS] = s_mix[l][0].words[w % NODE_WORDS];
+		}
+	}
+
+	// every lane's page for a round is computed from the cache in one interleaved batch
+	for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
+		uint32_t indices[ETHASH_BATCH_NONCES * MIX_NODES];
+		node pages[ETHASH_BATCH_NONCES * MIX_NODES];
+		for (unsigned l = 0; l != count; ++l) {
+			node const* mix = &s_mix[l][1];
+			uint32_t const index = fnv_hash(s_mix[l][0].words[0] ^ i, mix[(i % MIX_WORDS) / NODE_WORDS].words[i % NODE_WORDS]) % num_full_pages;
+			for (unsigned n = 0; n != MIX_NODES; ++n) {
+				indices[l * MIX_NODES + n] = index * MIX_NODES + n;
+			}
+		}
+		ethash_calculate_dag_items(pages, indices, count * MIX_NODES, light);
+		for (unsigned l = 0; l != count; ++l) {
+			for (unsigned n = 0; n != MIX_NODES; ++n) {
+				for (unsigned w = 0; w != NODE_WORDS; ++w) {
+					s_mix[l][1 + n].words[w] = fnv_hash(s_mix[l][1 + n].words[w], pages[l * MIX_NODES + n].words[w]);
+				}
+			}
+		}
+	}
+
+	for (unsigned l = 0; l != count; ++l) {
+		// compress mix, then Keccak-256(s + compressed_mix)
+		uint32_t final[NODE_WORDS + MIX_WORDS / 4];
+		memcpy(final, s_mix[l][0].words, 64);
+		for (uint32_t w = 0; w != MIX_WORDS; w += 4) {
+			uint32_t const* m = &s_mix[l][1 + w / NODE_WORDS].words[w % NODE_WORDS];
+			uint32_t reduction = m[0];
+			reduction = reduction * FNV_PRIME ^ m[1];
+			reduction = reduction * FNV_PRIME ^ m[2];
+			reduction = reduction * FNV_PRIME ^ m[3];
+			final[NODE_WORDS + w / 4] = reduction;
+		}
+		fix_endian_arr32(final + NODE_WORDS, MIX_WORDS / 4);
+		memcpy(&ret[l].mix_hash, final + NODE_WORDS, 32);
+		SHA3_256(&ret[l].result, (uint8_t*)final, 64 + 32);
+		ret[l].success = true;
+	}
+	return true;
+}
+
+static bool ethash_mmap(struct ethash_full* ret, FILE* f, bool writable, unsigned flags)
 {
 	int fd;
 	char* mmapped_data;
+	int map_flags = MAP_SHARED;
+	size_t const map_size = (size_t)ret->file_size + ETHASH_DAG_MAGIC_NUM_SIZE;
 	errno = 0;
 	ret->file = f;
 	if ((fd = ethash_fileno(ret->file)) == -1) {
 		return false;
 	}
+#ifdef MAP_POPULATE
+	if (flags & ETHASH_FULL_POPULATE) {
+		map_flags |= MAP_POPULATE;
+	}
+#endif
 	mmapped_data = mmap(
 		NULL,
-		(size_t)ret->file_size + ETHASH_DAG_MAGIC_NUM_SIZE,
-		PROT_READ | PROT_WRITE,
-		MAP_SHARED,
+		map_size,
+		writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		map_flags,
 		fd,
 		0
 	);
 	if (mmapped_data == MAP_FAILED) {
 		return false;
 	}
+#ifdef MADV_HUGEPAGE
+	if (flags & ETHASH_FULL_HUGEPAGES) {
+		// only honoured where the kernel supports huge pages for file mappings
+		madvise(mmapped_data, map_size, MADV_HUGEPAGE);
+	}
+#endif
 	ret->data = (node*)(mmapped_data + ETHASH_DAG_MAGIC_NUM_SIZE);
 	return true;
 }
 
+// Maps the complete DAG for @a seed_hash in @a dirname read-only, if there is one.
+static ethash_full_t ethash_full_open_readonly(
+	char const* dirname,
+	ethash_h256_t const seed_hash,
+	uint64_t full_size,
+	unsigned flags
+)
+{
+	char mutable_name[DAG_MUTABLE_NAME_MAX_SIZE];
+	ethash_io_mutable_name(ETHASH_REVISION, &seed_hash, mutable_name);
+	char* filename = ethash_io_create_filename(dirname, mutable_name, strlen(mutable_name));
+	if (!filename) {
+		return NULL;
+	}
+	FILE* f = ethash_fopen(filename, "rb");
+	free(filename);
+	if (!f) {
+		return NULL;
+	}
+	size_t found_size;
+	uint64_t magic_num;
+	if (!ethash_file_size(f, &found_size) ||
+		found_size != full_size + ETHASH_DAG_MAGIC_NUM_SIZE ||
+		fread(&magic_num, ETHASH_DAG_MAGIC_NUM_SIZE, 1, f) != 1 ||
+		magic_num != ETHASH_DAG_MAGIC_NUM) {
+		fclose(f);
+		return NULL;
+	}
+	struct ethash_full* ret = calloc(sizeof(*ret), 1);
+	if (!ret) {
+		fclose(f);
+		return NULL;
+	}
+	ret->file_size = full_size;
+	if (!ethash_mmap(ret, f, false, flags)) {
+		fclose(f);
+		free(ret);
+		return NULL;
+	}
+	return ret;
+}
+
 ethash_full_t ethash_full_new_internal(
 	char const* dirname,
 	ethash_h256_t const seed_hash,
@@ -438,9 +932,24 @@ ethash_full_t ethash_full_new_internal(
 	ethash_light_t const light,
 	ethash_callback_t callback
 )
+{
+	return ethash_full_new_flags(dirname, seed_hash, full_size, light, callback, 0);
+}
+
+ethash_full_t ethash_full_new_flags(
+	char const* dirname,
+	ethash_h256_t const seed_hash,
+	uint64_t full_size,
+	ethash_light_t const light,
+	ethash_callback_t callback,
+	unsigned flags
+)
 {
 	struct ethash_full* ret;
 	FILE *f = NULL;
+	if (flags & ETHASH_FULL_READONLY) {
+		return ethash_full_open_readonly(dirname, seed_hash, full_size, flags);
+	}
 	ret = calloc(sizeof(*ret), 1);
 	if (!ret) {
 		return NULL;
@@ -462,7 +971,7 @@ ethash_full_t ethash_full_new_internal(
 	}
 
 	if (err == ETHASH_IO_MEMO_MISMATCH || err == ETHASH_IO_MEMO_MATCH) {
-		if (!ethash_mmap(ret, f)) {
+		if (!ethash_mmap(ret, f, true, flags)) {
 			ETHASH_CRITICAL("mmap failure()");
 			goto fail_close_file;
 		}
@@ -510,7 +1019,7 @@ ethash_full_t ethash_full_new_internal(
 
 fail_free_full_data:
 	// could check that munmap(..) == 0 but even if it did not can't really do anything here
-	munmap(ret->data, (size_t)full_size);
+	munmap((char*)ret->data - ETHASH_DAG_MAGIC_NUM_SIZE, (size_t)full_size + ETHASH_DAG_MAGIC_NUM_SIZE);
 #if defined(__MIC__)
 	_mm_free(ret->data);
 #endif
@@ -532,10 +1041,30 @@ ethash_full_t ethash_full_new(ethash_light_t light, ethash_callback_t callback)
 	return ethash_full_new_internal(strbuf, seedhash, full_size, light, callback);
 }
 
+ethash_full_t ethash_full_new_opts(
+	ethash_light_t light,
+	char const* dirname,
+	unsigned flags,
+	ethash_callback_t callback
+)
+{
+	char strbuf[256];
+	if (!dirname) {
+		if (!ethash_get_default_dirname(strbuf, 256)) {
+			return NULL;
+		}
+		dirname = strbuf;
+	}
+	uint64_t full_size = ethash_get_datasize(light->block_number);
+	ethash_h256_t seedhash = ethash_get_seedhash(light->block_number);
+	return ethash_full_new_flags(dirname, seedhash, full_size, light, callback, flags);
+}
+
 void ethash_full_delete(ethash_full_t full)
 {
+	// the mapping starts at the magic number, just before the data
 	// could check that munmap(..) == 0 but even if it did not can't really do anything here
-	munmap(full->data, (size_t)full->file_size);
+	munmap((char*)full->data - ETHASH_DAG_MAGIC_NUM_SIZE, (size_t)full->file_size + ETHASH_DAG_MAGIC_NUM_SIZE);
 	if (full->file) {
 		fclose(full->file);
 	}
@@ -562,6 +1091,17 @@ ethash_return_value_t ethash_full_compute(
 	return ret;
 }
 
+bool ethash_full_compute_batch(
+	ethash_full_t full,
+	ethash_h256_t const header_hash,
+	uint64_t start_nonce,
+	unsigned count,
+	ethash_return_value_t* ret
+)
+{
+	return ethash_dag_compute_batch(full->data, full->file_size, header_hash, start_nonce, count, ret);
+}
+
 void const* ethash_full_dag(ethash_full_t full)
 {
 	return full->data;
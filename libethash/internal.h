@@ -146,6 +146,18 @@ ethash_full_t ethash_full_new_internal(
 	ethash_callback_t callback
 );
 
+/**
+ * As @ref ethash_full_new_internal(), with the ETHASH_FULL_* options of @ref ethash_full_new_opts().
+ */
+ethash_full_t ethash_full_new_flags(
+	char const* dirname,
+	ethash_h256_t const seed_hash,
+	uint64_t full_size,
+	ethash_light_t const light,
+	ethash_callback_t callback,
+	unsigned flags
+);
+
 void ethash_calculate_dag_item(
 	node* const ret,
 	uint32_t node_index,
@@ -25,11 +25,20 @@
 #include <libethereum/Interface.h>
 #include <libethcore/ChainOperationParams.h>
 #include <libethcore/CommonJS.h>
+#include "EthashAux.h"
 #include "EthashCPUMiner.h"
 using namespace std;
 using namespace dev;
 using namespace eth;
 
+namespace
+{
+
+/// Most header hashes remembered as having valid seals before the memory is reset.
+size_t const c_maxVerifiedSeals = 16384;
+
+}
+
 void Ethash::init()
 {
 	ETH_REGISTER_SEAL_ENGINE(Ethash);
@@ -241,6 +250,10 @@ bool Ethash::quickVerifySeal(BlockHeader const& _bi) const
 
 bool Ethash::verifySeal(BlockHeader const& _bi) const
 {
+	DEV_READ_GUARDED(x_verifiedSeals)
+		if (m_verifiedSeals.count(_bi.hash()))
+			return true;
+
 	bool pre = quickVerifySeal(_bi);
 #if !ETH_DEBUG
 	if (!pre)
@@ -270,6 +283,58 @@ bool Ethash::verifySeal(BlockHeader const& _bi) const
 	return slow;
 }
 
+vector<bool> Ethash::verifySeals(vector<BlockHeader> const& _headers, unsigned _chainHead) const
+{
+	vector<bool> ret(_headers.size(), false);
+
+	// The cheap check first; what passes is evaluated in one batch per epoch. Only the light caches of
+	// the chain head's epoch and the next are worth building; other headers are checked in full on import.
+	u256 const epoch = _chainHead / ETHASH_EPOCH_LENGTH;
+	map<h256, vector<size_t>> byEpoch;
+	for (size_t i = 0; i < _headers.size(); ++i)
+	{
+		u256 const headerEpoch = _headers[i].number() / ETHASH_EPOCH_LENGTH;
+		if (!_headers[i].parentHash())
+			ret[i] = true;
+		else if (!quickVerifySeal(_headers[i]))
+			continue;
+		else if (headerEpoch != epoch && headerEpoch != epoch + 1)
+			ret[i] = true;
+		else
+			byEpoch[seedHash(_headers[i])].push_back(i);
+	}
+
+	h256Hash verified;
+	for (auto const& e: byEpoch)
+	{
+		h256s headerHashes;
+		vector<Nonce> nonces;
+		for (size_t i: e.second)
+		{
+			headerHashes.push_back(_headers[i].hash(WithoutSeal));
+			nonces.push_back(nonce(_headers[i]));
+		}
+		vector<EthashProofOfWork::Result> results = EthashAux::eval(e.first, headerHashes, nonces);
+		for (size_t j = 0; j < e.second.size(); ++j)
+		{
+			BlockHeader const& h = _headers[e.second[j]];
+			if (results[j].value <= boundary(h) && results[j].mixHash == mixHash(h))
+			{
+				ret[e.second[j]] = true;
+				verified.insert(h.hash());
+			}
+		}
+	}
+
+	DEV_WRITE_GUARDED(x_verifiedSeals)
+	{
+		if (m_verifiedSeals.size() + verified.size() > c_maxVerifiedSeals)
+			m_verifiedSeals.clear();
+		m_verifiedSeals.insert(verified.begin(), verified.end());
+	}
+	return ret;
+}
+
 void Ethash::generateSeal(BlockHeader const& _bi)
 {
 	m_sealing = _bi;
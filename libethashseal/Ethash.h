@@ -45,6 +45,7 @@ public:
 
 	StringHashMap jsInfo(BlockHeader const& _bi) const override;
 	void verify(Strictness _s, BlockHeader const& _bi, BlockHeader const& _parent, bytesConstRef _block) const override;
+	std::vector<bool> verifySeals(std::vector<BlockHeader> const& _headers, unsigned _chainHead) const override;
 	void verifyTransaction(ImportRequirements::value _ir, TransactionBase const& _t, BlockHeader const& _header, u256 const& _startGasUsed) const override;
 	void populateFromParent(BlockHeader& _bi, BlockHeader const& _parent) const override;
 
@@ -81,6 +82,10 @@ private:
 	eth::GenericFarm<EthashProofOfWork> m_farm;
 	std::string m_sealer = "cpu";
 	BlockHeader m_sealing;
+
+	/// Headers whose seals verifySeals() found valid, so verifySeal() need not evaluate them again on import.
+	mutable SharedMutex x_verifiedSeals;
+	mutable h256Hash m_verifiedSeals;
 };
 
 }
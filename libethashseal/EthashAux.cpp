@@ -22,6 +22,7 @@
 #include "EthashAux.h"
 #include <boost/detail/endian.hpp>
 #include <boost/filesystem.hpp>
+#include <atomic>
 #include <chrono>
 #include <array>
 #include <thread>
@@ -46,6 +47,8 @@ EthashAux* dev::eth::EthashAux::s_this = nullptr;
 
 EthashAux::~EthashAux()
 {
+	if (m_lightGenerator && m_lightGenerator->joinable())
+		m_lightGenerator->join();
 }
 
 EthashAux* EthashAux::get()
@@ -110,6 +113,53 @@ uint64_t EthashAux::number(h256 const& _seedHash)
 	return epoch * ETHASH_EPOCH_LENGTH;
 }
 
+void EthashAux::setDAGOptions(DAGOptions const& _options)
+{
+	DEV_GUARDED(get()->x_fulls)
+	{
+		get()->m_dagOptions = _options;
+		while (get()->m_residentFulls.size() > _options.maxResidentEpochs)
+			get()->m_residentFulls.pop_front();
+	}
+}
+
+EthashAux::DAGOptions EthashAux::dagOptions()
+{
+	Guard l(get()->x_fulls);
+	return get()->m_dagOptions;
+}
+
+void EthashAux::keepResident_WITH_LOCK(FullType const& _full)
+{
+	auto it = find(m_residentFulls.begin(), m_residentFulls.end(), _full);
+	if (it != m_residentFulls.end())
+		m_residentFulls.erase(it);
+	m_residentFulls.push_back(_full);
+	while (m_residentFulls.size() > m_dagOptions.maxResidentEpochs)
+		m_residentFulls.pop_front();
+}
+
+void EthashAux::trimLights_WITH_LOCK(h256 const& _seedHash, unsigned _max)
+{
+	auto keep = m_lights.find(_seedHash);
+	if (keep == m_lights.end())
+		return;
+	uint64_t const epoch = keep->second->light->block_number / ETHASH_EPOCH_LENGTH;
+	auto distance = [&](LightType const& _l)
+	{
+		uint64_t e = _l->light->block_number / ETHASH_EPOCH_LENGTH;
+		return e > epoch ? e - epoch : epoch - e;
+	};
+	while (m_lights.size() > max(_max, 1U))
+	{
+		auto furthest = m_lights.end();
+		for (auto it = m_lights.begin(); it != m_lights.end(); ++it)
+			if (it != keep && (furthest == m_lights.end() || distance(it->second) > distance(furthest->second)))
+				furthest = it;
+		m_lights.erase(furthest);
+	}
+}
+
 void EthashAux::killCache(h256 const& _s)
 {
 	WriteGuard l(x_lights);
@@ -118,11 +168,69 @@ void EthashAux::killCache(h256 const& _s)
 
 EthashAux::LightType EthashAux::light(h256 const& _seedHash)
 {
-	UpgradableGuard l(get()->x_lights);
-	if (get()->m_lights.count(_seedHash))
-		return get()->m_lights.at(_seedHash);
-	UpgradeGuard l2(l);
-	return (get()->m_lights[_seedHash] = make_shared<LightAllocation>(_seedHash));
+	LightType ret;
+	shared_future<LightType> generating;
+	DEV_READ_GUARDED(get()->x_lights)
+	{
+		auto it = get()->m_lights.find(_seedHash);
+		if (it != get()->m_lights.end())
+			ret = it->second;
+		else if (get()->m_generatingLight && get()->m_generatingSeed == _seedHash)
+			generating = get()->m_generatedLight;
+	}
+	// Already being built in the background; a second copy would only take longer.
+	if (!ret && generating.valid())
+		ret = generating.get();
+	if (!ret)
+	{
+		unsigned const maxLights = dagOptions().maxResidentEpochs + 1;
+		WriteGuard l(get()->x_lights);
+		auto it = get()->m_lights.find(_seedHash);
+		if (it != get()->m_lights.end())
+			ret = it->second;
+		else
+		{
+			ret = get()->m_lights[_seedHash] = make_shared<LightAllocation>(_seedHash);
+			get()->trimLights_WITH_LOCK(_seedHash, maxLights);
+		}
+	}
+	// Whoever needed this epoch will soon need the next one; have it ready by then, however this one was found.
+	get()->precomputeLight(sha3(_seedHash));
+	return ret;
+}
+
+void EthashAux::precomputeLight(h256 const& _seedHash)
+{
+	// Called on every lookup, so the common case only takes the read lock.
+	DEV_READ_GUARDED(x_lights)
+		if (m_generatingLight || m_lights.count(_seedHash))
+			return;
+	unsigned const maxLights = dagOptions().maxResidentEpochs + 1;
+	WriteGuard l(x_lights);
+	if (m_generatingLight || m_lights.count(_seedHash))
+		return;
+	if (m_lightGenerator && m_lightGenerator->joinable())
+		m_lightGenerator->join();
+	auto generated = make_shared<promise<LightType>>();
+	m_generatingLight = true;
+	m_generatingSeed = _seedHash;
+	m_generatedLight = generated->get_future().share();
+	m_lightGenerator.reset(new thread([=]()
+	{
+		// Built outside the lock, so lookups of the current epoch are not held up.
+		LightType light;
+		DEV_IGNORE_EXCEPTIONS(light = make_shared<LightAllocation>(_seedHash));
+		DEV_WRITE_GUARDED(x_lights)
+		{
+			if (light && !m_lights.count(_seedHash))
+			{
+				m_lights[_seedHash] = light;
+				trimLights_WITH_LOCK(_seedHash, maxLights);
+			}
+			m_generatingLight = false;
+		}
+		generated->set_value(light);
+	}));
 }
 
 EthashAux::LightAllocation::LightAllocation(h256 const& _seedHash)
@@ -146,9 +254,17 @@ bytesConstRef EthashAux::LightAllocation::data() const
 
 EthashAux::FullAllocation::FullAllocation(ethash_light_t _light, ethash_callback_t _cb)
 {
-//	cdebug << "About to call ethash_full_new...";
-	full = ethash_full_new(_light, _cb);
-//	cdebug << "Called OK.";
+	DAGOptions options = dagOptions();
+	unsigned flags = (options.populate ? ETHASH_FULL_POPULATE : 0) | (options.hugePages ? ETHASH_FULL_HUGEPAGES : 0);
+	full = nullptr;
+	if (!options.sharedDir.empty())
+	{
+		full = ethash_full_new_opts(_light, options.sharedDir.c_str(), flags | ETHASH_FULL_READONLY, nullptr);
+		if (full)
+			clog(DAGChannel) << "Mapped shared DAG from" << options.sharedDir;
+	}
+	if (!full)
+		full = ethash_full_new_opts(_light, nullptr, flags, _cb);
 	if (!full)
 	{
 		clog(DAGChannel) << "DAG Generation Failure. Reason: "  << strerror(errno);
@@ -181,7 +297,7 @@ EthashAux::FullType EthashAux::full(h256 const& _seedHash, bool _createIfMissing
 	DEV_GUARDED(get()->x_fulls)
 		if ((ret = get()->m_fulls[_seedHash].lock()))
 		{
-			get()->m_lastUsedFull = ret;
+			get()->keepResident_WITH_LOCK(ret);
 			return ret;
 		}
 
@@ -193,12 +309,30 @@ EthashAux::FullType EthashAux::full(h256 const& _seedHash, bool _createIfMissing
 //		cnote << "Done loading.";
 
 		DEV_GUARDED(get()->x_fulls)
-			get()->m_fulls[_seedHash] = get()->m_lastUsedFull = ret;
+		{
+			get()->m_fulls[_seedHash] = ret;
+			get()->keepResident_WITH_LOCK(ret);
+		}
+		get()->m_fullsChanged.notify_all();
 	}
 
 	return ret;
 }
 
+EthashAux::FullType EthashAux::waitForFull(h256 const& _seedHash, function<bool()> const& _abort)
+{
+	while (!_abort())
+	{
+		if (computeFull(_seedHash, true) == 100)
+			if (FullType ret = full(_seedHash, false))
+				return ret;
+		// The timeout covers a DAG finishing between computeFull() and the wait.
+		unique_lock<Mutex> l(get()->x_fulls);
+		get()->m_fullsChanged.wait_for(l, chrono::milliseconds(100));
+	}
+	return FullType();
+}
+
 unsigned EthashAux::computeFull(h256 const& _seedHash, bool _createIfMissing)
 {
 	Guard l(get()->x_fulls);
@@ -211,7 +345,7 @@ unsigned EthashAux::computeFull(h256 const& _seedHash, bool _createIfMissing)
 
 	if (FullType ret = get()->m_fulls[_seedHash].lock())
 	{
-		get()->m_lastUsedFull = ret;
+		get()->keepResident_WITH_LOCK(ret);
 		return 100;
 	}
 
@@ -257,3 +391,58 @@ EthashProofOfWork::Result EthashAux::eval(h256 const& _seedHash, h256 const& _he
 		return EthashProofOfWork::Result{ ~h256(), h256() };
 	}
 }
+
+vector<EthashProofOfWork::Result> EthashAux::eval(h256 const& _seedHash, h256s const& _headerHashes, vector<Nonce> const& _nonces, unsigned _threads)
+{
+	assert(_headerHashes.size() == _nonces.size());
+	vector<EthashProofOfWork::Result> ret(_headerHashes.size(), EthashProofOfWork::Result{ ~h256(), h256() });
+
+	// Look the epoch's data up once; the threads then share it without locking.
+	FullType dag;
+	DEV_GUARDED(get()->x_fulls)
+	{
+		auto it = get()->m_fulls.find(_seedHash);
+		if (it != get()->m_fulls.end())
+			dag = it->second.lock();
+	}
+	LightType l;
+	if (!dag)
+		DEV_IGNORE_EXCEPTIONS(l = light(_seedHash));
+	if (!dag && !l)
+		return ret;
+
+	size_t const batches = (ret.size() + ETHASH_BATCH_NONCES - 1) / ETHASH_BATCH_NONCES;
+	atomic<size_t> next(0);
+	auto body = [&]()
+	{
+		ethash_h256_t headers[ETHASH_BATCH_NONCES];
+		uint64_t nonces[ETHASH_BATCH_NONCES];
+		ethash_return_value_t results[ETHASH_BATCH_NONCES];
+		for (size_t b = next++; b < batches; b = next++)
+		{
+			size_t first = b * ETHASH_BATCH_NONCES;
+			unsigned count = (unsigned)min<size_t>(ETHASH_BATCH_NONCES, ret.size() - first);
+			for (unsigned i = 0; i < count; ++i)
+			{
+				headers[i] = *(ethash_h256_t const*)_headerHashes[first + i].data();
+				nonces[i] = (uint64_t)(u64)_nonces[first + i];
+			}
+			if (dag)
+				for (unsigned i = 0; i < count; ++i)
+					results[i] = ethash_full_compute(dag->full, headers[i], nonces[i]);
+			else
+				ethash_light_compute_batch(l->light, headers, nonces, count, results);
+			for (unsigned i = 0; i < count; ++i)
+				ret[first + i] = EthashProofOfWork::Result{h256((uint8_t*)&results[i].result, h256::ConstructFromPointer), h256((uint8_t*)&results[i].mix_hash, h256::ConstructFromPointer)};
+		}
+	};
+
+	unsigned threads = (unsigned)min<size_t>(_threads ? _threads : max(thread::hardware_concurrency(), 1U), batches);
+	vector<thread> helpers;
+	for (unsigned i = 1; i < threads; ++i)
+		helpers.emplace_back(body);
+	body();
+	for (auto& h: helpers)
+		h.join();
+	return ret;
+}
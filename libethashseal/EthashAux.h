@@ -22,6 +22,8 @@
 #pragma once
 
 #include <condition_variable>
+#include <deque>
+#include <future>
 #include <libethash/ethash.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/Worker.h>
@@ -44,6 +46,19 @@ public:
 
 	static EthashAux* get();
 
+	/// How DAGs and light caches are kept in memory.
+	struct DAGOptions
+	{
+		unsigned maxResidentEpochs = 2;	///< DAGs kept loaded once unused; light caches kept besides the one being built.
+		bool populate = false;			///< Fault the whole DAG in when it is mapped rather than on first use.
+		bool hugePages = false;			///< Ask for the DAG mapping to be backed by huge pages.
+		std::string sharedDir;			///< If set, DAGs found here are mapped read-only and shared with other processes.
+	};
+
+	/// Sets the options used for DAGs loaded from now on and trims what is resident to fit them.
+	static void setDAGOptions(DAGOptions const& _options);
+	static DAGOptions dagOptions();
+
 	struct LightAllocation
 	{
 		LightAllocation(h256 const& _seedHash);
@@ -81,8 +96,13 @@ public:
 	static std::pair<uint64_t, unsigned> fullGeneratingProgress() { return std::make_pair(get()->m_generatingFullNumber, get()->m_fullProgress); }
 	/// Kicks off generation of DAG for @a _blocknumber and blocks until ready; @returns result or empty pointer if not existing and _createIfMissing is false.
 	static FullType full(h256 const& _seedHash, bool _createIfMissing = false, std::function<int(unsigned)> const& _f = std::function<int(unsigned)>());
+	/// Kicks off generation of DAG for @a _seedHash if needed and waits until it is ready or @a _abort returns true; @returns result or empty pointer if aborted.
+	static FullType waitForFull(h256 const& _seedHash, std::function<bool()> const& _abort);
 
 	static EthashProofOfWork::Result eval(h256 const& _seedHash, h256 const& _headerHash, Nonce const& _nonce);
+	/// Evaluates each of @a _nonces on the header hash at the same position in @a _headerHashes, all of the epoch of @a _seedHash.
+	/// Uses the full DAG if it is loaded and the light cache otherwise, on @a _threads threads (0 for one per core).
+	static std::vector<EthashProofOfWork::Result> eval(h256 const& _seedHash, h256s const& _headerHashes, std::vector<Nonce> const& _nonces, unsigned _threads = 0);
 
 private:
 	EthashAux() {}
@@ -91,15 +111,28 @@ private:
 
 	void killCache(h256 const& _s);
 
+	/// Starts building the light cache for @a _seedHash in the background, unless it exists or one is being built.
+	void precomputeLight(h256 const& _seedHash);
+
+	/// Marks @a _full as the most recently used DAG, dropping the least recently used beyond the resident limit.
+	void keepResident_WITH_LOCK(FullType const& _full);
+	/// Drops the light caches of the epochs furthest from @a _seedHash's until at most @a _max remain.
+	void trimLights_WITH_LOCK(h256 const& _seedHash, unsigned _max);
+
 	static EthashAux* s_this;
 
 	SharedMutex x_lights;
 	std::unordered_map<h256, std::shared_ptr<LightAllocation>> m_lights;
+	std::unique_ptr<std::thread> m_lightGenerator;
+	bool m_generatingLight = false;
+	h256 m_generatingSeed;								///< The light cache m_lightGenerator builds, while m_generatingLight.
+	std::shared_future<std::shared_ptr<LightAllocation>> m_generatedLight;	///< Its result; null if building it failed.
 
 	Mutex x_fulls;
 	std::condition_variable m_fullsChanged;
 	std::unordered_map<h256, std::weak_ptr<FullAllocation>> m_fulls;
-	FullType m_lastUsedFull;
+	std::deque<FullType> m_residentFulls;	///< Most recently used last; keeps DAGs (incl. ones made ahead of their epoch) loaded while unused.
+	DAGOptions m_dagOptions;
 	std::unique_ptr<std::thread> m_fullGenerator;
 	uint64_t m_generatingFullNumber = NotGenerating;
 	unsigned m_fullProgress;
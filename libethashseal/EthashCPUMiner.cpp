@@ -24,8 +24,15 @@
 #include "EthashCPUMiner.h"
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <map>
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 #include <random>
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#endif
 #if ETH_CPUID
 #define HAVE_STDINT_H
 #include <libcpuid/libcpuid.h>
@@ -35,6 +42,127 @@ using namespace dev;
 using namespace eth;
 
 unsigned EthashCPUMiner::s_numInstances = 0;
+bool EthashCPUMiner::s_hugePages = false;
+bool EthashCPUMiner::s_numaReplicas = false;
+
+namespace
+{
+
+/// Hashes a mining thread does between two hash rate updates.
+unsigned const c_hashesPerReport = 1024;
+
+/// A private copy of a DAG. Its pages end up on the NUMA node of the thread that made it.
+class DAGCopy
+{
+public:
+	DAGCopy(EthashAux::FullType const& _full, bool _hugePages): m_full(_full), m_size(_full->size())
+	{
+#if defined(__linux__)
+		void* p = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+		{
+			cwarn << "Could not allocate a copy of the DAG; mining from the shared one.";
+			return;
+		}
+		if (_hugePages && madvise(p, m_size, MADV_HUGEPAGE) != 0)
+			cwarn << "Transparent huge pages are not available for the DAG.";
+		memcpy(p, _full->data().data(), m_size);
+		m_data = p;
+		// The shared DAG is only needed as a fallback; don't keep it resident for the copy's sake.
+		m_full.reset();
+#else
+		(void)_hugePages;
+#endif
+	}
+
+	~DAGCopy()
+	{
+#if defined(__linux__)
+		if (m_data)
+			munmap(m_data, m_size);
+#endif
+	}
+
+	void const* data() const { return m_data ? m_data : m_full->data().data(); }
+
+	/// @returns the copy of @a _full, the DAG for @a _seedHash, for NUMA node @a _node, making it if
+	/// there is none. Copies outlive the work packages that use them, since every package restarts the
+	/// mining threads; they are dropped once the DAG of another epoch is asked for.
+	static shared_ptr<DAGCopy> get(h256 const& _seedHash, EthashAux::FullType const& _full, unsigned _node, bool _hugePages)
+	{
+		static Mutex s_x;
+		static h256 s_seedHash;
+		static map<unsigned, shared_ptr<DAGCopy>> s_copies;
+		Guard l(s_x);
+		if (_seedHash != s_seedHash)
+		{
+			s_copies.clear();
+			s_seedHash = _seedHash;
+		}
+		auto& c = s_copies[_node];
+		if (!c)
+			c = make_shared<DAGCopy>(_full, _hugePages);
+		return c;
+	}
+
+private:
+	EthashAux::FullType m_full;
+	size_t m_size;
+	void* m_data = nullptr;
+};
+
+#if defined(__linux__)
+/// @returns the CPUs of each NUMA node, from sysfs.
+vector<vector<unsigned>> numaNodes()
+{
+	vector<vector<unsigned>> ret;
+	for (unsigned n = 0; boost::filesystem::exists("/sys/devices/system/node/node" + toString(n)); ++n)
+	{
+		ifstream f("/sys/devices/system/node/node" + toString(n) + "/cpulist");
+		string list;
+		getline(f, list);
+		vector<string> ranges;
+		boost::split(ranges, list, boost::is_any_of(","));
+		vector<unsigned> cpus;
+		for (auto const& r: ranges)
+		{
+			if (r.empty())
+				continue;
+			size_t dash = r.find('-');
+			unsigned first = stoul(r.substr(0, dash));
+			unsigned last = dash == string::npos ? first : stoul(r.substr(dash + 1));
+			for (unsigned c = first; c <= last; ++c)
+				cpus.push_back(c);
+		}
+		if (!cpus.empty())
+			ret.push_back(cpus);
+	}
+	return ret;
+}
+#endif
+
+/// Pins the calling thread to the CPUs of the NUMA node that miner @a _index belongs to; @returns that node.
+unsigned pinToNumaNode(unsigned _index)
+{
+#if defined(__linux__)
+	static vector<vector<unsigned>> const s_nodes = numaNodes();
+	if (s_nodes.size() < 2)
+		return 0;
+	unsigned node = _index % s_nodes.size();
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (unsigned c: s_nodes[node])
+		CPU_SET(c, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0)
+		cwarn << "Could not pin miner" << _index << "to NUMA node" << node;
+	return node;
+#else
+	(void)_index;
+	return 0;
+#endif
+}
+
+}
 
 #if ETH_CPUID
 static string jsonEncode(map<string, string> const& _m)
@@ -80,34 +208,47 @@ void EthashCPUMiner::workLoop()
 	static std::mt19937_64 s_eng((utcTime() + std::hash<decltype(tid)>()(tid)));
 
 	uint64_t tryNonce = s_eng();
-	ethash_return_value ethashReturn;
 
 	WorkPackage w = work();
 
-	EthashAux::FullType dag;
-	while (!shouldStop() && !dag)
-	{
-		while (!shouldStop() && EthashAux::computeFull(w.seedHash, true) != 100)
-			this_thread::sleep_for(chrono::milliseconds(500));
-		dag = EthashAux::full(w.seedHash, false);
-	}
+	unsigned node = s_numaReplicas ? pinToNumaNode(index()) : 0;
+	EthashAux::FullType dag = EthashAux::waitForFull(w.seedHash, [&]() { return shouldStop(); });
+	if (!dag)
+		return;
+	shared_ptr<DAGCopy> copy;
+	if (s_hugePages || s_numaReplicas)
+		copy = DAGCopy::get(w.seedHash, dag, node, s_hugePages);
+	void const* data = copy ? copy->data() : dag->data().data();
+	uint64_t size = dag->size();
 
 	h256 boundary = w.boundary;
-	unsigned hashCount = 1;
-	for (; !shouldStop(); tryNonce++, hashCount++)
+	ethash_h256_t const& header = *(ethash_h256_t const*)w.headerHash.data();
+	ethash_return_value_t results[ETHASH_BATCH_NONCES];
+	unsigned hashCount = 0;
+	for (; !shouldStop(); tryNonce += ETHASH_BATCH_NONCES)
 	{
-		ethashReturn = ethash_full_compute(dag->full, *(ethash_h256_t*)w.headerHash.data(), tryNonce);
-		h256 value = h256((uint8_t*)&ethashReturn.result, h256::ConstructFromPointer);
-		if (value <= boundary && submitProof(EthashProofOfWork::Solution{(h64)(u64)tryNonce, h256((uint8_t*)&ethashReturn.mix_hash, h256::ConstructFromPointer)}))
-			break;
-		if (!(hashCount % 100))
-			accumulateHashes(100);
+		ethash_dag_compute_batch(data, size, header, tryNonce, ETHASH_BATCH_NONCES, results);
+		for (unsigned i = 0; i < ETHASH_BATCH_NONCES; ++i)
+		{
+			h256 value = h256((uint8_t*)&results[i].result, h256::ConstructFromPointer);
+			if (value <= boundary && submitProof(EthashProofOfWork::Solution{(h64)(u64)(tryNonce + i), h256((uint8_t*)&results[i].mix_hash, h256::ConstructFromPointer)}))
+			{
+				accumulateHashes(hashCount + i + 1);
+				return;
+			}
+		}
+		if ((hashCount += ETHASH_BATCH_NONCES) >= c_hashesPerReport)
+		{
+			accumulateHashes(hashCount);
+			hashCount = 0;
+		}
 	}
+	accumulateHashes(hashCount);
 }
 
 std::string EthashCPUMiner::platformInfo()
 {
-	string baseline = toString(std::thread::hardware_concurrency()) + "-thread CPU";
+	string baseline = toString(std::thread::hardware_concurrency()) + "-thread CPU (" + ethash_batch_isa() + ")";
 
 #if ETH_CPUID
 	if (!cpuid_present())
@@ -43,6 +43,10 @@ public:
 	static void listDevices() {}
 	static bool configureGPU(unsigned, unsigned, unsigned, unsigned, unsigned, bool, unsigned, uint64_t) { return false; }
 	static void setNumInstances(unsigned _instances) { s_numInstances = std::min<unsigned>(_instances, std::thread::hardware_concurrency()); }
+	/// Mine from a copy of the DAG backed by transparent huge pages, cutting TLB misses on the random DAG reads.
+	static void setHugePages(bool _on) { s_hugePages = _on; }
+	/// Give each NUMA node its own copy of the DAG and pin the mining threads to the nodes in turn (Linux only).
+	static void setNumaReplicas(bool _on) { s_numaReplicas = _on; }
 
 protected:
 	void kickOff() override;
@@ -51,6 +55,8 @@ protected:
 private:
 	void workLoop() override;
 	static unsigned s_numInstances;
+	static bool s_hugePages;
+	static bool s_numaReplicas;
 };
 
 }
@@ -110,7 +110,9 @@ enum class ImportResult
 	Malformed,
 	OverbidGasPrice,
 	BadChain,
-	ZeroSignature
+	ZeroSignature,
+	NonceTooLow,
+	InsufficientFunds
 };
 
 struct ImportRequirements
@@ -55,6 +55,10 @@ public:
 
 	/// Don't forget to call Super::verify when subclassing & overriding.
 	virtual void verify(Strictness _s, BlockHeader const& _bi, BlockHeader const& _parent = BlockHeader(), bytesConstRef _block = bytesConstRef()) const;
+	/// Checks the seals of a batch of headers ahead of their import, using many threads where the engine can.
+	/// The second argument is the number of our best block; seals it would be costly to check that far from it are left for import.
+	/// @returns false for each header whose seal is certainly invalid; the default checks nothing.
+	virtual std::vector<bool> verifySeals(std::vector<BlockHeader> const& _headers, unsigned) const { return std::vector<bool>(_headers.size(), true); }
 	/// Additional verification for transactions in blocks.
 	virtual void verifyTransaction(ImportRequirements::value _ir, TransactionBase const& _t, BlockHeader const& _header, u256 const& _startGasUsed) const;
 	/// Don't forget to call Super::populateFromParent when subclassing & overriding.
@@ -22,6 +22,8 @@
 #include "Block.h"
 
 #include <ctime>
+#include <deque>
+#include <queue>
 #include <boost/filesystem.hpp>
 #include <boost/timer.hpp>
 #include <libdevcore/CommonIO.h>
@@ -311,6 +313,63 @@ bool Block::sync(BlockChain const& _bc, h256 const& _block, BlockHeader const& _
 	return ret;
 }
 
+namespace
+{
+
+/// Transactions waiting to go into a block, kept per sender in nonce order. Only each sender's
+/// next transaction is on offer, so a transaction is never tried before its predecessor.
+class SyncCandidates
+{
+public:
+	/// @param _ts transactions in queue order; each sender's must be in nonce order.
+	explicit SyncCandidates(Transactions const& _ts)
+	{
+		for (unsigned i = 0; i < _ts.size(); ++i)
+			m_bySender[_ts[i].from()].push_back(make_pair(i, &_ts[i]));
+		for (auto const& s: m_bySender)
+			offer(s.second.front());
+	}
+
+	bool empty() const { return m_heads.empty(); }
+
+	/// Takes the best-paying transaction on offer. Its sender has nothing else on offer until advance().
+	Transaction const& pop()
+	{
+		Transaction const* ret = m_heads.top().transaction;
+		m_heads.pop();
+		return *ret;
+	}
+
+	/// Offers the transaction following the one just popped for @a _sender.
+	void advance(Address const& _sender)
+	{
+		auto& q = m_bySender[_sender];
+		q.pop_front();
+		if (!q.empty())
+			offer(q.front());
+	}
+
+private:
+	using Candidate = pair<unsigned, Transaction const*>;
+
+	struct Head
+	{
+		u256 gasPrice;
+		unsigned order;
+		Transaction const* transaction;
+
+		/// Highest gas price on top; ties go to the one the queue put first.
+		bool operator<(Head const& _other) const { return gasPrice < _other.gasPrice || (gasPrice == _other.gasPrice && order > _other.order); }
+	};
+
+	void offer(Candidate const& _c) { m_heads.push(Head{_c.second->gasPrice(), _c.first, _c.second}); }
+
+	unordered_map<Address, deque<Candidate>> m_bySender;
+	priority_queue<Head> m_heads;
+};
+
+}
+
 pair<TransactionReceipts, bool> Block::sync(BlockChain const& _bc, TransactionQueue& _tq, GasPricer const& _gp, unsigned msTimeout)
 {
 	if (isSealed())
@@ -321,94 +380,123 @@ pair<TransactionReceipts, bool> Block::sync(BlockChain const& _bc, TransactionQu
 	// TRANSACTIONS
 	pair<TransactionReceipts, bool> ret;
 
+	// Transactions already in the block are skipped, so only those that arrived since the last sync are looked at.
 	auto ts = _tq.topTransactions(c_maxSyncTransactions, m_transactionSet);
 	ret.second = (ts.size() == c_maxSyncTransactions);	// say there's more to the caller if we hit the limit
 
 	assert(_bc.currentHash() == m_currentBlock.parentHash());
 	auto deadline =  chrono::steady_clock::now() + chrono::milliseconds(msTimeout);
 
-	for (int goodTxs = max(0, (int)ts.size() - 1); goodTxs < (int)ts.size(); )
+	u256 const ask = _gp.ask(*this);
+	SyncCandidates candidates(ts);
+	while (!candidates.empty())
 	{
-		goodTxs = 0;
-		for (auto const& t: ts)
-			if (!m_transactionSet.count(t.sha3()))
+		Transaction const& t = candidates.pop();
+		// Whether the sender's next transaction can still go in after this one.
+		bool senderGood = false;
+		try
+		{
+			if (t.gasPrice() >= ask)
 			{
-				try
-				{
-					if (t.gasPrice() >= _gp.ask(*this))
-					{
-//						Timer t;
-						execute(_bc.lastBlockHashes(), t);
-						ret.first.push_back(m_receipts.back());
-						++goodTxs;
-//						cnote << "TX took:" << t.elapsed() * 1000;
-					}
-					else if (t.gasPrice() < _gp.ask(*this) * 9 / 10)
-					{
-						clog(StateTrace) << t.sha3() << "Dropping El Cheapo transaction (<90% of ask price)";
-						_tq.drop(t.sha3());
-					}
-				}
-				catch (InvalidNonce const& in)
-				{
-					bigint const& req = *boost::get_error_info<errinfo_required>(in);
-					bigint const& got = *boost::get_error_info<errinfo_got>(in);
-
-					if (req > got)
-					{
-						// too old
-						clog(StateTrace) << t.sha3() << "Dropping old transaction (nonce too low)";
-						_tq.drop(t.sha3());
-					}
-					else if (got > req + _tq.waiting(t.sender()))
-					{
-						// too new
-						clog(StateTrace) << t.sha3() << "Dropping new transaction (too many nonces ahead)";
-						_tq.drop(t.sha3());
-					}
-					else
-						_tq.setFuture(t.sha3());
-				}
-				catch (BlockGasLimitReached const& e)
-				{
-					bigint const& got = *boost::get_error_info<errinfo_got>(e);
-					if (got > m_currentBlock.gasLimit())
-					{
-						clog(StateTrace) << t.sha3() << "Dropping over-gassy transaction (gas > block's gas limit)";
-						clog(StateTrace) << "got: " << got << " required: " << m_currentBlock.gasLimit();
-						_tq.drop(t.sha3());
-					}
-					else
-					{
-						clog(StateTrace) << t.sha3() << "Temporarily no gas left in current block (txs gas > block's gas limit)";
-						//_tq.drop(t.sha3());
-						// Temporarily no gas left in current block.
-						// OPTIMISE: could note this and then we don't evaluate until a block that does have the gas left.
-						// for now, just leave alone.
-					}
-				}
-				catch (Exception const& _e)
-				{
-					// Something else went wrong - drop it.
-					clog(StateTrace) << t.sha3() << "Dropping invalid transaction:" << diagnostic_information(_e);
-					_tq.drop(t.sha3());
-				}
-				catch (std::exception const&)
-				{
-					// Something else went wrong - drop it.
-					_tq.drop(t.sha3());
-					cwarn << t.sha3() << "Transaction caused low-level exception :(";
-				}
+//				Timer t;
+				execute(_bc.lastBlockHashes(), t);
+				ret.first.push_back(m_receipts.back());
+				senderGood = true;
+//				cnote << "TX took:" << t.elapsed() * 1000;
 			}
+			else if (t.gasPrice() < ask * 9 / 10)
+			{
+				clog(StateTrace) << t.sha3() << "Dropping El Cheapo transaction (<90% of ask price)";
+				_tq.drop(t.sha3());
+			}
+		}
+		catch (InvalidNonce const& in)
+		{
+			bigint const& req = *boost::get_error_info<errinfo_required>(in);
+			bigint const& got = *boost::get_error_info<errinfo_got>(in);
+
+			if (req > got)
+			{
+				// too old
+				clog(StateTrace) << t.sha3() << "Dropping old transaction (nonce too low)";
+				_tq.drop(t.sha3());
+				senderGood = true;
+			}
+			else if (got > req + _tq.waiting(t.sender()))
+			{
+				// too new
+				clog(StateTrace) << t.sha3() << "Dropping new transaction (too many nonces ahead)";
+				_tq.drop(t.sha3());
+			}
+			else
+				_tq.setFuture(t.sha3());
+		}
+		catch (BlockGasLimitReached const& e)
+		{
+			bigint const& got = *boost::get_error_info<errinfo_got>(e);
+			if (got > m_currentBlock.gasLimit())
+			{
+				clog(StateTrace) << t.sha3() << "Dropping over-gassy transaction (gas > block's gas limit)";
+				clog(StateTrace) << "got: " << got << " required: " << m_currentBlock.gasLimit();
+				_tq.drop(t.sha3());
+			}
+			else
+			{
+				clog(StateTrace) << t.sha3() << "Temporarily no gas left in current block (txs gas > block's gas limit)";
+				//_tq.drop(t.sha3());
+				// Temporarily no gas left in current block.
+				// OPTIMISE: could note this and then we don't evaluate until a block that does have the gas left.
+				// for now, just leave alone.
+			}
+		}
+		catch (Exception const& _e)
+		{
+			// Something else went wrong - drop it.
+			clog(StateTrace) << t.sha3() << "Dropping invalid transaction:" << diagnostic_information(_e);
+			_tq.drop(t.sha3());
+		}
+		catch (std::exception const&)
+		{
+			// Something else went wrong - drop it.
+			_tq.drop(t.sha3());
+			cwarn << t.sha3() << "Transaction caused low-level exception :(";
+		}
+
+		if (senderGood)
+			candidates.advance(t.from());
 		if (chrono::steady_clock::now() > deadline)
 		{
-			ret.second = true;	// say there's more to the caller if we ended up crossing the deadline.
+			ret.second = !candidates.empty();	// say there's more to the caller if we ended up crossing the deadline.
 			break;
 		}
 	}
 	return ret;
 }
 
+TransactionReceipts Block::replay(BlockChain const& _bc, Transactions const& _ts)
+{
+	if (isSealed())
+		BOOST_THROW_EXCEPTION(InvalidOperationOnSealedBlock());
+
+	noteChain(_bc);
+
+	TransactionReceipts ret;
+	AddressHash failed;
+	for (auto const& t: _ts)
+		if (!failed.count(t.from()) && !m_transactionSet.count(t.sha3()))
+			try
+			{
+				execute(_bc.lastBlockHashes(), t);
+				ret.push_back(m_receipts.back());
+			}
+			catch (Exception const& _e)
+			{
+				clog(StateTrace) << t.sha3() << "Not carrying transaction over:" << diagnostic_information(_e);
+				failed.insert(t.from());
+			}
+	return ret;
+}
+
 u256 Block::enactOn(VerifiedBlockRef const& _block, BlockChain const& _bc)
 {
 	noteChain(_bc);
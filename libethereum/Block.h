@@ -220,8 +220,14 @@ public:
 
 	/// Sync our transactions, killing those from the queue that we have and assimilating those that we don't.
 	/// @returns a list of receipts one for each transaction placed from the queue into the state and bool, true iff there are more transactions to be processed.
+	/// Each sender's transactions are tried in nonce order, best-paying sender first, in a single pass.
 	std::pair<TransactionReceipts, bool> sync(BlockChain const& _bc, TransactionQueue& _tq, GasPricer const& _gp, unsigned _msTimeout = 100);
 
+	/// Executes @a _ts, in order, on top of this block. Used to carry pending transactions over to a new head.
+	/// Once one of a sender's transactions fails, the rest of that sender's are skipped and left to the queue.
+	/// @returns the receipts of the transactions applied.
+	TransactionReceipts replay(BlockChain const& _bc, Transactions const& _ts);
+
 	/// Sync our state with the block chain.
 	/// This basically involves wiping ourselves if we've been superceded and rebuilding from the transaction queue.
 	bool sync(BlockChain const& _bc);
@@ -35,9 +35,12 @@
 #include <libdevcore/FileSystem.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/BlockHeader.h>
+#include <atomic>
+#include <thread>
 #include "GenesisInfo.h"
 #include "State.h"
 #include "Block.h"
+#include "BlockFreezer.h"
 #include "Defaults.h"
 using namespace std;
 using namespace dev;
@@ -179,6 +182,15 @@ static const unsigned c_minCacheSize = 1024 * 1024 * 32;
 
 #endif
 
+/// Max number of blocks moved into the freezer by a single call to freeze().
+static const unsigned c_maxFreezeBatch = 1024;
+
+/// Number of consecutive blocks a thread of verifyState() takes on at once.
+static const unsigned c_verifyChunkSize = 64;
+
+/// Minimum number of newly verified blocks between two checkpoints of verifyState().
+static const unsigned c_verifyCheckpointInterval = 1024;
+
 BlockChain::BlockChain(ChainParams const& _p, std::string const& _dbPath, WithExisting _we, ProgressCallback const& _pc):
 	m_lastBlockHashes(new LastBlockHashes(*this)),
 	m_dbPath(_dbPath)
@@ -217,6 +229,7 @@ void BlockChain::init(ChainParams const& _p)
 	m_sealEngine.reset(m_params.createSealEngine());
 	m_genesis.clear();
 	genesis();
+	m_freezerDepth = Defaults::freezerDepth();
 }
 
 unsigned BlockChain::open(std::string const& _path, WithExisting _we)
@@ -245,6 +258,7 @@ unsigned BlockChain::open(std::string const& _path, WithExisting _we)
 	{
 		cnote << "Killing blockchain & extras database (WithExisting::Kill).";
 		boost::filesystem::remove_all(chainPath + "/blocks");
+		boost::filesystem::remove_all(chainPath + "/freezer");
 		boost::filesystem::remove_all(extrasPath + "/extras");
 	}
 
@@ -272,6 +286,8 @@ unsigned BlockChain::open(std::string const& _path, WithExisting _we)
 		}
 	}
 
+	m_freezer.reset(new BlockFreezer(chainPath + "/freezer"));
+
 //	m_writeOptions.sync = true;
 
 	if (_we != WithExisting::Verify && !details(m_genesisHash))
@@ -300,7 +316,7 @@ unsigned BlockChain::open(std::string const& _path, WithExisting _we)
 
 void BlockChain::open(std::string const& _path, WithExisting _we, ProgressCallback const& _pc)
 {
-	if (open(_path, _we) != c_minorProtocolVersion || _we == WithExisting::Verify)
+	if (open(_path, _we) != c_minorProtocolVersion || _we == WithExisting::Verify || pendingRebuild())
 		rebuild(_path, _pc);
 }
 
@@ -317,6 +333,7 @@ void BlockChain::close()
 	// Not thread safe...
 	delete m_extrasDB;
 	delete m_blocksDB;
+	m_freezer.reset();
 	m_lastBlockHash = m_genesisHash;
 	m_lastBlockNumber = 0;
 	m_details.clear();
@@ -341,45 +358,58 @@ void BlockChain::rebuild(std::string const& _path, std::function<void(unsigned,
 	ProfilerStart("BlockChain_rebuild.log");
 #endif
 
-	unsigned originalNumber = m_lastBlockNumber;
+	// Every imported block is a checkpoint: its state is committed and "best" is updated. So if a
+	// previous rebuild was interrupted, we can carry on from there as long as we still have the
+	// old extras to tell us what comes next.
+	unsigned originalNumber = pendingRebuild();
+	bool resume = originalNumber && boost::filesystem::exists(extrasPath + "/extras.old");
+	if (!resume)
+		originalNumber = m_lastBlockNumber;
 
-	///////////////////////////////
-	// TODO
-	// - KILL ALL STATE/CHAIN
-	// - REINSERT ALL BLOCKS
-	///////////////////////////////
-
-	// Keep extras DB around, but under a temp name
-	delete m_extrasDB;
-	m_extrasDB = nullptr;
-	boost::filesystem::rename(extrasPath + "/extras", extrasPath + "/extras.old");
 	ldb::DB* oldExtrasDB;
 	ldb::Options o;
 	o.create_if_missing = true;
-	ldb::DB::Open(o, extrasPath + "/extras.old", &oldExtrasDB);
-	ldb::DB::Open(o, extrasPath + "/extras", &m_extrasDB);
-
-	// Open a fresh state DB
-	Block s = genesisBlock(State::openDB(path, m_genesisHash, WithExisting::Kill));
-
-	// Clear all memos ready for replay.
-	m_details.clear();
-	m_logBlooms.clear();
-	m_receipts.clear();
-	m_transactionAddresses.clear();
-	m_blockHashes.clear();
-	m_blocksBlooms.clear();
-	m_lastBlockHashes->clear();
-	m_lastBlockHash = genesisHash();
-	m_lastBlockNumber = 0;
+	Block s(Block::Null);
+	if (resume)
+	{
+		cnote << "Resuming interrupted rebuild at block" << (m_lastBlockNumber + 1) << "of" << originalNumber;
+		ldb::DB::Open(o, extrasPath + "/extras.old", &oldExtrasDB);
+		s = genesisBlock(State::openDB(path, m_genesisHash, WithExisting::Trust));
+	}
+	else
+	{
+		// Keep extras DB around, but under a temp name
+		delete m_extrasDB;
+		m_extrasDB = nullptr;
+		boost::filesystem::rename(extrasPath + "/extras", extrasPath + "/extras.old");
+		ldb::DB::Open(o, extrasPath + "/extras.old", &oldExtrasDB);
+		ldb::DB::Open(o, extrasPath + "/extras", &m_extrasDB);
 
-	m_details[m_lastBlockHash].totalDifficulty = s.info().difficulty();
+		// Open a fresh state DB
+		s = genesisBlock(State::openDB(path, m_genesisHash, WithExisting::Kill));
 
-	m_extrasDB->Put(m_writeOptions, toSlice(m_lastBlockHash, ExtraDetails), (ldb::Slice)dev::ref(m_details[m_lastBlockHash].rlp()));
+		// Clear all memos ready for replay.
+		m_details.clear();
+		m_logBlooms.clear();
+		m_receipts.clear();
+		m_transactionAddresses.clear();
+		m_blockHashes.clear();
+		m_blocksBlooms.clear();
+		m_lastBlockHashes->clear();
+		m_lastBlockHash = genesisHash();
+		m_lastBlockNumber = 0;
+
+		m_details[m_lastBlockHash].totalDifficulty = s.info().difficulty();
+
+		m_extrasDB->Put(m_writeOptions, toSlice(m_lastBlockHash, ExtraDetails), (ldb::Slice)dev::ref(m_details[m_lastBlockHash].rlp()));
+		m_extrasDB->Put(m_writeOptions, ldb::Slice("rebuild"), (ldb::Slice)dev::ref(rlp(originalNumber)));
+	}
 
 	h256 lastHash = m_lastBlockHash;
+	unsigned frozen = m_freezer->count();
+	unsigned imported = 0;
 	Timer t;
-	for (unsigned d = 1; d <= originalNumber; ++d)
+	for (unsigned d = m_lastBlockNumber + 1; d <= originalNumber; ++d)
 	{
 		if (!(d % 1000))
 		{
@@ -388,7 +418,8 @@ void BlockChain::rebuild(std::string const& _path, std::function<void(unsigned,
 		}
 		try
 		{
-			bytes b = block(queryExtras<BlockHash, uint64_t, ExtraBlockHash>(d, m_blockHashes, x_blockHashes, NullBlockHash, oldExtrasDB).value);
+			h256 h = queryExtras<BlockHash, uint64_t, ExtraBlockHash>(d, m_blockHashes, x_blockHashes, NullBlockHash, oldExtrasDB).value;
+			bytes b = d < frozen ? m_freezer->block(d) : block(h);
 
 			BlockHeader bi(&b);
 
@@ -399,6 +430,7 @@ void BlockChain::rebuild(std::string const& _path, std::function<void(unsigned,
 			}
 			lastHash = bi.hash();
 			import(b, s.db(), 0);
+			imported = d;
 		}
 		catch (...)
 		{
@@ -414,8 +446,113 @@ void BlockChain::rebuild(std::string const& _path, std::function<void(unsigned,
 	ProfilerStop();
 #endif
 
+	// Reimporting put the frozen blocks back into the databases; they're still in the freezer.
+	ldb::WriteBatch blocksBatch;
+	ldb::WriteBatch extrasBatch;
+	for (unsigned d = 1; d < frozen && d <= imported; ++d)
+	{
+		h256 h = numberHash(d);
+		blocksBatch.Delete(toSlice(h));
+		extrasBatch.Delete(toSlice(h, ExtraReceipts));
+	}
+	extrasBatch.Delete(ldb::Slice("rebuild"));
+	m_blocksDB->Write(m_writeOptions, &blocksBatch);
+	m_extrasDB->Write(m_writeOptions, &extrasBatch);
+
 	delete oldExtrasDB;
-	boost::filesystem::remove_all(path + "/extras.old");
+	boost::filesystem::remove_all(extrasPath + "/extras.old");
+}
+
+unsigned BlockChain::pendingRebuild() const
+{
+	string r;
+	m_extrasDB->Get(m_readOptions, ldb::Slice("rebuild"), &r);
+	return r.empty() ? 0 : RLP(r).toInt<unsigned>();
+}
+
+unsigned BlockChain::verifiedCheckpoint() const
+{
+	string r;
+	m_extrasDB->Get(m_readOptions, ldb::Slice("verified"), &r);
+	return r.empty() ? 0 : RLP(r).toInt<unsigned>();
+}
+
+unsigned BlockChain::verifyState(OverlayDB const& _stateDB, unsigned _from, unsigned _to, unsigned _threads, ProgressCallback const& _progress)
+{
+	_from = max(_from, 1u);
+	_to = min(_to, number());
+	if (_from > _to)
+		return 0;
+
+	unsigned const total = _to - _from + 1;
+	unsigned const chunks = (total + c_verifyChunkSize - 1) / c_verifyChunkSize;
+	atomic<unsigned> nextChunk(0);
+	atomic<unsigned> done(0);
+
+	Mutex x_results;
+	unsigned firstBad = 0;
+	vector<bool> chunkDone(chunks, false);
+	unsigned contiguous = 0;		// Chunks [0, contiguous) are all verified.
+	unsigned lastCheckpoint = _from - 1;
+
+	auto verifyChunks = [&]()
+	{
+		OverlayDB db = _stateDB;
+		for (unsigned c = nextChunk++; c < chunks; c = nextChunk++)
+		{
+			unsigned begin = _from + c * c_verifyChunkSize;
+			unsigned end = min(begin + c_verifyChunkSize - 1, _to);
+			for (unsigned n = begin; n <= end; ++n)
+			{
+				bool pastFailure = false;
+				DEV_GUARDED(x_results)
+					pastFailure = firstBad && firstBad < n;
+				if (pastFailure)
+					break;
+				try
+				{
+					bytes b = block(numberHash(n));
+					Block s(*this, db);
+					s.enactOn(verifyBlock(&b, m_onBad, ImportRequirements::OutOfOrderChecks), *this);
+				}
+				catch (...)
+				{
+					cwarn << "State verification failed at block" << n << ":" << boost::current_exception_diagnostic_information();
+					DEV_GUARDED(x_results)
+						if (!firstBad || n < firstBad)
+							firstBad = n;
+					break;
+				}
+				++done;
+			}
+
+			DEV_GUARDED(x_results)
+			{
+				chunkDone[c] = true;
+				while (contiguous < chunks && chunkDone[contiguous])
+					++contiguous;
+				unsigned verified = min(_from - 1 + contiguous * c_verifyChunkSize, _to);
+				if (firstBad)
+					verified = min(verified, firstBad - 1);
+				if (verified >= lastCheckpoint + c_verifyCheckpointInterval || (verified == _to && verified > lastCheckpoint))
+				{
+					m_extrasDB->Put(m_writeOptions, ldb::Slice("verified"), (ldb::Slice)dev::ref(rlp(verified)));
+					lastCheckpoint = verified;
+				}
+				if (_progress)
+					_progress(done, total);
+			}
+		}
+	};
+
+	vector<thread> workers;
+	for (unsigned i = 1; i < max(_threads, 1u); ++i)
+		workers.push_back(thread(verifyChunks));
+	verifyChunks();
+	for (auto& w: workers)
+		w.join();
+
+	return firstBad;
 }
 
 string BlockChain::dumpDatabase() const
@@ -1099,6 +1236,7 @@ void BlockChain::rewind(unsigned _newHead)
 	{
 		if (_newHead >= m_lastBlockNumber)
 			return;
+		thaw(_newHead + 1);
 		clearCachesDuringChainReversion(_newHead + 1);
 		m_lastBlockHash = numberHash(_newHead);
 		m_lastBlockNumber = _newHead;
@@ -1385,7 +1523,7 @@ bool BlockChain::isKnown(h256 const& _hash, bool _isCurrent) const
 		{
 			string d;
 			m_blocksDB->Get(m_readOptions, toSlice(_hash), &d);
-			if (d.empty())
+			if (d.empty() && frozenNumber(_hash) == c_notFrozen)
 				return false;
 		}
 	DEV_READ_GUARDED(x_details)
@@ -1417,6 +1555,9 @@ bytes BlockChain::block(h256 const& _hash) const
 
 	if (d.empty())
 	{
+		unsigned n = frozenNumber(_hash);
+		if (n != c_notFrozen)
+			return m_freezer->block(n);
 		cwarn << "Couldn't find requested block:" << _hash;
 		return bytes();
 	}
@@ -1447,6 +1588,12 @@ bytes BlockChain::headerData(h256 const& _hash) const
 
 	if (d.empty())
 	{
+		unsigned n = frozenNumber(_hash);
+		if (n != c_notFrozen)
+		{
+			bytes b = m_freezer->block(n);
+			return BlockHeader::extractHeader(&b).data().toBytes();
+		}
 		cwarn << "Couldn't find requested block:" << _hash;
 		return bytes();
 	}
@@ -1460,6 +1607,138 @@ bytes BlockChain::headerData(h256 const& _hash) const
 	return BlockHeader::extractHeader(&m_blocks[_hash]).data().toBytes();
 }
 
+void BlockChain::streamBlocks(unsigned _from, unsigned _to, std::function<void(bytesConstRef)> const& _f) const
+{
+	ldb::ReadOptions bulk = m_readOptions;
+	bulk.fill_cache = false;
+	uint64_t frozen = m_freezer ? m_freezer->count() : 0;
+	_to = min(_to, number());
+	for (unsigned n = _from; n <= _to; ++n)
+	{
+		if (!n)
+		{
+			bytes g = m_params.genesisBlock();
+			_f(&g);
+		}
+		else if (n < frozen)
+		{
+			bytes b = m_freezer->block(n);
+			_f(&b);
+		}
+		else
+		{
+			string d;
+			h256 h = numberHash(n);
+			m_blocksDB->Get(bulk, toSlice(h), &d);
+			if (!d.empty())
+				_f(bytesConstRef(&d));
+			else
+			{
+				// Moved to the freezer since we started, or only in the cache: take the usual path.
+				bytes b = block(h);
+				if (b.empty())
+					BOOST_THROW_EXCEPTION(BlockNotFound() << errinfo_comment("Canonical block " + toString(n) + " missing from the database."));
+				_f(&b);
+			}
+		}
+	}
+}
+
+BlockReceipts BlockChain::receipts(h256 const& _hash) const
+{
+	BlockReceipts ret = queryExtras<BlockReceipts, ExtraReceipts>(_hash, m_receipts, x_receipts, NullBlockReceipts);
+	if (!ret.receipts.empty())
+		return ret;
+
+	unsigned n = frozenNumber(_hash);
+	if (n == c_notFrozen)
+		return ret;
+	bytes r = m_freezer->receipts(n);
+	if (r.empty())
+		return ret;
+
+	noteUsed(_hash, ExtraReceipts);
+
+	WriteGuard l(x_receipts);
+	return m_receipts[_hash] = BlockReceipts(RLP(r));
+}
+
+unsigned BlockChain::frozenNumber(h256 const& _hash) const
+{
+	if (!m_freezer || !m_freezer->count())
+		return c_notFrozen;
+	unsigned n = details(_hash).number;
+	return n < m_freezer->count() && numberHash(n) == _hash ? n : c_notFrozen;
+}
+
+void BlockChain::freeze()
+{
+	if (!m_freezer || !m_freezerDepth || number() <= m_freezerDepth)
+		return;
+
+	unsigned from = m_freezer->count();
+	unsigned to = min(number() - m_freezerDepth, from + c_maxFreezeBatch);
+	if (from >= to)
+		return;
+
+	h256s frozen;
+	for (unsigned n = from; n < to; ++n)
+	{
+		h256 h = numberHash(n);
+		string b;
+		string r;
+		if (n)
+			m_blocksDB->Get(m_readOptions, toSlice(h), &b);
+		else
+			b = asString(m_params.genesisBlock());
+		m_extrasDB->Get(m_readOptions, toSlice(h, ExtraReceipts), &r);
+		if (b.empty())
+		{
+			cwarn << "Couldn't find canonical block" << n << "(" << h << ") to freeze.";
+			break;
+		}
+		m_freezer->append(bytesConstRef(&b), bytesConstRef(&r));
+		frozen.push_back(h);
+	}
+	// Make sure the frozen copies are durable before dropping the originals.
+	m_freezer->sync();
+
+	ldb::WriteBatch blocksBatch;
+	ldb::WriteBatch extrasBatch;
+	for (h256 const& h: frozen)
+	{
+		blocksBatch.Delete(toSlice(h));
+		extrasBatch.Delete(toSlice(h, ExtraReceipts));
+	}
+	m_blocksDB->Write(m_writeOptions, &blocksBatch);
+	m_extrasDB->Write(m_writeOptions, &extrasBatch);
+
+	clog(BlockChainNote) << "Froze blocks" << from << "to" << (from + frozen.size() - 1);
+}
+
+void BlockChain::thaw(unsigned _from)
+{
+	if (!m_freezer || _from >= m_freezer->count())
+		return;
+
+	ldb::WriteBatch blocksBatch;
+	ldb::WriteBatch extrasBatch;
+	for (unsigned n = max(_from, 1u); n < m_freezer->count(); ++n)
+	{
+		h256 h = numberHash(n);
+		bytes b = m_freezer->block(n);
+		bytes r = m_freezer->receipts(n);
+		blocksBatch.Put(toSlice(h), (ldb::Slice)dev::ref(b));
+		if (!r.empty())
+			extrasBatch.Put(toSlice(h, ExtraReceipts), (ldb::Slice)dev::ref(r));
+	}
+	m_blocksDB->Write(m_writeOptions, &blocksBatch);
+	m_extrasDB->Write(m_writeOptions, &extrasBatch);
+	m_freezer->truncate(_from);
+
+	clog(BlockChainNote) << "Thawed frozen blocks from" << _from;
+}
+
 Block BlockChain::genesisBlock(OverlayDB const& _db) const
 {
 	h256 r = BlockHeader(m_params.genesisBlock()).stateRoot();
@@ -62,6 +62,7 @@ static const h256s NullH256s;
 
 class State;
 class Block;
+class BlockFreezer;
 
 DEV_SIMPLE_EXCEPTION(AlreadyHaveBlock);
 DEV_SIMPLE_EXCEPTION(FutureTime);
@@ -149,6 +150,11 @@ public:
 	bytes block(h256 const& _hash) const;
 	bytes block() const { return block(currentHash()); }
 
+	/// Calls @a _f with each canonical block (RLP format) from number @a _from to @a _to inclusive, in order.
+	/// Meant for bulk reads such as exports: the block caches are bypassed. Thread-safe.
+	/// @throws BlockNotFound if a canonical block in the range cannot be found.
+	void streamBlocks(unsigned _from, unsigned _to, std::function<void(bytesConstRef)> const& _f) const;
+
 	/// Get a block (RLP format) for the given hash (or the most recent mined if none given). Thread-safe.
 	bytes headerData(h256 const& _hash) const;
 	bytes headerData() const { return headerData(currentHash()); }
@@ -163,7 +169,7 @@ public:
 
 	/// Get the transactions' receipts of a block (or the most recent mined if none given). Thread-safe.
 	/// receipts are given in the same order are in the same order as the transactions
-	BlockReceipts receipts(h256 const& _hash) const { return queryExtras<BlockReceipts, ExtraReceipts>(_hash, m_receipts, x_receipts, NullBlockReceipts); }
+	BlockReceipts receipts(h256 const& _hash) const;
 	BlockReceipts receipts() const { return receipts(currentHash()); }
 
 	/// Get the transaction by block hash and index;
@@ -237,8 +243,21 @@ public:
 
 	/// Run through database and verify all blocks by reevaluating.
 	/// Will call _progress with the progress in this operation first param done, second total.
+	/// If a previous rebuild was interrupted, it is resumed from the last block it imported.
 	void rebuild(std::string const& _path, ProgressCallback const& _progress = std::function<void(unsigned, unsigned)>());
 
+	/// Re-execute the canonical blocks @a _from to @a _to (inclusive) against the state database and
+	/// check that each reproduces its header's state root. Every block is executed on top of its
+	/// parent's state root, so the range is split over @a _threads threads. A checkpoint of the
+	/// contiguous verified prefix is saved periodically; pass verifiedCheckpoint() + 1 as @a _from to
+	/// resume from the last one. The genesis block has nothing to execute, so @a _from is at least 1.
+	/// Will call _progress with the progress in this operation first param done, second total.
+	/// @returns the number of the first block that failed verification, or 0 if all passed.
+	unsigned verifyState(OverlayDB const& _stateDB, unsigned _from, unsigned _to, unsigned _threads, ProgressCallback const& _progress = ProgressCallback());
+
+	/// @returns the highest block number up to which verifyState() has checked the chain.
+	unsigned verifiedCheckpoint() const;
+
 	/// Alter the head of the chain to some prior block along it.
 	void rewind(unsigned _newHead);
 
@@ -288,6 +307,13 @@ public:
 	/// Deallocate unused data.
 	void garbageCollect(bool _force = false);
 
+	/// Move a batch of canonical blocks (and their receipts) which are older than the freezer depth
+	/// out of the databases and into the append-only freezer. To be called periodically.
+	void freeze();
+
+	/// Change the number of blocks behind the head below which blocks get frozen; 0 disables freezing.
+	void setFreezerDepth(unsigned _depth) { m_freezerDepth = _depth; }
+
 	/// Change the function that is called with a bad block.
 	void setOnBad(std::function<void(Exception&)> _t) { m_onBad = _t; }
 
@@ -318,6 +344,8 @@ private:
 	unsigned open(std::string const& _path, WithExisting _we);
 	/// Open the database, rebuilding if necessary.
 	void open(std::string const& _path, WithExisting _we, ProgressCallback const& _pc);
+	/// @returns the block number an interrupted rebuild was aiming for, or 0 if there is none.
+	unsigned pendingRebuild() const;
 	/// Finalise everything and close the database.
 	void close();
 
@@ -349,6 +377,12 @@ private:
 
 	void checkConsistency();
 
+	/// @returns the number of block @a _hash if it is held in the freezer, or c_notFrozen otherwise.
+	unsigned frozenNumber(h256 const& _hash) const;
+	/// Move all frozen blocks from number @a _from onwards back into the databases.
+	void thaw(unsigned _from);
+	static const unsigned c_notFrozen = (unsigned)-1;
+
 	/// Clears all caches from the tip of the chain up to (including) _firstInvalid.
 	/// These include the blooms, the block hashes and the transaction lookup tables.
 	void clearCachesDuringChainReversion(unsigned _firstInvalid);
@@ -388,6 +422,10 @@ private:
 	ldb::DB* m_blocksDB;
 	ldb::DB* m_extrasDB;
 
+	/// Flat-file store of ancient canonical blocks and receipts. Thread-safe.
+	std::unique_ptr<BlockFreezer> m_freezer;
+	unsigned m_freezerDepth = 0;
+
 	/// Hash of the last (valid) block on the longest chain.
 	mutable boost::shared_mutex x_lastBlockHash;
 	h256 m_lastBlockHash;
@@ -22,6 +22,8 @@
 #include "BlockChainSync.h"
 
 #include <chrono>
+#include <limits>
+#include <unordered_set>
 #include <libdevcore/Common.h>
 #include <libdevcore/TrieHash.h>
 #include <libp2p/Host.h>
@@ -40,6 +42,9 @@ using namespace p2p;
 unsigned const c_maxPeerUknownNewBlocks = 1024; /// Max number of unknown new blocks peer can give us
 unsigned const c_maxRequestHeaders = 1024;
 unsigned const c_maxRequestBodies = 1024;
+unsigned const c_skeletonSpacing = 192;		///< Skeleton headers are this many blocks apart; the gaps between them are filled in parallel.
+unsigned const c_maxSkeletonHeaders = 128;	///< Most skeleton headers asked for at once.
+unsigned const c_maxSkeletonConflicts = 3;	///< Replies in a row that don't link up with the skeleton before we suspect the skeleton instead.
 
 
 std::ostream& dev::eth::operator<<(std::ostream& _out, SyncStatus const& _sync)
@@ -120,6 +125,14 @@ template<typename T> void removeAllStartingWith(std::map<unsigned, std::vector<T
 	_container.erase(++lower, _container.end());
 }
 
+/// Takes out one peer's hold on @a _number, leaving any other peers'.
+void eraseOne(std::unordered_multiset<unsigned>& _numbers, unsigned _number)
+{
+	auto it = _numbers.find(_number);
+	if (it != _numbers.end())
+		_numbers.erase(it);
+}
+
 template<typename T> void mergeInto(std::map<unsigned, std::vector<T>>& _container, unsigned _number, T&& _data)
 {
 	assert(!haveItem(_container, _number));
@@ -190,6 +203,13 @@ void BlockChainSync::onBlockImported(BlockHeader const& _info)
 	}
 }
 
+void BlockChainSync::tick()
+{
+	RecursiveGuard l(x_sync);
+	if (m_state == SyncState::Blocks)
+		continueSync();
+}
+
 void BlockChainSync::abortSync()
 {
 	resetSync();
@@ -260,11 +280,19 @@ void BlockChainSync::syncPeer(std::shared_ptr<EthereumPeer> _peer, bool _force)
 
 void BlockChainSync::continueSync()
 {
-	host().foreachPeer([this](std::shared_ptr<EthereumPeer> _p)
+	// Fastest peers first, so they're given the blocks the queue needs soonest.
+	vector<shared_ptr<EthereumPeer>> peers;
+	host().foreachPeer([&](std::shared_ptr<EthereumPeer> _p)
 	{
-		syncPeer(_p, false);
+		peers.push_back(_p);
 		return true;
 	});
+	stable_sort(peers.begin(), peers.end(), [](shared_ptr<EthereumPeer> const& _a, shared_ptr<EthereumPeer> const& _b)
+	{
+		return make_pair(_a->m_bodyRate.itemsPerSecond(), _a->m_headerRate.itemsPerSecond()) > make_pair(_b->m_bodyRate.itemsPerSecond(), _b->m_headerRate.itemsPerSecond());
+	});
+	for (auto const& p: peers)
+		syncPeer(p, false);
 }
 
 void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
@@ -276,14 +304,17 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
 		pauseSync();
 		return;
 	}
+	if (requestSkeleton(_peer))
+		return;
 	// check to see if we need to download any block bodies first
 	auto header = m_headers.begin();
 	h256s neededBodies;
 	vector<unsigned> neededNumbers;
 	unsigned index = 0;
+	unsigned const maxBodies = _peer->m_bodyRate.requestSize(c_maxRequestBodies);
 	if (m_haveCommonHeader && !m_headers.empty() && m_headers.begin()->first == m_lastImportedBlock + 1)
 	{
-		while (header != m_headers.end() && neededBodies.size() < c_maxRequestBodies && index < header->second.size())
+		while (header != m_headers.end() && neededBodies.size() < maxBodies && index < header->second.size())
 		{
 			unsigned block = header->first + index;
 			if (m_downloadingBodies.count(block) == 0 && !haveItem(m_bodies, block))
@@ -301,6 +332,7 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
 	if (neededBodies.size() > 0)
 	{
 		m_bodySyncPeers[_peer] = neededNumbers;
+		_peer->m_bodyRate.requested(neededBodies.size());
 		_peer->requestBlockBodies(neededBodies);
 	}
 	else
@@ -332,7 +364,7 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
 
 			while (count == 0 && next != m_headers.end())
 			{
-				count = std::min(c_maxRequestHeaders, next->first - start);
+				count = std::min(_peer->m_headerRate.requestSize(c_maxRequestHeaders), next->first - start);
 				while(count > 0 && m_downloadingHeaders.count(start) != 0)
 				{
 					start++;
@@ -350,6 +382,7 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
 				{
 					m_headerSyncPeers[_peer] = headers;
 					assert(!haveItem(m_headers, start));
+					_peer->m_headerRate.requested(count);
 					_peer->requestBlockHeaders(start, count, 0, false);
 				}
 				else if (start >= next->first)
@@ -362,6 +395,124 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
 		else
 			_peer->requestBlockHeaders(start, 1, 0, false);
 	}
+	if (_peer->m_asking == Asking::Nothing)
+		hedge(_peer);
+}
+
+bool BlockChainSync::requestSkeleton(std::shared_ptr<EthereumPeer> _peer)
+{
+	// The skeleton comes from the peer we're syncing to, and is kept a while ahead of the blocks still needed.
+	if (!m_haveCommonHeader || !m_skeletonPeer.expired() || _peer->m_totalDifficulty < m_syncingTotalDifficulty || m_skeletonSuspects.count(_peer))
+		return false;
+	if (m_skeletonEnd > m_lastImportedBlock + c_skeletonSpacing * c_maxSkeletonHeaders / 2)
+		return false;
+	unsigned const first = max(m_skeletonEnd, m_lastImportedBlock) + c_skeletonSpacing;
+	if (first >= m_highestBlock)
+		return false;
+	unsigned const count = min(c_maxSkeletonHeaders, (m_highestBlock - first) / c_skeletonSpacing + 1);
+	clog(NetAllDetail) << "Requesting" << count << "skeleton headers from" << first;
+	m_skeletonPeer = _peer;
+	m_skeletonFirst = first;
+	// Not asked for again even if the reply falls short; the gaps above are then filled without a skeleton.
+	m_skeletonEnd = first + (count - 1) * c_skeletonSpacing;
+	_peer->requestBlockHeaders(first, count, c_skeletonSpacing - 1, false);
+	return true;
+}
+
+void BlockChainSync::suspectSkeletonPeer(std::shared_ptr<EthereumPeer> _peer)
+{
+	for (auto i = m_skeletonSuspects.begin(); i != m_skeletonSuspects.end();)
+		if (i->expired())
+			i = m_skeletonSuspects.erase(i);
+		else
+			++i;
+	m_skeletonSuspects.insert(_peer);
+}
+
+bool BlockChainSync::linksToSkeleton(vector<BlockHeader> const& _headers)
+{
+	if (_headers.empty())
+		return true;
+	for (size_t i = 1; i < _headers.size(); ++i)
+		if (_headers[i].number() != _headers[i - 1].number() + 1 || _headers[i].parentHash() != _headers[i - 1].hash())
+			return false;
+	unsigned const first = static_cast<unsigned>(_headers.front().number());
+	unsigned const last = static_cast<unsigned>(_headers.back().number());
+	Header const* prev = first ? findItem(m_headers, first - 1) : nullptr;
+	Header const* next = findItem(m_headers, last + 1);
+	return (!prev || !prev->skeleton || prev->hash == _headers.front().parentHash()) && (!next || !next->skeleton || next->parent == _headers.back().hash());
+}
+
+bool BlockChainSync::hedge(std::shared_ptr<EthereumPeer> _peer)
+{
+	// The lowest numbers held by a straggler are what the block queue is waiting for first.
+	auto const now = PeerSyncRate::Clock::now();
+	auto straggling = [&](decltype(m_bodySyncPeers) const& _requests, PeerSyncRate EthereumPeer::* _rate) -> vector<unsigned> const*
+	{
+		double const rate = ((*_peer).*_rate).itemsPerSecond();
+		vector<unsigned> const* ret = nullptr;
+		for (auto const& r: _requests)
+		{
+			auto p = r.first.lock();
+			if (!p || p == _peer || r.second.empty() || !((*p).*_rate).isStraggling(now) || ((*p).*_rate).itemsPerSecond() >= rate)
+				continue;
+			if (!ret || r.second.front() < ret->front())
+				ret = &r.second;
+		}
+		return ret;
+	};
+
+	if (auto blocks = straggling(m_bodySyncPeers, &EthereumPeer::m_bodyRate))
+	{
+		unsigned const maxBodies = _peer->m_bodyRate.requestSize(c_maxRequestBodies);
+		h256s hashes;
+		vector<unsigned> numbers;
+		for (unsigned block: *blocks)
+		{
+			Header const* header = findItem(m_headers, block);
+			if (header && !haveItem(m_bodies, block) && m_downloadingBodies.count(block) == 1 && numbers.size() < maxBodies)
+			{
+				hashes.push_back(header->hash);
+				numbers.push_back(block);
+			}
+		}
+		if (!numbers.empty())
+		{
+			clog(NetAllDetail) << "Hedging" << numbers.size() << "block bodies from" << numbers.front() << "held by a slower peer";
+			for (unsigned block: numbers)
+				m_downloadingBodies.insert(block);
+			m_bodySyncPeers[_peer] = numbers;
+			_peer->m_bodyRate.requested(numbers.size(), now);
+			_peer->requestBlockBodies(hashes);
+			return true;
+		}
+	}
+
+	if (auto blocks = straggling(m_headerSyncPeers, &EthereumPeer::m_headerRate))
+	{
+		// Headers are asked for by range, so take the run from the first one still missing.
+		unsigned const maxHeaders = _peer->m_headerRate.requestSize(c_maxRequestHeaders);
+		vector<unsigned> numbers;
+		for (unsigned block: *blocks)
+		{
+			bool const wanted = !haveItem(m_headers, block) && m_downloadingHeaders.count(block) == 1;
+			if (wanted && (numbers.empty() || block == numbers.back() + 1) && numbers.size() < maxHeaders)
+				numbers.push_back(block);
+			else if (!numbers.empty())
+				break;
+		}
+		if (!numbers.empty())
+		{
+			clog(NetAllDetail) << "Hedging" << numbers.size() << "block headers from" << numbers.front() << "held by a slower peer";
+			for (unsigned block: numbers)
+				m_downloadingHeaders.insert(block);
+			m_headerSyncPeers[_peer] = numbers;
+			_peer->m_headerRate.requested(numbers.size(), now);
+			_peer->requestBlockHeaders(numbers.front(), numbers.size(), 0, false);
+			return true;
+		}
+	}
+	return false;
 }
 
 void BlockChainSync::clearPeerDownload(std::shared_ptr<EthereumPeer> _peer)
@@ -370,14 +521,14 @@ void BlockChainSync::clearPeerDownload(std::shared_ptr<EthereumPeer> _peer)
 	if (syncPeer != m_headerSyncPeers.end())
 	{
 		for (unsigned block : syncPeer->second)
-			m_downloadingHeaders.erase(block);
+			eraseOne(m_downloadingHeaders, block);
 		m_headerSyncPeers.erase(syncPeer);
 	}
 	syncPeer = m_bodySyncPeers.find(_peer);
 	if (syncPeer != m_bodySyncPeers.end())
 	{
 		for (unsigned block : syncPeer->second)
-			m_downloadingBodies.erase(block);
+			eraseOne(m_downloadingBodies, block);
 		m_bodySyncPeers.erase(syncPeer);
 	}
 }
@@ -389,7 +540,7 @@ void BlockChainSync::clearPeerDownload()
 		if (s->first.expired())
 		{
 			for (unsigned block : s->second)
-				m_downloadingHeaders.erase(block);
+				eraseOne(m_downloadingHeaders, block);
 			m_headerSyncPeers.erase(s++);
 		}
 		else
@@ -400,7 +551,7 @@ void BlockChainSync::clearPeerDownload()
 		if (s->first.expired())
 		{
 			for (unsigned block : s->second)
-				m_downloadingBodies.erase(block);
+				eraseOne(m_downloadingBodies, block);
 			m_bodySyncPeers.erase(s++);
 		}
 		else
@@ -415,13 +566,88 @@ void BlockChainSync::logNewBlock(h256 const& _h)
 	m_knownNewHashes.erase(_h);
 }
 
+vector<size_t> BlockChainSync::screenHeaders(std::shared_ptr<EthereumPeer> _peer, vector<BlockHeader> const& _headers, vector<bool>& o_requested, vector<bool>& o_valid)
+{
+	RecursiveGuard l(x_sync);
+	bool const skeleton = m_skeletonPeer.lock() == _peer;
+	auto syncPeer = m_headerSyncPeers.find(_peer);
+	unordered_set<unsigned> asked;
+	if (syncPeer != m_headerSyncPeers.end())
+		asked.insert(syncPeer->second.begin(), syncPeer->second.end());
+
+	vector<size_t> ret;
+	for (size_t i = 0; i < _headers.size(); ++i)
+	{
+		BlockHeader const& info = _headers[i];
+		if (info.number() > numeric_limits<unsigned>::max())
+			continue;
+		unsigned blockNumber = static_cast<unsigned>(info.number());
+		if (skeleton)
+			o_requested[i] = blockNumber == m_skeletonFirst + i * c_skeletonSpacing && blockNumber <= m_skeletonEnd;
+		else if (syncPeer != m_headerSyncPeers.end())
+			o_requested[i] = asked.count(blockNumber) > 0;
+		else
+			// A single header asked for by hash, or while looking for the common block.
+			o_requested[i] = _headers.size() == 1;
+		if (!o_requested[i] || haveItem(m_headers, blockNumber) || (blockNumber <= m_lastImportedBlock && m_haveCommonHeader) || host().chain().isKnown(info.hash()))
+			continue;
+
+		// Difficulty and the rest follow from the parent, where we know it.
+		BlockHeader parent;
+		if (i && _headers[i - 1].hash() == info.parentHash())
+			parent = _headers[i - 1];
+		else if (host().chain().isKnown(info.parentHash()))
+			parent = host().chain().info(info.parentHash());
+		else if (Header const* prev = blockNumber ? findItem(m_headers, blockNumber - 1) : nullptr)
+			if (prev->hash == info.parentHash())
+				parent = BlockHeader(prev->data, HeaderData);
+		if (parent)
+			try
+			{
+				host().chain().sealEngine()->verify(IgnoreSeal, info, parent);
+			}
+			catch (Exception const&)
+			{
+				o_valid[i] = false;
+				continue;
+			}
+		ret.push_back(i);
+	}
+	return ret;
+}
+
 void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP const& _r)
 {
+	auto const arrived = PeerSyncRate::Clock::now();
+	size_t itemCount = _r.itemCount();
+	vector<BlockHeader> headers;
+	headers.reserve(itemCount);
+	for (unsigned i = 0; i < itemCount; i++)
+		headers.emplace_back(_r[i].data(), HeaderData);
+
+	// Check the seals of what survives the cheap checks across all cores, without holding the sync lock.
+	vector<bool> requested(itemCount, false);
+	vector<bool> validSeals(itemCount, true);
+	vector<size_t> toVerify = screenHeaders(_peer, headers, requested, validSeals);
+	if (!toVerify.empty())
+	{
+		vector<BlockHeader> batch;
+		batch.reserve(toVerify.size());
+		for (size_t i: toVerify)
+			batch.push_back(headers[i]);
+		vector<bool> verified = host().chain().sealEngine()->verifySeals(batch, host().chain().number());
+		for (size_t j = 0; j < toVerify.size(); ++j)
+			validSeals[toVerify[j]] = verified[j];
+	}
+
 	RecursiveGuard l(x_sync);
 	DEV_INVARIANT_CHECK;
-	size_t itemCount = _r.itemCount();
 	clog(NetMessageSummary) << "BlocksHeaders (" << dec << itemCount << "entries)" << (itemCount ? "" : ": NoMoreHeaders");
+	_peer->m_headerRate.replied(itemCount, arrived);
 	clearPeerDownload(_peer);
+	bool const skeleton = m_skeletonPeer.lock() == _peer;
+	if (skeleton)
+		m_skeletonPeer.reset();
 	if (m_state != SyncState::Blocks && m_state != SyncState::NewBlocks && m_state != SyncState::Waiting)
 	{
 		clog(NetMessageSummary) << "Ignoring unexpected blocks";
@@ -437,9 +663,35 @@ void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP
 		clog(NetAllDetail) << "Peer does not have the blocks requested";
 		_peer->addRating(-1);
 	}
+	else if (skeleton)
+		m_skeletonSupplier = _peer;
+	else if (m_haveCommonHeader)
+	{
+		// Reject the whole segment rather than have it undo the skeleton headers it should fit between.
+		if (!linksToSkeleton(headers))
+		{
+			clog(NetImpolite) << "Block headers from" << headers.front().number() << "don't link up with the skeleton";
+			_peer->addRating(-1);
+			if (++m_skeletonConflicts > c_maxSkeletonConflicts)
+			{
+				// The skeleton is more likely wrong than all of those peers; don't take one from its supplier again.
+				clog(NetWarn) << "Too many block headers not linking up with the skeleton; restarting sync";
+				if (auto supplier = m_skeletonSupplier.lock())
+				{
+					supplier->addRating(-10);
+					suspectSkeletonPeer(supplier);
+				}
+				restartSync();
+			}
+			else
+				continueSync();
+			return;
+		}
+		m_skeletonConflicts = 0;
+	}
 	for (unsigned i = 0; i < itemCount; i++)
 	{
-		BlockHeader info(_r[i].data(), HeaderData);
+		BlockHeader const& info = headers[i];
 		unsigned blockNumber = static_cast<unsigned>(info.number());
 		if (haveItem(m_headers, blockNumber))
 		{
@@ -451,6 +703,24 @@ void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP
 			clog(NetMessageSummary) << "Skipping header " << blockNumber;
 			continue;
 		}
+		if (skeleton && blockNumber != m_skeletonFirst + i * c_skeletonSpacing)
+		{
+			clog(NetImpolite) << "Skeleton header " << blockNumber << " out of place";
+			_peer->addRating(-1);
+			break;
+		}
+		if (!requested[i])
+		{
+			clog(NetMessageSummary) << "Skipping unrequested header " << blockNumber;
+			continue;
+		}
+		if (!validSeals[i])
+		{
+			// The rest of the batch builds on this one; drop it all.
+			clog(NetImpolite) << "Invalid seal or difficulty on block header " << blockNumber << " " << info.hash();
+			_peer->addRating(-1);
+			break;
+		}
 		if (blockNumber > m_highestBlock)
 			m_highestBlock = blockNumber;
 
@@ -463,7 +733,7 @@ void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP
 		}
 		else
 		{
-			Header hdr { _r[i].data().toBytes(), info.hash(), info.parentHash() };
+			Header hdr { _r[i].data().toBytes(), info.hash(), info.parentHash(), skeleton };
 
 			// validate chain
 			HeaderId headerId { info.transactionsRoot(), info.sha3Uncles() };
@@ -524,6 +794,7 @@ void BlockChainSync::onPeerBlockBodies(std::shared_ptr<EthereumPeer> _peer, RLP
 	DEV_INVARIANT_CHECK;
 	size_t itemCount = _r.itemCount();
 	clog(NetMessageSummary) << "BlocksBodies (" << dec << itemCount << "entries)" << (itemCount ? "" : ": NoMoreBodies");
+	_peer->m_bodyRate.replied(itemCount);
 	clearPeerDownload(_peer);
 	if (m_state != SyncState::Blocks && m_state != SyncState::NewBlocks && m_state != SyncState::Waiting) {
 		clog(NetMessageSummary) << "Ignoring unexpected blocks";
@@ -759,6 +1030,10 @@ void BlockChainSync::resetSync()
 	m_bodySyncPeers.clear();
 	m_headerIdToNumber.clear();
 	m_syncingTotalDifficulty = 0;
+	m_skeletonPeer.reset();
+	m_skeletonSupplier.reset();
+	m_skeletonEnd = 0;
+	m_skeletonConflicts = 0;
 	m_state = SyncState::NotSynced;
 }
 
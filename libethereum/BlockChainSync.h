@@ -22,7 +22,9 @@
 #pragma once
 
 #include <mutex>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <libdevcore/Guards.h>
 #include <libethcore/Common.h>
@@ -83,6 +85,9 @@ public:
 	/// Called when a blockchain has imported a new block onto the DB
 	void onBlockImported(BlockHeader const& _info);
 
+	/// Called about once a second, so idle peers can take over the blocks of straggling ones.
+	void tick();
+
 	/// @returns Synchonization status
 	SyncStatus status() const;
 
@@ -101,6 +106,10 @@ private:
 	void resetSync();
 	void syncPeer(std::shared_ptr<EthereumPeer> _peer, bool _force);
 	void requestBlocks(std::shared_ptr<EthereumPeer> _peer);
+	/// Asks @a _peer, if it's faster, for the lowest items of another peer's straggling request too. @returns true if it asked.
+	bool hedge(std::shared_ptr<EthereumPeer> _peer);
+	/// Asks @a _peer, if it's the best peer and the skeleton doesn't reach far enough ahead, for its next headers. @returns true if it asked.
+	bool requestSkeleton(std::shared_ptr<EthereumPeer> _peer);
 	void clearPeerDownload(std::shared_ptr<EthereumPeer> _peer);
 	void clearPeerDownload();
 	void collectBlocks();
@@ -111,8 +120,20 @@ private:
 		bytes data;		///< Header data
 		h256 hash;		///< Block hash
 		h256 parent;	///< Parent hash
+		bool skeleton;	///< Fetched as part of the skeleton; the headers filling the gaps must link up with it
 	};
 
+	/// Stops @a _peer supplying skeletons, e.g. after its skeleton conflicted with too many other peers' headers.
+	void suspectSkeletonPeer(std::shared_ptr<EthereumPeer> _peer);
+
+	/// @returns true if @a _headers, a reply filling a gap, form a chain that links up with any skeleton headers either side of it.
+	bool linksToSkeleton(std::vector<BlockHeader> const& _headers);
+
+	/// Screens @a _headers from @a _peer with the cheap checks, so only what passes them has its seal checked.
+	/// Sets o_requested for those @a _peer was asked for and clears o_valid for those that don't follow from a known parent.
+	/// @returns the positions of the requested headers we don't have yet and that weren't found invalid.
+	std::vector<size_t> screenHeaders(std::shared_ptr<EthereumPeer> _peer, std::vector<BlockHeader> const& _headers, std::vector<bool>& o_requested, std::vector<bool>& o_valid);
+
 	/// Used to identify header by transactions and uncles hashes
 	struct HeaderId
 	{
@@ -144,8 +165,8 @@ private:
 	h256Hash m_knownNewHashes; 					///< New hashes we know about use for logging only
 	unsigned m_startingBlock = 0;      	    	///< Last block number for the start of sync
 	unsigned m_highestBlock = 0;       	     	///< Highest block number seen
-	std::unordered_set<unsigned> m_downloadingHeaders;		///< Set of block body numbers being downloaded
-	std::unordered_set<unsigned> m_downloadingBodies;		///< Set of block header numbers being downloaded
+	std::unordered_multiset<unsigned> m_downloadingHeaders;	///< Numbers of block headers being downloaded, once for each peer asked (more than one if hedged)
+	std::unordered_multiset<unsigned> m_downloadingBodies;	///< Numbers of block bodies being downloaded, once for each peer asked (more than one if hedged)
 	std::map<unsigned, std::vector<Header>> m_headers;	    ///< Downloaded headers
 	std::map<unsigned, std::vector<bytes>> m_bodies;	    ///< Downloaded block bodies
 	std::map<std::weak_ptr<EthereumPeer>, std::vector<unsigned>, std::owner_less<std::weak_ptr<EthereumPeer>>> m_headerSyncPeers; ///< Peers to m_downloadingSubchain number map
@@ -155,6 +176,12 @@ private:
 	unsigned m_lastImportedBlock = 0; 			///< Last imported block number
 	h256 m_lastImportedBlockHash;				///< Last imported block hash
 	u256 m_syncingTotalDifficulty;				///< Highest peer difficulty
+	std::weak_ptr<EthereumPeer> m_skeletonPeer;	///< Peer asked for skeleton headers, if the request is outstanding
+	unsigned m_skeletonFirst = 0;				///< Number of the first header asked of m_skeletonPeer
+	unsigned m_skeletonEnd = 0;					///< Skeleton headers have been asked for up to this number
+	unsigned m_skeletonConflicts = 0;			///< Replies in a row rejected for not linking up with the skeleton
+	std::weak_ptr<EthereumPeer> m_skeletonSupplier;	///< Peer the skeleton headers last came from
+	std::set<std::weak_ptr<EthereumPeer>, std::owner_less<std::weak_ptr<EthereumPeer>>> m_skeletonSuspects;	///< Peers whose skeletons conflicted with the rest; not asked for one again, even after a restart
 
 private:
 	static char const* const s_stateNames[static_cast<int>(SyncState::Size)];
@@ -0,0 +1,343 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file BlockFreezer.cpp
+ * @date 2016
+ */
+
+#include "BlockFreezer.h"
+
+#include <libdevcore/CommonData.h>
+#include <libdevcore/Exceptions.h>
+#include <boost/filesystem.hpp>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+namespace fs = boost::filesystem;
+
+const char* FreezerNote::name() { return EthBlue "❄" EthBlue " ℹ"; }
+
+namespace
+{
+
+/// Size of one serialised index entry: segment (4 bytes), length (4 bytes), offset (8 bytes).
+static const unsigned c_indexEntrySize = 16;
+
+#if defined(_WIN32)
+// No positional I/O on Windows; serialise all seek+read/write pairs.
+static Mutex s_ioLock;
+#endif
+
+int openFile(string const& _path)
+{
+#if defined(_WIN32)
+	int fd = _open(_path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	int fd = ::open(_path.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+	if (fd < 0)
+		BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Cannot open freezer file " + _path));
+	return fd;
+}
+
+void closeFile(int _fd)
+{
+#if defined(_WIN32)
+	_close(_fd);
+#else
+	::close(_fd);
+#endif
+}
+
+uint64_t fileSize(int _fd)
+{
+#if defined(_WIN32)
+	return _filelengthi64(_fd);
+#else
+	struct stat st;
+	if (fstat(_fd, &st))
+		BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Cannot stat freezer file"));
+	return st.st_size;
+#endif
+}
+
+void readAt(int _fd, uint64_t _offset, bytesRef _out)
+{
+#if defined(_WIN32)
+	Guard l(s_ioLock);
+	if (_lseeki64(_fd, _offset, SEEK_SET) < 0 || _read(_fd, _out.data(), _out.size()) != (int)_out.size())
+		BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Short read from freezer file"));
+#else
+	for (size_t done = 0; done < _out.size();)
+	{
+		ssize_t r = ::pread(_fd, _out.data() + done, _out.size() - done, _offset + done);
+		if (r <= 0)
+			BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Short read from freezer file"));
+		done += r;
+	}
+#endif
+}
+
+void writeAt(int _fd, uint64_t _offset, bytesConstRef _data)
+{
+#if defined(_WIN32)
+	Guard l(s_ioLock);
+	if (_lseeki64(_fd, _offset, SEEK_SET) < 0 || _write(_fd, _data.data(), _data.size()) != (int)_data.size())
+		BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Short write to freezer file"));
+#else
+	for (size_t done = 0; done < _data.size();)
+	{
+		ssize_t r = ::pwrite(_fd, _data.data() + done, _data.size() - done, _offset + done);
+		if (r <= 0)
+			BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Short write to freezer file"));
+		done += r;
+	}
+#endif
+}
+
+void truncateFile(int _fd, uint64_t _size)
+{
+#if defined(_WIN32)
+	if (_chsize_s(_fd, _size))
+#else
+	if (::ftruncate(_fd, _size))
+#endif
+		BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Cannot truncate freezer file"));
+}
+
+void syncFile(int _fd)
+{
+#if defined(_WIN32)
+	_commit(_fd);
+#else
+	::fsync(_fd);
+#endif
+}
+
+byte const* mapFile(int _fd, uint64_t _size)
+{
+#if defined(_WIN32)
+	(void)_fd;
+	(void)_size;
+	return nullptr;
+#else
+	if (!_size)
+		return nullptr;
+	void* p = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+	return p == MAP_FAILED ? nullptr : (byte const*)p;
+#endif
+}
+
+void unmapFile(byte const* _map, uint64_t _size)
+{
+#if defined(_WIN32)
+	(void)_map;
+	(void)_size;
+#else
+	if (_map)
+		::munmap((void*)_map, _size);
+#endif
+}
+
+}
+
+FreezerTable::FreezerTable(string const& _dir, string const& _name):
+	m_dir(_dir),
+	m_name(_name)
+{
+	fs::create_directories(m_dir);
+	m_indexFd = openFile(m_dir + "/" + m_name + ".idx");
+
+	// Drop any partially written index entry.
+	m_count = fileSize(m_indexFd) / c_indexEntrySize;
+	truncateFile(m_indexFd, m_count * c_indexEntrySize);
+
+	IndexEntry last;
+	if (m_count)
+		last = readIndex(m_count - 1);
+
+	for (unsigned s = 0; s <= last.segment; ++s)
+		openSegment(s);
+
+	// Drop any data appended after the last complete index entry.
+	Segment& active = m_segments.back();
+	active.size = m_count ? last.offset + last.length : 0;
+	truncateFile(active.fd, active.size);
+	for (unsigned s = last.segment + 1; fs::exists(segmentPath(s)); ++s)
+		fs::remove(segmentPath(s));
+
+	for (unsigned s = 0; s < last.segment; ++s)
+		sealSegment(m_segments[s]);
+
+	clog(FreezerNote) << "Opened freezer table" << m_name << "with" << m_count << "items in" << m_segments.size() << "segments";
+}
+
+FreezerTable::~FreezerTable()
+{
+	for (auto& s: m_segments)
+		closeSegment(s);
+	closeFile(m_indexFd);
+}
+
+string FreezerTable::segmentPath(unsigned _segment) const
+{
+	char num[16];
+	snprintf(num, sizeof(num), "%04u", _segment);
+	return m_dir + "/" + m_name + "." + num + ".dat";
+}
+
+FreezerTable::IndexEntry FreezerTable::readIndex(uint64_t _i) const
+{
+	byte e[c_indexEntrySize];
+	readAt(m_indexFd, _i * c_indexEntrySize, bytesRef(e, c_indexEntrySize));
+	IndexEntry ret;
+	ret.segment = fromBigEndian<uint32_t>(bytesConstRef(e, 4));
+	ret.length = fromBigEndian<uint32_t>(bytesConstRef(e + 4, 4));
+	ret.offset = fromBigEndian<uint64_t>(bytesConstRef(e + 8, 8));
+	return ret;
+}
+
+void FreezerTable::openSegment(unsigned _segment)
+{
+	Segment s;
+	s.fd = openFile(segmentPath(_segment));
+	s.size = fileSize(s.fd);
+	m_segments.push_back(s);
+}
+
+void FreezerTable::sealSegment(Segment& _s)
+{
+	syncFile(_s.fd);
+	_s.map = mapFile(_s.fd, _s.size);
+}
+
+void FreezerTable::closeSegment(Segment& _s)
+{
+	unmapFile(_s.map, _s.size);
+	_s.map = nullptr;
+	if (_s.fd >= 0)
+		closeFile(_s.fd);
+	_s.fd = -1;
+}
+
+void FreezerTable::append(bytesConstRef _item)
+{
+	WriteGuard l(x_table);
+	if (m_segments.back().size && m_segments.back().size + _item.size() > c_freezerSegmentSize)
+	{
+		sealSegment(m_segments.back());
+		openSegment(m_segments.size());
+		truncateFile(m_segments.back().fd, 0);
+		m_segments.back().size = 0;
+	}
+
+	Segment& active = m_segments.back();
+	writeAt(active.fd, active.size, _item);
+
+	byte e[c_indexEntrySize];
+	bytesRef segment(e, 4);
+	bytesRef length(e + 4, 4);
+	bytesRef offset(e + 8, 8);
+	toBigEndian<uint32_t>(m_segments.size() - 1, segment);
+	toBigEndian<uint32_t>(_item.size(), length);
+	toBigEndian<uint64_t>(active.size, offset);
+	writeAt(m_indexFd, m_count * c_indexEntrySize, bytesConstRef(e, c_indexEntrySize));
+
+	active.size += _item.size();
+	++m_count;
+}
+
+bytes FreezerTable::item(uint64_t _i) const
+{
+	ReadGuard l(x_table);
+	if (_i >= m_count)
+		return bytes();
+
+	IndexEntry e = readIndex(_i);
+	Segment const& s = m_segments[e.segment];
+	if (s.map)
+		return bytes(s.map + e.offset, s.map + e.offset + e.length);
+
+	bytes ret(e.length);
+	readAt(s.fd, e.offset, &ret);
+	return ret;
+}
+
+void FreezerTable::truncate(uint64_t _count)
+{
+	WriteGuard l(x_table);
+	if (_count >= m_count)
+		return;
+
+	IndexEntry first = readIndex(_count);
+	while (m_segments.size() > first.segment + 1)
+	{
+		closeSegment(m_segments.back());
+		m_segments.pop_back();
+		fs::remove(segmentPath(m_segments.size()));
+	}
+
+	// The segment becomes the one appended to again, so it may no longer be mapped.
+	Segment& active = m_segments.back();
+	unmapFile(active.map, active.size);
+	active.map = nullptr;
+	active.size = first.offset;
+	truncateFile(active.fd, active.size);
+
+	m_count = _count;
+	truncateFile(m_indexFd, m_count * c_indexEntrySize);
+}
+
+void FreezerTable::sync()
+{
+	WriteGuard l(x_table);
+	syncFile(m_segments.back().fd);
+	syncFile(m_indexFd);
+}
+
+BlockFreezer::BlockFreezer(string const& _path):
+	m_blocks(_path, "blocks"),
+	m_receipts(_path, "receipts")
+{
+	// An interrupted append may have left one table ahead of the other.
+	truncate(count());
+}
+
+void BlockFreezer::append(bytesConstRef _block, bytesConstRef _receipts)
+{
+	m_blocks.append(_block);
+	m_receipts.append(_receipts);
+}
+
+void BlockFreezer::truncate(uint64_t _count)
+{
+	m_receipts.truncate(_count);
+	m_blocks.truncate(_count);
+}
+
+void BlockFreezer::sync()
+{
+	m_blocks.sync();
+	m_receipts.sync();
+}
@@ -0,0 +1,144 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file BlockFreezer.h
+ * @date 2016
+ *
+ * Immutable, append-only storage for ancient blocks and their receipts.
+ */
+
+#pragma once
+
+#include <libdevcore/Common.h>
+#include <libdevcore/Guards.h>
+#include <libdevcore/Log.h>
+#include <string>
+#include <vector>
+
+namespace dev
+{
+namespace eth
+{
+
+struct FreezerNote: public LogChannel { static const char* name(); static const int verbosity = 3; };
+
+/// Maximum size of a single data segment file of a freezer table.
+static const uint64_t c_freezerSegmentSize = 1024 * 1024 * 1024;
+
+/**
+ * @brief A single append-only column of the freezer.
+ *
+ * Items are addressed by their dense position (0, 1, 2, ...) and are stored back-to-back in
+ * a series of segment files. A fixed-width index file records the segment, offset and length of
+ * every item so that any of them can be found with a single lookup. Segments which are full are
+ * never written to again and are read through a memory map.
+ *
+ * @threadsafe
+ */
+class FreezerTable
+{
+public:
+	/// Opens (creating if needed) the table @a _name within directory @a _dir. Any data written
+	/// after the last complete index entry (e.g. because of a crash) is discarded.
+	FreezerTable(std::string const& _dir, std::string const& _name);
+	~FreezerTable();
+
+	FreezerTable(FreezerTable const&) = delete;
+	FreezerTable& operator=(FreezerTable const&) = delete;
+
+	/// @returns the number of items in the table.
+	uint64_t count() const { ReadGuard l(x_table); return m_count; }
+
+	/// Appends @a _item at position count().
+	void append(bytesConstRef _item);
+
+	/// @returns the item at position @a _i or an empty array if there is no such item.
+	bytes item(uint64_t _i) const;
+
+	/// Drops all items from position @a _count onwards.
+	void truncate(uint64_t _count);
+
+	/// Flushes everything appended so far to the disk.
+	void sync();
+
+private:
+	struct Segment
+	{
+		int fd = -1;
+		uint64_t size = 0;
+		byte const* map = nullptr;	///< Non-null only for segments that are full and hence immutable.
+	};
+
+	struct IndexEntry
+	{
+		uint32_t segment = 0;
+		uint32_t length = 0;
+		uint64_t offset = 0;
+	};
+
+	std::string segmentPath(unsigned _segment) const;
+	IndexEntry readIndex(uint64_t _i) const;
+	void openSegment(unsigned _segment);
+	void sealSegment(Segment& _s);
+	void closeSegment(Segment& _s);
+
+	std::string m_dir;
+	std::string m_name;
+
+	mutable SharedMutex x_table;
+	int m_indexFd = -1;
+	uint64_t m_count = 0;
+	std::vector<Segment> m_segments;	///< The last one is the segment currently appended to.
+};
+
+/**
+ * @brief Flat-file store for finalised blocks and their receipts, indexed by block number.
+ *
+ * Entries are only ever appended in block-number order, so the block and the receipts of
+ * block @a n live at position @a n of their respective tables.
+ *
+ * @threadsafe
+ */
+class BlockFreezer
+{
+public:
+	explicit BlockFreezer(std::string const& _path);
+
+	/// @returns the number of blocks held; these are blocks 0 to count() - 1.
+	uint64_t count() const { return std::min(m_blocks.count(), m_receipts.count()); }
+
+	/// Adds the next block, i.e. block number count(), together with its receipts.
+	void append(bytesConstRef _block, bytesConstRef _receipts);
+
+	/// @returns the RLP of block number @a _number or an empty array if it is not held.
+	bytes block(uint64_t _number) const { return _number < count() ? m_blocks.item(_number) : bytes(); }
+
+	/// @returns the receipts RLP of block number @a _number or an empty array if it is not held.
+	bytes receipts(uint64_t _number) const { return _number < count() ? m_receipts.item(_number) : bytes(); }
+
+	/// Drops all blocks from number @a _count onwards.
+	void truncate(uint64_t _count);
+
+	/// Flushes everything appended so far to the disk.
+	void sync();
+
+private:
+	FreezerTable m_blocks;
+	FreezerTable m_receipts;
+};
+
+}
+}
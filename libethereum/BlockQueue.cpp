@@ -66,6 +66,7 @@ void BlockQueue::stop()
 		m_deleting = true;
 
 	m_moreToVerify.notify_all();
+	m_roomForMore.notify_all();
 	for (auto& i: m_verifiers)
 		i.join();
 	m_verifiers.clear();
@@ -86,6 +87,7 @@ void BlockQueue::clear()
 	m_future.clear();
 	m_difficulty = 0;
 	m_drainingDifficulty = 0;
+	m_roomForMore.notify_all();
 }
 
 void BlockQueue::verifierBody()
@@ -124,6 +126,7 @@ void BlockQueue::verifierBody()
 			if (!m_verifying.remove(work.hash))
 				cwarn << "Unexpected exception when verifying block: " << _ex.what();
 			drainVerified_WITH_BOTH_LOCKS();
+			m_roomForMore.notify_all();
 			continue;
 		}
 
@@ -383,6 +386,12 @@ BlockQueueStatus BlockQueue::status() const
 		m_future.count(), m_unknown.count(), m_knownBad.size() };
 }
 
+void BlockQueue::waitForRoom(unsigned _max)
+{
+	unique_lock<Mutex> l(m_verification);
+	m_roomForMore.wait(l, [&](){ return m_deleting || m_verified.count() + m_verifying.count() + m_unverified.count() <= _max; });
+}
+
 QueueStatus BlockQueue::blockStatus(h256 const& _h) const
 {
 	ReadGuard l(m_lock);
@@ -442,6 +451,8 @@ void BlockQueue::drain(VerifiedBlocks& o_out, unsigned _max)
 			m_drainingDifficulty = 0;
 			DEV_GUARDED(m_verification)
 				o_out = m_verified.dequeueMultiple(min<unsigned>(_max, m_verified.count()));
+			if (!o_out.empty())
+				m_roomForMore.notify_all();
 
 			for (auto const& bs: o_out)
 			{
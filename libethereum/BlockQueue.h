@@ -264,6 +264,10 @@ public:
 	/// Get some infomration on the current status.
 	BlockQueueStatus status() const;
 
+	/// Block the caller until no more than @a _max blocks are waiting for verification or import,
+	/// or the queue is stopped.
+	void waitForRoom(unsigned _max);
+
 	/// Get some infomration on the given block's status regarding us.
 	QueueStatus blockStatus(h256 const& _h) const;
 
@@ -313,6 +317,7 @@ private:
 
 	mutable Mutex m_verification;										///< Mutex that allows writing to m_verified, m_verifying and m_unverified.
 	std::condition_variable m_moreToVerify;								///< Signaled when m_unverified has a new entry.
+	std::condition_variable m_roomForMore;								///< Signaled when blocks leave the verification queues.
 	SizedBlockQueue<VerifiedBlock> m_verified;								///< List of blocks, in correct order, verified and ready for chain-import.
 	SizedBlockQueue<VerifiedBlock> m_verifying;								///< List of blocks being verified; as long as the block component (bytes) is empty, it's not finished.
 	SizedBlockQueue<UnverifiedBlock> m_unverified;							///< List of <block hash, parent hash, block data> in correct order, ready for verification.
@@ -57,6 +57,9 @@ const char* ClientTrace::name() { return EthTeal "⧫" EthGray " ◎"; }
 const char* ClientDetail::name() { return EthTeal "⧫" EthCoal " ●"; }
 #endif
 
+/// Number of blocks waiting in the block queue above which queueBlock() holds back its caller.
+static const unsigned c_maxQueuedBlocks = 10000;
+
 Client::Client(
 	ChainParams const& _params,
 	int _networkID,
@@ -120,15 +123,32 @@ void Client::init(p2p::Host* _extNet, std::string const& _dbPath, WithExisting _
 
 	if (_dbPath.size())
 		Defaults::setDBPath(_dbPath);
+
+	// A killed chain takes its pending transactions with it.
+	if (_forceAction == WithExisting::Kill)
+		DEV_IGNORE_EXCEPTIONS(boost::filesystem::remove(transactionJournalPath()));
+	publishStateSnapshot();
+
 	doWork(false);
 	startWorking();
 }
 
-ImportResult Client::queueBlock(bytes const& _block, bool _isSafe)
+string Client::transactionJournalPath() const
+{
+	return Defaults::dbPath() + "/" + toHex(bc().genesisHash().ref().cropped(0, 4)) + "/transactions.journal";
+}
+
+void Client::openTransactionJournal()
 {
-	if (m_bq.status().verified + m_bq.status().verifying + m_bq.status().unverified > 10000)
-		this_thread::sleep_for(std::chrono::milliseconds(500));
-	return m_bq.import(&_block, _isSafe);
+	// On our own thread, so the journal is never swapped under maintainJournal().
+	executeInMainThread([=]() { m_tq.openJournal(transactionJournalPath()); });
+}
+
+ImportResult Client::queueBlock(bytesConstRef _block, bool _isSafe)
+{
+	// Hold back the caller until the verifiers and importer have caught up.
+	m_bq.waitForRoom(c_maxQueuedBlocks);
+	return m_bq.import(_block, _isSafe);
 }
 
 tuple<ImportRoute, bool, unsigned> Client::syncQueue(unsigned _max)
@@ -267,6 +287,7 @@ void Client::reopenChain(ChainParams const& _p, WithExisting _we)
 		m_working = Block(chainParams().accountStartNonce);
 	}
 
+	publishStateSnapshot();
 	if (auto h = m_host.lock())
 		h->reset();
 
@@ -471,7 +492,7 @@ void Client::onNewBlocks(h256s const& _blocks, h256Hash& io_changed)
 		appendFromBlock(h, BlockPolarity::Live, io_changed);
 }
 
-void Client::resyncStateFromChain()
+void Client::resyncStateFromChain(AddressHash const* _touched)
 {
 	// RESTART MINING
 
@@ -491,21 +512,46 @@ void Client::resyncStateFromChain()
 		{
 			DEV_WRITE_GUARDED(x_preSeal)
 				m_preSeal = newPreMine;
-			DEV_WRITE_GUARDED(x_working)
-				m_working = newPreMine;
+
+			// Pending transactions of senders the new blocks did not touch are still valid in the same order;
+			// replay those straight away and send only the others back through the queue.
+			Transactions carried;
 			DEV_READ_GUARDED(x_postSeal)
 				if (!m_postSeal.isSealed() || m_postSeal.info().hash() != newPreMine.info().parentHash())
 					for (auto const& t: m_postSeal.pending())
 					{
+						if (_touched && !_touched->count(t.from()))
+						{
+							carried.push_back(t);
+							continue;
+						}
 						clog(ClientTrace) << "Resubmitting post-seal transaction " << t;
 //						ctrace << "Resubmitting post-seal transaction " << t;
 						auto ir = m_tq.import(t, IfDropped::Retry);
 						if (ir != ImportResult::Success)
 							onTransactionQueueReady();
 					}
+
+			TransactionReceipts carriedReceipts;
+			DEV_WRITE_GUARDED(x_working)
+			{
+				m_working = newPreMine;
+				if (!carried.empty())
+					carriedReceipts = m_working.replay(bc(), carried);
+			}
 			DEV_READ_GUARDED(x_working) DEV_WRITE_GUARDED(x_postSeal)
 				m_postSeal = m_working;
 
+			if (!carriedReceipts.empty())
+			{
+				clog(ClientTrace) << "Carried" << carriedReceipts.size() << "of" << carried.size() << "pending transactions over to the new head";
+				h256Hash changeds;
+				DEV_READ_GUARDED(x_postSeal)
+					for (size_t i = 0; i < carriedReceipts.size(); i++)
+						appendFromNewPending(carriedReceipts[i], changeds, m_postSeal.pending()[i].sha3());
+				noteChanged(changeds);
+			}
+
 			onPostStateChanged();
 		}
 
@@ -535,16 +581,32 @@ void Client::onChainChanged(ImportRoute const& _ir)
 //	ctrace << "onChainChanged()";
 	h256Hash changeds;
 	onDeadBlocks(_ir.deadBlocks, changeds);
+	AddressHash touched;
 	for (auto const& t: _ir.goodTranactions)
 	{
 		clog(ClientTrace) << "Safely dropping transaction " << t.sha3();
 		m_tq.dropGood(t);
+		touched.insert(t.from());
 	}
 	onNewBlocks(_ir.liveBlocks, changeds);
-	resyncStateFromChain();
+	m_gp->noteChainChanged(bc());
+	publishStateSnapshot();
+	// After a reorganisation the pending transactions' senders may have lost transactions too; resubmit them all.
+	resyncStateFromChain(_ir.deadBlocks.empty() ? &touched : nullptr);
 	noteChanged(changeds);
 }
 
+void Client::publishStateSnapshot()
+{
+	// Queued transactions are checked against the head's state, without copying a whole Block per check.
+	auto s = make_shared<State>(chainParams().accountStartNonce, m_stateDB);
+	DEV_IF_THROWS(s->setRoot(bc().info().stateRoot()))
+	{
+		s.reset();
+	}
+	m_tq.setStateSnapshot(s);
+}
+
 bool Client::remoteActive() const
 {
 	return chrono::system_clock::now() - m_lastGetWork < chrono::seconds(30);
@@ -684,6 +746,7 @@ void Client::tick()
 		m_report.ticks++;
 		checkWatchGarbage();
 		m_bq.tick();
+		m_tq.maintainJournal();
 		m_lastTick = chrono::system_clock::now();
 		if (m_report.ticks == 15)
 			clog(ClientTrace) << activityReport();
@@ -708,6 +771,7 @@ void Client::checkWatchGarbage()
 
 		// blockchain GC
 		bc().garbageCollect();
+		bc().freeze();
 
 		m_lastGarbageCollection = chrono::system_clock::now();
 	}
@@ -757,6 +821,14 @@ void Client::flushTransactions()
 	doWork();
 }
 
+array<ServedDataStatus, 3> Client::servedDataStatus() const
+{
+	auto h = m_host.lock();
+	if (!h)
+		return array<ServedDataStatus, 3>();
+	return h->servedDataStatus();
+}
+
 SyncStatus Client::syncStatus() const
 {
 	auto h = m_host.lock();
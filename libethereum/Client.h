@@ -40,6 +40,7 @@
 #include "Block.h"
 #include "CommonNet.h"
 #include "ClientBase.h"
+#include "ServedDataCache.h"
 
 namespace dev
 {
@@ -91,14 +92,14 @@ public:
 	ChainParams const& chainParams() const { return bc().chainParams(); }
 
 	/// Resets the gas pricer to some other object.
-	void setGasPricer(std::shared_ptr<GasPricer> _gp) { m_gp = _gp; }
+	void setGasPricer(std::shared_ptr<GasPricer> _gp) { m_gp = _gp; m_gp->update(bc()); }
 	std::shared_ptr<GasPricer> gasPricer() const { return m_gp; }
 
 	/// Blocks until all pending transactions have been processed.
 	virtual void flushTransactions() override;
 
 	/// Queues a block for import.
-	ImportResult queueBlock(bytes const& _block, bool _isSafe = false);
+	ImportResult queueBlock(bytesConstRef _block, bool _isSafe = false);
 
 	/// Get the remaining gas limit in this block.
 	virtual u256 gasLimitRemaining() const override { return m_postSeal.gasLimitRemaining(); }
@@ -117,6 +118,8 @@ public:
 	BlockQueueStatus blockQueueStatus() const { return m_bq.status(); }
 	/// Get some information on the block syncing.
 	SyncStatus syncStatus() const override;
+	/// Get the counters of the caches of headers, bodies and receipts we serve peers, in that order.
+	std::array<ServedDataStatus, 3> servedDataStatus() const;
 	/// Get the block queue.
 	BlockQueue const& blockQueue() const { return m_bq; }
 	/// Get the block queue.
@@ -185,6 +188,11 @@ public:
 	void rewind(unsigned _n);
 	/// Rescue the chain.
 	void rescue() { bc().rescue(m_stateDB); }
+	/// Bring back the transactions that were pending when the node last stopped, and journal the
+	/// transaction queue next to the chain's database from now on.
+	void openTransactionJournal();
+	/// Re-execute canonical blocks and check their state roots; see BlockChain::verifyState().
+	unsigned verifyState(unsigned _from, unsigned _to, unsigned _threads, ProgressCallback const& _progress = ProgressCallback()) { return bc().verifyState(m_stateDB, _from, _to, _threads, _progress); }
 
 	/// Queues a function to be executed in the main thread (that owns the blockchain, etc).
 	void executeInMainThread(std::function<void()> const& _function);
@@ -243,7 +251,9 @@ protected:
 	virtual void onNewBlocks(h256s const& _blocks, h256Hash& io_changed);
 
 	/// Called after processing blocks by onChainChanged(_ir)
-	void resyncStateFromChain();
+	/// @param _touched senders of the transactions in the newly imported blocks, if there was no reorganisation.
+	/// Pending transactions of other senders are then replayed on the new head rather than resubmitted to the queue.
+	void resyncStateFromChain(AddressHash const* _touched = nullptr);
 
 	/// Clear working state of transactions
 	void resetState();
@@ -252,6 +262,9 @@ protected:
 	/// Called by either submitWork() or in our main thread through syncBlockQueue().
 	void onChainChanged(ImportRoute const& _ir);
 
+	/// Gives the transaction queue the state at the head of the chain to check transactions against.
+	void publishStateSnapshot();
+
 	/// Signal handler for when the block queue needs processing.
 	void syncBlockQueue();
 
@@ -281,6 +294,9 @@ protected:
 	/// Executes the pending functions in m_functionQueue
 	void callQueuedFunctions();
 
+	/// @returns where the transaction queue is journaled, next to the chain's database.
+	std::string transactionJournalPath() const;
+
 	BlockChain m_bc;						///< Maintains block database and owns the seal engine.
 	BlockQueue m_bq;						///< Maintains a list of incoming blocks not yet on the blockchain (to be imported).
 	std::shared_ptr<GasPricer> m_gp;		///< The gas pricer.
@@ -146,6 +146,7 @@ public:
 	virtual EVMSchedule evmSchedule() const override { return sealEngine()->evmSchedule(pendingInfo().number()); }
 
 	virtual ImportResult injectTransaction(bytes const& _rlp, IfDropped _id = IfDropped::Ignore) override { prepareForTransaction(); return m_tq.import(_rlp, _id); }
+	virtual h256 queueTransaction(bytes const& _rlp) override { prepareForTransaction(); return m_tq.submit(_rlp); }
 	virtual ImportResult injectBlock(bytes const& _block) override;
 
 	using Interface::addresses;
@@ -51,6 +51,7 @@ static const unsigned c_maxPayload = 262144;	///< Maximum size of packet for us
 #endif
 static const unsigned c_maxNodes = c_maxBlocks; ///< Maximum number of nodes will ever send.
 static const unsigned c_maxReceipts = c_maxBlocks; ///< Maximum number of receipts will ever send.
+static const unsigned c_knownTransactionsPerGeneration = 2048;	///< Transactions remembered per generation of a peer's known-transactions filter (up to ~1% false positives over its two 4KB generations).
 
 class BlockChain;
 class TransactionQueue;
@@ -39,9 +39,15 @@ public:
 	static Defaults* get() { if (!s_this) s_this = new Defaults; return s_this; }
 	static void setDBPath(std::string const& _dbPath) { get()->m_dbPath = _dbPath; }
 	static std::string const& dbPath() { return get()->m_dbPath; }
+	static void setFreezerDepth(unsigned _depth) { get()->m_freezerDepth = _depth; }
+	static unsigned freezerDepth() { return get()->m_freezerDepth; }
 
 private:
+	/// Default number of blocks behind the head beyond which blocks are moved to the freezer.
+	static const unsigned c_defaultFreezerDepth = 90000;
+
 	std::string m_dbPath;
+	unsigned m_freezerDepth = c_defaultFreezerDepth;
 
 	static Defaults* s_this;
 };
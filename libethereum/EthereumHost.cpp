@@ -22,6 +22,8 @@
 #include "EthereumHost.h"
 
 #include <chrono>
+#include <cmath>
+#include <random>
 #include <thread>
 #include <libdevcore/Common.h>
 #include <libp2p/Host.h>
@@ -40,6 +42,9 @@ using namespace p2p;
 
 unsigned const EthereumHost::c_oldProtocolVersion = 62; //TODO: remove this once v63+ is common
 static unsigned const c_maxSendTransactions = 256;
+static size_t const c_servedHeadersCacheSize = 4 * 1024 * 1024;	///< About 8000 headers.
+static size_t const c_servedBodiesCacheSize = 32 * 1024 * 1024;
+static size_t const c_servedReceiptsCacheSize = 16 * 1024 * 1024;
 
 char const* const EthereumHost::s_stateNames[static_cast<int>(SyncState::Size)] = {"NotSynced", "Idle", "Waiting", "Blocks", "State", "NewBlocks" };
 
@@ -51,6 +56,13 @@ const char* EthereumHostTrace::name() { return EthPurple "⧫" EthGray " "; }
 
 namespace
 {
+/// @returns a uniformly random number below @a _n, from an engine per thread seeded with system entropy.
+size_t randomIndex(size_t _n)
+{
+	static thread_local std::mt19937_64 s_eng(s_fixedHashEngine());
+	return std::uniform_int_distribution<size_t>(0, _n - 1)(s_eng);
+}
+
 class EthereumPeerObserver: public EthereumPeerObserverFace
 {
 public:
@@ -172,7 +184,8 @@ private:
 class EthereumHostData: public EthereumHostDataFace
 {
 public:
-	EthereumHostData(BlockChain const& _chain, OverlayDB const& _db): m_chain(_chain), m_db(_db) {}
+	EthereumHostData(BlockChain const& _chain, OverlayDB const& _db, ServedDataCache& _headers, ServedDataCache& _bodies, ServedDataCache& _receipts):
+		m_chain(_chain), m_db(_db), m_headers(_headers), m_bodies(_bodies), m_receipts(_receipts) {}
 
 	pair<bytes, unsigned> blockHeaders(RLP const& _blockId, unsigned _maxHeaders, u256 _skip, bool _reverse) const override
 	{
@@ -286,7 +299,10 @@ public:
 		}
 
 		for (unsigned i = 0; i < hashes.size() && rlp.size() < c_maxPayload; ++i)
-			rlp += m_chain.headerData(hashes[_reverse ? i : hashes.size() - 1 - i]);
+		{
+			h256 const& h = hashes[_reverse ? i : hashes.size() - 1 - i];
+			rlp += *m_headers.get(h, [&]() { return m_chain.headerData(h); });
+		}
 
 		return make_pair(rlp, itemCount);
 	}
@@ -303,14 +319,16 @@ public:
 			auto h = _blockHashes[i].toHash<h256>();
 			if (m_chain.isKnown(h))
 			{
-				bytes blockBytes = m_chain.block(h);
-				RLP block{blockBytes};
-				RLPStream body;
-				body.appendList(2);
-				body.appendRaw(block[1].data()); // transactions
-				body.appendRaw(block[2].data()); // uncles
-				auto bodyBytes = body.out();
-				rlp.insert(rlp.end(), bodyBytes.begin(), bodyBytes.end());
+				rlp += *m_bodies.get(h, [&]() -> bytes
+				{
+					bytes blockBytes = m_chain.block(h);
+					RLP block{blockBytes};
+					RLPStream body;
+					body.appendList(2);
+					body.appendRaw(block[1].data()); // transactions
+					body.appendRaw(block[2].data()); // uncles
+					return body.out();
+				});
 				++n;
 			}
 		}
@@ -356,9 +374,7 @@ public:
 			auto h = _blockHashes[i].toHash<h256>();
 			if (m_chain.isKnown(h))
 			{
-				auto const receipts = m_chain.receipts(h);
-				auto receiptsRlpList = receipts.rlp();
-				rlp.insert(rlp.end(), receiptsRlpList.begin(), receiptsRlpList.end());
+				rlp += *m_receipts.get(h, [&]() { return m_chain.receipts(h).rlp(); });
 				++n;
 			}
 		}
@@ -370,6 +386,9 @@ public:
 private:
 	BlockChain const& m_chain;
 	OverlayDB const& m_db;
+	ServedDataCache& m_headers;		///< Header RLP by block hash.
+	ServedDataCache& m_bodies;		///< Body (transactions and uncles) RLP by block hash.
+	ServedDataCache& m_receipts;	///< Receipts RLP by block hash.
 };
 
 }
@@ -382,7 +401,10 @@ EthereumHost::EthereumHost(BlockChain const& _ch, OverlayDB const& _db, Transact
 	m_tq		(_tq),
 	m_bq		(_bq),
 	m_networkId	(_networkId),
-	m_hostData(make_shared<EthereumHostData>(m_chain, m_db))
+	m_servedHeaders(c_servedHeadersCacheSize),
+	m_servedBodies(c_servedBodiesCacheSize),
+	m_servedReceipts(c_servedReceiptsCacheSize),
+	m_hostData(make_shared<EthereumHostData>(m_chain, m_db, m_servedHeaders, m_servedBodies, m_servedReceipts))
 {
 	// TODO: Composition would be better. Left like that to avoid initialization
 	//       issues as BlockChainSync accesses other EthereumHost members.
@@ -451,6 +473,8 @@ void EthereumHost::doWork()
 	{
 		m_lastTick = now;
 		foreachPeer([](std::shared_ptr<EthereumPeer> _p) { _p->tick(); return true; });
+		DEV_RECURSIVE_GUARDED(x_sync)
+			m_sync->tick();
 	}
 
 //	return netChange;
@@ -461,44 +485,71 @@ void EthereumHost::doWork()
 void EthereumHost::maintainTransactions()
 {
 	// Send any new transactions.
-	unordered_map<std::shared_ptr<EthereumPeer>, std::vector<size_t>> peerTransactions;
 	auto ts = m_tq.topTransactions(c_maxSendTransactions);
+	vector<shared_ptr<EthereumPeer>> peers;
+	foreachPeer([&](shared_ptr<EthereumPeer> _p) { peers.push_back(_p); return true; });
+
+	// Each transaction goes in full to about the square root of the peers that don't know it yet; they pass it on.
+	size_t const fanOut = max<size_t>(1, (size_t)ceil(sqrt((double)peers.size())));
+	vector<vector<size_t>> peerTransactions(peers.size());
+	vector<bytes const*> rlps(ts.size());
 	{
 		Guard l(x_transactions);
+		// Encode each transaction once, keeping the encodings while they stay at the top of the queue.
+		unordered_map<h256, bytes> cached;
 		for (size_t i = 0; i < ts.size(); ++i)
 		{
-			auto const& t = ts[i];
-			bool unsent = !m_transactionsSent.count(t.sha3());
-			auto peers = get<1>(randomSelection(0, [&](EthereumPeer* p) { return p->m_requireTransactions || (unsent && !p->m_knownTransactions.count(t.sha3())); }));
-			for (auto const& p: peers)
-				peerTransactions[p].push_back(i);
+			h256 h = ts[i].sha3();
+			auto it = m_transactionRLPs.find(h);
+			bytes& rlp = cached[h];
+			rlp = it != m_transactionRLPs.end() ? move(it->second) : ts[i].rlp();
+			rlps[i] = &rlp;
 		}
-		for (auto const& t: ts)
-			m_transactionsSent.insert(t.sha3());
-	}
-	foreachPeer([&](shared_ptr<EthereumPeer> _p)
-	{
-		bytes b;
-		unsigned n = 0;
-		for (auto const& i: peerTransactions[_p])
+		m_transactionRLPs = move(cached);
+
+		vector<size_t> allowed;
+		for (size_t i = 0; i < ts.size(); ++i)
 		{
-			_p->m_knownTransactions.insert(ts[i].sha3());
-			b += ts[i].rlp();
-			++n;
+			h256 h = ts[i].sha3();
+			bool unsent = m_transactionsSent.insert(h).second;
+			allowed.clear();
+			for (size_t j = 0; j < peers.size(); ++j)
+				if (peers[j]->m_requireTransactions)
+					peerTransactions[j].push_back(i);
+				else if (unsent)
+					DEV_GUARDED(peers[j]->x_knownTransactions)
+						if (!peers[j]->m_knownTransactions.contains(h))
+							allowed.push_back(j);
+			for (size_t k = 0; k < fanOut && !allowed.empty(); ++k)
+			{
+				size_t n = randomIndex(allowed.size());
+				peerTransactions[allowed[n]].push_back(i);
+				allowed[n] = allowed.back();
+				allowed.pop_back();
+			}
 		}
-
-		_p->clearKnownTransactions();
-
-		if (n || _p->m_requireTransactions)
+	}
+	// The encodings stay put until the next call, which is on this same thread.
+	for (size_t j = 0; j < peers.size(); ++j)
+	{
+		auto const& p = peers[j];
+		auto const& sending = peerTransactions[j];
+		if (!sending.empty())
+			DEV_GUARDED(p->x_knownTransactions)
+				for (size_t i: sending)
+					p->m_knownTransactions.insert(ts[i].sha3());
+
+		if (!sending.empty() || p->m_requireTransactions)
 		{
-			RLPStream ts;
-			_p->prep(ts, TransactionsPacket, n).appendRaw(b, n);
-			_p->sealAndSend(ts);
-			clog(EthereumHostTrace) << "Sent" << n << "transactions to " << _p->session()->info().clientVersion;
+			RLPStream s;
+			p->prep(s, TransactionsPacket, sending.size());
+			for (size_t i: sending)
+				s.appendRaw(*rlps[i], 1);
+			p->sealAndSend(s);
+			clog(EthereumHostTrace) << "Sent" << sending.size() << "transactions to " << p->session()->info().clientVersion;
 		}
-		_p->m_requireTransactions = false;
-		return true;
-	});
+		p->m_requireTransactions = false;
+	}
 }
 
 void EthereumHost::foreachPeer(std::function<bool(std::shared_ptr<EthereumPeer>)> const& _f) const
@@ -542,7 +593,7 @@ tuple<vector<shared_ptr<EthereumPeer>>, vector<shared_ptr<EthereumPeer>>, vector
 	chosen.reserve(chosenSize);
 	for (unsigned i = chosenSize; i && allowed.size(); i--)
 	{
-		unsigned n = rand() % allowed.size();
+		size_t n = randomIndex(allowed.size());
 		chosen.push_back(std::move(allowed[n]));
 		allowed.erase(allowed.begin() + n);
 	}
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <array>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -38,12 +39,15 @@
 #include <libethereum/BlockChainSync.h>
 #include "CommonNet.h"
 #include "EthereumPeer.h"
+#include "ServedDataCache.h"
 
 namespace dev
 {
 
 class RLPStream;
 
+namespace test { class SyncSimulation; }
+
 namespace eth
 {
 
@@ -60,6 +64,8 @@ struct EthereumHostTrace: public LogChannel { static const char* name(); static
  */
 class EthereumHost: public p2p::HostCapability<EthereumPeer>, Worker
 {
+	friend class dev::test::SyncSimulation;
+
 public:
 	/// Start server, but don't listen.
 	EthereumHost(BlockChain const& _ch, OverlayDB const& _db, TransactionQueue& _tq, BlockQueue& _bq, u256 _networkId);
@@ -87,11 +93,14 @@ public:
 	BlockQueue& bq() { return m_bq; }
 	BlockQueue const& bq() const { return m_bq; }
 	SyncStatus status() const;
+	/// @returns the counters of the caches of headers, bodies and receipts we reply with, in that order.
+	std::array<ServedDataStatus, 3> servedDataStatus() const { return {{m_servedHeaders.status(), m_servedBodies.status(), m_servedReceipts.status()}}; }
 	h256 latestBlockSent() { return m_latestBlockSent; }
 	static char const* stateName(SyncState _s) { return s_stateNames[static_cast<int>(_s)]; }
 
 	static unsigned const c_oldProtocolVersion;
-	void foreachPeer(std::function<bool(std::shared_ptr<EthereumPeer>)> const& _f) const;
+	/// Calls @a _f for each connected peer, best rated first, until it returns false. Virtual so tests can supply their own peers.
+	virtual void foreachPeer(std::function<bool(std::shared_ptr<EthereumPeer>)> const& _f) const;
 
 protected:
 	std::shared_ptr<p2p::Capability> newPeerCapability(std::shared_ptr<p2p::SessionFace> const& _s, unsigned _idOffset, p2p::CapDesc const& _cap, uint16_t _capID) override;
@@ -126,6 +135,7 @@ private:
 
 	h256 m_latestBlockSent;
 	h256Hash m_transactionsSent;
+	std::unordered_map<h256, bytes> m_transactionRLPs;	///< Encodings of the transactions last sent, by hash; reused while they stay at the top of the queue.
 
 	std::unordered_set<p2p::NodeID> m_banned;
 
@@ -137,6 +147,10 @@ private:
 	std::unique_ptr<BlockChainSync> m_sync;
 	std::atomic<time_t> m_lastTick = { 0 };
 
+	ServedDataCache m_servedHeaders;
+	ServedDataCache m_servedBodies;
+	ServedDataCache m_servedReceipts;
+
 	std::shared_ptr<EthereumHostDataFace> m_hostData;
 	std::shared_ptr<EthereumPeerObserverFace> m_peerObserver;
 };
@@ -234,6 +234,29 @@ bool EthereumPeer::isCriticalSyncing() const
 	return m_asking == Asking::BlockHeaders || m_asking == Asking::State || (m_asking == Asking::BlockBodies && m_protocolVersion == 62);
 }
 
+void EthereumPeer::serve(RLP const& _r, std::function<void(RLP const&)> const& _respond)
+{
+	// The packet is only valid while it is being interpreted.
+	auto request = make_shared<bytes>(_r.data().toBytes());
+	auto self = shared_from_this();
+	offload([self, request, _respond]()
+	{
+		RLP r(*request);
+		try
+		{
+			_respond(r);
+		}
+		catch (Exception const&)
+		{
+			clog(NetWarn) << "Peer causing an Exception:" << boost::current_exception_diagnostic_information() << r;
+		}
+		catch (std::exception const& _e)
+		{
+			clog(NetWarn) << "Peer causing an exception:" << _e.what() << r;
+		}
+	});
+}
+
 bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 {
 	assert(m_observer);
@@ -267,7 +290,6 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 	{
 		/// Packet layout:
 		/// [ block: { P , B_32 }, maxHeaders: P, skip: P, reverse: P in { 0 , 1 } ]
-		const auto blockId = _r[0];
 		const auto maxHeaders = _r[1].toInt<u256>();
 		const auto skip = _r[2].toInt<u256>();
 		const auto reverse = _r[3].toInt<bool>();
@@ -280,12 +302,13 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 			break;
 		}
 
-		pair<bytes, unsigned> const rlpAndItemCount = m_hostData->blockHeaders(blockId, numHeadersToSend, skip, reverse);
+		serve(_r, [this, numHeadersToSend, skip, reverse](RLP const& _r)
+		{
+			bytes rlp = m_hostData->blockHeaders(_r[0], numHeadersToSend, skip, reverse).first;
 
-		RLPStream s;
-		prep(s, BlockHeadersPacket, rlpAndItemCount.second).appendRaw(rlpAndItemCount.first, rlpAndItemCount.second);
-		sealAndSend(s);
-		addRating(0);
+			sealAndSend(BlockHeadersPacket, move(rlp));
+			addRating(0);
+		});
 		break;
 	}
 	case BlockHeadersPacket:
@@ -311,12 +334,13 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 			break;
 		}
 
-		pair<bytes, unsigned> const rlpAndItemCount = m_hostData->blockBodies(_r);
+		serve(_r, [this](RLP const& _r)
+		{
+			bytes rlp = m_hostData->blockBodies(_r).first;
 
-		addRating(0);
-		RLPStream s;
-		prep(s, BlockBodiesPacket, rlpAndItemCount.second).appendRaw(rlpAndItemCount.first, rlpAndItemCount.second);
-		sealAndSend(s);
+			addRating(0);
+			sealAndSend(BlockBodiesPacket, move(rlp));
+		});
 		break;
 	}
 	case BlockBodiesPacket:
@@ -365,14 +389,17 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 		}
 		clog(NetMessageSummary) << "GetNodeData (" << dec << count << " entries)";
 
-		strings const data = m_hostData->nodeData(_r);
-
-		addRating(0);
-		RLPStream s;
-		prep(s, NodeDataPacket, data.size());
-		for (auto const& element: data)
-			s.append(element);
-		sealAndSend(s);
+		serve(_r, [this](RLP const& _r)
+		{
+			strings const data = m_hostData->nodeData(_r);
+
+			addRating(0);
+			RLPStream s;
+			prep(s, NodeDataPacket, data.size());
+			for (auto const& element: data)
+				s.append(element);
+			sealAndSend(s);
+		});
 		break;
 	}
 	case GetReceiptsPacket:
@@ -386,12 +413,13 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 		}
 		clog(NetMessageSummary) << "GetReceipts (" << dec << count << " entries)";
 
-		pair<bytes, unsigned> const rlpAndItemCount = m_hostData->receipts(_r);
+		serve(_r, [this](RLP const& _r)
+		{
+			bytes rlp = m_hostData->receipts(_r).first;
 
-		addRating(0);
-		RLPStream s;
-		prep(s, ReceiptsPacket, rlpAndItemCount.second).appendRaw(rlpAndItemCount.first, rlpAndItemCount.second);
-		sealAndSend(s);
+			addRating(0);
+			sealAndSend(ReceiptsPacket, move(rlp));
+		});
 		break;
 	}
 	case NodeDataPacket:
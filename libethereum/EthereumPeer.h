@@ -28,12 +28,17 @@
 
 #include <libdevcore/RLP.h>
 #include <libdevcore/Guards.h>
+#include <libdevcore/RotatingBloom.h>
 #include <libethcore/Common.h>
 #include <libp2p/Capability.h>
 #include "CommonNet.h"
+#include "PeerSyncRate.h"
 
 namespace dev
 {
+
+namespace test { class SyncSimulation; }
+
 namespace eth
 {
 
@@ -84,6 +89,7 @@ class EthereumPeer: public p2p::Capability
 {
 	friend class EthereumHost; //TODO: remove this
 	friend class BlockChainSync; //TODO: remove this
+	friend class dev::test::SyncSimulation;
 
 public:
 	/// Basic constructor.
@@ -139,12 +145,12 @@ private:
 	/// Interpret an incoming message.
 	virtual bool interpret(unsigned _id, RLP const& _r);
 
+	/// Answers the request @a _r with @a _respond, off the network threads; answers go out in the order requested.
+	void serve(RLP const& _r, std::function<void(RLP const&)> const& _respond);
+
 	/// Request status. Called from constructor
 	void requestStatus(u256 _hostNetworkId, u256 _chainTotalDifficulty, h256 _chainCurrentHash, h256 _chainGenesisHash);
 
-	/// Clear all known transactions.
-	void clearKnownTransactions() { std::lock_guard<std::mutex> l(x_knownTransactions); m_knownTransactions.clear(); }
-
 	// Request of type _packetType with _hashes as input parameters
 	void requestByHashes(h256s const& _hashes, Asking _asking, SubprotocolPacketType _packetType);
 
@@ -188,9 +194,11 @@ private:
 	Mutex x_knownBlocks;
 	h256Hash m_knownBlocks;					///< Blocks that the peer already knows about (that don't need to be sent to them).
 	Mutex x_knownTransactions;
-	h256Hash m_knownTransactions;			///< Transactions that the peer already knows of.
+	RotatingBloom<4096> m_knownTransactions{c_knownTransactionsPerGeneration};	///< Transactions that the peer (probably) already knows of.
 	unsigned m_unknownNewBlocks = 0;		///< Number of unknown NewBlocks received from this peer
 	unsigned m_lastAskedHeaders = 0;		///< Number of hashes asked
+	PeerSyncRate m_headerRate;				///< How fast the peer answers sync requests for headers. Used by BlockChainSync under its lock.
+	PeerSyncRate m_bodyRate;				///< How fast the peer answers sync requests for bodies. Used by BlockChainSync under its lock.
 
 	std::shared_ptr<EthereumPeerObserverFace> m_observer;
 	std::shared_ptr<EthereumHostDataFace> m_hostData;
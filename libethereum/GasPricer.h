@@ -52,6 +52,8 @@ public:
 	virtual u256 bid(TransactionPriority _p = TransactionPriority::Medium) const = 0;
 
 	virtual void update(BlockChain const&) {}
+	/// Called by the client whenever the best chain changes. Only pricers that update cheaply should do so here.
+	virtual void noteChainChanged(BlockChain const&) {}
 };
 
 class TrivialGasPricer: public GasPricer
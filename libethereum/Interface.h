@@ -98,6 +98,10 @@ public:
 	/// Injects the RLP-encoded transaction given by the _rlp into the transaction queue directly.
 	virtual ImportResult injectTransaction(bytes const& _rlp, IfDropped _id = IfDropped::Ignore) = 0;
 
+	/// Queues the RLP-encoded signed transaction _rlp to be verified and imported in the background.
+	/// @returns its hash. @throws if it is malformed or too many have been queued.
+	virtual h256 queueTransaction(bytes const& _rlp) = 0;
+
 	/// Injects the RLP-encoded block given by the _rlp into the block queue directly.
 	virtual ImportResult injectBlock(bytes const& _block) = 0;
 
@@ -0,0 +1,75 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file PeerSyncRate.cpp
+ * @date 2016
+ */
+
+#include "PeerSyncRate.h"
+#include <algorithm>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+double const c_targetTime = 2;			///< Seconds a request should take at the peer's rate; well inside the 10s timeout.
+double const c_weight = 0.25;			///< Weight of the newest sample in the moving averages.
+unsigned const c_firstRequest = 32;		///< Items asked of a peer whose rate is unknown.
+unsigned const c_minRequest = 8;		///< Fewest items asked of even the slowest peer.
+double const c_straggleFactor = 3;		///< A request straggles once it has taken this many times the expected time...
+double const c_minStraggleTime = 1.5;	///< ...or this many seconds, whichever is longer.
+
+}
+
+void PeerSyncRate::requested(unsigned _items, Clock::time_point _now)
+{
+	m_asked = m_lastAsked = _items;
+	m_askedAt = _now;
+}
+
+void PeerSyncRate::replied(unsigned _items, Clock::time_point _now)
+{
+	if (!m_asked)
+		return;
+	m_asked = 0;
+	double const took = max(chrono::duration<double>(_now - m_askedAt).count(), 1e-3);
+	m_roundTrip = m_roundTrip ? m_roundTrip + c_weight * (took - m_roundTrip) : took;
+	// An empty reply says the peer lacks the items, not how fast it is.
+	if (!_items)
+		return;
+	double const rate = _items / took;
+	m_rate = m_rate ? m_rate + c_weight * (rate - m_rate) : rate;
+}
+
+unsigned PeerSyncRate::requestSize(unsigned _max) const
+{
+	unsigned const ceiling = min(_max, max(c_firstRequest, m_lastAsked * 2));
+	if (!m_rate)
+		return min(ceiling, c_firstRequest);
+	unsigned const size = (unsigned)min<double>(m_rate * c_targetTime, ceiling);
+	return max(min(c_minRequest, ceiling), size);
+}
+
+bool PeerSyncRate::isStraggling(Clock::time_point _now) const
+{
+	if (!m_asked)
+		return false;
+	// Rates are measured from request to reply, so they already allow for the round trip.
+	double const expected = m_rate ? m_asked / m_rate : c_targetTime;
+	return chrono::duration<double>(_now - m_askedAt).count() > max(c_minStraggleTime, c_straggleFactor * expected);
+}
@@ -0,0 +1,76 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file PeerSyncRate.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <chrono>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Round-trip time and delivery rate of one kind of sync request (headers or bodies) to a peer.
+ *
+ * Each reply updates moving averages of how long the peer took and how many items per second it
+ * delivered. The next request is sized to take about c_targetTime at that rate, so fast peers are
+ * asked for more and slow ones for less; a new peer starts small and its requests at most double
+ * from one to the next. A request outstanding for several times longer than expected is straggling,
+ * and its items may be asked of a faster peer as well.
+ *
+ * Thread Safety
+ * Unsafe; BlockChainSync only uses it under its lock.
+ */
+class PeerSyncRate
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// Notes a request for @a _items items sent at @a _now.
+	void requested(unsigned _items, Clock::time_point _now = Clock::now());
+
+	/// Notes the reply, with @a _items items, to the outstanding request. Ignored if there is none.
+	void replied(unsigned _items, Clock::time_point _now = Clock::now());
+
+	/// @returns the number of items to ask for next, at most @a _max.
+	unsigned requestSize(unsigned _max) const;
+
+	/// @returns true if the outstanding request has taken a lot longer than the peer's rate would suggest.
+	bool isStraggling(Clock::time_point _now = Clock::now()) const;
+
+	bool isRequesting() const { return m_asked; }
+
+	/// @returns the moving average of the items per second delivered; 0 until the first reply with items.
+	double itemsPerSecond() const { return m_rate; }
+
+	/// @returns the moving average of the time from request to reply.
+	std::chrono::milliseconds roundTrip() const { return std::chrono::milliseconds((long long)(m_roundTrip * 1000)); }
+
+private:
+	unsigned m_asked = 0;			///< Items of the outstanding request; 0 if none.
+	Clock::time_point m_askedAt;	///< When the outstanding request was sent.
+	unsigned m_lastAsked = 0;		///< Items of the last request.
+	double m_rate = 0;				///< Items per second.
+	double m_roundTrip = 0;			///< Seconds.
+};
+
+}
+}
@@ -0,0 +1,165 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RollingGasPricer.cpp
+ * @date 2016
+ */
+
+#include "RollingGasPricer.h"
+#include <cmath>
+#include <limits>
+#include "BlockChain.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// Ratio between the bounds of a bucket; mean prices of a bucket are within 1% of all its prices.
+double const c_bucketRatio = 1.02;
+
+}
+
+int GasPriceSketch::bucket(u256 const& _gasPrice)
+{
+	if (!_gasPrice)
+		return numeric_limits<int>::min();
+	return (int)floor(log(_gasPrice.convert_to<double>()) / log(c_bucketRatio));
+}
+
+void GasPriceSketch::insert(u256 const& _gasPrice, u256 const& _gasUsed)
+{
+	if (!_gasUsed)
+		return;
+	Bucket& b = m_buckets[bucket(_gasPrice)];
+	b.gas += _gasUsed;
+	b.priceGas += bigint(_gasPrice) * _gasUsed;
+	m_total += _gasUsed;
+}
+
+GasPriceSketch& GasPriceSketch::operator+=(GasPriceSketch const& _s)
+{
+	for (auto const& i: _s.m_buckets)
+	{
+		Bucket& b = m_buckets[i.first];
+		b.gas += i.second.gas;
+		b.priceGas += i.second.priceGas;
+	}
+	m_total += _s.m_total;
+	return *this;
+}
+
+GasPriceSketch& GasPriceSketch::operator-=(GasPriceSketch const& _s)
+{
+	for (auto const& i: _s.m_buckets)
+	{
+		auto it = m_buckets.find(i.first);
+		assert(it != m_buckets.end() && it->second.gas >= i.second.gas);
+		it->second.gas -= i.second.gas;
+		it->second.priceGas -= i.second.priceGas;
+		if (!it->second.gas)
+			m_buckets.erase(it);
+	}
+	m_total -= _s.m_total;
+	return *this;
+}
+
+u256 GasPriceSketch::quantile(double _q) const
+{
+	if (m_buckets.empty())
+		return 0;
+	u256 target = u256(m_total.convert_to<long double>() * max(0.0, min(1.0, _q)));
+	u256 seen = 0;
+	for (auto const& i: m_buckets)
+	{
+		seen += i.second.gas;
+		if (seen >= target)
+			return u256(i.second.priceGas / i.second.gas);
+	}
+	auto const& last = m_buckets.rbegin()->second;
+	return u256(last.priceGas / last.gas);
+}
+
+u256 RollingGasPricer::bid(TransactionPriority _p) const
+{
+	uint64_t octile = m_octiles[(int)_p];
+	return octile ? u256(octile) : TrivialGasPricer::bid(_p);
+}
+
+GasPriceSketch RollingGasPricer::sketchBlock(BlockChain const& _bc, h256 const& _hash)
+{
+	GasPriceSketch ret;
+	if (_bc.info(_hash).transactionsRoot() == EmptyTrie)
+		return ret;
+	bytes block = _bc.block(_hash);
+	BlockReceipts brs = _bc.receipts(_hash);
+	// Receipts carry the gas used by the block up to and including their transaction.
+	u256 before = 0;
+	size_t i = 0;
+	for (auto const& tr: RLP(block)[1])
+	{
+		if (i >= brs.receipts.size())
+			break;
+		u256 const& cumulative = brs.receipts[i++].gasUsed();
+		ret.insert(Transaction(tr.data(), CheckTransaction::None).gasPrice(), cumulative > before ? cumulative - before : 0);
+		before = cumulative;
+	}
+	return ret;
+}
+
+void RollingGasPricer::update(BlockChain const& _bc)
+{
+	Guard l(x_window);
+
+	// Find the newest block of the window still on the chain, collecting those imported since.
+	auto inWindow = [&](h256 const& _h)
+	{
+		for (auto it = m_window.rbegin(); it != m_window.rend(); ++it)
+			if (it->first == _h)
+				return true;
+		return false;
+	};
+	h256s fresh;
+	h256 h = _bc.currentHash();
+	for (; h && fresh.size() < m_blocks && !inWindow(h); h = _bc.info(h).parentHash())
+		fresh.push_back(h);
+
+	// Take out the blocks that are no longer on the chain; all of them if none is.
+	bool changed = !fresh.empty();
+	while (!m_window.empty() && m_window.back().first != h)
+	{
+		m_sum -= m_window.back().second;
+		m_window.pop_back();
+		changed = true;
+	}
+	if (!changed)
+		return;
+
+	for (auto it = fresh.rbegin(); it != fresh.rend(); ++it)
+	{
+		m_window.emplace_back(*it, sketchBlock(_bc, *it));
+		m_sum += m_window.back().second;
+	}
+	while (m_window.size() > m_blocks)
+	{
+		m_sum -= m_window.front().second;
+		m_window.pop_front();
+	}
+
+	for (unsigned i = 0; i < m_octiles.size(); ++i)
+		m_octiles[i] = (uint64_t)min<u256>(m_sum.quantile(i / 8.0), numeric_limits<uint64_t>::max());
+}
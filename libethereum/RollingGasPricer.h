@@ -0,0 +1,102 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RollingGasPricer.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <libdevcore/Guards.h>
+#include "GasPricer.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * Distribution of gas used over gas price, with prices bucketed to within 1% of each other.
+ *
+ * Sketches can be added to and subtracted from each other exactly, so a window over several
+ * blocks is kept by adding each new block's sketch and subtracting the one that falls out.
+ */
+class GasPriceSketch
+{
+public:
+	/// Counts @a _gasUsed gas paid for at @a _gasPrice.
+	void insert(u256 const& _gasPrice, u256 const& _gasUsed);
+
+	GasPriceSketch& operator+=(GasPriceSketch const& _s);
+	GasPriceSketch& operator-=(GasPriceSketch const& _s);
+
+	bool empty() const { return m_buckets.empty(); }
+	u256 totalGas() const { return m_total; }
+
+	/// @returns the gas price at fraction @a _q (in [0, 1]) of all the gas counted, weighted by gas used.
+	/// It is the mean price of the bucket it falls in, so within 1% of the exact quantile.
+	u256 quantile(double _q) const;
+
+private:
+	struct Bucket
+	{
+		u256 gas;
+		bigint priceGas;	///< Sum of price * gas, for the bucket's mean price.
+	};
+
+	static int bucket(u256 const& _gasPrice);
+
+	std::map<int, Bucket> m_buckets;
+	u256 m_total;
+};
+
+/**
+ * Bids the gas prices paid in the last few blocks of the chain, by priority.
+ *
+ * update() adds the blocks imported since the last call (and takes out those of a reorganised-away
+ * branch) to a rolling window, so it costs O(transactions in the new blocks). The bid for each
+ * priority is then published for ask()/bid() to read without locking. Until any gas has been
+ * paid in the window, or if the price would be 0, bids fall back to the fixed bid.
+ */
+class RollingGasPricer: public TrivialGasPricer
+{
+public:
+	/// @param _blocks number of most recent blocks whose gas prices are sampled.
+	RollingGasPricer(u256 const& _ask, u256 const& _bid, unsigned _blocks = 100): TrivialGasPricer(_ask, _bid), m_blocks(std::max(_blocks, 1u)) {}
+
+	u256 bid(TransactionPriority _p = TransactionPriority::Medium) const override;
+
+	void update(BlockChain const& _bc) override;
+	void noteChainChanged(BlockChain const& _bc) override { update(_bc); }
+
+private:
+	static GasPriceSketch sketchBlock(BlockChain const& _bc, h256 const& _hash);
+
+	unsigned const m_blocks;
+
+	Mutex x_window;
+	std::deque<std::pair<h256, GasPriceSketch>> m_window;	///< Oldest first.
+	GasPriceSketch m_sum;									///< Of all of m_window.
+
+	std::array<std::atomic<uint64_t>, 9> m_octiles = {{}};	///< By TransactionPriority; 0 if unknown.
+};
+
+}
+}
@@ -0,0 +1,72 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ServedDataCache.cpp
+ * @date 2016
+ */
+
+#include "ServedDataCache.h"
+#include <ostream>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+shared_ptr<bytes const> ServedDataCache::get(h256 const& _h, function<bytes()> const& _make)
+{
+	{
+		Guard l(x_cache);
+		auto it = m_entries.find(_h);
+		if (it != m_entries.end())
+		{
+			m_uses.splice(m_uses.begin(), m_uses, it->second.use);
+			++m_hits;
+			m_servedBytes += it->second.data->size();
+			return it->second.data;
+		}
+	}
+
+	auto ret = make_shared<bytes const>(_make());
+	Guard l(x_cache);
+	++m_misses;
+	m_servedBytes += ret->size();
+	if (ret->empty() || ret->size() > m_maxBytes || m_entries.count(_h))
+		return ret;
+	m_uses.push_front(_h);
+	m_entries[_h] = Entry{ret, m_uses.begin()};
+	m_bytes += ret->size();
+	while (m_bytes > m_maxBytes)
+	{
+		auto last = m_entries.find(m_uses.back());
+		m_bytes -= last->second.data->size();
+		m_entries.erase(last);
+		m_uses.pop_back();
+	}
+	return ret;
+}
+
+ServedDataStatus ServedDataCache::status() const
+{
+	Guard l(x_cache);
+	return ServedDataStatus{m_hits, m_misses, m_servedBytes, m_bytes, m_entries.size()};
+}
+
+ostream& dev::eth::operator<<(ostream& _out, ServedDataStatus const& _s)
+{
+	_out << _s.cachedItems << " cached (" << _s.cachedBytes << " bytes); ";
+	_out << _s.hits << " hits, " << _s.misses << " misses (" << int(_s.hitRate() * 100) << "%); ";
+	_out << _s.servedBytes << " bytes served";
+	return _out;
+}
@@ -0,0 +1,88 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ServedDataCache.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/// Counters of a ServedDataCache.
+struct ServedDataStatus
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t servedBytes;	///< Bytes of all fragments handed out, cached or not.
+	size_t cachedBytes;
+	size_t cachedItems;
+
+	double hitRate() const { return hits + misses ? double(hits) / (hits + misses) : 0; }
+};
+
+std::ostream& operator<<(std::ostream& _out, ServedDataStatus const& _s);
+
+/**
+ * @brief The RLP we reply with for each block (its header, body or receipts), shared by all peers.
+ *
+ * Peers syncing from us ask for the same recent blocks within seconds of each other. Fragments are
+ * kept by block hash, so they never go stale; the least recently used are dropped once the cache
+ * holds more than its byte budget.
+ *
+ * Thread Safety
+ * All methods are thread-safe.
+ */
+class ServedDataCache
+{
+public:
+	explicit ServedDataCache(size_t _maxBytes): m_maxBytes(_maxBytes) {}
+
+	/// @returns the fragment of block @a _h, calling @a _make for it, without the lock held, if it's not cached.
+	/// An empty fragment isn't cached.
+	std::shared_ptr<bytes const> get(h256 const& _h, std::function<bytes()> const& _make);
+
+	ServedDataStatus status() const;
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<bytes const> data;
+		std::list<h256>::iterator use;
+	};
+
+	size_t const m_maxBytes;
+	mutable Mutex x_cache;
+	std::unordered_map<h256, Entry> m_entries;
+	std::list<h256> m_uses;			///< Hashes of the entries, most recently used first.
+	size_t m_bytes = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+	uint64_t m_servedBytes = 0;
+};
+
+}
+}
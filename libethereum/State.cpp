@@ -410,23 +410,29 @@ void State::clearStorage(Address const& _contract)
 }
 
 map<h256, pair<u256, u256>> State::storage(Address const& _id) const
+{
+	return storage(_id, h256(), numeric_limits<unsigned>::max());
+}
+
+map<h256, pair<u256, u256>> State::storage(Address const& _id, h256 const& _begin, unsigned _max) const
 {
 	map<h256, pair<u256, u256>> ret;
 
 	if (Account const* a = account(_id))
 	{
-		// Pull out all values from trie storage.
+		// Pull values from trie storage. Cached entries may remove as many as there are of them,
+		// so read that many more than asked for.
 		if (h256 root = a->baseRoot())
 		{
-			SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), root);		// promise we won't alter the overlay! :)
-
-			for (auto it = memdb.hashedBegin(); it != memdb.hashedEnd(); ++it)
+			GenericTrieDB<OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), root);		// promise we won't alter the overlay! :)
+			unsigned limit = _max + min<size_t>(a->storageOverlay().size(), numeric_limits<unsigned>::max() - _max);
+			memdb.scan(_begin.ref(), limit, [&](bytesConstRef _hashedKey, bytesConstRef _value)
 			{
-				h256 const hashedKey((*it).first);
-				u256 const key = h256(it.key());
-				u256 const value = RLP((*it).second).toInt<u256>();
-				ret[hashedKey] = make_pair(key, value);
-			}
+				h256 const hashedKey(_hashedKey);
+				u256 const key = h256(m_db.lookupAux(hashedKey));
+				ret[hashedKey] = make_pair(key, RLP(_value).toInt<u256>());
+				return true;
+			});
 		}
 
 		// Then merge cached storage over the top.
@@ -434,11 +440,16 @@ map<h256, pair<u256, u256>> State::storage(Address const& _id) const
 		{
 			h256 const key = i.first;
 			h256 const hashedKey = sha3(key);
+			if (hashedKey < _begin)
+				continue;
 			if (i.second)
 				ret[hashedKey] = i;
 			else
 				ret.erase(hashedKey);
 		}
+
+		while (ret.size() > _max)
+			ret.erase(prev(ret.end()));
 	}
 	return ret;
 }
@@ -25,7 +25,7 @@
 #include <unordered_map>
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
-#include <libdevcore/TrieDB.h>
+#include <libdevcore/ArenaTrieDB.h>
 #include <libdevcore/OverlayDB.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/BlockHeader.h>
@@ -87,9 +87,9 @@ enum class Permanence
 };
 
 #if ETH_FATDB
-template <class KeyType, class DB> using SecureTrieDB = SpecificTrieDB<FatGenericTrieDB<DB>, KeyType>;
+template <class KeyType, class DB> using SecureTrieDB = SpecificTrieDB<FatGenericTrieDB<DB, ArenaTrieDB>, KeyType>;
 #else
-template <class KeyType, class DB> using SecureTrieDB = SpecificTrieDB<HashedGenericTrieDB<DB>, KeyType>;
+template <class KeyType, class DB> using SecureTrieDB = SpecificTrieDB<HashedGenericTrieDB<DB, ArenaTrieDB>, KeyType>;
 #endif
 
 DEV_SIMPLE_EXCEPTION(InvalidAccountStartNonceInState);
@@ -283,6 +283,10 @@ public:
 	/// @returns map of hashed keys to key-value pairs or empty map if no account exists at that address.
 	std::map<h256, std::pair<u256, u256>> storage(Address const& _contract) const;
 
+	/// Get part of the storage of an account: the @a _max entries with the lowest hashed keys not less than @a _begin.
+	/// @returns map of hashed keys to key-value pairs or empty map if no account exists at that address.
+	std::map<h256, std::pair<u256, u256>> storage(Address const& _contract, h256 const& _begin, unsigned _max) const;
+
 	/// Get the code of an account.
 	/// @returns bytes() if no account exists at that address.
 	/// @warning The reference to the code is only valid until the access to
@@ -411,6 +415,8 @@ AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state)
 			}
 			ret.insert(i.first);
 		}
+	// Write the changed trie nodes out now; copies of the state only take the root and the DB.
+	_state.commit();
 	return ret;
 }
 
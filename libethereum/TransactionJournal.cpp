@@ -0,0 +1,220 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TransactionJournal.cpp
+ * @date 2016
+ */
+
+#include "TransactionJournal.h"
+
+#include <libdevcore/CommonIO.h>
+#include <libdevcore/Exceptions.h>
+#include <libdevcore/SHA3.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <thread>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+namespace fs = boost::filesystem;
+
+namespace
+{
+
+/// Start of every journal file; a file without it is ignored.
+string const c_journalMagic = "ethtxj01";
+
+enum JournalRecord: byte
+{
+	AddedRecord = 1,	///< Sender, then the transaction's RLP.
+	RemovedRecord = 2,	///< Transaction hash.
+	DroppedRecord = 3	///< Transaction hash.
+};
+
+/// Size of the type and length that precede a record's payload.
+size_t const c_recordHeaderSize = 5;
+/// Size of the checksum that follows a record's payload.
+size_t const c_checksumSize = 8;
+
+h64 checksum(bytesConstRef _headerAndPayload)
+{
+	return h64(sha3(_headerAndPayload), h64::AlignLeft);
+}
+
+}
+
+TransactionJournal::TransactionJournal(string const& _path):
+	m_path(_path)
+{
+	fs::path p(m_path);
+	if (p.has_parent_path())
+		fs::create_directories(p.parent_path());
+	bool fresh = !fs::exists(p) || fs::file_size(p) == 0;
+	m_out.open(m_path, ios::binary | ios::app);
+	if (!m_out)
+		BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Cannot open transaction journal " + m_path));
+	if (fresh)
+		m_out.write(c_journalMagic.data(), c_journalMagic.size());
+}
+
+TransactionJournal::~TransactionJournal()
+{
+	flush();
+}
+
+TransactionJournal::Contents TransactionJournal::load(string const& _path, unsigned _threads)
+{
+	Contents ret;
+	bytes data = contents(_path);
+	if (data.size() < c_journalMagic.size() || !equal(c_journalMagic.begin(), c_journalMagic.end(), data.begin()))
+		return ret;
+
+	// Find the record boundaries; checksums are left for the parallel pass.
+	vector<bytesConstRef> records;
+	for (bytesConstRef in = bytesConstRef(&data).cropped(c_journalMagic.size()); in.size() >= c_recordHeaderSize;)
+	{
+		size_t size = c_recordHeaderSize + fromBigEndian<uint32_t>(in.cropped(1, 4)) + c_checksumSize;
+		if (size > in.size())
+			break;
+		records.push_back(in.cropped(0, size));
+		in = in.cropped(size);
+	}
+
+	// Check and decode every record; the senders are trusted once the checksum matches.
+	vector<Transaction> decoded(records.size());
+	vector<char> good(records.size(), 0);
+	auto decode = [&](size_t _i)
+	{
+		bytesConstRef r = records[_i];
+		bytesConstRef body = r.cropped(0, r.size() - c_checksumSize);
+		if (checksum(body) != h64(r.cropped(body.size())))
+			return;
+		bytesConstRef payload = body.cropped(c_recordHeaderSize);
+		if (r[0] == AddedRecord)
+		{
+			if (payload.size() <= Address::size)
+				return;
+			try
+			{
+				decoded[_i] = Transaction(payload.cropped(Address::size), CheckTransaction::None);
+				decoded[_i].forceSender(Address(payload.cropped(0, Address::size)));
+				decoded[_i].sha3();
+			}
+			catch (...)
+			{
+				return;
+			}
+		}
+		else if ((r[0] != RemovedRecord && r[0] != DroppedRecord) || payload.size() != h256::size)
+			return;
+		good[_i] = 1;
+	};
+	vector<thread> threads;
+	for (unsigned t = 0; t < max(_threads, 1U); ++t)
+		threads.emplace_back([&, t]() { for (size_t i = t; i < records.size(); i += max(_threads, 1U)) decode(i); });
+	for (auto& t: threads)
+		t.join();
+
+	// Replay the log up to the first damaged record.
+	unordered_map<h256, size_t> live;
+	for (size_t i = 0; i < records.size() && good[i]; ++i)
+		if (records[i][0] == AddedRecord)
+			live[decoded[i].sha3()] = i;
+		else
+		{
+			h256 h(records[i].cropped(c_recordHeaderSize, h256::size));
+			live.erase(h);
+			if (records[i][0] == DroppedRecord)
+				ret.dropped.insert(h);
+		}
+
+	vector<size_t> order;
+	order.reserve(live.size());
+	for (auto const& i: live)
+		order.push_back(i.second);
+	sort(order.begin(), order.end());
+	ret.transactions.reserve(order.size());
+	for (size_t i: order)
+		ret.transactions.push_back(move(decoded[i]));
+	return ret;
+}
+
+void TransactionJournal::append(ostream& _out, byte _type, bytesConstRef _payload)
+{
+	bytes record(c_recordHeaderSize);
+	record[0] = _type;
+	bytesRef length(record.data() + 1, 4);
+	toBigEndian<uint32_t>(_payload.size(), length);
+	record += _payload.toBytes();
+	h64 sum = checksum(&record);
+	record += sum.asBytes();
+	_out.write((char const*)record.data(), record.size());
+}
+
+void TransactionJournal::added(Transaction const& _t)
+{
+	bytes payload = _t.sender().asBytes() + _t.rlp();
+	Guard l(x_out);
+	append(m_out, AddedRecord, &payload);
+	++m_records;
+	m_out.flush();
+}
+
+void TransactionJournal::removed(h256 const& _h)
+{
+	Guard l(x_out);
+	append(m_out, RemovedRecord, _h.ref());
+	++m_records;
+	m_out.flush();
+}
+
+void TransactionJournal::dropped(h256 const& _h)
+{
+	Guard l(x_out);
+	append(m_out, DroppedRecord, _h.ref());
+	++m_records;
+	m_out.flush();
+}
+
+void TransactionJournal::rewrite(Transactions const& _ts, h256Hash const& _dropped)
+{
+	Guard l(x_out);
+	string tmp = m_path + ".new";
+	{
+		ofstream out(tmp, ios::binary | ios::trunc);
+		out.write(c_journalMagic.data(), c_journalMagic.size());
+		for (auto const& t: _ts)
+		{
+			bytes payload = t.sender().asBytes() + t.rlp();
+			append(out, AddedRecord, &payload);
+		}
+		for (auto const& h: _dropped)
+			append(out, DroppedRecord, h.ref());
+		out.flush();
+		if (!out)
+			BOOST_THROW_EXCEPTION(FileError() << errinfo_comment("Cannot write transaction journal " + tmp));
+	}
+	m_out.close();
+	fs::rename(tmp, m_path);
+	m_out.open(m_path, ios::binary | ios::app);
+	m_records = 0;
+}
+
+void TransactionJournal::flush()
+{
+	Guard l(x_out);
+	m_out.flush();
+}
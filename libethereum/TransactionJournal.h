@@ -0,0 +1,96 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TransactionJournal.h
+ * @date 2016
+ *
+ * On-disk journal of the transaction queue, so pending transactions survive a restart.
+ */
+
+#pragma once
+
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include "Transaction.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Append-only log of the changes made to a TransactionQueue.
+ *
+ * Each record is a type byte, a 4-byte big-endian payload length, the payload and an 8-byte
+ * checksum (the start of the sha3 of everything before it). Added transactions are stored as their
+ * raw RLP together with the sender recovered on import, so they can be reloaded without EC recovery;
+ * removed and dropped ones are stored as their hash. Each record is handed to the OS as it is logged,
+ * so only a crash of the machine can lose the tail; a record that is cut short or fails its checksum
+ * ends the log.
+ *
+ * @threadsafe
+ */
+class TransactionJournal
+{
+public:
+	/// Live contents of a journal.
+	struct Contents
+	{
+		Transactions transactions;	///< In the order they were added, each with its sender already set.
+		h256Hash dropped;			///< Transactions dropped from the queue, which should not be re-imported.
+	};
+
+	/// Opens (creating if needed) the journal at @a _path for appending.
+	explicit TransactionJournal(std::string const& _path);
+	~TransactionJournal();
+
+	TransactionJournal(TransactionJournal const&) = delete;
+	TransactionJournal& operator=(TransactionJournal const&) = delete;
+
+	/// Reads back the journal at @a _path, verifying and decoding records on @a _threads threads.
+	static Contents load(std::string const& _path, unsigned _threads);
+
+	/// Logs that @a _t, whose sender is known, was added to the queue.
+	void added(Transaction const& _t);
+	/// Logs that @a _h left the queue.
+	void removed(h256 const& _h);
+	/// Logs that @a _h was dropped and should not come back.
+	void dropped(h256 const& _h);
+
+	/// Replaces the journal with a snapshot of just @a _ts and @a _dropped.
+	void rewrite(Transactions const& _ts, h256Hash const& _dropped);
+
+	/// @returns the number of records appended since the journal was last rewritten.
+	uint64_t records() const { return m_records; }
+
+	/// Writes out anything buffered.
+	void flush();
+
+private:
+	void append(std::ostream& _out, byte _type, bytesConstRef _payload);
+
+	std::string m_path;
+	std::ofstream m_out;
+	std::atomic<uint64_t> m_records = {0};
+	mutable Mutex x_out;
+};
+
+}
+}
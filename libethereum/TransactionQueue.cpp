@@ -23,7 +23,9 @@
 
 #include <libdevcore/Log.h>
 #include <libethcore/Exceptions.h>
+#include "State.h"
 #include "Transaction.h"
+#include "TransactionJournal.h"
 using namespace std;
 using namespace dev;
 using namespace dev::eth;
@@ -32,17 +34,31 @@ const char* TransactionQueueChannel::name() { return EthCyan "┉┅▶"; }
 const char* TransactionQueueTraceChannel::name() { return EthCyan " ┅▶"; }
 
 const size_t c_maxVerificationQueueSize = 8192;
+const size_t c_maxVerifierBatch = 64;
+/// Default rate and burst at which a single source may queue transactions for verification.
+const unsigned c_defaultSubmissionRate = 1000;
+const unsigned c_defaultSubmissionBurst = 4096;
+/// Default transactions per second, and burst, accepted from the local node (RPC and the like).
+const unsigned c_defaultLocalSubmissionRate = 10000;
+const unsigned c_defaultLocalSubmissionBurst = 40960;
+/// Number of sources with an allowance beyond which those with a full one are forgotten.
+const size_t c_maxAllowances = 1024;
+/// Journal records that may pile up beyond twice the queue's size before the journal is compacted.
+const uint64_t c_minJournalRecords = 100000;
 
 TransactionQueue::TransactionQueue(unsigned _limit, unsigned _futureLimit):
-	m_current(PriorityCompare { *this }),
 	m_limit(_limit),
-	m_futureLimit(_futureLimit)
+	m_futureLimit(_futureLimit),
+	m_submissionRate(c_defaultSubmissionRate),
+	m_submissionBurst(c_defaultSubmissionBurst),
+	m_localSubmissionRate(c_defaultLocalSubmissionRate),
+	m_localSubmissionBurst(c_defaultLocalSubmissionBurst)
 {
 	unsigned verifierThreads = std::max(thread::hardware_concurrency(), 3U) - 2U;
 	for (unsigned i = 0; i < verifierThreads; ++i)
 		m_verifiers.emplace_back([=](){
 			setThreadName("txcheck" + toString(i));
-			this->verifierBody();
+			this->verifierBody(verifierThreads);
 		});
 }
 
@@ -68,65 +84,130 @@ ImportResult TransactionQueue::import(bytesConstRef _transactionRLP, IfDropped _
 	}
 }
 
-ImportResult TransactionQueue::check_WITH_LOCK(h256 const& _h, IfDropped _ik)
+ImportResult TransactionQueue::check(h256 const& _h, IfDropped _ik)
 {
-	if (m_known.count(_h))
+	KnownShard& k = knownShard(_h);
+	ReadGuard l(k.lock);
+	if (k.known.count(_h))
 		return ImportResult::AlreadyKnown;
 
-	if (m_dropped.count(_h) && _ik == IfDropped::Ignore)
+	if (k.dropped.count(_h) && _ik == IfDropped::Ignore)
 		return ImportResult::AlreadyInChain;
 
 	return ImportResult::Success;
 }
 
+void TransactionQueue::setKnown(h256 const& _h, unsigned _shard)
+{
+	KnownShard& k = knownShard(_h);
+	WriteGuard l(k.lock);
+	k.known[_h] = _shard;
+}
+
+void TransactionQueue::forget(h256 const& _h)
+{
+	KnownShard& k = knownShard(_h);
+	DEV_WRITE_GUARDED(k.lock)
+		k.known.erase(_h);
+	if (m_journal)
+		m_journal->removed(_h);
+}
+
 ImportResult TransactionQueue::import(Transaction const& _transaction, IfDropped _ik)
 {
 	if (_transaction.hasZeroSignature())
 		return ImportResult::ZeroSignature;
 	// Check if we already know this transaction.
 	h256 h = _transaction.sha3(WithSignature);
+	ImportResult ret = check(h, _ik);
+	if (ret != ImportResult::Success)
+		return ret;
 
-	ImportResult ret;
+	// Perform EC recovery before taking any lock.
+	Address from;
+	try
+	{
+		from = _transaction.sender();
+	}
+	catch (Exception const&)
 	{
-		UpgradableGuard l(m_lock);
-		auto ir = check_WITH_LOCK(h, _ik);
-		if (ir != ImportResult::Success)
-			return ir;
+		return ImportResult::Malformed;
+	}
 
-		{
-			_transaction.safeSender(); // Perform EC recovery outside of the write lock
-			UpgradeGuard ul(l);
-			ret = manageImport_WITH_LOCK(h, _transaction);
-		}
+	{
+		Shard& s = shard(from);
+		WriteGuard l(s.lock);
+		// The same transaction has the same sender, so any concurrent import of it has finished by now.
+		ret = check(h, _ik);
+		if (ret == ImportResult::Success)
+			ret = manageImport_WITH_LOCK(s, h, _transaction);
 	}
+	enforceLimits(shardIndex(from));
 	return ret;
 }
 
 Transactions TransactionQueue::topTransactions(unsigned _limit, h256Hash const& _avoid) const
 {
-	ReadGuard l(m_lock);
+	// Writers only ever hold one shard lock, so taking them all in order cannot deadlock.
+	vector<ReadGuard> guards;
+	guards.reserve(c_shards);
+	array<PriorityQueue::const_iterator, c_shards> heads;
+	for (unsigned i = 0; i < c_shards; ++i)
+	{
+		guards.emplace_back(m_shards[i].lock);
+		heads[i] = m_shards[i].current.begin();
+	}
+
+	// Merge the shards' queues, taking the best head each time.
 	Transactions ret;
-	for (auto t = m_current.begin(); ret.size() < _limit && t != m_current.end(); ++t)
-		if (!_avoid.count(t->transaction.sha3()))
-			ret.push_back(t->transaction);
+	while (ret.size() < _limit)
+	{
+		unsigned best = c_shards;
+		for (unsigned i = 0; i < c_shards; ++i)
+			if (heads[i] != m_shards[i].current.end() && (best == c_shards || heads[i]->priority < heads[best]->priority))
+				best = i;
+		if (best == c_shards)
+			break;
+		if (!_avoid.count(heads[best]->transaction.sha3()))
+			ret.push_back(heads[best]->transaction);
+		++heads[best];
+	}
 	return ret;
 }
 
 h256Hash TransactionQueue::knownTransactions() const
 {
-	ReadGuard l(m_lock);
-	return m_known;
+	h256Hash ret;
+	for (auto const& k: m_knownShards)
+		DEV_READ_GUARDED(k.lock)
+			for (auto const& i: k.known)
+				ret.insert(i.first);
+	return ret;
+}
+
+TransactionQueue::Status TransactionQueue::status() const
+{
+	Status ret;
+	DEV_GUARDED(x_queue)
+		ret.unverified = m_unverified.size();
+	ret.dropped = 0;
+	for (auto const& k: m_knownShards)
+		DEV_READ_GUARDED(k.lock)
+			ret.dropped += k.dropped.size();
+	ret.current = m_currentSize;
+	ret.future = m_futureSize;
+	return ret;
 }
 
-ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transaction const& _transaction)
+ImportResult TransactionQueue::manageImport_WITH_LOCK(Shard& _s, h256 const& _h, Transaction const& _transaction)
 {
 	try
 	{
 		assert(_h == _transaction.sha3());
 		// Remove any prior transaction with the same nonce but a lower gas price.
 		// Bomb out if there's a prior transaction with higher gas price.
-		auto cs = m_currentByAddressAndNonce.find(_transaction.from());
-		if (cs != m_currentByAddressAndNonce.end())
+		auto cs = _s.currentByAddressAndNonce.find(_transaction.from());
+		if (cs != _s.currentByAddressAndNonce.end())
 		{
 			auto t = cs->second.find(_transaction.nonce());
 			if (t != cs->second.end())
@@ -136,13 +217,13 @@ ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transactio
 				else
 				{
 					h256 dropped = (*t->second).transaction.sha3();
-					remove_WITH_LOCK(dropped);
+					remove_WITH_LOCK(_s, dropped);
 					m_onReplaced(dropped);
 				}
 			}
 		}
-		auto fs = m_future.find(_transaction.from());
-		if (fs != m_future.end())
+		auto fs = _s.future.find(_transaction.from());
+		if (fs != _s.future.end())
 		{
 			auto t = fs->second.find(_transaction.nonce());
 			if (t != fs->second.end())
@@ -151,23 +232,18 @@ ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transactio
 					return ImportResult::OverbidGasPrice;
 				else
 				{
+					forget(t->second.transaction.sha3());
 					fs->second.erase(t);
 					--m_futureSize;
 					if (fs->second.empty())
-						m_future.erase(fs);
+						_s.future.erase(fs);
 				}
 			}
 		}
 		// If valid, append to transactions.
-		insertCurrent_WITH_LOCK(make_pair(_h, _transaction));
+		insertCurrent_WITH_LOCK(_s, _h, _transaction);
 		clog(TransactionQueueTraceChannel) << "Queued vaguely legit-looking transaction" << _h;
 
-		while (m_current.size() > m_limit)
-		{
-			clog(TransactionQueueTraceChannel) << "Dropping out of bounds transaction" << _h;
-			remove_WITH_LOCK(m_current.rbegin()->transaction.sha3());
-		}
-
 		m_onReady();
 	}
 	catch (Exception const& _e)
@@ -186,172 +262,410 @@ ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transactio
 
 u256 TransactionQueue::maxNonce(Address const& _a) const
 {
-	ReadGuard l(m_lock);
-	return maxNonce_WITH_LOCK(_a);
+	Shard const& s = shard(_a);
+	ReadGuard l(s.lock);
+	return maxNonce_WITH_LOCK(s, _a);
 }
 
-u256 TransactionQueue::maxNonce_WITH_LOCK(Address const& _a) const
+u256 TransactionQueue::maxNonce_WITH_LOCK(Shard const& _s, Address const& _a) const
 {
 	u256 ret = 0;
-	auto cs = m_currentByAddressAndNonce.find(_a);
-	if (cs != m_currentByAddressAndNonce.end() && !cs->second.empty())
+	auto cs = _s.currentByAddressAndNonce.find(_a);
+	if (cs != _s.currentByAddressAndNonce.end() && !cs->second.empty())
 		ret = cs->second.rbegin()->first + 1;
-	auto fs = m_future.find(_a);
-	if (fs != m_future.end() && !fs->second.empty())
+	auto fs = _s.future.find(_a);
+	if (fs != _s.future.end() && !fs->second.empty())
 		ret = std::max(ret, fs->second.rbegin()->first + 1);
 	return ret;
 }
 
-void TransactionQueue::insertCurrent_WITH_LOCK(std::pair<h256, Transaction> const& _p)
+void TransactionQueue::insertCurrent_WITH_LOCK(Shard& _s, h256 const& _h, Transaction const& _t)
 {
-	if (m_currentByHash.count(_p.first))
+	if (_s.currentByHash.count(_h))
 	{
-		cwarn << "Transaction hash" << _p.first << "already in current?!";
+		cwarn << "Transaction hash" << _h << "already in current?!";
 		return;
 	}
 
-	Transaction const& t = _p.second;
 	// Insert into current
-	auto inserted = m_currentByAddressAndNonce[t.from()].insert(std::make_pair(t.nonce(), PriorityQueue::iterator()));
-	PriorityQueue::iterator handle = m_current.emplace(VerifiedTransaction(t));
+	auto& queue = _s.currentByAddressAndNonce[_t.from()];
+	bool newLowest = !queue.empty() && _t.nonce() < queue.begin()->first;
+	auto inserted = queue.insert(std::make_pair(_t.nonce(), PriorityQueue::iterator()));
+	PriorityKey key{_t.nonce() - queue.begin()->first, _t.gasPrice(), m_sequence++};
+	PriorityQueue::iterator handle = _s.current.emplace(VerifiedTransaction(_t, key)).first;
 	inserted.first->second = handle;
-	m_currentByHash[_p.first] = handle;
+	_s.currentByHash[_h] = handle;
+	++m_currentSize;
+	if (newLowest)
+		rekey_WITH_LOCK(_s, _t.from());
 
 	// Move following transactions from future to current
-	makeCurrent_WITH_LOCK(t);
-	m_known.insert(_p.first);
+	makeCurrent_WITH_LOCK(_s, _t);
+	setKnown(_h, shardIndex(_t.from()));
+	if (m_journal)
+		m_journal->added(_t);
 }
 
-bool TransactionQueue::remove_WITH_LOCK(h256 const& _txHash)
+bool TransactionQueue::remove_WITH_LOCK(Shard& _s, h256 const& _txHash)
 {
-	auto t = m_currentByHash.find(_txHash);
-	if (t == m_currentByHash.end())
+	auto t = _s.currentByHash.find(_txHash);
+	if (t == _s.currentByHash.end())
 		return false;
 
 	Address from = (*t->second).transaction.from();
-	auto it = m_currentByAddressAndNonce.find(from);
-	assert (it != m_currentByAddressAndNonce.end());
-	it->second.erase((*t->second).transaction.nonce());
-	m_current.erase(t->second);
-	m_currentByHash.erase(t);
+	u256 nonce = (*t->second).transaction.nonce();
+	auto it = _s.currentByAddressAndNonce.find(from);
+	assert (it != _s.currentByAddressAndNonce.end());
+	bool wasLowest = it->second.begin()->first == nonce;
+	it->second.erase(nonce);
+	_s.current.erase(t->second);
+	_s.currentByHash.erase(t);
+	--m_currentSize;
 	if (it->second.empty())
-		m_currentByAddressAndNonce.erase(it);
-	m_known.erase(_txHash);
+		_s.currentByAddressAndNonce.erase(it);
+	else if (wasLowest)
+		rekey_WITH_LOCK(_s, from);
+	forget(_txHash);
 	return true;
 }
 
+void TransactionQueue::rekey_WITH_LOCK(Shard& _s, Address const& _a)
+{
+	auto cs = _s.currentByAddressAndNonce.find(_a);
+	if (cs == _s.currentByAddressAndNonce.end())
+		return;
+
+	u256 const& lowest = cs->second.begin()->first;
+	for (auto& n: cs->second)
+	{
+		u256 height = n.first - lowest;
+		if ((*n.second).priority.height == height)
+			continue;
+		// Set elements are const; take it out, fix the key and put it back.
+		VerifiedTransaction t(move(const_cast<VerifiedTransaction&>(*n.second)));
+		_s.current.erase(n.second);
+		t.priority.height = height;
+		h256 h = t.transaction.sha3();
+		n.second = _s.current.emplace(move(t)).first;
+		_s.currentByHash[h] = n.second;
+	}
+}
+
 unsigned TransactionQueue::waiting(Address const& _a) const
 {
-	ReadGuard l(m_lock);
+	Shard const& s = shard(_a);
+	ReadGuard l(s.lock);
 	unsigned ret = 0;
-	auto cs = m_currentByAddressAndNonce.find(_a);
-	if (cs != m_currentByAddressAndNonce.end())
+	auto cs = s.currentByAddressAndNonce.find(_a);
+	if (cs != s.currentByAddressAndNonce.end())
 		ret = cs->second.size();
-	auto fs = m_future.find(_a);
-	if (fs != m_future.end())
+	auto fs = s.future.find(_a);
+	if (fs != s.future.end())
 		ret += fs->second.size();
 	return ret;
 }
 
 void TransactionQueue::setFuture(h256 const& _txHash)
 {
-	WriteGuard l(m_lock);
-	auto it = m_currentByHash.find(_txHash);
-	if (it == m_currentByHash.end())
+	unsigned si;
+	{
+		KnownShard& k = knownShard(_txHash);
+		ReadGuard l(k.lock);
+		auto f = k.known.find(_txHash);
+		if (f == k.known.end())
+			return;
+		si = f->second;
+	}
+
+	Shard& s = m_shards[si];
+	WriteGuard l(s.lock);
+	auto it = s.currentByHash.find(_txHash);
+	if (it == s.currentByHash.end())
 		return;
 
 	VerifiedTransaction const& st = *(it->second);
 
 	Address from = st.transaction.from();
-	auto& queue = m_currentByAddressAndNonce[from];
-	auto& target = m_future[from];
+	auto& queue = s.currentByAddressAndNonce[from];
+	auto& target = s.future[from];
 	auto cutoff = queue.lower_bound(st.transaction.nonce());
 	for (auto m = cutoff; m != queue.end(); ++m)
 	{
 		VerifiedTransaction& t = const_cast<VerifiedTransaction&>(*(m->second)); // set has only const iterators. Since we are moving out of container that's fine
-		m_currentByHash.erase(t.transaction.sha3());
+		s.currentByHash.erase(t.transaction.sha3());
 		target.emplace(t.transaction.nonce(), move(t));
-		m_current.erase(m->second);
+		s.current.erase(m->second);
+		--m_currentSize;
 		++m_futureSize;
 	}
 	queue.erase(cutoff, queue.end());
 	if (queue.empty())
-		m_currentByAddressAndNonce.erase(from);
+		s.currentByAddressAndNonce.erase(from);
 }
 
-void TransactionQueue::makeCurrent_WITH_LOCK(Transaction const& _t)
+void TransactionQueue::makeCurrent_WITH_LOCK(Shard& _s, Transaction const& _t)
 {
 	bool newCurrent = false;
-	auto fs = m_future.find(_t.from());
-	if (fs != m_future.end())
+	auto fs = _s.future.find(_t.from());
+	if (fs != _s.future.end())
 	{
 		u256 nonce = _t.nonce() + 1;
 		auto fb = fs->second.find(nonce);
 		if (fb != fs->second.end())
 		{
+			auto& queue = _s.currentByAddressAndNonce[_t.from()];
 			auto ft = fb;
 			while (ft != fs->second.end() && ft->second.transaction.nonce() == nonce)
 			{
-				auto inserted = m_currentByAddressAndNonce[_t.from()].insert(std::make_pair(ft->second.transaction.nonce(), PriorityQueue::iterator()));
-				PriorityQueue::iterator handle = m_current.emplace(move(ft->second));
+				auto inserted = queue.insert(std::make_pair(nonce, PriorityQueue::iterator()));
+				ft->second.priority = PriorityKey{nonce - queue.begin()->first, ft->second.transaction.gasPrice(), m_sequence++};
+				PriorityQueue::iterator handle = _s.current.emplace(move(ft->second)).first;
 				inserted.first->second = handle;
-				m_currentByHash[(*handle).transaction.sha3()] = handle;
+				_s.currentByHash[(*handle).transaction.sha3()] = handle;
 				--m_futureSize;
+				++m_currentSize;
 				++ft;
 				++nonce;
 				newCurrent = true;
 			}
 			fs->second.erase(fb, ft);
 			if (fs->second.empty())
-				m_future.erase(_t.from());
+				_s.future.erase(_t.from());
+			// The promoted transactions may sit below the sender's other current ones.
+			rekey_WITH_LOCK(_s, _t.from());
 		}
 	}
 
-	while (m_futureSize > m_futureLimit)
+	if (newCurrent)
+		m_onReady();
+}
+
+void TransactionQueue::enforceLimits(unsigned _firstShard)
+{
+	while (m_currentSize > m_limit)
 	{
+		// Find the shard whose worst transaction is the worst overall.
+		unsigned worst = c_shards;
+		PriorityKey worstKey;
+		for (unsigned i = 0; i < c_shards; ++i)
+			DEV_READ_GUARDED(m_shards[i].lock)
+				if (!m_shards[i].current.empty() && (worst == c_shards || worstKey < m_shards[i].current.rbegin()->priority))
+				{
+					worst = i;
+					worstKey = m_shards[i].current.rbegin()->priority;
+				}
+		if (worst == c_shards)
+			break;
+
+		Shard& s = m_shards[worst];
+		WriteGuard l(s.lock);
+		if (s.current.empty())
+			continue;
+		h256 h = s.current.rbegin()->transaction.sha3();
+		clog(TransactionQueueTraceChannel) << "Dropping out of bounds transaction" << h;
+		remove_WITH_LOCK(s, h);
+	}
+
+	for (unsigned n = 0; m_futureSize > m_futureLimit && n < c_shards;)
+	{
+		Shard& s = m_shards[(_firstShard + n) & (c_shards - 1)];
+		WriteGuard l(s.lock);
+		if (s.future.empty())
+		{
+			++n;
+			continue;
+		}
 		// TODO: priority queue for future transactions
 		// For now just drop random chain end
+		auto fs = s.future.begin();
+		h256 h = fs->second.rbegin()->second.transaction.sha3();
+		clog(TransactionQueueTraceChannel) << "Dropping out of bounds future transaction" << h;
+		fs->second.erase(--fs->second.end());
+		if (fs->second.empty())
+			s.future.erase(fs);
 		--m_futureSize;
-		clog(TransactionQueueTraceChannel) << "Dropping out of bounds future transaction" << m_future.begin()->second.rbegin()->second.transaction.sha3();
-		m_future.begin()->second.erase(--m_future.begin()->second.end());
-		if (m_future.begin()->second.empty())
-			m_future.erase(m_future.begin());
+		forget(h);
 	}
-
-	if (newCurrent)
-		m_onReady();
 }
 
 void TransactionQueue::drop(h256 const& _txHash)
 {
-	UpgradableGuard l(m_lock);
-
-	if (!m_known.count(_txHash))
-		return;
+	KnownShard& k = knownShard(_txHash);
+	unsigned si;
+	{
+		ReadGuard l(k.lock);
+		auto f = k.known.find(_txHash);
+		if (f == k.known.end())
+			return;
+		si = f->second;
+	}
 
-	UpgradeGuard ul(l);
-	m_dropped.insert(_txHash);
-	remove_WITH_LOCK(_txHash);
+	Shard& s = m_shards[si];
+	WriteGuard l(s.lock);
+	DEV_WRITE_GUARDED(k.lock)
+		k.dropped.insert(_txHash);
+	if (m_journal)
+		m_journal->dropped(_txHash);
+	remove_WITH_LOCK(s, _txHash);
 }
 
 void TransactionQueue::dropGood(Transaction const& _t)
 {
-	WriteGuard l(m_lock);
-	makeCurrent_WITH_LOCK(_t);
-	if (!m_known.count(_t.sha3()))
-		return;
-	remove_WITH_LOCK(_t.sha3());
+	Address from = _t.from();
+	{
+		Shard& s = shard(from);
+		WriteGuard l(s.lock);
+		makeCurrent_WITH_LOCK(s, _t);
+		remove_WITH_LOCK(s, _t.sha3());
+	}
+	enforceLimits(shardIndex(from));
 }
 
 void TransactionQueue::clear()
 {
-	WriteGuard l(m_lock);
-	m_known.clear();
-	m_current.clear();
-	m_currentByAddressAndNonce.clear();
-	m_currentByHash.clear();
-	m_future.clear();
+	vector<WriteGuard> guards;
+	guards.reserve(c_shards);
+	for (auto& s: m_shards)
+	{
+		guards.emplace_back(s.lock);
+		s.current.clear();
+		s.currentByAddressAndNonce.clear();
+		s.currentByHash.clear();
+		s.future.clear();
+	}
+	h256Hash dropped;
+	for (auto& k: m_knownShards)
+		DEV_WRITE_GUARDED(k.lock)
+		{
+			k.known.clear();
+			dropped.insert(k.dropped.begin(), k.dropped.end());
+		}
+	m_currentSize = 0;
 	m_futureSize = 0;
+	if (m_journal)
+		m_journal->rewrite(Transactions(), dropped);
+}
+
+unsigned TransactionQueue::openJournal(string const& _path)
+{
+	Timer timer;
+	unsigned threads = std::max(thread::hardware_concurrency(), 1U);
+	TransactionJournal::Contents journaled = TransactionJournal::load(_path, threads);
+	for (auto const& h: journaled.dropped)
+		DEV_WRITE_GUARDED(knownShard(h).lock)
+			knownShard(h).dropped.insert(h);
+
+	// The senders came from the journal, so no signatures are recovered; import on all cores.
+	atomic<unsigned> imported(0);
+	vector<thread> importers;
+	for (unsigned t = 0; t < threads; ++t)
+		importers.emplace_back([&, t]()
+		{
+			for (size_t i = t; i < journaled.transactions.size(); i += threads)
+				if (import(journaled.transactions[i]) == ImportResult::Success)
+					++imported;
+		});
+	for (auto& t: importers)
+		t.join();
+
+	// Journal appends happen under a shard's write lock, so none can see a half-set journal.
+	std::unique_ptr<TransactionJournal> journal(new TransactionJournal(_path));
+	{
+		vector<WriteGuard> guards;
+		guards.reserve(c_shards);
+		for (auto& s: m_shards)
+			guards.emplace_back(s.lock);
+		m_journal = move(journal);
+	}
+	compactJournal();
+	clog(TransactionQueueChannel) << "Reloaded" << imported << "of" << journaled.transactions.size() << "journaled transactions in" << timer.elapsed() << "s";
+	return imported;
+}
+
+void TransactionQueue::maintainJournal()
+{
+	if (m_journal && m_journal->records() > std::max<uint64_t>(c_minJournalRecords, 2 * (m_currentSize + m_futureSize)) && !m_compacting.exchange(true))
+	{
+		compactJournal();
+		m_compacting = false;
+	}
+}
+
+void TransactionQueue::compactJournal()
+{
+	Transactions ts;
+	h256Hash dropped;
+	// Journal appends happen under a shard's write lock, so none can be missed while these are held.
+	vector<ReadGuard> guards;
+	guards.reserve(c_shards);
+	for (auto const& s: m_shards)
+	{
+		guards.emplace_back(s.lock);
+		for (auto const& t: s.current)
+			ts.push_back(t.transaction);
+		for (auto const& f: s.future)
+			for (auto const& t: f.second)
+				ts.push_back(t.second.transaction);
+	}
+	for (auto const& k: m_knownShards)
+		DEV_READ_GUARDED(k.lock)
+			dropped.insert(k.dropped.begin(), k.dropped.end());
+	m_journal->rewrite(ts, dropped);
+}
+
+void TransactionQueue::setSubmissionLimit(unsigned _perSecond, unsigned _burst)
+{
+	Guard l(x_queue);
+	m_submissionRate = _perSecond;
+	m_submissionBurst = max(_burst, 1u);
+	for (auto it = m_allowances.begin(); it != m_allowances.end();)
+		it = it->first ? m_allowances.erase(it) : next(it);
+}
+
+void TransactionQueue::setLocalSubmissionLimit(unsigned _perSecond, unsigned _burst)
+{
+	Guard l(x_queue);
+	m_localSubmissionRate = _perSecond;
+	m_localSubmissionBurst = max(_burst, 1u);
+	m_allowances.erase(h512());
+}
+
+void TransactionQueue::setStateSnapshot(shared_ptr<State const> const& _s)
+{
+	Guard l(x_queue);
+	m_stateSnapshot = _s;
+}
+
+bool TransactionQueue::consumeAllowance_WITH_LOCK(h512 const& _source)
+{
+	// The local node shares one allowance, higher than a peer's.
+	auto rate = [&](h512 const& _s) { return _s ? m_submissionRate : m_localSubmissionRate; };
+	auto burst = [&](h512 const& _s) { return _s ? m_submissionBurst : m_localSubmissionBurst; };
+	if (!rate(_source))
+		return true;
+	auto now = chrono::steady_clock::now();
+	auto refill = [&](h512 const& _s, Allowance& _a)
+	{
+		double elapsed = chrono::duration<double>(now - _a.refilled).count();
+		_a.tokens = min<double>(burst(_s), _a.tokens + elapsed * rate(_s));
+		_a.refilled = now;
+	};
+	if (m_allowances.size() > c_maxAllowances)
+		for (auto it = m_allowances.begin(); it != m_allowances.end();)
+		{
+			refill(it->first, it->second);
+			it = it->second.tokens >= burst(it->first) ? m_allowances.erase(it) : next(it);
+		}
+
+	auto it = m_allowances.find(_source);
+	if (it == m_allowances.end())
+		it = m_allowances.emplace(_source, Allowance{(double)burst(_source), now}).first;
+	else
+		refill(_source, it->second);
+	if (it->second.tokens < 1)
+		return false;
+	it->second.tokens -= 1;
+	return true;
 }
 
 void TransactionQueue::enqueue(RLP const& _data, h512 const& _nodeId)
@@ -367,6 +681,11 @@ void TransactionQueue::enqueue(RLP const& _data, h512 const& _nodeId)
 				clog(TransactionQueueChannel) << "Transaction verification queue is full. Dropping" << itemCount - i << "transactions";
 				break;
 			}
+			if (!consumeAllowance_WITH_LOCK(_nodeId))
+			{
+				clog(TransactionQueueChannel) << "Source" << _nodeId.abridged() << "is over its rate. Dropping" << itemCount - i << "transactions";
+				break;
+			}
 			m_unverified.emplace_back(UnverifiedTransaction(_data[i].data(), _nodeId));
 			queued = true;
 		}
@@ -375,31 +694,79 @@ void TransactionQueue::enqueue(RLP const& _data, h512 const& _nodeId)
 		m_queueReady.notify_all();
 }
 
-void TransactionQueue::verifierBody()
+h256 TransactionQueue::submit(bytes const& _tx, h512 const& _source)
 {
-	while (!m_aborting)
+	// Decoding and hashing only; the signature is recovered by a verifier.
+	h256 ret = Transaction(&_tx, CheckTransaction::None).sha3();
 	{
-		UnverifiedTransaction work;
+		Guard l(x_queue);
+		if (m_unverified.size() >= c_maxVerificationQueueSize)
+			BOOST_THROW_EXCEPTION(TransactionQueueFull());
+		if (!consumeAllowance_WITH_LOCK(_source))
+			BOOST_THROW_EXCEPTION(TransactionRateLimited());
+		m_unverified.emplace_back(UnverifiedTransaction(&_tx, _source));
+	}
+	m_queueReady.notify_one();
+	return ret;
+}
 
+ImportResult TransactionQueue::checkState(State const& _s, Transaction const& _t)
+{
+	Address from = _t.sender();
+	if (_t.nonce() < _s.getNonce(from))
+		return ImportResult::NonceTooLow;
+	if (_s.balance(from) < bigint(_t.gas()) * _t.gasPrice() + _t.value())
+		return ImportResult::InsufficientFunds;
+	return ImportResult::Success;
+}
+
+void TransactionQueue::verifierBody(unsigned _threads)
+{
+	vector<UnverifiedTransaction> work;
+	while (!m_aborting)
+	{
+		work.clear();
+		shared_ptr<State const> snapshot;
 		{
 			unique_lock<Mutex> l(x_queue);
 			m_queueReady.wait(l, [&](){ return !m_unverified.empty() || m_aborting; });
 			if (m_aborting)
 				return;
-			work = move(m_unverified.front());
-			m_unverified.pop_front();
+			// Take a fair share of the backlog so the queue lock is taken once per batch rather than per transaction.
+			size_t n = std::min(c_maxVerifierBatch, (m_unverified.size() + _threads - 1) / _threads);
+			for (size_t i = 0; i < n; ++i)
+			{
+				work.push_back(move(m_unverified.front()));
+				m_unverified.pop_front();
+			}
+			snapshot = m_stateSnapshot;
 		}
 
-		try
-		{
-			Transaction t(work.transaction, CheckTransaction::Cheap); //Signature will be checked later
-			ImportResult ir = import(t);
-			m_onImport(ir, t.sha3(), work.nodeId);
-		}
-		catch (...)
+		// A copy per batch, as reading a State fills its cache.
+		unique_ptr<State> state;
+		if (snapshot)
+			state.reset(new State(*snapshot));
+
+		for (auto& w: work)
 		{
-			// should not happen as exceptions are handled in import.
-			cwarn << "Bad transaction:" << boost::current_exception_diagnostic_information();
+			try
+			{
+				Transaction t(w.transaction, CheckTransaction::Cheap); // Signature is recovered in checkState() or import(), still on this thread.
+				ImportResult ir = check(t.sha3(), IfDropped::Ignore);
+				if (ir == ImportResult::Success && state && !t.hasZeroSignature())
+					DEV_IF_THROWS(ir = checkState(*state, t))
+					{
+						ir = ImportResult::Malformed;
+					}
+				if (ir == ImportResult::Success)
+					ir = import(t);
+				m_onImport(ir, t.sha3(), w.nodeId);
+			}
+			catch (...)
+			{
+				// should not happen as exceptions are handled in import.
+				cwarn << "Bad transaction:" << boost::current_exception_diagnostic_information();
+			}
 		}
 	}
 }
@@ -21,11 +21,18 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <condition_variable>
 #include <thread>
 #include <deque>
+#include <map>
+#include <memory>
+#include <set>
 #include <libdevcore/Common.h>
+#include <libdevcore/Exceptions.h>
 #include <libdevcore/Guards.h>
 #include <libdevcore/Log.h>
 #include <libethcore/Common.h>
@@ -36,6 +43,12 @@ namespace dev
 namespace eth
 {
 
+class TransactionJournal;
+class State;
+
+DEV_SIMPLE_EXCEPTION(TransactionQueueFull);
+DEV_SIMPLE_EXCEPTION(TransactionRateLimited);
+
 struct TransactionQueueChannel: public LogChannel { static const char* name(); static const int verbosity = 4; };
 struct TransactionQueueTraceChannel: public LogChannel { static const char* name(); static const int verbosity = 7; };
 #define ctxq dev::LogOutputStream<dev::eth::TransactionQueueTraceChannel, true>()
@@ -43,6 +56,8 @@ struct TransactionQueueTraceChannel: public LogChannel { static const char* name
 /**
  * @brief A queue of Transactions, each stored as RLP.
  * Maintains a transaction queue sorted by nonce diff and gas price.
+ * Senders are spread over shards that are locked independently, so imports from different
+ * senders proceed in parallel; signatures are recovered before any lock is taken.
  * @threadsafe
  */
 class TransactionQueue
@@ -61,6 +76,23 @@ public:
 	/// @param _nodeId Optional network identified of a node transaction comes from.
 	void enqueue(RLP const& _data, h512 const& _nodeId);
 
+	/// Checks that @a _tx is a well-formed transaction and queues it to be verified and imported in the background.
+	/// The outcome is reported through onImport(), with @a _source as the node id; a zero @a _source is the local node.
+	/// @returns the transaction's hash.
+	/// @throws if it is malformed, the verification queue is full or @a _source is over its rate.
+	h256 submit(bytes const& _tx, h512 const& _source = h512());
+
+	/// Sets how many transactions a single remote source may have queued for verification per second,
+	/// in bursts of up to @a _burst. 0 means no limit.
+	void setSubmissionLimit(unsigned _perSecond, unsigned _burst);
+
+	/// Sets the same for local submissions (a zero source), which share one allowance.
+	void setLocalSubmissionLimit(unsigned _perSecond, unsigned _burst);
+
+	/// Sets the state queued transactions are checked against before import: those whose nonce
+	/// is already used or whose sender can't pay for them are rejected. Null turns the check off.
+	void setStateSnapshot(std::shared_ptr<State const> const& _s);
+
 	/// Verify and add transaction to the queue synchronously.
 	/// @param _tx RLP encoded transaction data.
 	/// @param _ik Set to Retry to force re-addinga transaction that was previously dropped.
@@ -111,7 +143,7 @@ public:
 		size_t dropped;
 	};
 	/// @returns the status of the transaction queue.
-	Status status() const { Status ret; DEV_GUARDED(x_queue) { ret.unverified = m_unverified.size(); } ReadGuard l(m_lock); ret.dropped = m_dropped.size(); ret.current = m_currentByHash.size(); ret.future = m_future.size(); return ret; }
+	Status status() const;
 
 	/// @returns the transacrtion limits on current/future.
 	Limits limits() const { return Limits{m_limit, m_futureLimit}; }
@@ -119,6 +151,15 @@ public:
 	/// Clear the queue
 	void clear();
 
+	/// Reloads the transactions journaled at @a _path, then journals every change to the queue there
+	/// so that its contents survive a restart. Must not race with maintainJournal().
+	/// @returns the number of transactions reloaded.
+	unsigned openJournal(std::string const& _path);
+
+	/// Compacts the journal once enough records have piled up. Rewrites the whole file, so it is
+	/// meant to be called now and then from a maintenance thread, not on the import path.
+	void maintainJournal();
+
 	/// Register a handler that will be called once there is a new transaction imported
 	template <class T> Handler<> onReady(T const& _t) { return m_onReady.add(_t); }
 
@@ -129,17 +170,45 @@ public:
 	template <class T> Handler<h256 const&> onReplaced(T const& _t) { return m_onReplaced.add(_t); }
 
 private:
+	/// Number of sender shards; a power of two.
+	static const unsigned c_shards = 16;
+
+	/// Position of a transaction in the priority queue, worked out when it is inserted.
+	/// Ordered by nonce height above the sender's lowest queued nonce, then by gas price (highest first), then by arrival.
+	struct PriorityKey
+	{
+		u256 height;
+		u256 gasPrice;
+		uint64_t sequence;
+
+		bool operator<(PriorityKey const& _other) const
+		{
+			if (height != _other.height)
+				return height < _other.height;
+			if (gasPrice != _other.gasPrice)
+				return gasPrice > _other.gasPrice;
+			return sequence < _other.sequence;
+		}
+	};
 
 	/// Verified and imported transaction
 	struct VerifiedTransaction
 	{
-		VerifiedTransaction(Transaction const& _t): transaction(_t) {}
-		VerifiedTransaction(VerifiedTransaction&& _t): transaction(std::move(_t.transaction)) {}
+		VerifiedTransaction(Transaction const& _t, PriorityKey const& _k): transaction(_t), priority(_k) {}
+		VerifiedTransaction(VerifiedTransaction&& _t): transaction(std::move(_t.transaction)), priority(std::move(_t.priority)) {}
 
 		VerifiedTransaction(VerifiedTransaction const&) = delete;
 		VerifiedTransaction& operator=(VerifiedTransaction const&) = delete;
 
 		Transaction transaction; ///< Transaction data
+		PriorityKey priority; ///< Sort key; only meaningful while the transaction is current.
+	};
+
+	/// Verification queue allowance of a source, as a token bucket.
+	struct Allowance
+	{
+		double tokens;
+		std::chrono::steady_clock::time_point refilled;
 	};
 
 	/// Transaction pending verification
@@ -166,52 +235,85 @@ private:
 
 	struct PriorityCompare
 	{
-		TransactionQueue& queue;
-		/// Compare transaction by nonce height and gas price.
-		bool operator()(VerifiedTransaction const& _first, VerifiedTransaction const& _second) const
-		{
-			u256 const& height1 = _first.transaction.nonce() - queue.m_currentByAddressAndNonce[_first.transaction.sender()].begin()->first;
-			u256 const& height2 = _second.transaction.nonce() - queue.m_currentByAddressAndNonce[_second.transaction.sender()].begin()->first;
-			return height1 < height2 || (height1 == height2 && _first.transaction.gasPrice() > _second.transaction.gasPrice());
-		}
+		bool operator()(VerifiedTransaction const& _first, VerifiedTransaction const& _second) const { return _first.priority < _second.priority; }
 	};
 
-	// Use a set with dynamic comparator for minmax priority queue. The comparator takes into account min account nonce. Updating it does not affect the order.
-	using PriorityQueue = std::multiset<VerifiedTransaction, PriorityCompare>;
-
-	ImportResult import(bytesConstRef _tx, IfDropped _ik = IfDropped::Ignore);
-	ImportResult check_WITH_LOCK(h256 const& _h, IfDropped _ik);
-	ImportResult manageImport_WITH_LOCK(h256 const& _h, Transaction const& _transaction);
+	using PriorityQueue = std::set<VerifiedTransaction, PriorityCompare>;
 
-	void insertCurrent_WITH_LOCK(std::pair<h256, Transaction> const& _p);
-	void makeCurrent_WITH_LOCK(Transaction const& _t);
-	bool remove_WITH_LOCK(h256 const& _txHash);
-	u256 maxNonce_WITH_LOCK(Address const& _a) const;
-	void verifierBody();
+	/// The transactions of all senders that map to one shard, with the lock that guards them.
+	struct Shard
+	{
+		mutable SharedMutex lock;
+		PriorityQueue current;
+		std::unordered_map<h256, PriorityQueue::iterator> currentByHash;			///< Transaction hash to set ref
+		std::unordered_map<Address, std::map<u256, PriorityQueue::iterator>> currentByAddressAndNonce; ///< Transactions grouped by account and nonce
+		std::unordered_map<Address, std::map<u256, VerifiedTransaction>> future;	///< Future transactions
+	};
 
-	mutable SharedMutex m_lock;													///< General lock.
-	h256Hash m_known;															///< Headers of transactions in both sets.
+	/// Hashes of known and dropped transactions, sharded by transaction hash.
+	struct KnownShard
+	{
+		mutable SharedMutex lock;
+		std::unordered_map<h256, unsigned> known;	///< Hash of each transaction in the queue to the index of its sender's shard.
+		h256Hash dropped;							///< Transactions that have previously been dropped
+	};
 
-	std::unordered_map<h256, std::function<void(ImportResult)>> m_callbacks;	///< Called once.
-	h256Hash m_dropped;															///< Transactions that have previously been dropped
+	static unsigned shardIndex(Address const& _a) { return _a[Address::size - 1] & (c_shards - 1); }
+	Shard& shard(Address const& _a) { return m_shards[shardIndex(_a)]; }
+	Shard const& shard(Address const& _a) const { return m_shards[shardIndex(_a)]; }
+	KnownShard& knownShard(h256 const& _h) { return m_knownShards[_h[0] & (c_shards - 1)]; }
 
-	PriorityQueue m_current;
-	std::unordered_map<h256, PriorityQueue::iterator> m_currentByHash;			///< Transaction hash to set ref
-	std::unordered_map<Address, std::map<u256, PriorityQueue::iterator>> m_currentByAddressAndNonce; ///< Transactions grouped by account and nonce
-	std::unordered_map<Address, std::map<u256, VerifiedTransaction>> m_future;	/// Future transactions
+	ImportResult import(bytesConstRef _tx, IfDropped _ik = IfDropped::Ignore);
+	ImportResult check(h256 const& _h, IfDropped _ik);
+	ImportResult manageImport_WITH_LOCK(Shard& _s, h256 const& _h, Transaction const& _transaction);
+
+	void insertCurrent_WITH_LOCK(Shard& _s, h256 const& _h, Transaction const& _t);
+	void makeCurrent_WITH_LOCK(Shard& _s, Transaction const& _t);
+	bool remove_WITH_LOCK(Shard& _s, h256 const& _txHash);
+	/// Recomputes the priority keys of @a _a's current transactions after its lowest nonce changed.
+	void rekey_WITH_LOCK(Shard& _s, Address const& _a);
+	u256 maxNonce_WITH_LOCK(Shard const& _s, Address const& _a) const;
+	/// Drops the lowest priority transactions of any shard until the current and future limits are met.
+	/// Must be called without holding any shard lock.
+	void enforceLimits(unsigned _firstShard);
+	/// Records @a _h as known, living in shard @a _shard.
+	void setKnown(h256 const& _h, unsigned _shard);
+	/// Removes @a _h from the known set.
+	void forget(h256 const& _h);
+	void verifierBody(unsigned _threads);
+	/// Takes one transaction's worth of @a _source's allowance; @returns false if it has none left.
+	bool consumeAllowance_WITH_LOCK(h512 const& _source);
+	/// Checks @a _t against the sender's nonce and balance in @a _s.
+	static ImportResult checkState(State const& _s, Transaction const& _t);
+	/// Rewrites the journal with the queue's current contents.
+	void compactJournal();
+
+	std::array<Shard, c_shards> m_shards;
+	std::array<KnownShard, c_shards> m_knownShards;
+	std::atomic<uint64_t> m_sequence = {0};										///< Arrival counter for priority ties.
 
 	Signal<> m_onReady;															///< Called when a subsequent call to import transactions will return a non-empty container. Be nice and exit fast.
 	Signal<ImportResult, h256 const&, h512 const&> m_onImport;					///< Called for each import attempt. Arguments are result, transaction id an node id. Be nice and exit fast.
 	Signal<h256 const&> m_onReplaced;											///< Called whan transction is dropped during a call to import() to make room for another transaction.
 	unsigned m_limit;															///< Max number of pending transactions
 	unsigned m_futureLimit;														///< Max number of future transactions
-	unsigned m_futureSize = 0;													///< Current number of future transactions
+	std::atomic<unsigned> m_currentSize = {0};									///< Current number of pending transactions
+	std::atomic<unsigned> m_futureSize = {0};									///< Current number of future transactions
 
 	std::condition_variable m_queueReady;										///< Signaled when m_unverified has a new entry.
 	std::vector<std::thread> m_verifiers;
 	std::deque<UnverifiedTransaction> m_unverified;								///< Pending verification queue
 	mutable Mutex x_queue;														///< Verification queue mutex
+	std::unordered_map<h512, Allowance> m_allowances;							///< Per-source allowances, under x_queue.
+	unsigned m_submissionRate;													///< Transactions per second per remote source; 0 for no limit.
+	unsigned m_submissionBurst;
+	unsigned m_localSubmissionRate;												///< Transactions per second from the local node; 0 for no limit.
+	unsigned m_localSubmissionBurst;
+	std::shared_ptr<State const> m_stateSnapshot;								///< Under x_queue.
 	std::atomic<bool> m_aborting = {false};										///< Exit condition for verifier.
+
+	std::unique_ptr<TransactionJournal> m_journal;								///< Where changes are logged, if anywhere.
+	std::atomic<bool> m_compacting = {false};									///< Whether a thread is compacting the journal.
 };
 
 }
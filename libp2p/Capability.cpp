@@ -52,9 +52,40 @@ void Capability::sealAndSend(RLPStream& _s)
 		session->sealAndSend(_s, c_protocolID);
 }
 
+void Capability::sealAndSend(unsigned _id, bytes&& _items)
+{
+	shared_ptr<SessionFace> session = m_session.lock();
+	if (!session)
+		return;
+
+	// Packet type and list prefix go in a slice of their own, ahead of the items.
+	vector<bytes> slices(2);
+	bytes& head = slices[0];
+	head.push_back(byte(_id + m_idOffset));
+	size_t const size = _items.size();
+	if (size < c_rlpListImmLenCount)
+		head.push_back(byte(c_rlpListStart + size));
+	else
+	{
+		unsigned const br = bytesRequired(size);
+		head.push_back(byte(c_rlpListIndLenZero + br));
+		for (unsigned i = br; i--;)
+			head.push_back(byte(size >> (8 * i)));
+	}
+	slices[1] = move(_items);
+	session->sealAndSend(move(slices), c_protocolID);
+}
+
 void Capability::addRating(int _r)
 {
 	shared_ptr<SessionFace> session = m_session.lock();
 	if (session)
 		session->addRating(_r);
 }
+
+void Capability::offload(std::function<void()> const& _f)
+{
+	shared_ptr<SessionFace> session = m_session.lock();
+	if (session)
+		session->offload(_f);
+}
@@ -54,8 +54,15 @@ protected:
 
 	RLPStream& prep(RLPStream& _s, unsigned _id, unsigned _args = 0);
 	void sealAndSend(RLPStream& _s);
+
+	/// Sends packet @a _id, a list of the RLP items one after another in @a _items, without copying them.
+	void sealAndSend(unsigned _id, bytes&& _items);
 	void addRating(int _r);
 
+	/// Runs @a _f off the network threads, after the handlers offloaded before it for this session.
+	/// For serving requests that may block, e.g. on the database; @a _f must not refer to the packet being interpreted.
+	void offload(std::function<void()> const& _f);
+
 	uint16_t const c_protocolID;
 
 private:
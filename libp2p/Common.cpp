@@ -26,6 +26,12 @@ using namespace dev;
 using namespace dev::p2p;
 
 const unsigned dev::p2p::c_protocolVersion = 4;
+const unsigned dev::p2p::c_snappyProtocolVersion = 5;
+#if ETH_SNAPPY
+const unsigned dev::p2p::c_helloProtocolVersion = 5;
+#else
+const unsigned dev::p2p::c_helloProtocolVersion = 4;
+#endif
 const unsigned dev::p2p::c_defaultIPPort = 30303;
 static_assert(dev::p2p::c_protocolVersion == 4, "Replace v3 compatbility with v4 compatibility before updating network version.");
 
@@ -200,6 +206,54 @@ void DeadlineOps::reap()
 	});
 }
 
+TrafficCounters& TrafficCounters::operator+=(TrafficCounters const& _t)
+{
+	ingressBytes += _t.ingressBytes;
+	ingressPackets += _t.ingressPackets;
+	egressBytes += _t.egressBytes;
+	egressPackets += _t.egressPackets;
+	return *this;
+}
+
+void SessionTraffic::note(string const& _cap, unsigned _type, bool _egress, size_t _bytes)
+{
+	TrafficCounters& p = packets[make_pair(_cap, _type)];
+	if (_egress)
+	{
+		total.egressBytes += _bytes;
+		total.egressPackets++;
+		p.egressBytes += _bytes;
+		p.egressPackets++;
+	}
+	else
+	{
+		total.ingressBytes += _bytes;
+		total.ingressPackets++;
+		p.ingressBytes += _bytes;
+		p.ingressPackets++;
+	}
+}
+
+map<string, TrafficCounters> SessionTraffic::capabilities() const
+{
+	map<string, TrafficCounters> ret;
+	for (auto const& p: packets)
+		ret[p.first.first] += p.second;
+	return ret;
+}
+
+SessionTraffic& SessionTraffic::operator+=(SessionTraffic const& _t)
+{
+	total += _t.total;
+	for (auto const& p: _t.packets)
+		packets[p.first] += p.second;
+	frameCoderMicroseconds += _t.frameCoderMicroseconds;
+	throttledMicroseconds += _t.throttledMicroseconds;
+	writeQueue += _t.writeQueue;
+	writeQueueBytes += _t.writeQueueBytes;
+	return *this;
+}
+
 Node::Node(NodeSpec const& _s, PeerType _p):
 	id(_s.id()),
 	endpoint(_s.nodeIPEndpoint()),
@@ -52,6 +52,10 @@ namespace p2p
 
 /// Peer network protocol version.
 extern const unsigned c_protocolVersion;
+/// First protocol version whose packets are Snappy-compressed once both sides have sent Hello (EIP-706).
+extern const unsigned c_snappyProtocolVersion;
+/// Protocol version we announce in Hello: c_snappyProtocolVersion if we can compress, otherwise c_protocolVersion.
+extern const unsigned c_helloProtocolVersion;
 extern const unsigned c_defaultIPPort;
 
 class NodeIPEndpoint;
@@ -145,6 +149,44 @@ using CapDesc = std::pair<std::string, u256>;
 using CapDescSet = std::set<CapDesc>;
 using CapDescs = std::vector<CapDesc>;
 
+/// Bytes and packets received and sent.
+struct TrafficCounters
+{
+	uint64_t ingressBytes = 0;
+	uint64_t ingressPackets = 0;
+	uint64_t egressBytes = 0;
+	uint64_t egressPackets = 0;
+
+	TrafficCounters& operator+=(TrafficCounters const& _t);
+};
+
+/// What a session has cost, in bandwidth and CPU.
+struct SessionTraffic
+{
+	TrafficCounters total;				///< Bytes as on the wire, framing and encryption included.
+	std::map<std::pair<std::string, unsigned>, TrafficCounters> packets;	///< By capability ("p2p" for the base protocol) and packet type within it.
+	uint64_t frameCoderMicroseconds = 0;	///< Spent encrypting, decrypting and authenticating.
+	uint64_t throttledMicroseconds = 0;		///< Writing was held back by egress limits.
+	size_t writeQueue = 0;					///< Packets waiting to be written, when this was taken.
+	size_t writeQueueBytes = 0;
+
+	/// Counts a packet of type @a _type of capability @a _cap, @a _bytes long.
+	void note(std::string const& _cap, unsigned _type, bool _egress, size_t _bytes);
+
+	/// @returns the counters summed by capability.
+	std::map<std::string, TrafficCounters> capabilities() const;
+
+	/// Adds @a _t's counters, and its queues as if they were ours.
+	SessionTraffic& operator+=(SessionTraffic const& _t);
+};
+
+/// Totals of the sessions that have ended; the host shares them with its sessions, which may outlive it.
+struct EndedSessionsTraffic
+{
+	Mutex x;
+	SessionTraffic traffic;
+};
+
 /*
  * Used by Host to pass negotiated information about a connection to a
  * new Peer Session; PeerSessionInfo is then maintained by Session and can
@@ -161,6 +203,7 @@ struct PeerSessionInfo
 	unsigned socketId;
 	std::map<std::string, std::string> notes;
 	unsigned const protocolVersion;
+	SessionTraffic traffic;			///< Filled in by Host::peerSessionInfo().
 };
 
 using PeerSessionInfos = std::vector<PeerSessionInfo>;
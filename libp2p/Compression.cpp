@@ -0,0 +1,80 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Compression.cpp
+ * @date 2016
+ */
+
+#include "Compression.h"
+#if ETH_SNAPPY
+#include <snappy.h>
+#endif
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+const size_t dev::p2p::c_maxUncompressedPayload = 16 * 1024 * 1024;
+
+bool dev::p2p::haveSnappy()
+{
+#if ETH_SNAPPY
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool dev::p2p::snappyCompress(bytesConstRef _in, bytes& io_out)
+{
+#if ETH_SNAPPY
+	if (_in.size() > c_maxUncompressedPayload)
+		return false;
+	size_t const offset = io_out.size();
+	io_out.resize(offset + snappy::MaxCompressedLength(_in.size()));
+	size_t length = 0;
+	snappy::RawCompress(reinterpret_cast<char const*>(_in.data()), _in.size(), reinterpret_cast<char*>(io_out.data() + offset), &length);
+	io_out.resize(offset + length);
+	return true;
+#else
+	(void)_in;
+	(void)io_out;
+	return false;
+#endif
+}
+
+bool dev::p2p::snappyUncompress(bytesConstRef _in, size_t _max, bytes& io_out)
+{
+#if ETH_SNAPPY
+	// The length is only what the sender claims; it bounds the allocation, and RawUncompress fails
+	// rather than write past it.
+	size_t length = 0;
+	if (!snappy::GetUncompressedLength(reinterpret_cast<char const*>(_in.data()), _in.size(), &length) || length > _max)
+		return false;
+	size_t const offset = io_out.size();
+	io_out.resize(offset + length);
+	if (!snappy::RawUncompress(reinterpret_cast<char const*>(_in.data()), _in.size(), reinterpret_cast<char*>(io_out.data() + offset)))
+	{
+		io_out.resize(offset);
+		return false;
+	}
+	return true;
+#else
+	(void)_in;
+	(void)_max;
+	(void)io_out;
+	return false;
+#endif
+}
@@ -0,0 +1,47 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Compression.h
+ * @date 2016
+ * Snappy compression of packet payloads, as negotiated by p2p version 5 (EIP-706).
+ */
+
+#pragma once
+
+#include <libdevcore/Common.h>
+
+namespace dev
+{
+namespace p2p
+{
+
+/// Largest packet payload sent or accepted when compressing, before compression.
+extern const size_t c_maxUncompressedPayload;
+
+/// @returns true if this build can compress packets.
+bool haveSnappy();
+
+/// Appends the Snappy compression of @a _in to @a io_out.
+/// @returns false, leaving @a io_out untouched, if Snappy isn't available or @a _in is larger than c_maxUncompressedPayload.
+bool snappyCompress(bytesConstRef _in, bytes& io_out);
+
+/// Appends the decompression of @a _in to @a io_out.
+/// @returns false if @a _in is malformed or would decompress to more than @a _max bytes, which is
+/// checked before anything is allocated, or if Snappy isn't available.
+bool snappyUncompress(bytesConstRef _in, size_t _max, bytes& io_out);
+
+}
+}
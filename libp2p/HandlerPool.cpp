@@ -0,0 +1,133 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file HandlerPool.cpp
+ * @date 2016
+ */
+
+#include "HandlerPool.h"
+#include <libdevcore/CommonIO.h>
+#include <libdevcore/Log.h>
+#include "Common.h"
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+HandlerPool::HandlerPool(unsigned _threads)
+{
+	for (unsigned i = 0; i < _threads; ++i)
+		m_threads.emplace_back([=]()
+		{
+			setThreadName("p2p.h" + toString(i));
+			run();
+		});
+}
+
+void HandlerPool::post(shared_ptr<Lane> const& _lane, function<void()> const& _f)
+{
+	{
+		Guard l(x_queue);
+		if (m_stopped)
+			return;
+		_lane->handlers.push_back(_f);
+		if (_lane->scheduled)
+			return;
+		_lane->scheduled = true;
+		m_queue.push_back(_lane);
+	}
+	m_ready.notify_one();
+}
+
+bool HandlerPool::deferUntilBelow(shared_ptr<Lane> const& _lane, unsigned _n, function<void()> const& _onResume)
+{
+	Guard l(x_queue);
+	if (m_stopped || _lane->handlers.size() < _n)
+		return false;
+	_lane->resumeBelow = _n;
+	_lane->onResume = _onResume;
+	return true;
+}
+
+void HandlerPool::stop()
+{
+	DEV_GUARDED(x_queue)
+		m_stopped = true;
+	m_ready.notify_all();
+	for (auto& t: m_threads)
+		t.join();
+	m_threads.clear();
+
+	// Handlers hold their capabilities (and resumptions their sessions); release them outside the lock.
+	deque<shared_ptr<Lane>> dropped;
+	DEV_GUARDED(x_queue)
+		dropped.swap(m_queue);
+	for (auto const& lane: dropped)
+	{
+		lane->handlers.clear();
+		lane->onResume = nullptr;
+	}
+}
+
+void HandlerPool::run()
+{
+	unique_lock<Mutex> l(x_queue);
+	while (true)
+	{
+		m_ready.wait(l, [&]() { return m_stopped || !m_queue.empty(); });
+		if (m_stopped)
+			return;
+
+		shared_ptr<Lane> lane = move(m_queue.front());
+		m_queue.pop_front();
+		function<void()> handler = move(lane->handlers.front());
+		l.unlock();
+
+		try
+		{
+			handler();
+		}
+		catch (std::exception const& _e)
+		{
+			clog(NetWarn) << "Exception in capability handler:" << _e.what();
+		}
+		handler = nullptr;
+
+		function<void()> resume;
+		deque<function<void()>> dropped;
+		l.lock();
+		lane->handlers.pop_front();
+		bool const stopped = m_stopped;
+		if (lane->onResume && (lane->handlers.size() < lane->resumeBelow || stopped))
+			resume.swap(lane->onResume);
+		if (stopped)
+			dropped.swap(lane->handlers);
+		if (lane->handlers.empty())
+			lane->scheduled = false;
+		else
+			// Back of the queue, so one busy session can't keep the others waiting.
+			m_queue.push_back(move(lane));
+
+		if (resume || !dropped.empty())
+		{
+			l.unlock();
+			if (resume && !stopped)
+				resume();
+			resume = nullptr;
+			dropped.clear();
+			l.lock();
+		}
+	}
+}
@@ -0,0 +1,85 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file HandlerPool.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace p2p
+{
+
+/**
+ * @brief Fixed set of threads running capability request handlers off the network threads.
+ *
+ * Handlers are queued on lanes, one per session. A lane's handlers run in the order they were
+ * posted and never two at once, while different lanes share the threads round-robin. A session
+ * whose lane is backed up stops reading until it drains (see deferUntilBelow()), so a peer sending
+ * requests faster than they are served is slowed down by TCP rather than queued without bound.
+ *
+ * Thread Safety
+ * All methods are thread-safe.
+ */
+class HandlerPool
+{
+public:
+	/// Handlers of one session, posted but not finished yet.
+	struct Lane
+	{
+		std::deque<std::function<void()>> handlers;	///< Front one is running if scheduled.
+		bool scheduled = false;						///< Whether the lane is queued for or held by a thread.
+		unsigned resumeBelow = 0;
+		std::function<void()> onResume;				///< Called once fewer than resumeBelow handlers remain.
+	};
+
+	explicit HandlerPool(unsigned _threads);
+	~HandlerPool() { stop(); }
+
+	std::shared_ptr<Lane> newLane() const { return std::make_shared<Lane>(); }
+
+	/// Queues @a _f to run after the handlers already posted on @a _lane. Dropped once stopped.
+	void post(std::shared_ptr<Lane> const& _lane, std::function<void()> const& _f);
+
+	/// If @a _lane has @a _n or more handlers unfinished, arranges for @a _onResume to be called (on a pool
+	/// thread) once it has fewer and @returns true. @returns false if it already has fewer.
+	bool deferUntilBelow(std::shared_ptr<Lane> const& _lane, unsigned _n, std::function<void()> const& _onResume);
+
+	/// Finishes the running handlers and drops the others. Further posts are dropped.
+	void stop();
+
+private:
+	void run();
+
+	Mutex x_queue;
+	std::condition_variable m_ready;
+	std::deque<std::shared_ptr<Lane>> m_queue;	///< Lanes with handlers waiting for a thread.
+	bool m_stopped = false;
+	std::vector<std::thread> m_threads;
+};
+
+}
+}
@@ -47,6 +47,9 @@ std::chrono::seconds const c_keepAliveInterval = std::chrono::seconds(30);
 /// Disconnect timeout after failure to respond to keepAlivePeers ping.
 std::chrono::milliseconds const c_keepAliveTimeOut = std::chrono::milliseconds(1000);
 
+/// Peers never connected to are dropped from the peer store once they haven't been tried for this long.
+std::chrono::hours const c_peerStoreForget = std::chrono::hours(24 * 7);
+
 HostNodeTableHandler::HostNodeTableHandler(Host& _host): m_host(_host) {}
 
 void HostNodeTableHandler::processEvent(NodeID const& _n, NodeTableEventType const& _e)
@@ -102,7 +105,7 @@ Host::Host(string const& _clientVersion, KeyPair const& _alias, NetworkPreferenc
 	m_clientVersion(_clientVersion),
 	m_netPrefs(_n),
 	m_ifAddresses(Network::getInterfaceAddresses()),
-	m_ioService(2),
+	m_ioService(max(_n.ioThreads, 1u)),
 	m_tcp4Acceptor(m_ioService),
 	m_alias(_alias),
 	m_lastPing(chrono::steady_clock::time_point::min())
@@ -186,6 +189,10 @@ void Host::doneWorking()
 	for (auto const& h: m_capabilities)
 		h.second->onStopping();
 
+	// finish the request handlers already running; the queued ones are dropped
+	if (m_handlers)
+		m_handlers->stop();
+
 	// disconnect pending handshake, before peers, as a handshake may create a peer
 	for (unsigned n = 0;; n = 0)
 	{
@@ -226,8 +233,22 @@ void Host::doneWorking()
 	m_ioService.reset();
 
 	// finally, clear out peers (in case they're lingering)
-	RecursiveGuard l(x_sessions);
-	m_sessions.clear();
+	DEV_RECURSIVE_GUARDED(x_sessions)
+		m_sessions.clear();
+
+	m_handlers.reset();
+
+	if (m_peerStore)
+	{
+		vector<shared_ptr<Peer>> peers;
+		auto now = chrono::system_clock::now();
+		DEV_RECURSIVE_GUARDED(x_sessions)
+			for (auto const& p: m_peers)
+				if (p.second->m_sessions || p.second->peerType == PeerType::Required || now - p.second->m_lastAttempted < c_peerStoreForget)
+					peers.push_back(p.second);
+		m_peerStore->rewrite(peers);
+		m_peerStore.reset();
+	}
 }
 
 void Host::startPeerSession(Public const& _id, RLP const& _rlp, unique_ptr<RLPXFrameCoder>&& _io, std::shared_ptr<RLPXSocket> const& _s)
@@ -276,11 +297,12 @@ void Host::startPeerSession(Public const& _id, RLP const& _rlp, unique_ptr<RLPXF
 
 	for (auto cap: caps)
 		capslog << "(" << cap.first << "," << dec << cap.second << ")";
+	p->m_caps = set<CapDesc>(caps.begin(), caps.end());
 
 	clog(NetMessageSummary) << "Hello: " << clientVersion << "V[" << protocolVersion << "]" << _id << showbase << capslog.str() << dec << listenPort;
 	
 	// create session so disconnects are managed
-	shared_ptr<SessionFace> ps = make_shared<Session>(this, move(_io), _s, p, PeerSessionInfo({_id, clientVersion, p->endpoint.address.to_string(), listenPort, chrono::steady_clock::duration(), _rlp[2].toSet<CapDesc>(), 0, map<string, string>(), protocolVersion}));
+	shared_ptr<SessionFace> ps = make_shared<Session>(this, move(_io), _s, p, PeerSessionInfo({_id, clientVersion, p->endpoint.address.to_string(), listenPort, chrono::steady_clock::duration(), _rlp[2].toSet<CapDesc>(), 0, map<string, string>(), protocolVersion, SessionTraffic()}));
 	if (protocolVersion < dev::p2p::c_protocolVersion - 1)
 	{
 		ps->disconnect(IncompatibleProtocol);
@@ -604,6 +626,9 @@ void Host::connect(std::shared_ptr<Peer> const& _p)
 			clog(NetConnect) << "Connection refused to node" << _p->id << "@" << ep << "(" << ec.message() << ")";
 			// Manually set error (session not present)
 			_p->m_lastDisconnect = TCPError;
+			_p->m_failures++;
+			if (m_peerStore)
+				m_peerStore->save(*_p);
 		}
 		else
 		{
@@ -632,10 +657,75 @@ PeerSessionInfos Host::peerSessionInfo() const
 	for (auto& i: m_sessions)
 		if (auto j = i.second.lock())
 			if (j->isConnected())
+			{
 				ret.push_back(j->info());
+				ret.back().traffic = j->traffic();
+			}
 	return ret;
 }
 
+SessionTraffic Host::traffic() const
+{
+	SessionTraffic ret;
+	DEV_GUARDED(m_endedTraffic->x)
+		ret = m_endedTraffic->traffic;
+	RecursiveGuard l(x_sessions);
+	for (auto& i: m_sessions)
+		if (auto j = i.second.lock())
+			ret += j->traffic();
+	return ret;
+}
+
+string Host::metrics() const
+{
+	PeerSessionInfos peers = peerSessionInfo();
+	SessionTraffic total = traffic();
+	ostringstream out;
+	auto family = [&](char const* _name, char const* _type, char const* _help)
+	{
+		out << "# HELP " << _name << " " << _help << "\n# TYPE " << _name << " " << _type << "\n";
+	};
+	auto seconds = [](uint64_t _microseconds) { return _microseconds / 1000000.0; };
+
+	family("p2p_peers", "gauge", "Connected peers.");
+	out << "p2p_peers " << peers.size() << "\n";
+
+	family("p2p_bytes_total", "counter", "Bytes received and sent, framing and encryption included, by capability and packet type.");
+	for (auto const& p: total.packets)
+		out << "p2p_bytes_total{direction=\"in\",capability=\"" << p.first.first << "\",packet=\"" << p.first.second << "\"} " << p.second.ingressBytes << "\n"
+			<< "p2p_bytes_total{direction=\"out\",capability=\"" << p.first.first << "\",packet=\"" << p.first.second << "\"} " << p.second.egressBytes << "\n";
+	family("p2p_packets_total", "counter", "Packets received and sent, by capability and packet type.");
+	for (auto const& p: total.packets)
+		out << "p2p_packets_total{direction=\"in\",capability=\"" << p.first.first << "\",packet=\"" << p.first.second << "\"} " << p.second.ingressPackets << "\n"
+			<< "p2p_packets_total{direction=\"out\",capability=\"" << p.first.first << "\",packet=\"" << p.first.second << "\"} " << p.second.egressPackets << "\n";
+	family("p2p_frame_coder_seconds_total", "counter", "Time spent encrypting, decrypting and authenticating frames.");
+	out << "p2p_frame_coder_seconds_total " << seconds(total.frameCoderMicroseconds) << "\n";
+	family("p2p_throttled_seconds_total", "counter", "Time writes were held back by egress limits, summed over peers.");
+	out << "p2p_throttled_seconds_total " << seconds(total.throttledMicroseconds) << "\n";
+
+	family("p2p_peer_bytes_total", "counter", "Bytes received from and sent to each peer.");
+	for (auto const& p: peers)
+		out << "p2p_peer_bytes_total{peer=\"" << p.id.hex() << "\",direction=\"in\"} " << p.traffic.total.ingressBytes << "\n"
+			<< "p2p_peer_bytes_total{peer=\"" << p.id.hex() << "\",direction=\"out\"} " << p.traffic.total.egressBytes << "\n";
+	family("p2p_peer_packets_total", "counter", "Packets received from and sent to each peer.");
+	for (auto const& p: peers)
+		out << "p2p_peer_packets_total{peer=\"" << p.id.hex() << "\",direction=\"in\"} " << p.traffic.total.ingressPackets << "\n"
+			<< "p2p_peer_packets_total{peer=\"" << p.id.hex() << "\",direction=\"out\"} " << p.traffic.total.egressPackets << "\n";
+	family("p2p_peer_frame_coder_seconds_total", "counter", "Time spent on each peer's frames.");
+	for (auto const& p: peers)
+		out << "p2p_peer_frame_coder_seconds_total{peer=\"" << p.id.hex() << "\"} " << seconds(p.traffic.frameCoderMicroseconds) << "\n";
+	family("p2p_peer_throttled_seconds_total", "counter", "Time writes to each peer were held back by egress limits.");
+	for (auto const& p: peers)
+		out << "p2p_peer_throttled_seconds_total{peer=\"" << p.id.hex() << "\"} " << seconds(p.traffic.throttledMicroseconds) << "\n";
+	family("p2p_peer_write_queue_packets", "gauge", "Packets waiting to be written to each peer.");
+	for (auto const& p: peers)
+		out << "p2p_peer_write_queue_packets{peer=\"" << p.id.hex() << "\"} " << p.traffic.writeQueue << "\n";
+	family("p2p_peer_write_queue_bytes", "gauge", "Bytes waiting to be written to each peer.");
+	for (auto const& p: peers)
+		out << "p2p_peer_write_queue_bytes{peer=\"" << p.id.hex() << "\"} " << p.traffic.writeQueueBytes << "\n";
+	return out.str();
+}
+
 size_t Host::peerCount() const
 {
 	unsigned retCount = 0;
@@ -698,6 +788,8 @@ void Host::run(boost::system::error_code const&)
 		}
 	}
 
+	// Most worthwhile first, as going by their history.
+	toConnect.sort([](shared_ptr<Peer> const& _a, shared_ptr<Peer> const& _b) { return _a->quality() > _b->quality(); });
 	for (auto p: toConnect)
 		if (p->peerType == PeerType::Required && reqConn++ < m_idealPeerCount)
 			connect(p);
@@ -733,6 +825,10 @@ void Host::startedWorking()
 		m_run = true;
 	}
 
+	if (m_netPrefs.handlerThreads)
+		m_handlers.reset(new HandlerPool(m_netPrefs.handlerThreads));
+	m_egressLimiter.setRate(m_netPrefs.egressLimit);
+
 	// start capability threads (ready for incoming connections)
 	for (auto const& h: m_capabilities)
 		h.second->onStarting();
@@ -757,6 +853,7 @@ void Host::startedWorking()
 	nodeTable->setEventHandler(new HostNodeTableHandler(*this));
 	m_nodeTable = nodeTable;
 	restoreNetwork(&m_restoreNetwork);
+	restorePeerStore();
 
 	clog(NetP2PNote) << "p2p.started id:" << id();
 
@@ -764,6 +861,24 @@ void Host::startedWorking()
 }
 
 void Host::doWork()
+{
+	if (!m_run)
+		return;
+
+	// Handlers of one connection are serialised by its socket's strand, so they may run on any of these.
+	vector<thread> ioThreads;
+	for (unsigned i = 1; i < m_netPrefs.ioThreads; ++i)
+		ioThreads.emplace_back([=]()
+		{
+			setThreadName("p2p." + toString(i));
+			runIoService();
+		});
+	runIoService();
+	for (auto& t: ioThreads)
+		t.join();
+}
+
+void Host::runIoService()
 {
 	try
 	{
@@ -790,7 +905,12 @@ void Host::keepAlivePeers()
 			++it;
 		}
 		else
+		{
+			// The session has ended; its peer's history is final until the next one.
+			if (m_peerStore && m_peers.count(it->first))
+				m_peerStore->save(*m_peers[it->first]);
 			it = m_sessions.erase(it);
+		}
 
 	m_lastPing = chrono::steady_clock::now();
 }
@@ -941,6 +1061,65 @@ void Host::restoreNetwork(bytesConstRef _b)
 	}
 }
 
+void Host::restorePeerStore()
+{
+	if (m_netPrefs.peerStore.empty() || m_dropPeers)
+		return;
+	try
+	{
+		m_peerStore.reset(new PeerStore(m_netPrefs.peerStore));
+	}
+	catch (std::exception const& _e)
+	{
+		clog(NetWarn) << "Peer store" << m_netPrefs.peerStore << "unavailable:" << _e.what();
+		return;
+	}
+
+	vector<shared_ptr<Peer>> dial;
+	DEV_RECURSIVE_GUARDED(x_sessions)
+		for (auto const& stored: m_peerStore->peers())
+		{
+			if (stored->id == id() || (!stored->endpoint.isAllowed() && stored->peerType == PeerType::Optional))
+				continue;
+			shared_ptr<Peer> p;
+			if (m_peers.count(stored->id))
+			{
+				// Already restored from the saved network, which lacks the session history.
+				p = m_peers[stored->id];
+				p->m_latency = stored->m_latency;
+				p->m_uptime = stored->m_uptime;
+				p->m_servedBytes = stored->m_servedBytes;
+				p->m_sessions = stored->m_sessions;
+				p->m_failures = stored->m_failures;
+				p->m_caps = stored->m_caps;
+			}
+			else
+			{
+				p = stored;
+				m_peers[p->id] = p;
+				if (p->peerType == PeerType::Required)
+					requirePeer(p->id, p->endpoint);
+				else
+					m_nodeTable->addNode(*p, NodeTable::NodeRelation::Known);
+			}
+
+			// Worth dialling straight away if it has been useful and may be again.
+			bool sharesCaps = any_of(p->m_caps.begin(), p->m_caps.end(), [&](CapDesc const& _c) { return haveCapability(_c); });
+			if (p->peerType == PeerType::Optional && p->m_sessions && sharesCaps && p->m_lastDisconnect != BadProtocol && p->m_lastDisconnect != UselessPeer)
+				dial.push_back(p);
+		}
+
+	if (m_netPrefs.pin)
+		return;
+	sort(dial.begin(), dial.end(), [](shared_ptr<Peer> const& _a, shared_ptr<Peer> const& _b) { return _a->quality() > _b->quality(); });
+	if (dial.size() > m_idealPeerCount)
+		dial.resize(m_idealPeerCount);
+	clog(NetP2PNote) << "Dialling" << dial.size() << "of the best peers from the peer store";
+	// Connections are made asynchronously, so these are all attempted at once.
+	for (auto const& p: dial)
+		connect(p);
+}
+
 KeyPair Host::networkAlias(bytesConstRef _b)
 {
 	RLP r(_b);
@@ -38,8 +38,11 @@
 #include "HostCapability.h"
 #include "Network.h"
 #include "Peer.h"
+#include "PeerStore.h"
 #include "RLPXSocket.h"
+#include "HandlerPool.h"
 #include "RLPXFrameCoder.h"
+#include "RateLimiter.h"
 #include "Common.h"
 namespace ba = boost::asio;
 namespace bi = ba::ip;
@@ -237,6 +240,19 @@ public:
 	/// Get the public endpoint information.
 	std::string enode() const { return "enode://" + id().hex() + "@" + (networkPreferences().publicIPAddress.empty() ? m_tcpPublic.address().to_string() : networkPreferences().publicIPAddress) + ":" + toString(m_tcpPublic.port()); }
 
+	/// @returns the pool running capabilities' request handlers, or null if they run on the network threads.
+	/// Only valid while the network is running.
+	HandlerPool* handlerPool() const { return m_handlers.get(); }
+
+	/// @returns the limit on bytes per second written to all peers together.
+	RateLimiter& egressLimiter() { return m_egressLimiter; }
+
+	/// @returns the traffic of all sessions, ended ones included.
+	SessionTraffic traffic() const;
+
+	/// @returns the traffic counters of the host and each peer, in Prometheus' text format.
+	std::string metrics() const;
+
 	/// Get the node information.
 	p2p::NodeInfo nodeInfo() const { return NodeInfo(id(), (networkPreferences().publicIPAddress.empty() ? m_tcpPublic.address().to_string() : networkPreferences().publicIPAddress), m_tcpPublic.port(), m_clientVersion); }
 
@@ -246,6 +262,9 @@ protected:
 	/// Deserialise the data and populate the set of known peers.
 	void restoreNetwork(bytesConstRef _b);
 
+	/// Opens the peer store, adds the peers in it and dials the best of them at once.
+	void restorePeerStore();
+
 private:
 	enum PeerSlotType { Egress, Ingress };
 	
@@ -278,6 +297,9 @@ private:
 	/// Run network. Not thread-safe; to be called only by worker.
 	virtual void doWork();
 
+	/// Runs network handlers on the calling thread until the network stops.
+	void runIoService();
+
 	/// Shutdown network. Not thread-safe; to be called only by worker.
 	virtual void doneWorking();
 
@@ -298,7 +320,7 @@ private:
 
 	int m_listenPort = -1;												///< What port are we listening on. -1 means binding failed or acceptor hasn't been initialized.
 
-	ba::io_service m_ioService;											///< IOService for network stuff.
+	ba::io_service m_ioService;											///< IOService for network stuff. Run by the worker and m_netPrefs.ioThreads - 1 further threads.
 	bi::tcp::acceptor m_tcp4Acceptor;										///< Listening acceptor.
 
 	std::unique_ptr<boost::asio::deadline_timer> m_timer;					///< Timer which, when network is running, calls scheduler() every c_timerInterval ms.
@@ -340,6 +362,11 @@ private:
 	bool m_dropPeers = false;
 
 	ReputationManager m_repMan;
+
+	std::unique_ptr<HandlerPool> m_handlers;							///< Runs capabilities' request handlers while the network is running.
+	RateLimiter m_egressLimiter;										///< Bytes per second written to all peers together.
+	std::shared_ptr<EndedSessionsTraffic> m_endedTraffic = std::make_shared<EndedSessionsTraffic>();	///< Added to by each session as it ends.
+	std::unique_ptr<PeerStore> m_peerStore;								///< Peers' connection history while the network is running, if kept.
 };
 
 }
@@ -34,8 +34,10 @@ std::vector<std::pair<std::shared_ptr<SessionFace>, std::shared_ptr<Peer>>> Host
 
 std::vector<std::pair<std::shared_ptr<SessionFace>, std::shared_ptr<Peer>>> HostCapabilityFace::peerSessions(u256 const& _version) const
 {
-	RecursiveGuard l(m_host->x_sessions);
 	std::vector<std::pair<std::shared_ptr<SessionFace>, std::shared_ptr<Peer>>> ret;
+	if (!m_host)
+		return ret;	// Not registered with a host (yet).
+	RecursiveGuard l(m_host->x_sessions);
 	for (auto const& i: m_host->m_sessions)
 		if (std::shared_ptr<SessionFace> s = i.second.lock())
 			if (s->capabilities().count(std::make_pair(name(), _version)))
@@ -62,6 +62,11 @@ struct NetworkPreferences
 	bool traverseNAT = true;
 	bool discovery = true;		// Discovery is activated with network.
 	bool pin = false;			// Only accept or connect to trusted peers.
+	unsigned ioThreads = 2;		// Threads handling sockets and timers; each connection is still handled in order.
+	unsigned handlerThreads = 2;	// Threads serving capabilities' requests, e.g. for blocks or state; 0 serves them on the network threads.
+	std::string peerStore;		// File keeping peers' connection history across restarts; none if empty.
+	size_t egressLimit = 0;		// Bytes per second sent to all peers together; 0 for no limit.
+	size_t peerEgressLimit = 0;	// Bytes per second sent to each peer; 0 for no limit.
 };
 
 /**
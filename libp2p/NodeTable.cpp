@@ -38,13 +38,18 @@ const char* NodeTableAllDetail::name() { return "=P="; }
 const char* NodeTableEgress::name() { return ">>P"; }
 const char* NodeTableIngress::name() { return "<<P"; }
 
-NodeEntry::NodeEntry(NodeID const& _src, Public const& _pubk, NodeIPEndpoint const& _gw): Node(_pubk, _gw), distance(NodeTable::distance(_src, _pubk)) {}
+NodeEntry::NodeEntry(NodeID const& _src, Public const& _pubk, NodeIPEndpoint const& _gw): NodeEntry(sha3(_src), _pubk, _gw) {}
+
+NodeEntry::NodeEntry(h256 const& _srcHash, Public const& _pubk, NodeIPEndpoint const& _gw): Node(_pubk, _gw), hash(sha3(_pubk)), distance(NodeTable::distance(_srcHash, hash)) {}
 
 NodeTable::NodeTable(ba::io_service& _io, KeyPair const& _alias, NodeIPEndpoint const& _endpoint, bool _enabled):
 	m_node(Node(_alias.pub(), _endpoint)),
 	m_secret(_alias.secret()),
+	m_nodeHash(sha3(m_node.id)),
 	m_socket(make_shared<NodeSocket>(_io, *reinterpret_cast<UDPSocketEvents*>(this), (bi::udp::endpoint)m_node.endpoint)),
 	m_socketPointer(m_socket.get()),
+	m_verifying(0),
+	m_strand(_io),
 	m_timers(_io)
 {
 	for (unsigned i = 0; i < s_bins; i++)
@@ -53,6 +58,10 @@ NodeTable::NodeTable(ba::io_service& _io, KeyPair const& _alias, NodeIPEndpoint
 	if (!_enabled)
 		return;
 	
+	m_verifier.reset(new HandlerPool(s_verifierThreads));
+	for (unsigned i = 0; i < s_verifierLanes; ++i)
+		m_verifierLanes.push_back(m_verifier->newLane());
+
 	try
 	{
 		m_socketPointer->connect();
@@ -68,9 +77,64 @@ NodeTable::NodeTable(ba::io_service& _io, KeyPair const& _alias, NodeIPEndpoint
 NodeTable::~NodeTable()
 {
 	m_socketPointer->disconnect();
+	if (m_verifier)
+		m_verifier->stop();
 	m_timers.stop();
 }
 
+unsigned NodeTable::distance(h256 const& _a, h256 const& _b)
+{
+	for (unsigned i = 0; i < h256::size; ++i)
+		if (byte d = _a[i] ^ _b[i])
+		{
+			unsigned ret = (h256::size - 1 - i) * 8;
+			while (d >>= 1)
+				++ret;
+			return ret;
+		}
+	return 0;
+}
+
+bool NodeTable::NodeBucket::remove(NodeEntry const& _n)
+{
+	for (unsigned i = 0; i < size; ++i)
+		if (hashes[i] == _n.hash)
+		{
+			for (--size; i < size; ++i)
+			{
+				hashes[i] = hashes[i + 1];
+				nodes[i] = move(nodes[i + 1]);
+			}
+			nodes[size].reset();
+			return true;
+		}
+	return false;
+}
+
+void NodeTable::NodeBucket::pushBack(shared_ptr<NodeEntry> const& _n)
+{
+	hashes[size] = _n->hash;
+	nodes[size] = _n;
+	++size;
+}
+
+void NodeTable::NodeBucket::popFront()
+{
+	for (unsigned i = 1; i < size; ++i)
+	{
+		hashes[i - 1] = hashes[i];
+		nodes[i - 1] = move(nodes[i]);
+	}
+	nodes[--size].reset();
+}
+
+void NodeTable::NodeBucket::clear()
+{
+	for (unsigned i = 0; i < size; ++i)
+		nodes[i].reset();
+	size = 0;
+}
+
 void NodeTable::processEvents()
 {
 	if (m_nodeEventHandler)
@@ -81,7 +145,7 @@ shared_ptr<NodeEntry> NodeTable::addNode(Node const& _node, NodeRelation _relati
 {
 	if (_relation == Known)
 	{
-		auto ret = make_shared<NodeEntry>(m_node.id, _node.id, _node.endpoint);
+		auto ret = make_shared<NodeEntry>(m_nodeHash, _node.id, _node.endpoint);
 		ret->pending = false;
 		DEV_GUARDED(x_nodes)
 			m_nodes[_node.id] = ret;
@@ -107,7 +171,7 @@ shared_ptr<NodeEntry> NodeTable::addNode(Node const& _node, NodeRelation _relati
 		if (m_nodes.count(_node.id))
 			return m_nodes[_node.id];
 	
-	auto ret = make_shared<NodeEntry>(m_node.id, _node.id, _node.endpoint);
+	auto ret = make_shared<NodeEntry>(m_nodeHash, _node.id, _node.endpoint);
 	DEV_GUARDED(x_nodes)
 		m_nodes[_node.id] = ret;
 	clog(NodeTableConnect) << "addNode pending for" << _node.endpoint;
@@ -129,8 +193,8 @@ list<NodeEntry> NodeTable::snapshot() const
 	list<NodeEntry> ret;
 	DEV_GUARDED(x_state)
 		for (auto const& s: m_state)
-			for (auto const& np: s.nodes)
-				if (auto n = np.lock())
+			for (unsigned i = 0; i < s.size; ++i)
+				if (auto n = s.nodes[i].lock())
 					ret.push_back(*n);
 	return ret;
 }
@@ -196,7 +260,7 @@ void NodeTable::doDiscover(NodeID _node, unsigned _round, shared_ptr<set<shared_
 		tried.pop_front();
 	}
 
-	m_timers.schedule(c_reqTimeout.count() * 2, [this, _node, _round, _tried](boost::system::error_code const& _ec)
+	m_timers.schedule(c_reqTimeout.count() * 2, m_strand.wrap([this, _node, _round, _tried](boost::system::error_code const& _ec)
 	{
 		if (_ec)
 			clog(NodeTableMessageDetail) << "Discovery timer was probably cancelled: " << _ec.value() << _ec.message();
@@ -211,81 +275,50 @@ void NodeTable::doDiscover(NodeID _node, unsigned _round, shared_ptr<set<shared_
 		// and therefore, in case of deallocation m_timers object no longer exists.
 
 		doDiscover(_node, _round + 1, _tried);
-	});
+	}));
 }
 
 vector<shared_ptr<NodeEntry>> NodeTable::nearestNodeEntries(NodeID _target)
 {
-	// send s_alpha FindNode packets to nodes we know, closest to target
-	static unsigned lastBin = s_bins - 1;
-	unsigned head = distance(m_node.id, _target);
-	unsigned tail = head == 0 ? lastBin : (head - 1) % s_bins;
-	
-	map<unsigned, list<shared_ptr<NodeEntry>>> found;
+	// Nodes in the target's bucket are nearest to it, then those in all buckets closer to us and then
+	// each further bucket in turn. So whole groups are taken in that order until s_bucketSize are found,
+	// keeping the nearest ones seen so far sorted by their xor with the target.
+	h256 const target = sha3(_target);
+	unsigned const head = distance(m_nodeHash, target);
+	array<pair<h256, shared_ptr<NodeEntry>>, s_bucketSize> nearest;
 	unsigned count = 0;
-	
-	// if d is 0, then we roll look forward, if last, we reverse, else, spread from d
-	if (head > 1 && tail != lastBin)
-		while (head != tail && head < s_bins && count < s_bucketSize)
-		{
-			Guard l(x_state);
-			for (auto const& n: m_state[head].nodes)
-				if (auto p = n.lock())
-				{
-					if (count < s_bucketSize)
-						found[distance(_target, p->id)].push_back(p);
-					else
-						break;
-				}
-			
-			if (count < s_bucketSize && tail)
-				for (auto const& n: m_state[tail].nodes)
-					if (auto p = n.lock())
-					{
-						if (count < s_bucketSize)
-							found[distance(_target, p->id)].push_back(p);
-						else
-							break;
-					}
-
-			head++;
-			if (tail)
-				tail--;
-		}
-	else if (head < 2)
-		while (head < s_bins && count < s_bucketSize)
-		{
-			Guard l(x_state);
-			for (auto const& n: m_state[head].nodes)
-				if (auto p = n.lock())
-				{
-					if (count < s_bucketSize)
-						found[distance(_target, p->id)].push_back(p);
-					else
-						break;
-				}
-			head++;
-		}
-	else
-		while (tail > 0 && count < s_bucketSize)
+	auto consider = [&](NodeBucket const& _s)
+	{
+		for (unsigned i = 0; i < _s.size; ++i)
 		{
-			Guard l(x_state);
-			for (auto const& n: m_state[tail].nodes)
-				if (auto p = n.lock())
-				{
-					if (count < s_bucketSize)
-						found[distance(_target, p->id)].push_back(p);
-					else
-						break;
-				}
-			tail--;
+			h256 const d = _s.hashes[i] ^ target;
+			if (count == s_bucketSize && !(d < nearest[count - 1].first))
+				continue;
+			auto n = _s.nodes[i].lock();
+			if (!n || !n->endpoint || !n->endpoint.isAllowed())
+				continue;
+			unsigned j = count < s_bucketSize ? count++ : count - 1;
+			for (; j > 0 && d < nearest[j - 1].first; --j)
+				nearest[j] = move(nearest[j - 1]);
+			nearest[j] = make_pair(d, move(n));
 		}
-	
+	};
+
+	DEV_GUARDED(x_state)
+	{
+		if (head)
+			consider(m_state[head - 1]);
+		if (count < s_bucketSize)
+			for (unsigned i = 1; i < head; ++i)
+				consider(m_state[i - 1]);
+		for (unsigned i = head + 1; i <= s_bins && count < s_bucketSize; ++i)
+			consider(m_state[i - 1]);
+	}
+
 	vector<shared_ptr<NodeEntry>> ret;
-	for (auto& nodes: found)
-		for (auto const& n: nodes.second)
-			if (ret.size() < s_bucketSize && !!n->endpoint && n->endpoint.isAllowed())
-				ret.push_back(n);
+	ret.reserve(count);
+	for (unsigned i = 0; i < count; ++i)
+		ret.push_back(move(nearest[i].second));
 	return ret;
 }
 
@@ -327,51 +360,56 @@ void NodeTable::noteActiveNode(Public const& _pubk, bi::udp::endpoint const& _en
 	if (_pubk == m_node.address() || !NodeIPEndpoint(_endpoint.address(), _endpoint.port(), _endpoint.port()).isAllowed())
 		return;
 
-	shared_ptr<NodeEntry> node = nodeEntry(_pubk);
-	if (!!node && !node->pending)
+	shared_ptr<NodeEntry> node;
+	DEV_GUARDED(x_nodes)
 	{
-		clog(NodeTableConnect) << "Noting active node:" << _pubk << _endpoint.address().to_string() << ":" << _endpoint.port();
-		node->endpoint.address = _endpoint.address();
-		node->endpoint.udpPort = _endpoint.port();
+		auto it = m_nodes.find(_pubk);
+		if (it == m_nodes.end() || it->second->pending)
+			return;
+		node = it->second;
+		if (node->endpoint.address != _endpoint.address() || node->endpoint.udpPort != _endpoint.port())
+		{
+			// Entries are read without locks once handed out, so a node that moved gets a new one.
+			node = make_shared<NodeEntry>(*node);
+			node->endpoint.address = _endpoint.address();
+			node->endpoint.udpPort = _endpoint.port();
+			it->second = node;
+		}
+	}
+
+	clog(NodeTableConnect) << "Noting active node:" << _pubk << _endpoint.address().to_string() << ":" << _endpoint.port();
+	
+	shared_ptr<NodeEntry> contested;
+	{
+		Guard l(x_state);
+		NodeBucket& s = bucket_UNSAFE(node.get());
+		bool removed = s.remove(*node);
 		
-		shared_ptr<NodeEntry> contested;
+		if (s.size >= s_bucketSize)
 		{
-			Guard l(x_state);
-			NodeBucket& s = bucket_UNSAFE(node.get());
-			bool removed = false;
-			s.nodes.remove_if([&node, &removed](weak_ptr<NodeEntry> const& n)
-			{
-				if (n.lock() == node)
-					removed = true;
-				return removed;
-			});
+			if (removed)
+				clog(NodeTableWarn) << "DANGER: Bucket overflow when swapping node position.";
 			
-			if (s.nodes.size() >= s_bucketSize)
-			{
-				if (removed)
-					clog(NodeTableWarn) << "DANGER: Bucket overflow when swapping node position.";
-				
-				// It's only contested iff nodeentry exists
-				contested = s.nodes.front().lock();
-				if (!contested)
-				{
-					s.nodes.pop_front();
-					s.nodes.push_back(node);
-					if (!removed && m_nodeEventHandler)
-						m_nodeEventHandler->appendEvent(node->id, NodeEntryAdded);
-				}
-			}
-			else
+			// It's only contested iff nodeentry exists
+			contested = s.nodes[0].lock();
+			if (!contested)
 			{
-				s.nodes.push_back(node);
+				s.popFront();
+				s.pushBack(node);
 				if (!removed && m_nodeEventHandler)
 					m_nodeEventHandler->appendEvent(node->id, NodeEntryAdded);
 			}
 		}
-		
-		if (contested)
-			evict(contested, node);
+		else
+		{
+			s.pushBack(node);
+			if (!removed && m_nodeEventHandler)
+				m_nodeEventHandler->appendEvent(node->id, NodeEntryAdded);
+		}
 	}
+	
+	if (contested)
+		evict(contested, node);
 }
 
 void NodeTable::dropNode(shared_ptr<NodeEntry> _n)
@@ -380,7 +418,7 @@ void NodeTable::dropNode(shared_ptr<NodeEntry> _n)
 	{
 		Guard l(x_state);
 		NodeBucket& s = bucket_UNSAFE(_n.get());
-		s.nodes.remove_if([&_n](weak_ptr<NodeEntry> n) { return n.lock() == _n; });
+		s.remove(*_n);
 	}
 	
 	// notify host
@@ -396,21 +434,73 @@ NodeTable::NodeBucket& NodeTable::bucket_UNSAFE(NodeEntry const* _n)
 
 void NodeTable::onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytesConstRef _packet)
 {
-	try {
-		unique_ptr<DiscoveryDatagram> packet = DiscoveryDatagram::interpretUDP(_from, _packet);
-		if (!packet)
+	if (!m_verifier)
+	{
+		if (shared_ptr<DiscoveryDatagram> packet = interpretPacket(_from, _packet))
+			m_strand.dispatch([=]() { handlePacket(_from, *packet); });
+		return;
+	}
+	if (m_verifying >= s_maxVerifying)
+	{
+		clog(NodeTableWarn) << "Dropping packet from " << _from.address().to_string() << ":" << _from.port() << " (too many waiting to be handled)";
+		return;
+	}
+	++m_verifying;
+	bi::address const& a = _from.address();
+	unsigned const endpoint = (a.is_v4() ? a.to_v4().to_ulong() : a.to_v6().to_bytes()[15]) ^ _from.port();
+	bytes packet = _packet.toBytes();
+	weak_ptr<NodeTable> self(shared_from_this());
+	m_verifier->post(m_verifierLanes[endpoint % s_verifierLanes], [this, self, _from, packet]()
+	{
+		// Only the signature is recovered here; acting on the packet touches entries that the timers' tasks use too.
+		shared_ptr<DiscoveryDatagram> decoded(interpretPacket(_from, &packet));
+		if (!decoded)
+		{
+			--m_verifying;
 			return;
-		if (packet->isExpired())
+		}
+		m_strand.post([this, self, _from, decoded]()
+		{
+			if (auto table = self.lock())
+			{
+				--m_verifying;
+				handlePacket(_from, *decoded);
+			}
+		});
+	});
+}
+
+unique_ptr<DiscoveryDatagram> NodeTable::interpretPacket(bi::udp::endpoint const& _from, bytesConstRef _packet)
+{
+	try
+	{
+		unique_ptr<DiscoveryDatagram> packet = DiscoveryDatagram::interpretUDP(_from, _packet);
+		if (packet && packet->isExpired())
 		{
 			clog(NodeTableWarn) << "Invalid packet (timestamp in the past) from " << _from.address().to_string() << ":" << _from.port();
-			return;
+			return unique_ptr<DiscoveryDatagram>();
 		}
+		return packet;
+	}
+	catch (std::exception const& _e)
+	{
+		clog(NodeTableWarn) << "Exception processing message from " << _from.address().to_string() << ":" << _from.port() << ": " << _e.what();
+	}
+	catch (...)
+	{
+		clog(NodeTableWarn) << "Exception processing message from " << _from.address().to_string() << ":" << _from.port();
+	}
+	return unique_ptr<DiscoveryDatagram>();
+}
 
-		switch (packet->packetType())
+void NodeTable::handlePacket(bi::udp::endpoint const& _from, DiscoveryDatagram const& _packet)
+{
+	try {
+		switch (_packet.packetType())
 		{
 			case Pong::type:
 			{
-				auto in = dynamic_cast<Pong const&>(*packet);
+				auto in = dynamic_cast<Pong const&>(_packet);
 				// whenever a pong is received, check if it's in m_evictions
 				bool found = false;
 				EvictionTimeout evictionEntry;
@@ -427,15 +517,21 @@ void NodeTable::onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytes
 				{
 					if (auto n = nodeEntry(evictionEntry.second))
 						dropNode(n);
-					if (auto n = nodeEntry(evictionEntry.first.first))
-						n->pending = false;
+					DEV_GUARDED(x_nodes)
+						if (m_nodes.count(evictionEntry.first.first))
+							m_nodes[evictionEntry.first.first]->pending = false;
 				}
 				else
 				{
 					// if not, check if it's known/pending or a pubk discovery ping
-					if (auto n = nodeEntry(in.sourceid))
-						n->pending = false;
-					else
+					bool known = false;
+					DEV_GUARDED(x_nodes)
+						if (m_nodes.count(in.sourceid))
+						{
+							m_nodes[in.sourceid]->pending = false;
+							known = true;
+						}
+					if (!known)
 					{
 						DEV_GUARDED(x_pubkDiscoverPings)
 						{
@@ -462,7 +558,7 @@ void NodeTable::onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytes
 				
 			case Neighbours::type:
 			{
-				auto in = dynamic_cast<Neighbours const&>(*packet);
+				auto in = dynamic_cast<Neighbours const&>(_packet);
 				bool expected = false;
 				auto now = chrono::steady_clock::now();
 				DEV_GUARDED(x_findNodeTimeout)
@@ -487,7 +583,7 @@ void NodeTable::onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytes
 
 			case FindNode::type:
 			{
-				auto in = dynamic_cast<FindNode const&>(*packet);
+				auto in = dynamic_cast<FindNode const&>(_packet);
 				vector<shared_ptr<NodeEntry>> nearest = nearestNodeEntries(in.target);
 				static unsigned const nlimit = (m_socketPointer->maxDatagramSize - 109) / 90;
 				for (unsigned offset = 0; offset < nearest.size(); offset += nlimit)
@@ -503,7 +599,7 @@ void NodeTable::onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytes
 
 			case PingNode::type:
 			{
-				auto in = dynamic_cast<PingNode const&>(*packet);
+				auto in = dynamic_cast<PingNode const&>(_packet);
 				in.source.address = _from.address();
 				in.source.udpPort = _from.port();
 				addNode(Node(in.sourceid, in.source));
@@ -516,7 +612,7 @@ void NodeTable::onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytes
 			}
 		}
 
-		noteActiveNode(packet->sourceid, _from);
+		noteActiveNode(_packet.sourceid, _from);
 	}
 	catch (std::exception const& _e)
 	{
@@ -530,7 +626,7 @@ void NodeTable::onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytes
 
 void NodeTable::doCheckEvictions()
 {
-	m_timers.schedule(c_evictionCheckInterval.count(), [this](boost::system::error_code const& _ec)
+	m_timers.schedule(c_evictionCheckInterval.count(), m_strand.wrap([this](boost::system::error_code const& _ec)
 	{
 		if (_ec)
 			clog(NodeTableMessageDetail) << "Check Evictions timer was probably cancelled: " << _ec.value() << _ec.message();
@@ -556,12 +652,12 @@ void NodeTable::doCheckEvictions()
 		
 		if (evictionsRemain)
 			doCheckEvictions();
-	});
+	}));
 }
 
 void NodeTable::doDiscovery()
 {
-	m_timers.schedule(c_bucketRefresh.count(), [this](boost::system::error_code const& _ec)
+	m_timers.schedule(c_bucketRefresh.count(), m_strand.wrap([this](boost::system::error_code const& _ec)
 	{
 		if (_ec)
 			clog(NodeTableMessageDetail) << "Discovery timer was probably cancelled: " << _ec.value() << _ec.message();
@@ -574,7 +670,7 @@ void NodeTable::doDiscovery()
 		crypto::Nonce::get().ref().copyTo(randNodeId.ref().cropped(0, h256::size));
 		crypto::Nonce::get().ref().copyTo(randNodeId.ref().cropped(h256::size, h256::size));
 		doDiscover(randNodeId);
-	});
+	}));
 }
 
 unique_ptr<DiscoveryDatagram> DiscoveryDatagram::interpretUDP(bi::udp::endpoint const& _from, bytesConstRef _packet)
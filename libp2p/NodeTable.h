@@ -22,12 +22,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <deque>
 
 #include <boost/integer/static_log2.hpp>
 
 #include <libp2p/UDP.h>
 #include "Common.h"
+#include "HandlerPool.h"
 
 namespace dev
 {
@@ -41,8 +44,10 @@ namespace p2p
 struct NodeEntry: public Node
 {
 	NodeEntry(NodeID const& _src, Public const& _pubk, NodeIPEndpoint const& _gw);
+	NodeEntry(h256 const& _srcHash, Public const& _pubk, NodeIPEndpoint const& _gw);
+	h256 const hash;			///< sha3 of the node id; distances are measured between these.
 	unsigned const distance;	///< Node's distance (xor of _src as integer).
-	bool pending = true;		///< Node will be ignored until Pong is received
+	bool pending = true;		///< Node will be ignored until Pong is received. LOCK x_nodes if the entry is in m_nodes.
 };
 
 enum NodeTableEventType
@@ -89,6 +94,7 @@ protected:
 };
 
 class NodeTable;
+struct DiscoveryDatagram;
 inline std::ostream& operator<<(std::ostream& _out, NodeTable const& _nodeTable);
 
 /**
@@ -100,7 +106,10 @@ inline std::ostream& operator<<(std::ostream& _out, NodeTable const& _nodeTable)
  * Host whenever a node is added or removed to/from the table.
  *
  * Thread-safety is ensured by modifying NodeEntry details via
- * shared_ptr replacement instead of mutating values.
+ * shared_ptr replacement instead of mutating values. Received packets
+ * are hashed, their signatures recovered and then handled on a few
+ * threads of their own rather than on the network thread; packets from
+ * one endpoint are handled in order.
  *
  * NodeTable accepts a port for UDP and will listen to the port on all available
  * interfaces.
@@ -138,7 +147,10 @@ public:
 	~NodeTable();
 
 	/// Returns distance based on xor metric two node ids. Used by NodeEntry and NodeTable.
-	static unsigned distance(NodeID const& _a, NodeID const& _b) { u256 d = sha3(_a) ^ sha3(_b); unsigned ret; for (ret = 0; d >>= 1; ++ret) {}; return ret; }
+	static unsigned distance(NodeID const& _a, NodeID const& _b) { return distance(sha3(_a), sha3(_b)); }
+
+	/// Returns distance between two hashed node ids, i.e. the index of the highest bit set in their xor.
+	static unsigned distance(h256 const& _a, h256 const& _b);
 
 	/// Set event handler for NodeEntryAdded and NodeEntryDropped events.
 	void setEventHandler(NodeTableEventHandler* _handler) { m_nodeEventHandler.reset(_handler); }
@@ -181,6 +193,9 @@ private:
 
 	static unsigned const s_bucketSize = 16;			///< Denoted by k in [Kademlia]. Number of nodes stored in each bucket.
 	static unsigned const s_alpha = 3;				///< Denoted by \alpha in [Kademlia]. Number of concurrent FindNode requests.
+	static unsigned const s_verifierThreads = 2;		///< Threads checking and handling received packets.
+	static unsigned const s_verifierLanes = 8;		///< Received packets are handled in order per lane; lanes are picked by endpoint.
+	static unsigned const s_maxVerifying = 1024;		///< Received packets waiting to be handled before further ones are dropped.
 
 	/// Intervals
 
@@ -189,10 +204,21 @@ private:
 	std::chrono::milliseconds const c_reqTimeout = std::chrono::milliseconds(300);						///< How long to wait for requests (evict, find iterations).
 	std::chrono::milliseconds const c_bucketRefresh = std::chrono::milliseconds(7200);							///< Refresh interval prevents bucket from becoming stale. [Kademlia]
 
+	/// Nodes at one distance from us, least recently seen first. Kept in place with each node's hash
+	/// alongside, so looking for the nearest nodes scans contiguous memory and only locks the ones it takes.
 	struct NodeBucket
 	{
 		unsigned distance;
-		std::list<std::weak_ptr<NodeEntry>> nodes;
+		unsigned size = 0;
+		std::array<h256, s_bucketSize> hashes;
+		std::array<std::weak_ptr<NodeEntry>, s_bucketSize> nodes;
+
+		/// Removes the entry with the id of @a _n, if any. @returns whether there was one.
+		bool remove(NodeEntry const& _n);
+		/// Appends @a _n; the bucket must not be full.
+		void pushBack(std::shared_ptr<NodeEntry> const& _n);
+		void popFront();
+		void clear();
 	};
 
 	/// Used to ping endpoint.
@@ -211,7 +237,7 @@ private:
 	/// Sends s_alpha concurrent requests to nodes nearest to target, for nodes nearest to target, up to s_maxSteps rounds.
 	void doDiscover(NodeID _target, unsigned _round = 0, std::shared_ptr<std::set<std::shared_ptr<NodeEntry>>> _tried = std::shared_ptr<std::set<std::shared_ptr<NodeEntry>>>());
 
-	/// Returns nodes from node table which are closest to target.
+	/// Returns up to s_bucketSize nodes from node table which are closest to target, nearest first.
 	std::vector<std::shared_ptr<NodeEntry>> nearestNodeEntries(NodeID _target);
 
 	/// Asynchronously drops _leastSeen node if it doesn't reply and adds _new node, otherwise _new node is thrown away.
@@ -230,9 +256,15 @@ private:
 
 	/// General Network Events
 
-	/// Called by m_socket when packet is received.
+	/// Called by m_socket when packet is received. Queues it for interpretPacket() on m_verifier, then for handlePacket() in m_strand.
 	void onReceived(UDPSocketFace*, bi::udp::endpoint const& _from, bytesConstRef _packet);
 
+	/// Checks the hash, signature and timestamp of a received packet. @returns it decoded, or null if it's invalid.
+	static std::unique_ptr<DiscoveryDatagram> interpretPacket(bi::udp::endpoint const& _from, bytesConstRef _packet);
+
+	/// Acts on a decoded packet. Only called in m_strand.
+	void handlePacket(bi::udp::endpoint const& _from, DiscoveryDatagram const& _packet);
+
 	/// Called by m_socket when socket is disconnected.
 	void onDisconnected(UDPSocketFace*) {}
 
@@ -248,6 +280,7 @@ private:
 
 	Node m_node;													///< This node. LOCK x_state if endpoint access or mutation is required. Do not modify id.
 	Secret m_secret;												///< This nodes secret key.
+	h256 const m_nodeHash;											///< sha3 of our id, which distances are measured from.
 
 	mutable Mutex x_nodes;											///< LOCK x_state first if both locks are required. Mutable for thread-safe copy in nodes() const.
 	std::unordered_map<NodeID, std::shared_ptr<NodeEntry>> m_nodes;	///< Known Node Endpoints
@@ -267,6 +300,11 @@ private:
 	std::shared_ptr<NodeSocket> m_socket;							///< Shared pointer for our UDPSocket; ASIO requires shared_ptr.
 	NodeSocket* m_socketPointer;									///< Set to m_socket.get(). Socket is created in constructor and disconnected in destructor to ensure access to pointer is safe.
 
+	std::unique_ptr<HandlerPool> m_verifier;						///< Checks signatures of received packets. Only if discovery is enabled.
+	std::vector<std::shared_ptr<HandlerPool::Lane>> m_verifierLanes;
+	std::atomic<unsigned> m_verifying;								///< Received packets not handled yet.
+	ba::io_service::strand m_strand;								///< Serialises handling of received packets with the timers' tasks.
+
 	DeadlineOps m_timers; ///< this should be the last member - it must be destroyed first
 };
 
@@ -21,6 +21,7 @@
  */
 
 #include "Peer.h"
+#include <cmath>
 using namespace std;
 using namespace dev;
 using namespace dev::p2p;
@@ -60,6 +61,14 @@ unsigned Peer::fallbackSeconds() const
 	}
 }
 	
+double Peer::quality() const
+{
+	double reliability = (m_sessions + 1.0) / (m_sessions + m_failures + 2.0);
+	double usefulness = log2(2.0 + m_uptime / 60.0) + log2(1.0 + m_servedBytes / 1048576.0);
+	double responsiveness = m_latency ? 500.0 / (500.0 + m_latency) : 0.5;
+	return reliability * usefulness * responsiveness;
+}
+
 bool Peer::operator<(Peer const& _p) const
 {
 	if (isOffline() != _p.isOffline())
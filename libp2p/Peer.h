@@ -53,6 +53,7 @@ class Peer: public Node
 {
 	friend class Session;		/// Allows Session to update score and rating.
 	friend class Host;		/// For Host: saveNetwork(), restoreNetwork()
+	friend class PeerStore;	/// Saves and restores the connection history.
 
 	friend class RLPXHandshake;
 
@@ -78,6 +79,22 @@ public:
 	
 	/// Peer session is noted as useful.
 	void noteSessionGood() { m_failedAttempts = 0; }
+
+	/// Last measured round trip, in milliseconds; 0 if never measured.
+	unsigned latency() const { return m_latency; }
+
+	/// Seconds connected to the peer, all sessions together.
+	uint64_t uptime() const { return m_uptime; }
+
+	/// Bytes of packets received from the peer, all sessions together.
+	uint64_t servedBytes() const { return m_servedBytes; }
+
+	/// Capabilities shared with the peer in its last session.
+	std::set<CapDesc> const& caps() const { return m_caps; }
+
+	/// How worthwhile connecting to the peer has been: established sessions which lasted and carried
+	/// data, at a low latency. Peers with the highest are dialled first after a restart.
+	double quality() const;
 	
 protected:
 	/// Returns number of seconds to wait until attempting connection, based on attempted connection history.
@@ -93,6 +110,15 @@ protected:
 	unsigned m_failedAttempts = 0;
 	DisconnectReason m_lastDisconnect = NoDisconnect;	///< Reason for disconnect that happened last.
 
+	/// Session history
+	
+	unsigned m_latency = 0;
+	uint64_t m_uptime = 0;
+	uint64_t m_servedBytes = 0;
+	unsigned m_sessions = 0;							///< Sessions established, all time.
+	unsigned m_failures = 0;							///< Connection attempts refused or timed out, all time.
+	std::set<CapDesc> m_caps;
+
 	/// Used by isOffline() and (todo) for peer to emit session information.
 	std::weak_ptr<Session> m_session;
 };
@@ -0,0 +1,154 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file PeerStore.cpp
+ * @date 2016
+ */
+
+#include "PeerStore.h"
+#include <libdevcore/CommonIO.h>
+#include <libdevcore/Log.h>
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+namespace
+{
+unsigned const c_recordVersion = 1;
+size_t const c_minSuperseded = 256;		///< Superseded records left in the file whatever the number of peers.
+}
+
+PeerStore::PeerStore(string const& _path):
+	m_path(_path)
+{
+	bytes data = contents(m_path);
+	bytesConstRef rest(&data);
+	while (!rest.empty())
+	{
+		bytesConstRef record;
+		try
+		{
+			record = rest.cropped(0, RLP(rest, RLP::ThrowOnFail | RLP::FailIfTooSmall).actualSize());
+		}
+		catch (std::exception const&)
+		{
+			// Most likely the last record, cut short.
+			clog(NetWarn) << "Ignoring the last" << rest.size() << "bytes of the peer store" << m_path;
+			break;
+		}
+		rest = rest.cropped(record.size());
+		try
+		{
+			if (auto p = decode(RLP(record)))
+				m_latest[p->id] = record.toBytes();
+		}
+		catch (std::exception const&)
+		{
+			clog(NetWarn) << "Ignoring a malformed record in the peer store" << m_path;
+		}
+	}
+	Guard l(x_file);
+	compact_UNSAFE();
+}
+
+vector<shared_ptr<Peer>> PeerStore::peers() const
+{
+	vector<shared_ptr<Peer>> ret;
+	Guard l(x_file);
+	for (auto const& i: m_latest)
+		ret.push_back(decode(RLP(i.second)));
+	return ret;
+}
+
+void PeerStore::save(Peer const& _p)
+{
+	if (!_p.id)
+		return;
+	bytes record = encode(_p);
+	Guard l(x_file);
+	m_file.write(reinterpret_cast<char const*>(record.data()), record.size());
+	m_file.flush();
+	m_latest[_p.id] = move(record);
+	if (++m_records > 2 * m_latest.size() + c_minSuperseded)
+		compact_UNSAFE();
+}
+
+void PeerStore::rewrite(vector<shared_ptr<Peer>> const& _peers)
+{
+	Guard l(x_file);
+	m_latest.clear();
+	for (auto const& p: _peers)
+		if (p && p->id)
+			m_latest[p->id] = encode(*p);
+	compact_UNSAFE();
+}
+
+void PeerStore::compact_UNSAFE()
+{
+	m_file.close();
+	bytes all;
+	for (auto const& i: m_latest)
+		all += i.second;
+	try
+	{
+		writeFile(m_path, all, true);
+	}
+	catch (std::exception const& _e)
+	{
+		clog(NetWarn) << "Couldn't rewrite the peer store" << m_path << ":" << _e.what();
+	}
+	m_records = m_latest.size();
+	m_file.open(m_path, ios::binary | ios::app);
+	if (!m_file)
+		clog(NetWarn) << "Couldn't open the peer store" << m_path << "for writing";
+}
+
+bytes PeerStore::encode(Peer const& _p)
+{
+	RLPStream s(16);
+	s << c_recordVersion << _p.id;
+	_p.endpoint.streamRLP(s);
+	s << (_p.peerType == PeerType::Required)
+		<< chrono::duration_cast<chrono::seconds>(_p.m_lastConnected.time_since_epoch()).count()
+		<< chrono::duration_cast<chrono::seconds>(_p.m_lastAttempted.time_since_epoch()).count()
+		<< _p.m_failedAttempts << (unsigned)_p.m_lastDisconnect << _p.m_score << _p.m_rating
+		<< _p.m_latency << u256(_p.m_uptime) << u256(_p.m_servedBytes) << _p.m_sessions << _p.m_failures;
+	s.appendList(_p.m_caps.size());
+	for (auto const& c: _p.m_caps)
+		s.appendList(2) << c.first << c.second;
+	return s.out();
+}
+
+shared_ptr<Peer> PeerStore::decode(RLP const& _r)
+{
+	if (!_r.isList() || _r.itemCount() < 16 || _r[0].toInt<unsigned>() != c_recordVersion)
+		return nullptr;
+	auto p = make_shared<Peer>(Node(_r[1].toHash<NodeID>(RLP::VeryStrict), NodeIPEndpoint(_r[2]), _r[3].toInt<bool>() ? PeerType::Required : PeerType::Optional));
+	p->m_lastConnected = chrono::system_clock::time_point(chrono::seconds(_r[4].toInt<unsigned>()));
+	p->m_lastAttempted = chrono::system_clock::time_point(chrono::seconds(_r[5].toInt<unsigned>()));
+	p->m_failedAttempts = _r[6].toInt<unsigned>();
+	p->m_lastDisconnect = (DisconnectReason)_r[7].toInt<unsigned>();
+	p->m_score = (int)_r[8].toInt<unsigned>();
+	p->m_rating = (int)_r[9].toInt<unsigned>();
+	p->m_latency = _r[10].toInt<unsigned>();
+	p->m_uptime = _r[11].toInt<uint64_t>();
+	p->m_servedBytes = _r[12].toInt<uint64_t>();
+	p->m_sessions = _r[13].toInt<unsigned>();
+	p->m_failures = _r[14].toInt<unsigned>();
+	for (auto const& c: _r[15])
+		p->m_caps.insert(make_pair(c[0].toString(), c[1].toInt<u256>()));
+	return p;
+}
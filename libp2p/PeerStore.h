@@ -0,0 +1,75 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file PeerStore.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <libdevcore/Guards.h>
+#include "Peer.h"
+
+namespace dev
+{
+namespace p2p
+{
+
+/**
+ * @brief Peers' connection history, kept on disk across restarts.
+ *
+ * The file is a sequence of RLP records, one appended whenever a peer's state is saved; the last
+ * record of a peer wins. A record cut short by a crash is ignored. The file is rewritten with just
+ * the latest records when it is opened and once superseded records make up most of it.
+ *
+ * Thread Safety
+ * All methods are thread-safe.
+ */
+class PeerStore
+{
+public:
+	/// Opens the store at @a _path, creating it if it doesn't exist.
+	explicit PeerStore(std::string const& _path);
+
+	/// @returns the latest saved state of each peer in the store.
+	std::vector<std::shared_ptr<Peer>> peers() const;
+
+	/// Appends the current state of @a _p.
+	void save(Peer const& _p);
+
+	/// Rewrites the store with the current state of @a _peers, dropping other peers' records.
+	void rewrite(std::vector<std::shared_ptr<Peer>> const& _peers);
+
+private:
+	static bytes encode(Peer const& _p);
+	static std::shared_ptr<Peer> decode(RLP const& _r);
+
+	/// Writes the latest records to the file. @warning Only call with x_file locked.
+	void compact_UNSAFE();
+
+	std::string const m_path;
+	mutable Mutex x_file;
+	std::unordered_map<NodeID, bytes> m_latest;	///< Latest record of each peer, as in the file.
+	size_t m_records = 0;						///< Records in the file, superseded ones included.
+	std::ofstream m_file;						///< Open for appending.
+};
+
+}
+}
@@ -46,6 +46,17 @@ RLPXFrameInfo::RLPXFrameInfo(bytesConstRef _header):
 	totalLength(header.itemCount() == 3 ? header[2].toInt<uint32_t>() : 0)
 {}
 
+namespace
+{
+
+/// Frames are encrypted and MACed (or MACed and decrypted) this much at a time, so each piece is still in cache for the second step.
+size_t const c_frameChunk = 8192;
+
+/// Header of legacy single-frame packets: an empty protocol-type and sequence-id.
+byte const c_legacyHeader[] = {0xc2, 0x80, 0x80};
+
+}
+
 namespace dev
 {
 namespace p2p
@@ -53,8 +64,20 @@ namespace p2p
 class RLPXFrameCoderImpl
 {
 public:
-	/// Update state of _mac.
-	void updateMAC(CryptoPP::Keccak_256& _mac, bytesConstRef _seed = {});
+	/// Update state of _mac: mac.update(aes(mac.digest) ^ seed), where the seed of a frame is the digest itself.
+	void updateMAC(CryptoPP::Keccak_256& _mac, CryptoPP::AES::Encryption const& _macEnc, bytesConstRef _seed = {});
+
+	/// Writes the first 16 bytes of the digest of @a _mac to @a o_digest.
+	static void digest(CryptoPP::Keccak_256 const& _mac, byte* o_digest);
+
+	/// Encrypts and MACs the header of a frame of @a _length bytes, writing it and the header-mac to the 32 bytes at @a o_header.
+	void writeHeader(bytesConstRef _header, size_t _length, byte* o_header);
+
+	/// Encrypts and MACs the next @a _size bytes of the frame being written; @a o_cipher may be @a _plain.
+	void encryptPayload(byte const* _plain, byte* o_cipher, size_t _size);
+
+	/// Writes the padding of a frame of @a _length bytes and the frame-mac to @a o_tail, which has room for both.
+	void finishPayload(size_t _length, byte* o_tail);
 
 	CryptoPP::SecByteBlock frameEncKey;						///< Key for m_frameEnc
 	CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption frameEnc;	///< Encoder for egress plaintext.
@@ -62,14 +85,12 @@ public:
 	CryptoPP::SecByteBlock frameDecKey;						///< Key for m_frameDec
 	CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption frameDec;	///< Decoder for egress plaintext.
 
-	CryptoPP::SecByteBlock macEncKey;						/// Key for m_macEnd
-	CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption macEnc;	/// One-way coder used by updateMAC for ingress and egress MAC updates.
+	CryptoPP::SecByteBlock macEncKey;						/// Key for egressMacEnc and ingressMacEnc.
+	CryptoPP::AES::Encryption egressMacEnc;					/// Block cipher used by updateMAC for egress MAC updates.
+	CryptoPP::AES::Encryption ingressMacEnc;				/// Block cipher used by updateMAC for ingress MAC updates; separate so either direction needs no lock.
 
 	CryptoPP::Keccak_256 egressMac;		///< State of MAC for egress ciphertext.
 	CryptoPP::Keccak_256 ingressMac;	///< State of MAC for ingress ciphertext.
-
-private:
-	Mutex x_macEnc;  ///< Mutex.
 };
 }
 }
@@ -129,7 +150,8 @@ void RLPXFrameCoder::setup(bool _originated, h512 const& _remoteEphemeral, h256
 	sha3(keyMaterial, outRef); // output mac-secret
 	m_impl->macEncKey.resize(h256::size);
 	memcpy(m_impl->macEncKey.data(), outRef.data(), h256::size);
-	m_impl->macEnc.SetKey(m_impl->macEncKey, h256::size);
+	m_impl->egressMacEnc.SetKey(m_impl->macEncKey, h256::size);
+	m_impl->ingressMacEnc.SetKey(m_impl->macEncKey, h256::size);
 
 	// Initiator egress-mac: sha3(mac-secret^recipient-nonce || auth-sent-init)
 	//           ingress-mac: sha3(mac-secret^initiator-nonce || auth-recvd-ack)
@@ -154,61 +176,67 @@ void RLPXFrameCoder::setup(bool _originated, h512 const& _remoteEphemeral, h256
 
 void RLPXFrameCoder::writeFrame(uint16_t _protocolType, bytesConstRef _payload, bytes& o_bytes)
 {
-	RLPStream header;
-	uint32_t len = (uint32_t)_payload.size();
-	header.appendRaw(bytes({byte((len >> 16) & 0xff), byte((len >> 8) & 0xff), byte(len & 0xff)}));
-	header.appendList(1) << _protocolType;
-	writeFrame(header, _payload, o_bytes);
+	RLPStream header(1);
+	header << _protocolType;
+	writeFrame(&header.out(), _payload, o_bytes);
 }
 
 void RLPXFrameCoder::writeFrame(uint16_t _protocolType, uint16_t _seqId, bytesConstRef _payload, bytes& o_bytes)
 {
-	RLPStream header;
-	uint32_t len = (uint32_t)_payload.size();
-	header.appendRaw(bytes({byte((len >> 16) & 0xff), byte((len >> 8) & 0xff), byte(len & 0xff)}));
-	header.appendList(2) << _protocolType << _seqId;
-	writeFrame(header, _payload, o_bytes);
+	RLPStream header(2);
+	header << _protocolType << _seqId;
+	writeFrame(&header.out(), _payload, o_bytes);
 }
 
 void RLPXFrameCoder::writeFrame(uint16_t _protocolType, uint16_t _seqId, uint32_t _totalSize, bytesConstRef _payload, bytes& o_bytes)
 {
-	RLPStream header;
-	uint32_t len = (uint32_t)_payload.size();
-	header.appendRaw(bytes({byte((len >> 16) & 0xff), byte((len >> 8) & 0xff), byte(len & 0xff)}));
-	header.appendList(3) << _protocolType << _seqId << _totalSize;
-	writeFrame(header, _payload, o_bytes);
+	RLPStream header(3);
+	header << _protocolType << _seqId << _totalSize;
+	writeFrame(&header.out(), _payload, o_bytes);
 }
 
-void RLPXFrameCoder::writeFrame(RLPStream const& _header, bytesConstRef _payload, bytes& o_bytes)
+void RLPXFrameCoder::writeFrame(bytesConstRef _header, bytesConstRef _payload, bytes& o_bytes)
 {
-	// TODO: SECURITY check header values && header <= 16 bytes
-	bytes headerWithMac(h256::size);
-	bytesConstRef(&_header.out()).copyTo(bytesRef(&headerWithMac));
-	m_impl->frameEnc.ProcessData(headerWithMac.data(), headerWithMac.data(), 16);
-	updateEgressMACWithHeader(bytesConstRef(&headerWithMac).cropped(0, 16));
-	egressDigest().ref().copyTo(bytesRef(&headerWithMac).cropped(h128::size,h128::size));
-
-	auto padding = (16 - (_payload.size() % 16)) % 16;
-	o_bytes.swap(headerWithMac);
-	o_bytes.resize(32 + _payload.size() + padding + h128::size);
-	bytesRef packetRef(o_bytes.data() + 32, _payload.size());
-	m_impl->frameEnc.ProcessData(packetRef.data(), _payload.data(), _payload.size());
-	bytesRef paddingRef(o_bytes.data() + 32 + _payload.size(), padding);
-	if (padding)
-		m_impl->frameEnc.ProcessData(paddingRef.data(), paddingRef.data(), padding);
-	bytesRef packetWithPaddingRef(o_bytes.data() + 32, _payload.size() + padding);
-	updateEgressMACWithFrame(packetWithPaddingRef);
-	bytesRef macRef(o_bytes.data() + 32 + _payload.size() + padding, h128::size);
-	egressDigest().ref().copyTo(macRef);
+	// _payload may be (part of) o_bytes, so encrypt into a new buffer and keep the old one until done.
+	bytes frame(frameSize(_payload.size()));
+	writeFrame(_header, _payload, bytesRef(&frame));
+	o_bytes.swap(frame);
+}
+
+void RLPXFrameCoder::writeFrame(bytesConstRef _header, bytesConstRef _payload, bytesRef o_frame)
+{
+	// TODO: SECURITY check header values
+	asserts(_header.size() <= h128::size - 3 && o_frame.size() == frameSize(_payload.size()));
+	RLPXFrameCoderImpl& impl = *m_impl;
+	size_t const len = _payload.size();
+	impl.writeHeader(_header, len, o_frame.data());
+	impl.encryptPayload(_payload.data(), o_frame.data() + h256::size, len);
+	impl.finishPayload(len, o_frame.data() + h256::size + len);
+}
+
+void RLPXFrameCoder::writeFrame(bytesConstRef _header, std::vector<bytesRef> const& io_payload, bytesRef o_header, bytes& o_tail)
+{
+	// TODO: SECURITY check header values
+	asserts(_header.size() <= h128::size - 3 && o_header.size() == h256::size);
+	RLPXFrameCoderImpl& impl = *m_impl;
+	size_t len = 0;
+	for (auto const& i: io_payload)
+		len += i.size();
+	impl.writeHeader(_header, len, o_header.data());
+	for (auto const& i: io_payload)
+		impl.encryptPayload(i.data(), i.data(), i.size());
+	o_tail.resize(frameSize(len) - h256::size - len);
+	impl.finishPayload(len, o_tail.data());
 }
 
 void RLPXFrameCoder::writeSingleFramePacket(bytesConstRef _packet, bytes& o_bytes)
 {
-	RLPStream header;
-	uint32_t len = (uint32_t)_packet.size();
-	header.appendRaw(bytes({byte((len >> 16) & 0xff), byte((len >> 8) & 0xff), byte(len & 0xff)}));
-	header.appendRaw(bytes({0xc2,0x80,0x80}));
-	writeFrame(header, _packet, o_bytes);
+	writeFrame(bytesConstRef(c_legacyHeader, sizeof(c_legacyHeader)), _packet, o_bytes);
+}
+
+void RLPXFrameCoder::writeSingleFramePacket(std::vector<bytesRef> const& io_packet, bytesRef o_header, bytes& o_tail)
+{
+	writeFrame(bytesConstRef(c_legacyHeader, sizeof(c_legacyHeader)), io_packet, o_header, o_tail);
 }
 
 bool RLPXFrameCoder::authAndDecryptHeader(bytesRef io)
@@ -225,72 +253,115 @@ bool RLPXFrameCoder::authAndDecryptHeader(bytesRef io)
 
 bool RLPXFrameCoder::authAndDecryptFrame(bytesRef io)
 {
-	bytesRef cipherText(io.cropped(0, io.size() - h128::size));
-	updateIngressMACWithFrame(cipherText);
-	bytesConstRef frameMac(io.data() + io.size() - h128::size, h128::size);
-	if (*(h128*)frameMac.data() != ingressDigest())
+	if (io.size() < h128::size)
 		return false;
-	m_impl->frameDec.ProcessData(io.data(), io.data(), io.size() - h128::size);
-	return true;
+	RLPXFrameCoderImpl& impl = *m_impl;
+
+	// Each piece of ciphertext is decrypted straight after it's MACed, while it's still in cache.
+	size_t const len = io.size() - h128::size;
+	for (size_t i = 0; i < len; i += c_frameChunk)
+	{
+		size_t n = min<size_t>(c_frameChunk, len - i);
+		impl.ingressMac.Update(io.data() + i, n);
+		impl.frameDec.ProcessData(io.data() + i, io.data() + i, n);
+	}
+	impl.updateMAC(impl.ingressMac, impl.ingressMacEnc);
+	h128 expected;
+	impl.digest(impl.ingressMac, expected.data());
+	return *(h128*)(io.data() + len) == expected;
 }
 
 h128 RLPXFrameCoder::egressDigest()
 {
-	Keccak_256 h(m_impl->egressMac);
 	h128 digest;
-	h.TruncatedFinal(digest.data(), h128::size);
+	m_impl->digest(m_impl->egressMac, digest.data());
 	return digest;
 }
 
 h128 RLPXFrameCoder::ingressDigest()
 {
-	Keccak_256 h(m_impl->ingressMac);
 	h128 digest;
-	h.TruncatedFinal(digest.data(), h128::size);
+	m_impl->digest(m_impl->ingressMac, digest.data());
 	return digest;
 }
 
 void RLPXFrameCoder::updateEgressMACWithHeader(bytesConstRef _headerCipher)
 {
-	m_impl->updateMAC(m_impl->egressMac, _headerCipher.cropped(0, 16));
+	m_impl->updateMAC(m_impl->egressMac, m_impl->egressMacEnc, _headerCipher.cropped(0, 16));
 }
 
 void RLPXFrameCoder::updateEgressMACWithFrame(bytesConstRef _cipher)
 {
 	m_impl->egressMac.Update(_cipher.data(), _cipher.size());
-	m_impl->updateMAC(m_impl->egressMac);
+	m_impl->updateMAC(m_impl->egressMac, m_impl->egressMacEnc);
 }
 
 void RLPXFrameCoder::updateIngressMACWithHeader(bytesConstRef _headerCipher)
 {
-	m_impl->updateMAC(m_impl->ingressMac, _headerCipher.cropped(0, 16));
+	m_impl->updateMAC(m_impl->ingressMac, m_impl->ingressMacEnc, _headerCipher.cropped(0, 16));
 }
 
 void RLPXFrameCoder::updateIngressMACWithFrame(bytesConstRef _cipher)
 {
 	m_impl->ingressMac.Update(_cipher.data(), _cipher.size());
-	m_impl->updateMAC(m_impl->ingressMac);
+	m_impl->updateMAC(m_impl->ingressMac, m_impl->ingressMacEnc);
 }
 
-void RLPXFrameCoderImpl::updateMAC(Keccak_256& _mac, bytesConstRef _seed)
+void RLPXFrameCoderImpl::updateMAC(Keccak_256& _mac, AES::Encryption const& _macEnc, bytesConstRef _seed)
 {
 	if (_seed.size() && _seed.size() != h128::size)
 		asserts(false);
 
-	Keccak_256 prevDigest(_mac);
-	h128 encDigest(h128::size);
-	prevDigest.TruncatedFinal(encDigest.data(), h128::size);
-	h128 prevDigestOut = encDigest;
+	h128 prevDigest;
+	digest(_mac, prevDigest.data());
+	h128 encDigest;
+	_macEnc.ProcessAndXorBlock(prevDigest.data(), _seed.size() ? _seed.data() : prevDigest.data(), encDigest.data());
+
+	// update mac for final digest
+	_mac.Update(encDigest.data(), h128::size);
+}
+
+void RLPXFrameCoderImpl::digest(Keccak_256 const& _mac, byte* o_digest)
+{
+	Keccak_256 h(_mac);
+	h.TruncatedFinal(o_digest, h128::size);
+}
+
+void RLPXFrameCoderImpl::writeHeader(bytesConstRef _header, size_t _length, byte* o_header)
+{
+	// frame-size || header-data, zero-padded to 16 bytes, then header-mac
+	o_header[0] = byte((_length >> 16) & 0xff);
+	o_header[1] = byte((_length >> 8) & 0xff);
+	o_header[2] = byte(_length & 0xff);
+	memset(o_header + 3, 0, h128::size - 3);
+	_header.copyTo(bytesRef(o_header + 3, h128::size - 3));
+	frameEnc.ProcessData(o_header, o_header, h128::size);
+	updateMAC(egressMac, egressMacEnc, bytesConstRef(o_header, h128::size));
+	digest(egressMac, o_header + h128::size);
+}
 
+void RLPXFrameCoderImpl::encryptPayload(byte const* _plain, byte* o_cipher, size_t _size)
+{
+	// Each piece of ciphertext is MACed straight after it's written, while it's still in cache.
+	for (size_t i = 0; i < _size; i += c_frameChunk)
 	{
-		Guard l(x_macEnc);
-		macEnc.ProcessData(encDigest.data(), encDigest.data(), 16);
+		size_t n = min<size_t>(c_frameChunk, _size - i);
+		frameEnc.ProcessData(o_cipher + i, _plain + i, n);
+		egressMac.Update(o_cipher + i, n);
 	}
-	if (_seed.size())
-		encDigest ^= *(h128*)_seed.data();
-	else
-		encDigest ^= *(h128*)prevDigestOut.data();
+}
 
-	// update mac for final digest
-	_mac.Update(encDigest.data(), h128::size);
+void RLPXFrameCoderImpl::finishPayload(size_t _length, byte* o_tail)
+{
+	size_t const padding = (16 - (_length % 16)) % 16;
+	if (padding)
+	{
+		memset(o_tail, 0, padding);
+		frameEnc.ProcessData(o_tail, o_tail, padding);
+		egressMac.Update(o_tail, padding);
+	}
+
+	// frame-mac
+	updateMAC(egressMac, egressMacEnc);
+	digest(egressMac, o_tail + padding);
 }
@@ -92,14 +92,30 @@ public:
 	
 	/// Write first frame of segmented or sequence-tagged payload.
 	void writeFrame(uint16_t _protocolType, uint16_t _seqId, uint32_t _totalSize, bytesConstRef _payload, bytes& o_bytes);
+
+	/// Encrypt and MAC the frame of @a _payload with header-data @a _header (RLP of at most 13 bytes) into @a o_frame,
+	/// in a single pass over the payload. @a o_frame must be frameSize(_payload.size()) bytes long; it may hold
+	/// @a _payload already, at offset 32, to encrypt in place, but may not overlap it otherwise.
+	void writeFrame(bytesConstRef _header, bytesConstRef _payload, bytesRef o_frame);
+
+	/// Encrypt and MAC, in place, the frame of the payload made of @a io_payload's slices one after another, for a
+	/// vectored write of header, slices and tail. The header and header-mac are written to @a o_header (32 bytes)
+	/// and the padding and frame-mac to @a o_tail, which is resized to fit.
+	void writeFrame(bytesConstRef _header, std::vector<bytesRef> const& io_payload, bytesRef o_header, bytes& o_tail);
+
+	/// @returns size of the frame carrying @a _payloadSize bytes: header, header-mac, padded payload and frame-mac.
+	static size_t frameSize(size_t _payloadSize) { return h256::size + _payloadSize + (16 - _payloadSize % 16) % 16 + h128::size; }
 	
 	/// Legacy. Encrypt _packet as ill-defined legacy RLPx frame.
 	void writeSingleFramePacket(bytesConstRef _packet, bytes& o_bytes);
 
+	/// Legacy. Encrypt the packet made of @a io_packet's slices in place, as with writeFrame() above.
+	void writeSingleFramePacket(std::vector<bytesRef> const& io_packet, bytesRef o_header, bytes& o_tail);
+
 	/// Authenticate and decrypt header in-place.
 	bool authAndDecryptHeader(bytesRef io_cipherWithMac);
 	
-	/// Authenticate and decrypt frame in-place.
+	/// Authenticate and decrypt frame in-place, in a single pass. If it fails, the contents of @a io_cipherWithMac are undefined.
 	bool authAndDecryptFrame(bytesRef io_cipherWithMac);
 	
 	/// Return first 16 bytes of current digest from egress mac.
@@ -109,7 +125,7 @@ public:
 	h128 ingressDigest();
 
 protected:
-	void writeFrame(RLPStream const& _header, bytesConstRef _payload, bytes& o_bytes);
+	void writeFrame(bytesConstRef _header, bytesConstRef _payload, bytes& o_bytes);
 	
 	/// Update state of egress MAC with frame header.
 	void updateEgressMACWithHeader(bytesConstRef _headerCipher);
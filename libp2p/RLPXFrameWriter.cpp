@@ -116,10 +116,10 @@ size_t RLPXFrameWriter::mux(RLPXFrameCoder& _coder, unsigned _size, deque<bytes>
 			{
 				offset = qs.writing->data().size() - qs.remaining;
 				length = qs.remaining <= frameAllot ? qs.remaining : frameAllot;
-				bytes portion = bytesConstRef(&qs.writing->data()).cropped(offset, length).toBytes();
+				bytesConstRef portion = bytesConstRef(&qs.writing->data()).cropped(offset, length);
 				qs.remaining -= length;
 				frameAllot -= portion.size();
-				payload += portion;
+				payload.insert(payload.end(), portion.begin(), portion.end());
 			}
 			
 			assert((!qs.remaining && (offset > 0 || !qs.multiFrame)) || (qs.remaining && qs.multiFrame));
@@ -148,8 +148,8 @@ size_t RLPXFrameWriter::mux(RLPXFrameCoder& _coder, unsigned _size, deque<bytes>
 
 			assert(frameLen >= payload.size());
 			frameLen -= payload.size();
-			o_toWrite.push_back(payload);
-			payload.resize(0);
+			o_toWrite.push_back(move(payload));
+			payload.clear();
 			
 			if (!qs.remaining && qs.multiFrame)
 				qs.multiFrame = false;
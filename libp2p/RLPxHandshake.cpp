@@ -48,10 +48,10 @@ void RLPXHandshake::writeAuth()
 	encryptECIES(m_remote, &m_auth, m_authCipher);
 
 	auto self(shared_from_this());
-	ba::async_write(m_socket->ref(), ba::buffer(m_authCipher), [this, self](boost::system::error_code ec, std::size_t)
+	ba::async_write(m_socket->ref(), ba::buffer(m_authCipher), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 	{
 		transition(ec);
-	});
+	}));
 }
 
 void RLPXHandshake::writeAck()
@@ -66,10 +66,10 @@ void RLPXHandshake::writeAck()
 	encryptECIES(m_remote, &m_ack, m_ackCipher);
 
 	auto self(shared_from_this());
-	ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), [this, self](boost::system::error_code ec, std::size_t)
+	ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 	{
 		transition(ec);
-	});
+	}));
 }
 
 void RLPXHandshake::writeAckEIP8()
@@ -91,10 +91,10 @@ void RLPXHandshake::writeAckEIP8()
 	m_ackCipher.insert(m_ackCipher.begin(), prefix.begin(), prefix.end());
 	
 	auto self(shared_from_this());
-	ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), [this, self](boost::system::error_code ec, std::size_t)
+	ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 	{
 		transition(ec);
-	});
+	}));
 }
 
 void RLPXHandshake::setAuthValues(Signature const& _sig, Public const& _remotePubk, h256 const& _remoteNonce, uint64_t _remoteVersion)
@@ -112,7 +112,7 @@ void RLPXHandshake::readAuth()
 	clog(NetP2PConnect) << "p2p.connect.ingress receiving auth from " << m_socket->remoteEndpoint();
 	m_authCipher.resize(307);
 	auto self(shared_from_this());
-	ba::async_read(m_socket->ref(), ba::buffer(m_authCipher, 307), [this, self](boost::system::error_code ec, std::size_t)
+	ba::async_read(m_socket->ref(), ba::buffer(m_authCipher, 307), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 	{
 		if (ec)
 			transition(ec);
@@ -127,7 +127,7 @@ void RLPXHandshake::readAuth()
 		}
 		else
 			readAuthEIP8();
-	});
+	}));
 }
 
 void RLPXHandshake::readAuthEIP8()
@@ -138,7 +138,7 @@ void RLPXHandshake::readAuthEIP8()
 	m_authCipher.resize((size_t)size + 2);
 	auto rest = ba::buffer(ba::buffer(m_authCipher) + 307);
 	auto self(shared_from_this());
-	ba::async_read(m_socket->ref(), rest, [this, self](boost::system::error_code ec, std::size_t)
+	ba::async_read(m_socket->ref(), rest, m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 	{
 		bytesConstRef ct(&m_authCipher);
 		if (ec)
@@ -161,7 +161,7 @@ void RLPXHandshake::readAuthEIP8()
 			m_nextState = Error;
 			transition();
 		}
-	});
+	}));
 }
 
 void RLPXHandshake::readAck()
@@ -169,7 +169,7 @@ void RLPXHandshake::readAck()
 	clog(NetP2PConnect) << "p2p.connect.egress receiving ack from " << m_socket->remoteEndpoint();
 	m_ackCipher.resize(210);
 	auto self(shared_from_this());
-	ba::async_read(m_socket->ref(), ba::buffer(m_ackCipher, 210), [this, self](boost::system::error_code ec, std::size_t)
+	ba::async_read(m_socket->ref(), ba::buffer(m_ackCipher, 210), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 	{
 		if (ec)
 			transition(ec);
@@ -182,7 +182,7 @@ void RLPXHandshake::readAck()
 		}
 		else
 			readAckEIP8();
-	});
+	}));
 }
 
 void RLPXHandshake::readAckEIP8()
@@ -193,7 +193,7 @@ void RLPXHandshake::readAckEIP8()
 	m_ackCipher.resize((size_t)size + 2);
 	auto rest = ba::buffer(ba::buffer(m_ackCipher) + 210);
 	auto self(shared_from_this());
-	ba::async_read(m_socket->ref(), rest, [this, self](boost::system::error_code ec, std::size_t)
+	ba::async_read(m_socket->ref(), rest, m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 	{
 		bytesConstRef ct(&m_ackCipher);
 		if (ec)
@@ -212,7 +212,7 @@ void RLPXHandshake::readAckEIP8()
 			m_nextState = Error;
 			transition();
 		}
-	});
+	}));
 }
 
 void RLPXHandshake::cancel()
@@ -248,7 +248,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
 	auto self(shared_from_this());
 	assert(m_nextState != StartSession);
 	m_idleTimer.expires_from_now(c_timeout);
-	m_idleTimer.async_wait([this, self](boost::system::error_code const& _ec)
+	m_idleTimer.async_wait(m_socket->strand().wrap([this, self](boost::system::error_code const& _ec)
 	{
 		if (!_ec)
 		{
@@ -256,7 +256,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
 				clog(NetP2PConnect) << "Disconnecting " << m_socket->remoteEndpoint() << " (Handshake Timeout)";
 			cancel();
 		}
-	});
+	}));
 	
 	if (m_nextState == New)
 	{
@@ -293,7 +293,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
 
 		RLPStream s;
 		s.append((unsigned)HelloPacket).appendList(5)
-			<< dev::p2p::c_protocolVersion
+			<< dev::p2p::c_helloProtocolVersion
 			<< m_host->m_clientVersion
 			<< m_host->caps()
 			<< m_host->listenPort()
@@ -302,10 +302,10 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
 		bytes packet;
 		s.swapOut(packet);
 		m_io->writeSingleFramePacket(&packet, m_handshakeOutBuffer);
-		ba::async_write(m_socket->ref(), ba::buffer(m_handshakeOutBuffer), [this, self](boost::system::error_code ec, std::size_t)
+		ba::async_write(m_socket->ref(), ba::buffer(m_handshakeOutBuffer), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 		{
 			transition(ec);
-		});
+		}));
 	}
 	else if (m_nextState == ReadHello)
 	{
@@ -316,7 +316,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
 		// read frame header
 		unsigned const handshakeSize = 32;
 		m_handshakeInBuffer.resize(handshakeSize);
-		ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, handshakeSize), [this, self](boost::system::error_code ec, std::size_t)
+		ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, handshakeSize), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
 		{
 			if (ec)
 				transition(ec);
@@ -358,7 +358,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
 				
 				/// read padded frame and mac
 				m_handshakeInBuffer.resize(frameSize + ((16 - (frameSize % 16)) % 16) + h128::size);
-				ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, m_handshakeInBuffer.size()), [this, self, headerRLP](boost::system::error_code ec, std::size_t)
+				ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, m_handshakeInBuffer.size()), m_socket->strand().wrap([this, self, headerRLP](boost::system::error_code ec, std::size_t)
 				{
 					m_idleTimer.cancel();
 					
@@ -405,8 +405,8 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
 							transition();
 						}
 					}
-				});
+				}));
 			}
-		});
+		}));
 	}
 }
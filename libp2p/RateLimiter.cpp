@@ -0,0 +1,71 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RateLimiter.cpp
+ * @date 2016
+ */
+
+#include "RateLimiter.h"
+#include <algorithm>
+#include <limits>
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+void RateLimiter::setRate(size_t _bytesPerSecond)
+{
+	Guard l(x_allowance);
+	m_rate = _bytesPerSecond;
+	m_allowance = double(_bytesPerSecond);
+	m_refilled = Clock::now();
+}
+
+RateLimiter::Clock::duration RateLimiter::delay(Clock::time_point _now)
+{
+	Guard l(x_allowance);
+	if (!m_rate)
+		return Clock::duration::zero();
+	refill_UNSAFE(_now);
+	if (m_allowance >= 0)
+		return Clock::duration::zero();
+	return chrono::duration_cast<Clock::duration>(chrono::duration<double>(-m_allowance / m_rate));
+}
+
+size_t RateLimiter::available(Clock::time_point _now)
+{
+	Guard l(x_allowance);
+	if (!m_rate)
+		return numeric_limits<size_t>::max();
+	refill_UNSAFE(_now);
+	return m_allowance > 0 ? size_t(m_allowance) : 0;
+}
+
+void RateLimiter::consume(size_t _bytes, Clock::time_point _now)
+{
+	Guard l(x_allowance);
+	if (!m_rate)
+		return;
+	refill_UNSAFE(_now);
+	m_allowance -= _bytes;
+}
+
+void RateLimiter::refill_UNSAFE(Clock::time_point _now)
+{
+	if (_now <= m_refilled)
+		return;
+	m_allowance = min<double>(m_rate, m_allowance + chrono::duration<double>(_now - m_refilled).count() * m_rate);
+	m_refilled = _now;
+}
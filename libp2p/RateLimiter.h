@@ -0,0 +1,72 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RateLimiter.h
+ * @date 2016
+ */
+
+#pragma once
+
+#include <chrono>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace p2p
+{
+
+/**
+ * @brief Limits the bytes per second sent, as a token bucket.
+ *
+ * The allowance refills at the rate, up to one second's worth. Sending is allowed whenever the
+ * allowance isn't negative and takes the whole write from it, so a write larger than the allowance
+ * goes out at once and the next waits until the allowance has recovered.
+ *
+ * Thread Safety
+ * All methods are thread-safe.
+ */
+class RateLimiter
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// A rate of 0 doesn't limit.
+	explicit RateLimiter(size_t _bytesPerSecond = 0) { setRate(_bytesPerSecond); }
+
+	void setRate(size_t _bytesPerSecond);
+	size_t rate() const { Guard l(x_allowance); return m_rate; }
+
+	/// @returns how long to wait before sending; zero if sending at @a _now is within the limit.
+	Clock::duration delay(Clock::time_point _now = Clock::now());
+
+	/// @returns how many bytes may be sent at @a _now before the allowance runs out; the most a size_t holds if unlimited.
+	size_t available(Clock::time_point _now = Clock::now());
+
+	/// Notes @a _bytes sent at @a _now.
+	void consume(size_t _bytes, Clock::time_point _now = Clock::now());
+
+private:
+	/// Adds the allowance accrued up to @a _now. @warning Only call with x_allowance locked.
+	void refill_UNSAFE(Clock::time_point _now);
+
+	mutable Mutex x_allowance;
+	size_t m_rate = 0;				///< Bytes per second; 0 if unlimited.
+	double m_allowance = 0;			///< Bytes; negative after a write larger than what was left.
+	Clock::time_point m_refilled;	///< When m_allowance was last brought up to date.
+};
+
+}
+}
@@ -28,6 +28,7 @@
 #include <libdevcore/Exceptions.h>
 #include "Host.h"
 #include "Capability.h"
+#include "Compression.h"
 using namespace std;
 using namespace dev;
 using namespace dev::p2p;
@@ -38,11 +39,15 @@ Session::Session(Host* _h, unique_ptr<RLPXFrameCoder>&& _io, std::shared_ptr<RLP
 	m_socket(_s),
 	m_peer(_n),
 	m_info(_info),
-	m_ping(chrono::steady_clock::time_point::max())
+	m_ping(chrono::steady_clock::time_point::max()),
+	m_endedTraffic(_h->m_endedTraffic),
+	m_egressLimiter(_h->networkPreferences().peerEgressLimit)
 {
 	registerFraming(0);
 	m_peer->m_lastDisconnect = NoDisconnect;
+	m_peer->m_sessions++;
 	m_lastReceived = m_connect = chrono::steady_clock::now();
+	m_compression = !isFramingEnabled() && m_info.protocolVersion >= c_snappyProtocolVersion && c_helloProtocolVersion >= c_snappyProtocolVersion;
 	DEV_GUARDED(x_info)
 		m_info.socketId = m_socket->ref().native_handle();
 }
@@ -53,6 +58,12 @@ Session::~Session()
 	ThreadContext tc2(info().clientVersion);
 	clog(NetMessageSummary) << "Closing peer session :-(";
 	m_peer->m_lastConnected = m_peer->m_lastAttempted - chrono::seconds(1);
+	m_peer->m_uptime += chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - m_connect).count();
+	SessionTraffic t;
+	DEV_GUARDED(x_traffic)
+		t = m_traffic;
+	DEV_GUARDED(m_endedTraffic->x)
+		m_endedTraffic->traffic += t;
 
 	// Read-chain finished for one reason or another.
 	for (auto& i: m_capabilities)
@@ -114,6 +125,7 @@ template <class T> vector<T> randomSelection(vector<T> const& _t, unsigned _n)
 bool Session::readPacket(uint16_t _capId, PacketType _t, RLP const& _r)
 {
 	m_lastReceived = chrono::steady_clock::now();
+	m_peer->m_servedBytes += _r.actualSize();
 	clog(NetRight) << _t << _r;
 	try // Generic try-catch block designed to capture RLP format errors - TODO: give decent diagnostics, make a bit more specific over what is caught.
 	{
@@ -175,6 +187,7 @@ bool Session::interpret(PacketType _t, RLP const& _r)
 		DEV_GUARDED(x_info)
 		{
 			m_info.lastPing = std::chrono::steady_clock::now() - m_ping;
+			m_peer->m_latency = chrono::duration_cast<chrono::milliseconds>(m_info.lastPing).count();
 			clog(NetTriviaSummary) << "Latency: " << chrono::duration_cast<chrono::milliseconds>(m_info.lastPing).count() << " ms";
 		}
 		break;
@@ -201,9 +214,14 @@ RLPStream& Session::prep(RLPStream& _s, PacketType _id, unsigned _args)
 
 void Session::sealAndSend(RLPStream& _s, uint16_t _protocolID)
 {
-	bytes b;
-	_s.swapOut(b);
-	send(move(b), _protocolID);
+	std::vector<bytes> slices(1);
+	_s.swapOut(slices[0]);
+	send(move(slices), _protocolID);
+}
+
+void Session::sealAndSend(std::vector<bytes>&& _slices, uint16_t _protocolID)
+{
+	send(move(_slices), _protocolID);
 }
 
 bool Session::checkPacket(bytesConstRef _msg)
@@ -215,19 +233,38 @@ bool Session::checkPacket(bytesConstRef _msg)
 	return true;
 }
 
-void Session::send(bytes&& _msg, uint16_t _protocolID)
+bool Session::checkPacket(std::vector<bytes> const& _slices)
+{
+	if (_slices.empty())
+		return false;
+	if (_slices.size() == 1)
+		return checkPacket(&_slices[0]);
+	size_t size = 0;
+	for (auto const& i: _slices)
+		size += i.size();
+	if (_slices[0].size() < 2 || _slices[0][0] > 0x7f)
+		return false;
+	return RLP(bytesConstRef(&_slices[0]).cropped(1), RLP::LaissezFaire).actualSize() + 1 == size;
+}
+
+void Session::send(std::vector<bytes>&& _slices, uint16_t _protocolID)
 {
-	bytesConstRef msg(&_msg);
-	clog(NetLeft) << RLP(msg.cropped(1));
-	if (!checkPacket(msg))
+	if (_slices.size() == 1)
+		clog(NetLeft) << RLP(bytesConstRef(&_slices[0]).cropped(1));
+	if (!checkPacket(_slices))
 		clog(NetWarn) << "INVALID PACKET CONSTRUCTED!";
 
 	if (!m_socket->ref().is_open())
 		return;
 
 	bool doWrite = false;
+	unsigned const type = _slices[0].empty() ? 0 : _slices[0][0];
 	if (isFramingEnabled())
 	{
+		bytes msg = move(_slices[0]);
+		for (unsigned i = 1; i < _slices.size(); ++i)
+			msg += _slices[i];
+		noteTraffic(packetKind(_protocolID, type), true, msg.size());
 		DEV_GUARDED(x_framing)
 		{
 			doWrite = m_encFrames.empty();
@@ -235,36 +272,93 @@ void Session::send(bytes&& _msg, uint16_t _protocolID)
 			if (!f)
 				return;
 
-			f->writer.enque(RLPXPacket(_protocolID, msg));
+			f->writer.enque(RLPXPacket(_protocolID, &msg));
 			multiplexAll();
 		}
 
 		if (doWrite)
-			writeFrames();
+		{
+			auto self(shared_from_this());
+			m_socket->strand().dispatch([this, self]() { writeFrames(); });
+		}
 	}
 	else
 	{
+		if (m_compression && !_slices[0].empty())
+		{
+			// The packet type stays in the clear; the rest is compressed as a whole.
+			bytes payload = bytesConstRef(&_slices[0]).cropped(1).toBytes();
+			for (unsigned i = 1; i < _slices.size(); ++i)
+				payload += _slices[i];
+			bytes packet(1, _slices[0][0]);
+			if (!snappyCompress(&payload, packet))
+			{
+				clog(NetWarn) << "Not sending a packet of" << payload.size() << "bytes, more than a peer accepts compressed.";
+				return;
+			}
+			_slices.assign(1, move(packet));
+		}
+
+		// Packets are encrypted in the order they are queued, which is the order the MAC needs them written in.
+		EgressPacket p;
+		p.slices = move(_slices);
+		std::vector<bytesRef> payload;
+		size_t size = h256::size;
+		for (auto& i: p.slices)
+		{
+			payload.push_back(&i);
+			size += i.size();
+		}
 		DEV_GUARDED(x_framing)
 		{
-			m_writeQueue.push_back(std::move(_msg));
+			auto start = chrono::steady_clock::now();
+			m_io->writeSingleFramePacket(payload, p.header.ref(), p.tail);
+			noteFrameCoder(start);
+			size += p.tail.size();
+			m_writeQueue.push_back(move(p));
 			doWrite = (m_writeQueue.size() == 1);
 		}
+		noteTraffic(packetKind(_protocolID, type), true, size);
 
 		if (doWrite)
-			write();
+		{
+			auto self(shared_from_this());
+			m_socket->strand().dispatch([this, self]() { write(); });
+		}
 	}
 }
 
 void Session::write()
 {
-	bytes const* out = nullptr;
+	if (throttle([this]() { write(); }))
+		return;
+
+	// What's queued goes out in one vectored write, as far as the limits allow; the first packet always does.
+	auto now = chrono::steady_clock::now();
+	size_t const allowance = min(m_egressLimiter.available(now), m_server->egressLimiter().available(now));
+	std::vector<ba::const_buffer> out;
+	size_t size = 0;
 	DEV_GUARDED(x_framing)
 	{
-		m_io->writeSingleFramePacket(&m_writeQueue[0], m_writeQueue[0]);
-		out = &m_writeQueue[0];
+		for (m_writing = 0; m_writing < m_writeQueue.size() && m_writing < c_maxPacketsPerWrite; ++m_writing)
+		{
+			EgressPacket const& p = m_writeQueue[m_writing];
+			size_t packetSize = h256::size + p.tail.size();
+			for (auto const& s: p.slices)
+				packetSize += s.size();
+			if (m_writing && size + packetSize > allowance)
+				break;
+			out.push_back(ba::buffer(p.header.data(), h256::size));
+			for (auto const& s: p.slices)
+				out.push_back(ba::buffer(s));
+			out.push_back(ba::buffer(p.tail));
+			size += packetSize;
+		}
 	}
+	m_egressLimiter.consume(size, now);
+	m_server->egressLimiter().consume(size, now);
 	auto self(shared_from_this());
-	ba::async_write(m_socket->ref(), ba::buffer(*out), [this, self](boost::system::error_code ec, std::size_t /*length*/)
+	ba::async_write(m_socket->ref(), out, m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t /*length*/)
 	{
 		ThreadContext tc(info().id.abridged());
 		ThreadContext tc2(info().clientVersion);
@@ -278,16 +372,20 @@ void Session::write()
 
 		DEV_GUARDED(x_framing)
 		{
-			m_writeQueue.pop_front();
+			m_writeQueue.erase(m_writeQueue.begin(), m_writeQueue.begin() + m_writing);
+			m_writing = 0;
 			if (m_writeQueue.empty())
 				return;
 		}
 		write();
-	});
+	}));
 }
 
 void Session::writeFrames()
 {
+	if (throttle([this]() { writeFrames(); }))
+		return;
+
 	bytes const* out = nullptr;
 	DEV_GUARDED(x_framing)
 	{
@@ -296,9 +394,11 @@ void Session::writeFrames()
 		else
 			out = &m_encFrames[0];
 	}
+	m_egressLimiter.consume(out->size());
+	m_server->egressLimiter().consume(out->size());
 
 	auto self(shared_from_this());
-	ba::async_write(m_socket->ref(), ba::buffer(*out), [this, self](boost::system::error_code ec, std::size_t /*length*/)
+	ba::async_write(m_socket->ref(), ba::buffer(*out), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t /*length*/)
 	{
 		ThreadContext tc(info().id.abridged());
 		ThreadContext tc2(info().clientVersion);
@@ -321,7 +421,7 @@ void Session::writeFrames()
 		}
 
 		writeFrames();
-	});
+	}));
 }
 
 void Session::drop(DisconnectReason _reason)
@@ -338,6 +438,11 @@ void Session::drop(DisconnectReason _reason)
 			socket.close();
 		}
 		catch (...) {}
+	if (m_throttle)
+	{
+		boost::system::error_code ec;
+		m_throttle->cancel(ec);
+	}
 
 	m_peer->m_lastDisconnect = _reason;
 	if (_reason == BadProtocol)
@@ -350,15 +455,32 @@ void Session::drop(DisconnectReason _reason)
 
 void Session::disconnect(DisconnectReason _reason)
 {
-	clog(NetConnect) << "Disconnecting (our reason:" << reasonOf(_reason) << ")";
+	auto self(shared_from_this());
+	m_socket->strand().dispatch([this, self, _reason]()
+	{
+		clog(NetConnect) << "Disconnecting (our reason:" << reasonOf(_reason) << ")";
 
-	if (m_socket->ref().is_open())
+		if (m_socket->ref().is_open())
+		{
+			RLPStream s;
+			prep(s, DisconnectPacket, 1) << (int)_reason;
+			sealAndSend(s, 0);
+		}
+		drop(_reason);
+	});
+}
+
+void Session::offload(function<void()> const& _f)
+{
+	HandlerPool* pool = m_server->handlerPool();
+	if (!pool)
 	{
-		RLPStream s;
-		prep(s, DisconnectPacket, 1) << (int)_reason;
-		sealAndSend(s, 0);
+		_f();
+		return;
 	}
-	drop(_reason);
+	if (!m_handlers)
+		m_handlers = pool->newLane();
+	pool->post(m_handlers, _f);
 }
 
 void Session::start()
@@ -379,13 +501,16 @@ void Session::doRead()
 
 	auto self(shared_from_this());
 	m_data.resize(h256::size);
-	ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, h256::size), [this,self](boost::system::error_code ec, std::size_t length)
+	ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, h256::size), m_socket->strand().wrap([this,self](boost::system::error_code ec, std::size_t length)
 	{
 		ThreadContext tc(info().id.abridged());
 		ThreadContext tc2(info().clientVersion);
 		if (!checkRead(h256::size, ec, length))
 			return;
-		else if (!m_io->authAndDecryptHeader(bytesRef(m_data.data(), length)))
+		auto start = chrono::steady_clock::now();
+		bool const authentic = m_io->authAndDecryptHeader(bytesRef(m_data.data(), length));
+		noteFrameCoder(start);
+		if (!authentic)
 		{
 			clog(NetWarn) << "header decrypt failed";
 			drop(BadProtocol); // todo: better error
@@ -412,13 +537,16 @@ void Session::doRead()
 		/// read padded frame and mac
 		auto tlen = hLength + hPadding + h128::size;
 		m_data.resize(tlen);
-		ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, tlen), [this, self, hLength, hProtocolId, tlen](boost::system::error_code ec, std::size_t length)
+		ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, tlen), m_socket->strand().wrap([this, self, hLength, hProtocolId, tlen](boost::system::error_code ec, std::size_t length)
 		{
 			ThreadContext tc(info().id.abridged());
 			ThreadContext tc2(info().clientVersion);
 			if (!checkRead(tlen, ec, length))
 				return;
-			else if (!m_io->authAndDecryptFrame(bytesRef(m_data.data(), tlen)))
+			auto start = chrono::steady_clock::now();
+			bool const authentic = m_io->authAndDecryptFrame(bytesRef(m_data.data(), tlen));
+			noteFrameCoder(start);
+			if (!authentic)
 			{
 				clog(NetWarn) << "frame decrypt failed";
 				drop(BadProtocol); // todo: better error
@@ -426,6 +554,22 @@ void Session::doRead()
 			}
 
 			bytesConstRef frame(m_data.data(), hLength);
+			if (m_compression)
+			{
+				bool ok = !frame.empty();
+				if (ok)
+				{
+					m_uncompressed.assign(1, frame[0]);
+					ok = snappyUncompress(frame.cropped(1), c_maxUncompressedPayload, m_uncompressed);
+				}
+				if (!ok)
+				{
+					clog(NetWarn) << "Malformed or oversized compressed packet of" << frame.size() << "bytes received";
+					disconnect(BadProtocol);
+					return;
+				}
+				frame = bytesConstRef(&m_uncompressed);
+			}
 			if (!checkPacket(frame))
 			{
 				cerr << "Received " << frame.size() << ": " << toHex(frame) << endl;
@@ -436,6 +580,7 @@ void Session::doRead()
 			else
 			{
 				auto packetType = (PacketType)RLP(frame.cropped(0, 1)).toInt<unsigned>();
+				noteTraffic(packetKind(hProtocolId, packetType), false, h256::size + tlen);
 				RLP r(frame.cropped(1));
 				bool ok = readPacket(hProtocolId, packetType, r);
 				(void)ok;
@@ -444,9 +589,26 @@ void Session::doRead()
 					clog(NetWarn) << "Couldn't interpret packet." << RLP(r);
 #endif
 			}
-			doRead();
-		});
-	});
+			readNext();
+		}));
+	}));
+}
+
+void Session::readNext()
+{
+	HandlerPool* pool = m_server->handlerPool();
+	auto self(shared_from_this());
+	auto resume = [this, self]()
+	{
+		m_socket->strand().post([this, self]() { readNext(); });
+	};
+	if (m_handlers && pool && pool->deferUntilBelow(m_handlers, c_maxQueuedHandlers, resume))
+		return;
+
+	if (isFramingEnabled())
+		doReadFrames();
+	else
+		doRead();
 }
 
 bool Session::checkRead(std::size_t _expected, boost::system::error_code _ec, std::size_t _length)
@@ -483,7 +645,7 @@ void Session::doReadFrames()
 
 	auto self(shared_from_this());
 	m_data.resize(h256::size);
-	ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, h256::size), [this, self](boost::system::error_code ec, std::size_t length)
+	ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, h256::size), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t length)
 	{
 		ThreadContext tc(info().id.abridged());
 		ThreadContext tc2(info().clientVersion);
@@ -492,7 +654,10 @@ void Session::doReadFrames()
 
 		DEV_GUARDED(x_framing)
 		{
-			if (!m_io->authAndDecryptHeader(bytesRef(m_data.data(), length)))
+			auto start = chrono::steady_clock::now();
+			bool const authentic = m_io->authAndDecryptHeader(bytesRef(m_data.data(), length));
+			noteFrameCoder(start);
+			if (!authentic)
 			{
 				clog(NetWarn) << "header decrypt failed";
 				drop(BadProtocol); // todo: better error
@@ -515,7 +680,7 @@ void Session::doReadFrames()
 		RLPXFrameInfo header(rawHeader);
 		auto tlen = header.length + header.padding + h128::size; // padded frame and mac
 		m_data.resize(tlen);
-		ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, tlen), [this, self, tlen, header](boost::system::error_code ec, std::size_t length)
+		ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, tlen), m_socket->strand().wrap([this, self, tlen, header](boost::system::error_code ec, std::size_t length)
 		{
 			ThreadContext tc(info().id.abridged());
 			ThreadContext tc2(info().clientVersion);
@@ -534,13 +699,16 @@ void Session::doReadFrames()
 					return;
 				}
 
+				auto start = chrono::steady_clock::now();
 				auto v = f->reader.demux(*m_io, header, frame);
+				noteFrameCoder(start);
 				px.swap(v);
 			}
 
 			for (RLPXPacket& p: px)
 			{
 				PacketType packetType = (PacketType)RLP(p.type()).toInt<unsigned>(RLP::AllowNonCanon);
+				noteTraffic(packetKind(header.protocolId, packetType), false, p.size());
 				bool ok = readPacket(header.protocolId, packetType, RLP(p.data()));
 #if ETH_DEBUG
 				if (!ok)
@@ -549,9 +717,9 @@ void Session::doReadFrames()
 				ok = true;
 				(void)ok;
 			}
-			doReadFrames();
-		});
-	});
+			readNext();
+		}));
+	}));
 }
 
 std::shared_ptr<Session::Framing> Session::getFraming(uint16_t _protocolID)
@@ -584,6 +752,83 @@ void Session::registerFraming(uint16_t _id)
 
 void Session::multiplexAll()
 {
+	auto start = chrono::steady_clock::now();
 	for (auto& f: m_framing)
 		f.second->writer.mux(*m_io, maxFrameSize(), m_encFrames);
+	noteFrameCoder(start);
+}
+
+bool Session::throttle(function<void()> const& _resume)
+{
+	auto now = chrono::steady_clock::now();
+	auto wait = max(m_egressLimiter.delay(now), m_server->egressLimiter().delay(now));
+	if (wait <= chrono::steady_clock::duration::zero())
+		return false;
+
+	auto us = chrono::duration_cast<chrono::microseconds>(wait).count() + 1;
+	DEV_GUARDED(x_traffic)
+		m_traffic.throttledMicroseconds += us;
+	auto self(shared_from_this());
+	m_throttle.reset(new ba::deadline_timer(m_socket->ref().get_io_service()));
+	m_throttle->expires_from_now(boost::posix_time::microseconds(us));
+	m_throttle->async_wait(m_socket->strand().wrap([this, self, _resume](boost::system::error_code const& _ec)
+	{
+		if (!_ec)
+			_resume();
+	}));
+	return true;
+}
+
+pair<string, unsigned> Session::packetKind(uint16_t _protocolID, unsigned _type) const
+{
+	if (isFramingEnabled())
+	{
+		if (_protocolID == 0 && _type < UserPacket)
+			return make_pair(string("p2p"), _type);
+		for (auto const& i: m_capabilities)
+			if (i.second->c_protocolID == _protocolID)
+				return make_pair(i.first.first, _type);
+	}
+	else
+	{
+		if (_type < UserPacket)
+			return make_pair(string("p2p"), _type);
+		for (auto const& i: m_capabilities)
+			if (_type >= i.second->m_idOffset && _type - i.second->m_idOffset < i.second->hostCapability()->messageCount())
+				return make_pair(i.first.first, _type - i.second->m_idOffset);
+	}
+	return make_pair(string("unknown"), _type);
+}
+
+void Session::noteTraffic(pair<string, unsigned> const& _kind, bool _egress, size_t _bytes)
+{
+	Guard l(x_traffic);
+	m_traffic.note(_kind.first, _kind.second, _egress, _bytes);
+}
+
+void Session::noteFrameCoder(chrono::steady_clock::time_point _start)
+{
+	auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - _start).count();
+	Guard l(x_traffic);
+	m_traffic.frameCoderMicroseconds += us;
+}
+
+SessionTraffic Session::traffic() const
+{
+	SessionTraffic ret;
+	DEV_GUARDED(x_traffic)
+		ret = m_traffic;
+	DEV_GUARDED(x_framing)
+	{
+		ret.writeQueue = m_writeQueue.size() + m_encFrames.size();
+		for (auto const& p: m_writeQueue)
+		{
+			ret.writeQueueBytes += h256::size + p.tail.size();
+			for (auto const& s: p.slices)
+				ret.writeQueueBytes += s.size();
+		}
+		for (auto const& f: m_encFrames)
+			ret.writeQueueBytes += f.size();
+	}
+	return ret;
 }
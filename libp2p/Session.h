@@ -34,7 +34,9 @@
 #include <libdevcore/Guards.h>
 #include "RLPXFrameCoder.h"
 #include "RLPXSocket.h"
+#include "HandlerPool.h"
 #include "Common.h"
+#include "RateLimiter.h"
 #include "RLPXFrameWriter.h"
 #include "RLPXFrameReader.h"
 
@@ -63,6 +65,15 @@ public:
 
 	virtual void sealAndSend(RLPStream& _s, uint16_t _protocolID) = 0;
 
+	/// Sends the packet made of @a _slices one after another. They are moved, not copied, into the write queue.
+	virtual void sealAndSend(std::vector<bytes>&& _slices, uint16_t _protocolID)
+	{
+		RLPStream s;
+		for (auto const& i: _slices)
+			s.appendRaw(i, 0);
+		sealAndSend(s, _protocolID);
+	}
+
 	virtual int rating() const = 0;
 	virtual void addRating(int _r) = 0;
 
@@ -81,6 +92,13 @@ public:
 	virtual std::chrono::steady_clock::time_point lastReceived() const = 0;
 
 	virtual ReputationManager& repMan() = 0;
+
+	/// Runs @a _f, the handler of a request received on this session, off the network threads if there
+	/// are threads for that. Handlers offloaded by a session run in the order they were offloaded.
+	virtual void offload(std::function<void()> const& _f) { _f(); }
+
+	/// @returns what the session has cost so far.
+	virtual SessionTraffic traffic() const { return SessionTraffic(); }
 };
 
 /**
@@ -90,7 +108,8 @@ public:
 class Session: public SessionFace, public std::enable_shared_from_this<SessionFace>
 {
 public:
-	static bool isFramingAllowedForVersion(unsigned _version) { return _version > 4; }
+	/// Version 5 only adds compression (EIP-706); frames with several protocols' packets need both sides above it.
+	static bool isFramingAllowedForVersion(unsigned _version) { return _version > c_snappyProtocolVersion; }
 
 	Session(Host* _server, std::unique_ptr<RLPXFrameCoder>&& _io, std::shared_ptr<RLPXSocket> const& _s, std::shared_ptr<Peer> const& _n, PeerSessionInfo _info);
 	virtual ~Session();
@@ -105,6 +124,7 @@ public:
 	NodeID id() const override;
 
 	void sealAndSend(RLPStream& _s, uint16_t _protocolID) override;
+	void sealAndSend(std::vector<bytes>&& _slices, uint16_t _protocolID) override;
 
 	int rating() const override;
 	void addRating(int _r) override;
@@ -125,10 +145,14 @@ public:
 
 	ReputationManager& repMan() override;
 
+	void offload(std::function<void()> const& _f) override;
+
+	SessionTraffic traffic() const override;
+
 private:
 	static RLPStream& prep(RLPStream& _s, PacketType _t, unsigned _args = 0);
 
-	void send(bytes&& _msg, uint16_t _protocolID);
+	void send(std::vector<bytes>&& _slices, uint16_t _protocolID);
 
 	/// Drop the connection for the reason @a _r.
 	void drop(DisconnectReason _r);
@@ -136,6 +160,9 @@ private:
 	/// Perform a read on the socket.
 	void doRead();
 	void doReadFrames();
+
+	/// Reads on, unless too many offloaded handlers are unfinished; then reads on once enough of them are done.
+	void readNext();
 	
 	/// Check error code after reading and drop peer if error code.
 	bool checkRead(std::size_t _expected, boost::system::error_code _ec, std::size_t _length);
@@ -144,6 +171,18 @@ private:
 	void write();
 	void writeFrames();
 
+	/// @returns true if egress limits hold writing back for now, in which case @a _resume is called in the socket's strand once they allow it.
+	bool throttle(std::function<void()> const& _resume);
+
+	/// @returns the capability and its own packet type of a packet of type @a _type sent as @a _protocolID.
+	std::pair<std::string, unsigned> packetKind(uint16_t _protocolID, unsigned _type) const;
+
+	/// Counts a packet @a _bytes long on the wire.
+	void noteTraffic(std::pair<std::string, unsigned> const& _kind, bool _egress, size_t _bytes);
+
+	/// Counts time spent in the frame coder since @a _start.
+	void noteFrameCoder(std::chrono::steady_clock::time_point _start);
+
 	/// Deliver RLPX packet to Session or Capability for interpretation.
 	bool readPacket(uint16_t _capId, PacketType _t, RLP const& _r);
 
@@ -153,13 +192,28 @@ private:
 	/// @returns true iff the _msg forms a valid message for sending or receiving on the network.
 	static bool checkPacket(bytesConstRef _msg);
 
+	/// @returns true iff the packet made of @a _slices is valid for sending, going by its packet type and RLP prefix.
+	static bool checkPacket(std::vector<bytes> const& _slices);
+
+	/// Legacy packet, encrypted as it is queued, waiting to be written along with any others queued behind it.
+	struct EgressPacket
+	{
+		h256 header;				///< Frame header and header-mac.
+		std::vector<bytes> slices;	///< The packet, encrypted in place.
+		bytes tail;					///< Frame padding and frame-mac.
+	};
+
 	Host* m_server;							///< The host that owns us. Never null.
 
 	std::unique_ptr<RLPXFrameCoder> m_io;	///< Transport over which packets are sent.
 	std::shared_ptr<RLPXSocket> m_socket;		///< Socket of peer's connection.
-	Mutex x_framing;						///< Mutex for the write queue.
-	std::deque<bytes> m_writeQueue;			///< The write queue.
+	mutable Mutex x_framing;				///< Mutex for the write queue.
+	std::deque<EgressPacket> m_writeQueue;	///< The write queue; references to its packets stay valid while others are queued behind.
+	size_t m_writing = 0;					///< Number of packets at the front of m_writeQueue being written.
+	static const size_t c_maxPacketsPerWrite = 64;	///< Most packets gathered into one vectored write.
 	std::vector<byte> m_data;			    ///< Buffer for ingress packet data.
+	bytes m_uncompressed;					///< Packet type and decompressed payload of the last ingress packet, if compressing.
+	bool m_compression = false;				///< Whether packets after Hello are Snappy-compressed (both sides announced version 5 and we're not framing).
 	bytes m_incoming;						///< Read buffer for ingress bytes.
 
 	std::shared_ptr<Peer> m_peer;			///< The Peer object.
@@ -174,6 +228,15 @@ private:
 
 	std::map<CapDesc, std::shared_ptr<Capability>> m_capabilities;	///< The peer's capability set.
 
+	mutable Mutex x_traffic;
+	SessionTraffic m_traffic;								///< Counted so far; queue depths are only filled in by traffic().
+	std::shared_ptr<EndedSessionsTraffic> m_endedTraffic;	///< The host's totals, which m_traffic is added to as the session ends.
+	RateLimiter m_egressLimiter;							///< Bytes per second written to this peer.
+	std::unique_ptr<ba::deadline_timer> m_throttle;			///< Scheduled while egress limits hold writing back. Only used within the socket's strand.
+
+	std::shared_ptr<HandlerPool::Lane> m_handlers;					///< Handlers offloaded to the host's pool. Only used within the socket's strand.
+	static const unsigned c_maxQueuedHandlers = 16;					///< Reading pauses while this many offloaded handlers are unfinished.
+
 	// framing-related stuff (protected by x_writeQueue mutex)
 	struct Framing
 	{
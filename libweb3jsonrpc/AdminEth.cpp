@@ -45,6 +45,26 @@ Json::Value AdminEth::admin_eth_blockQueueStatus(string const& _session)
 	return ret;
 }
 
+Json::Value AdminEth::admin_eth_servedDataStatus(string const& _session)
+{
+	RPC_ADMIN;
+	Json::Value ret;
+	auto status = m_eth.servedDataStatus();
+	char const* const names[] = {"headers", "bodies", "receipts"};
+	for (unsigned i = 0; i < status.size(); ++i)
+	{
+		Json::Value s;
+		s["hits"] = (Json::UInt64)status[i].hits;
+		s["misses"] = (Json::UInt64)status[i].misses;
+		s["hitRate"] = status[i].hitRate();
+		s["servedBytes"] = (Json::UInt64)status[i].servedBytes;
+		s["cachedBytes"] = (Json::UInt64)status[i].cachedBytes;
+		s["cachedItems"] = (Json::UInt64)status[i].cachedItems;
+		ret[names[i]] = s;
+	}
+	return ret;
+}
+
 bool AdminEth::admin_eth_setAskPrice(string const& _wei, string const& _session)
 {
 	RPC_ADMIN;
@@ -28,6 +28,7 @@ public:
 
 	virtual bool admin_eth_setMining(bool _on, std::string const& _session) override;
 	virtual Json::Value admin_eth_blockQueueStatus(std::string const& _session) override;
+	virtual Json::Value admin_eth_servedDataStatus(std::string const& _session) override;
 	virtual bool admin_eth_setAskPrice(std::string const& _wei, std::string const& _session) override;
 	virtual bool admin_eth_setBidPrice(std::string const& _wei, std::string const& _session) override;
 	virtual Json::Value admin_eth_findBlock(std::string const& _blockHash, std::string const& _session) override;
@@ -15,6 +15,7 @@ namespace dev {
                 AdminEthFace()
                 {
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_eth_blockQueueStatus", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT, "param1",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminEthFace::admin_eth_blockQueueStatusI);
+                    this->bindAndAddMethod(jsonrpc::Procedure("admin_eth_servedDataStatus", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT, "param1",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminEthFace::admin_eth_servedDataStatusI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_eth_setAskPrice", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminEthFace::admin_eth_setAskPriceI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_eth_setBidPrice", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminEthFace::admin_eth_setBidPriceI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_eth_setMining", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN, "param1",jsonrpc::JSON_BOOLEAN,"param2",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminEthFace::admin_eth_setMiningI);
@@ -40,6 +41,10 @@ namespace dev {
                 {
                     response = this->admin_eth_blockQueueStatus(request[0u].asString());
                 }
+                inline virtual void admin_eth_servedDataStatusI(const Json::Value &request, Json::Value &response)
+                {
+                    response = this->admin_eth_servedDataStatus(request[0u].asString());
+                }
                 inline virtual void admin_eth_setAskPriceI(const Json::Value &request, Json::Value &response)
                 {
                     response = this->admin_eth_setAskPrice(request[0u].asString(), request[1u].asString());
@@ -119,6 +124,7 @@ namespace dev {
                     response = this->miner_hashrate();
                 }
                 virtual Json::Value admin_eth_blockQueueStatus(const std::string& param1) = 0;
+                virtual Json::Value admin_eth_servedDataStatus(const std::string& param1) = 0;
                 virtual bool admin_eth_setAskPrice(const std::string& param1, const std::string& param2) = 0;
                 virtual bool admin_eth_setBidPrice(const std::string& param1, const std::string& param2) = 0;
                 virtual bool admin_eth_setMining(bool param1, const std::string& param2) = 0;
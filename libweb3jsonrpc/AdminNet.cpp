@@ -38,6 +38,12 @@ Json::Value AdminNet::admin_net_peers(std::string const& _session)
 	return admin_peers();
 }
 
+std::string AdminNet::admin_net_metrics(std::string const& _session)
+{
+	RPC_ADMIN;
+	return m_network.networkMetrics();
+}
+
 Json::Value AdminNet::admin_net_nodeInfo(std::string const& _session)
 {
 	RPC_ADMIN;
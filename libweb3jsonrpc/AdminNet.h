@@ -23,6 +23,7 @@ public:
 	virtual bool admin_net_stop(std::string const& _session) override;
 	virtual bool admin_net_connect(std::string const& _node, std::string const& _session) override;
 	virtual Json::Value admin_net_peers(std::string const& _session) override;
+	virtual std::string admin_net_metrics(std::string const& _session) override;
 	virtual Json::Value admin_net_nodeInfo(std::string const& _session) override;
 	virtual Json::Value admin_nodeInfo() override;
 	virtual Json::Value admin_peers() override;
@@ -18,6 +18,7 @@ namespace dev {
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_net_stop", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN, "param1",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminNetFace::admin_net_stopI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_net_connect", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminNetFace::admin_net_connectI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_net_peers", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminNetFace::admin_net_peersI);
+                    this->bindAndAddMethod(jsonrpc::Procedure("admin_net_metrics", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_STRING, "param1",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminNetFace::admin_net_metricsI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_net_nodeInfo", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT, "param1",jsonrpc::JSON_STRING, NULL), &dev::rpc::AdminNetFace::admin_net_nodeInfoI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_nodeInfo", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT,  NULL), &dev::rpc::AdminNetFace::admin_nodeInfoI);
                     this->bindAndAddMethod(jsonrpc::Procedure("admin_peers", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT,  NULL), &dev::rpc::AdminNetFace::admin_peersI);
@@ -40,6 +41,10 @@ namespace dev {
                 {
                     response = this->admin_net_peers(request[0u].asString());
                 }
+                inline virtual void admin_net_metricsI(const Json::Value &request, Json::Value &response)
+                {
+                    response = this->admin_net_metrics(request[0u].asString());
+                }
                 inline virtual void admin_net_nodeInfoI(const Json::Value &request, Json::Value &response)
                 {
                     response = this->admin_net_nodeInfo(request[0u].asString());
@@ -62,6 +67,7 @@ namespace dev {
                 virtual bool admin_net_stop(const std::string& param1) = 0;
                 virtual bool admin_net_connect(const std::string& param1, const std::string& param2) = 0;
                 virtual Json::Value admin_net_peers(const std::string& param1) = 0;
+                virtual std::string admin_net_metrics(const std::string& param1) = 0;
                 virtual Json::Value admin_net_nodeInfo(const std::string& param1) = 0;
                 virtual Json::Value admin_nodeInfo() = 0;
                 virtual Json::Value admin_peers() = 0;
@@ -145,11 +145,10 @@ Json::Value Debug::debug_storageRangeAt(string const& _blockHashOrNumber, int _t
 		State state(State::Null);
 		createIntermediateState(state, block, i, m_eth.blockChain());
 
-		map<h256, pair<u256, u256>> const storage(state.storage(Address(_address)));
+		// begin is inclusive; fetch one more than asked for to find nextKey.
+		map<h256, pair<u256, u256>> const storage(state.storage(Address(_address), h256fromHex(_begin), (unsigned)_maxResults + 1));
 
-		// begin is inclusive
-		auto itBegin = storage.lower_bound(h256fromHex(_begin));
-		for (auto it = itBegin; it != storage.end(); ++it)
+		for (auto it = storage.begin(); it != storage.end(); ++it)
 		{
 			if (ret["storage"].size() == static_cast<unsigned>(_maxResults))
 			{
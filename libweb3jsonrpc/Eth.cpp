@@ -328,13 +328,8 @@ string Eth::eth_sendRawTransaction(std::string const& _rlp)
 {
 	try
 	{
-		if (client()->injectTransaction(jsToBytes(_rlp, OnFailed::Throw)) == ImportResult::Success)
-		{
-			Transaction tx(jsToBytes(_rlp, OnFailed::Throw), CheckTransaction::None);
-			return toJS(tx.sha3());
-		}
-		else
-			return toJS(h256());
+		// Verified and imported in the background; the outcome shows in the pending transactions.
+		return toJS(client()->queueTransaction(jsToBytes(_rlp, OnFailed::Throw)));
 	}
 	catch (...)
 	{
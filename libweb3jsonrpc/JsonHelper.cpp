@@ -78,6 +78,26 @@ Json::Value toJson(p2p::PeerSessionInfo const& _p)
 		ret["notes"][i.first] = i.second;
 	for (auto const& i: _p.caps)
 		ret["caps"].append(i.first + "/" + toString((unsigned)i.second));
+
+	auto counters = [](p2p::TrafficCounters const& _t) -> Json::Value
+	{
+		Json::Value c;
+		c["ingressBytes"] = (Json::UInt64)_t.ingressBytes;
+		c["ingressPackets"] = (Json::UInt64)_t.ingressPackets;
+		c["egressBytes"] = (Json::UInt64)_t.egressBytes;
+		c["egressPackets"] = (Json::UInt64)_t.egressPackets;
+		return c;
+	};
+	Json::Value& traffic = ret["traffic"];
+	traffic = counters(_p.traffic.total);
+	traffic["frameCoderMicroseconds"] = (Json::UInt64)_p.traffic.frameCoderMicroseconds;
+	traffic["throttledMicroseconds"] = (Json::UInt64)_p.traffic.throttledMicroseconds;
+	traffic["writeQueue"] = (Json::UInt64)_p.traffic.writeQueue;
+	traffic["writeQueueBytes"] = (Json::UInt64)_p.traffic.writeQueueBytes;
+	for (auto const& i: _p.traffic.capabilities())
+		traffic["caps"][i.first] = counters(i.second);
+	for (auto const& i: _p.traffic.packets)
+		traffic["packets"][i.first.first + "/" + toString(i.first.second)] = counters(i.second);
 	return ret;
 }
 
@@ -89,6 +89,9 @@ public:
 	/// Get network id
 	virtual u256 networkId() const = 0;
 
+	/// Get the traffic counters of the network and each peer, in Prometheus' text format.
+	virtual std::string networkMetrics() const = 0;
+
 	/// Gets the nodes.
 	virtual p2p::Peers nodes() const = 0;
 
@@ -191,6 +194,8 @@ public:
 
 	p2p::NodeInfo nodeInfo() const override { return m_net.nodeInfo(); }
 
+	std::string networkMetrics() const override { return m_net.metrics(); }
+
 	p2p::NodeID id() const override { return m_net.id(); }
 
 	u256 networkId() const override { return m_ethereum.get()->networkId(); }
@@ -0,0 +1,88 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RotatingBloom.cpp
+ * @date 2016
+ */
+
+#include <libdevcore/CommonIO.h>
+#include <libdevcore/RotatingBloom.h>
+#include <libdevcore/SHA3.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+
+namespace dev
+{
+namespace test
+{
+
+BOOST_FIXTURE_TEST_SUITE(RotatingBloomTest, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(remembersAGeneration)
+{
+	RotatingBloom<4096> bloom(1000);
+	for (unsigned i = 0; i < 1000; ++i)
+		bloom.insert(sha3(toString(i)));
+	for (unsigned i = 0; i < 1000; ++i)
+		BOOST_CHECK(bloom.contains(sha3(toString(i))));
+
+	// The first generation is still checked while the second fills up...
+	for (unsigned i = 1000; i < 2000; ++i)
+		bloom.insert(sha3(toString(i)));
+	for (unsigned i = 0; i < 2000; ++i)
+		BOOST_CHECK(bloom.contains(sha3(toString(i))));
+
+	// ...and dropped when the third starts.
+	bloom.insert(sha3(toString(2000)));
+	unsigned forgotten = 0;
+	for (unsigned i = 0; i < 1000; ++i)
+		forgotten += !bloom.contains(sha3(toString(i)));
+	BOOST_CHECK_GT(forgotten, 990);
+
+	bloom.clear();
+	BOOST_CHECK(!bloom.contains(sha3(toString(2000))));
+}
+
+BOOST_AUTO_TEST_CASE(sameBitsAsFixedHashBloom)
+{
+	RotatingBloom<256> bloom(1000);
+	FixedHash<256> reference;
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		bloom.insert(sha3(toString(i)));
+		reference.shiftBloom<3>(sha3(toString(i)));
+	}
+	for (unsigned i = 0; i < 1000; ++i)
+		BOOST_CHECK_EQUAL(bloom.contains(sha3(toString(i))), reference.containsBloom<3>(sha3(toString(i))));
+}
+
+BOOST_AUTO_TEST_CASE(falsePositives)
+{
+	RotatingBloom<4096> bloom(2048);
+	for (unsigned i = 0; i < 4096; ++i)
+		bloom.insert(sha3(toString(i)));
+	unsigned hits = 0;
+	for (unsigned i = 0; i < 10000; ++i)
+		hits += bloom.contains(sha3("other" + toString(i)));
+	BOOST_CHECK_LT(hits, 200);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
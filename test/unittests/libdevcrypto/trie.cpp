@@ -18,6 +18,7 @@
 #include <fstream>
 #include <boost/test/unit_test.hpp>
 #include <json_spirit/JsonSpiritHeaders.h>
+#include <libdevcore/ArenaTrieDB.h>
 #include <libdevcore/CommonIO.h>
 #include <libdevcore/TrieDB.h>
 #include <libdevcore/TrieHash.h>
@@ -97,20 +98,27 @@ BOOST_AUTO_TEST_CASE(hex_encoded_securetrie_test)
 			MemoryDB fm;
 			EnforceRefs fr(fm, true);
 			FatGenericTrieDB<MemoryDB> ft(&fm);
+			MemoryDB am;
+			EnforceRefs ar(am, true);
+			ArenaTrieDB<MemoryDB> at(&am);
 			t.init();
 			ht.init();
 			ft.init();
+			at.init();
 			BOOST_REQUIRE(t.check(true));
 			BOOST_REQUIRE(ht.check(true));
 			BOOST_REQUIRE(ft.check(true));
+			BOOST_REQUIRE(at.check(true));
 			for (auto const& k: ss)
 			{
 				t.insert(k.first, k.second);
 				ht.insert(k.first, k.second);
 				ft.insert(k.first, k.second);
+				at.insert(k.first, k.second);
 				BOOST_REQUIRE(t.check(true));
 				BOOST_REQUIRE(ht.check(true));
 				BOOST_REQUIRE(ft.check(true));
+				BOOST_REQUIRE(at.check(true));
 				auto i = ft.begin();
 				auto j = t.begin();
 				for (; i != ft.end() && j != t.end(); ++i, ++j)
@@ -120,6 +128,7 @@ BOOST_AUTO_TEST_CASE(hex_encoded_securetrie_test)
 					BOOST_REQUIRE((*i).second.toBytes() == (*j).second.toBytes());
 				}
 				BOOST_CHECK_EQUAL(ht.root(), ft.root());
+				BOOST_CHECK_EQUAL(t.root(), at.root());
 			}
 			BOOST_REQUIRE(!o["root"].is_null());
 			BOOST_CHECK_EQUAL(o["root"].get_str(), toHexPrefixed(ht.root().asArray()));
@@ -164,20 +173,27 @@ BOOST_AUTO_TEST_CASE(trie_test_anyorder)
 			MemoryDB fm;
 			EnforceRefs fr(fm, true);
 			FatGenericTrieDB<MemoryDB> ft(&fm);
+			MemoryDB am;
+			EnforceRefs ar(am, true);
+			ArenaTrieDB<MemoryDB> at(&am);
 			t.init();
 			ht.init();
 			ft.init();
+			at.init();
 			BOOST_REQUIRE(t.check(true));
 			BOOST_REQUIRE(ht.check(true));
 			BOOST_REQUIRE(ft.check(true));
+			BOOST_REQUIRE(at.check(true));
 			for (auto const& k: ss)
 			{
 				t.insert(k.first, k.second);
 				ht.insert(k.first, k.second);
 				ft.insert(k.first, k.second);
+				at.insert(k.first, k.second);
 				BOOST_REQUIRE(t.check(true));
 				BOOST_REQUIRE(ht.check(true));
 				BOOST_REQUIRE(ft.check(true));
+				BOOST_REQUIRE(at.check(true));
 				auto i = ft.begin();
 				auto j = t.begin();
 				for (; i != ft.end() && j != t.end(); ++i, ++j)
@@ -187,10 +203,12 @@ BOOST_AUTO_TEST_CASE(trie_test_anyorder)
 					BOOST_REQUIRE((*i).second.toBytes() == (*j).second.toBytes());
 				}
 				BOOST_CHECK_EQUAL(ht.root(), ft.root());
+				BOOST_CHECK_EQUAL(t.root(), at.root());
 			}
 			BOOST_REQUIRE(!o["root"].is_null());
 			BOOST_CHECK_EQUAL(o["root"].get_str(), toHexPrefixed(t.root().asArray()));
 			BOOST_CHECK_EQUAL(ht.root(), ft.root());
+			BOOST_CHECK_EQUAL(t.root(), at.root());
 		}
 	}
 }
@@ -249,22 +267,28 @@ BOOST_AUTO_TEST_CASE(trie_tests_ordered)
 		MemoryDB fm;
 		EnforceRefs fr(fm, true);
 		FatGenericTrieDB<MemoryDB> ft(&fm);
+		MemoryDB am;
+		EnforceRefs ar(am, true);
+		ArenaTrieDB<MemoryDB> at(&am);
 		t.init();
 		ht.init();
 		ft.init();
+		at.init();
 		BOOST_REQUIRE(t.check(true));
 		BOOST_REQUIRE(ht.check(true));
 		BOOST_REQUIRE(ft.check(true));
+		BOOST_REQUIRE(at.check(true));
 
 		for (auto const& k: ss)
 		{
 			if (find(keysToBeDeleted.begin(), keysToBeDeleted.end(), k.first) != keysToBeDeleted.end() && k.second.empty())
-				t.remove(k.first), ht.remove(k.first), ft.remove(k.first);
+				t.remove(k.first), ht.remove(k.first), ft.remove(k.first), at.remove(k.first);
 			else
-				t.insert(k.first, k.second), ht.insert(k.first, k.second), ft.insert(k.first, k.second);
+				t.insert(k.first, k.second), ht.insert(k.first, k.second), ft.insert(k.first, k.second), at.insert(k.first, k.second);
 			BOOST_REQUIRE(t.check(true));
 			BOOST_REQUIRE(ht.check(true));
 			BOOST_REQUIRE(ft.check(true));
+			BOOST_REQUIRE(at.check(true));
 			auto i = ft.begin();
 			auto j = t.begin();
 			for (; i != ft.end() && j != t.end(); ++i, ++j)
@@ -274,6 +298,7 @@ BOOST_AUTO_TEST_CASE(trie_tests_ordered)
 				BOOST_REQUIRE((*i).second.toBytes() == (*j).second.toBytes());
 			}
 			BOOST_CHECK_EQUAL(ht.root(), ft.root());
+			BOOST_CHECK_EQUAL(t.root(), at.root());
 		}
 
 		BOOST_REQUIRE(!o["root"].is_null());
@@ -490,6 +515,86 @@ BOOST_AUTO_TEST_CASE(trieLowerBound)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(trieScan)
+{
+	MemoryDB dm;
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+	StringMap m;
+	for (int i = 0; i < 500; ++i)
+	{
+		auto k = randomWord();
+		m[k] = toString(i);
+		d.insert(k, m[k]);
+	}
+
+	vector<pair<string, string>> all;
+	BOOST_CHECK_EQUAL(d.scan(bytesConstRef(), 10000, [&](bytesConstRef _k, bytesConstRef _v) { all.push_back(make_pair(_k.toString(), _v.toString())); return true; }), m.size());
+	vector<pair<string, string>> expected(m.begin(), m.end());
+	BOOST_REQUIRE(all == expected);
+
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		string start = i % 2 ? randomWord() : next(m.begin(), i % m.size())->first;
+		vector<pair<string, string>> part;
+		d.scan(bytesConstRef(start), 7, [&](bytesConstRef _k, bytesConstRef _v) { part.push_back(make_pair(_k.toString(), _v.toString())); return true; });
+		auto from = m.lower_bound(start);
+		vector<pair<string, string>> expected;
+		for (auto it = from; it != m.end() && expected.size() < 7; ++it)
+			expected.push_back(*it);
+		BOOST_REQUIRE(part == expected);
+	}
+
+	unsigned visited = 0;
+	d.scan(bytesConstRef(), 10000, [&](bytesConstRef, bytesConstRef) { return ++visited < 3; });
+	BOOST_CHECK_EQUAL(visited, 3);
+}
+
+BOOST_AUTO_TEST_CASE(trieParallelScan)
+{
+	MemoryDB dm;
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+	StringMap m;
+	for (int i = 0; i < 1000; ++i)
+	{
+		auto k = h256(i).asBytes();
+		m[asString(k)] = toString(i);
+		d.insert(sha3(k).asBytes(), asBytes(toString(i)));
+	}
+
+	Mutex x;
+	set<string> values;
+	d.parallelScan([&](bytesConstRef, bytesConstRef _v) { Guard l(x); values.insert(_v.toString()); return true; }, 4);
+	BOOST_CHECK_EQUAL(values.size(), m.size());
+	for (auto const& i: m)
+		BOOST_CHECK(values.count(i.second));
+}
+
+BOOST_AUTO_TEST_CASE(trieRangeProof)
+{
+	MemoryDB dm;
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+	for (int i = 0; i < 200; ++i)
+		d.insert(sha3(h256(i)).asBytes(), asBytes(toString(i)));
+
+	h256 start = sha3(h256(42));
+	vector<pair<bytes, bytes>> range;
+	vector<bytes> proof;
+	d.scan(start.ref(), 20, [&](bytesConstRef _k, bytesConstRef _v) { range.push_back(make_pair(_k.toBytes(), _v.toBytes())); return true; }, &proof);
+	BOOST_REQUIRE_EQUAL(range.size(), 20);
+
+	// The proof alone must be enough to look up both ends of the range.
+	MemoryDB pm;
+	for (auto const& n: proof)
+		pm.insert(sha3(n), &n);
+	GenericTrieDB<MemoryDB> p(&pm, d.root());
+	BOOST_CHECK(asBytes(p.at(range.front().first)) == range.front().second);
+	BOOST_CHECK(asBytes(p.at(range.back().first)) == range.back().second);
+	BOOST_CHECK(range.front().first == start.asBytes());
+}
+
 BOOST_AUTO_TEST_CASE(trieStess)
 {
 	cnote << "Stress-testing Trie...";
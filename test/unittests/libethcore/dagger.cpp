@@ -23,8 +23,10 @@
 #include <fstream>
 #include <json_spirit/JsonSpiritHeaders.h>
 #include <libdevcore/CommonIO.h>
+#include <libdevcore/TransientDirectory.h>
 #include <libethashseal/Ethash.h>
 #include <libethashseal/EthashAux.h>
+#include <libethash/internal.h>
 #include <boost/test/unit_test.hpp>
 #include <test/tools/libtesteth/TestHelper.h>
 
@@ -77,7 +79,102 @@ BOOST_AUTO_TEST_CASE(basic_test)
 		EthashProofOfWork::Result r = EthashAux::eval(Ethash::seedHash(header), header.hash(WithoutSeal), Ethash::nonce(header));
 		BOOST_REQUIRE_EQUAL(r.value, result);
 		BOOST_REQUIRE_EQUAL(r.mixHash, Ethash::mixHash(header));
+
+		// The batch evaluation agrees, wherever in its batch the header lands.
+		h256s headerHashes(ETHASH_BATCH_NONCES + 3, sha3("other"));
+		vector<Nonce> nonces(headerHashes.size(), Nonce(u64(42)));
+		headerHashes.back() = headerHashes[5] = header.hash(WithoutSeal);
+		nonces.back() = nonces[5] = Ethash::nonce(header);
+		auto batch = EthashAux::eval(Ethash::seedHash(header), headerHashes, nonces, 2);
+		BOOST_REQUIRE_EQUAL(batch.size(), headerHashes.size());
+		BOOST_CHECK_EQUAL(batch[5].value, result);
+		BOOST_CHECK_EQUAL(batch.back().mixHash, Ethash::mixHash(header));
+		BOOST_CHECK(batch[0].value != result);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(batchMatchesSingle)
+{
+	// A small DAG over a small cache is enough to exercise the kernels.
+	ethash_h256_t seed;
+	memset(&seed, 7, 32);
+	ethash_light_t light = ethash_light_new_internal(64 * 1024, &seed);
+	BOOST_REQUIRE(light);
+	uint64_t const size = 1024 * 1024 + 3 * ETHASH_MIX_BYTES;
+	vector<node> dag(size / sizeof(node));
+	BOOST_REQUIRE(ethash_compute_full_data(dag.data(), size, light, nullptr));
+	ethash_light_delete(light);
+
+	ethash_full full;
+	full.file = nullptr;
+	full.file_size = size;
+	full.data = dag.data();
+	h256 headerHash = sha3("header");
+	ethash_h256_t const& header = *(ethash_h256_t const*)headerHash.data();
+	for (uint64_t start = 0; start < 100000; start += 9973)
+		for (unsigned count = 1; count <= ETHASH_BATCH_NONCES; ++count)
+		{
+			ethash_return_value_t batch[ETHASH_BATCH_NONCES];
+			BOOST_REQUIRE(ethash_full_compute_batch(&full, header, start, count, batch));
+			for (unsigned i = 0; i < count; ++i)
+			{
+				ethash_return_value_t single = ethash_full_compute(&full, header, start + i);
+				BOOST_CHECK(!memcmp(&single.result, &batch[i].result, 32));
+				BOOST_CHECK(!memcmp(&single.mix_hash, &batch[i].mix_hash, 32));
+			}
+		}
+	ethash_return_value_t r[ETHASH_BATCH_NONCES + 1];
+	BOOST_CHECK(!ethash_full_compute_batch(&full, header, 0, ETHASH_BATCH_NONCES + 1, r));
+}
+
+BOOST_AUTO_TEST_CASE(sharedReadOnlyDAG)
+{
+	TransientDirectory td;
+	ethash_h256_t seed;
+	memset(&seed, 9, 32);
+	ethash_light_t light = ethash_light_new_internal(64 * 1024, &seed);
+	BOOST_REQUIRE(light);
+	uint64_t const size = 1024 * 1024 + 3 * ETHASH_MIX_BYTES;
+
+	// Nothing to share yet.
+	BOOST_CHECK(!ethash_full_new_flags(td.path().c_str(), seed, size, light, nullptr, ETHASH_FULL_READONLY));
+
+	ethash_full_t generated = ethash_full_new_flags(td.path().c_str(), seed, size, light, nullptr, 0);
+	BOOST_REQUIRE(generated);
+	ethash_full_t shared = ethash_full_new_flags(td.path().c_str(), seed, size, light, nullptr, ETHASH_FULL_READONLY | ETHASH_FULL_POPULATE);
+	BOOST_REQUIRE(shared);
+	BOOST_CHECK(!memcmp(ethash_full_dag(generated), ethash_full_dag(shared), size));
+
+	h256 headerHash = sha3("header");
+	ethash_h256_t const& header = *(ethash_h256_t const*)headerHash.data();
+	ethash_return_value_t a = ethash_full_compute(generated, header, 42);
+	ethash_return_value_t b = ethash_full_compute(shared, header, 42);
+	BOOST_CHECK(!memcmp(&a.result, &b.result, 32));
+	BOOST_CHECK(!memcmp(&a.mix_hash, &b.mix_hash, 32));
+
+	ethash_full_delete(shared);
+	ethash_full_delete(generated);
+	ethash_light_delete(light);
+}
+
+BOOST_AUTO_TEST_CASE(fullDataMatchesItems)
+{
+	ethash_h256_t seed;
+	memset(&seed, 9, 32);
+	ethash_light_t light = ethash_light_new_internal(64 * 1024, &seed);
+	BOOST_REQUIRE(light);
+	// Not a whole number of generation chunks or batches.
+	uint64_t const size = 1024 * 1024 + 5 * ETHASH_MIX_BYTES;
+	vector<node> dag(size / sizeof(node));
+	BOOST_REQUIRE(ethash_compute_full_data(dag.data(), size, light, nullptr));
+	for (uint32_t i = 0; i < dag.size(); ++i)
+	{
+		node item;
+		ethash_calculate_dag_item(&item, i, light);
+		BOOST_REQUIRE(!memcmp(&item, &dag[i], sizeof(node)));
 	}
+	BOOST_CHECK(!ethash_compute_full_data(dag.data(), size, light, [](unsigned _p) { return _p >= 50 ? 1 : 0; }));
+	ethash_light_delete(light);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -259,6 +259,43 @@ BOOST_AUTO_TEST_CASE(bGasPricer)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(bSyncAndReplay)
+{
+	TestBlockChain testBlockchain(TestBlockChain::defaultGenesisBlock(63000));
+	TestBlock const& genesisBlock = testBlockchain.testGenesis();
+	OverlayDB const& genesisDB = genesisBlock.state().db();
+	BlockChain const& blockchain = testBlockchain.interface();
+
+	// Imported out of nonce order; one sync still takes them all.
+	TestBlock testBlock;
+	TestTransaction transaction3 = TestTransaction::defaultTransaction(3, 1, 21000);
+	TestTransaction transaction1 = TestTransaction::defaultTransaction(1, 1, 21000);
+	TestTransaction transaction2 = TestTransaction::defaultTransaction(2, 1, 21000);
+	testBlock.addTransaction(transaction3);
+	testBlock.addTransaction(transaction1);
+	testBlock.addTransaction(transaction2);
+
+	ZeroGasPricer gp;
+	Block block = blockchain.genesisBlock(genesisDB);
+	block.sync(blockchain);
+	block.sync(blockchain, testBlock.transactionQueue(), gp);
+	BOOST_REQUIRE_EQUAL(block.pending().size(), 3);
+
+	// Replaying the pending transactions on another block gives the same state.
+	Block replayed = blockchain.genesisBlock(genesisDB);
+	replayed.sync(blockchain);
+	TransactionReceipts receipts = replayed.replay(blockchain, block.pending());
+	BOOST_REQUIRE_EQUAL(receipts.size(), 3);
+	BOOST_CHECK(receipts.back().stateRoot() == block.receipt(2).stateRoot());
+
+	// Once a sender's transaction fails, its later ones are skipped.
+	Block skipped = blockchain.genesisBlock(genesisDB);
+	skipped.sync(blockchain);
+	receipts = skipped.replay(blockchain, Transactions { block.pending()[1], block.pending()[2] });
+	BOOST_CHECK(receipts.empty());
+	BOOST_CHECK(skipped.pending().empty());
+}
+
 BOOST_AUTO_TEST_CASE(bGetReceiptOverflow)
 {
 	TestBlockChain bc;
@@ -539,4 +539,26 @@ BOOST_AUTO_TEST_CASE(updateStats)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(verifyState)
+{
+	TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
+	for (unsigned i = 1; i <= 5; ++i)
+	{
+		TestBlock block;
+		block.addTransaction(TestTransaction::defaultTransaction(i));
+		block.mine(bc);
+		bc.addBlock(block);
+	}
+
+	BlockChain& bcRef = bc.interfaceUnsafe();
+	OverlayDB const& db = bc.testGenesis().state().db();
+	unsigned progress = 0;
+	BOOST_CHECK_EQUAL(bcRef.verifyState(db, 1, bcRef.number(), 4, [&](unsigned _done, unsigned) { progress = _done; }), 0);
+	BOOST_CHECK_EQUAL(progress, 5);
+	BOOST_CHECK_EQUAL(bcRef.verifiedCheckpoint(), bcRef.number());
+
+	// Nothing left to verify past the checkpoint.
+	BOOST_CHECK_EQUAL(bcRef.verifyState(db, bcRef.verifiedCheckpoint() + 1, bcRef.number(), 4), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,453 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file BlockChainSync.cpp
+ * @date 2016
+ * Syncs through EthereumHost and BlockChainSync from simulated peers that answer at a set latency and rate.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <boost/test/unit_test.hpp>
+#include <libdevcore/Log.h>
+#include <libethereum/Block.h>
+#include <libethereum/BlockQueue.h>
+#include <libethereum/EthereumHost.h>
+#include <libethereum/TransactionQueue.h>
+#include <libp2p/Host.h>
+#include <test/tools/libtesteth/BlockChainHelper.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using namespace dev::p2p;
+using namespace dev::test;
+
+namespace dev
+{
+namespace test
+{
+
+/// Keeps what is sent on it for SyncSimulation to answer.
+class SimulatedSession: public SessionFace
+{
+public:
+	explicit SimulatedSession(NodeID const& _id): m_id(_id) {}
+
+	void start() override { }
+	void disconnect(DisconnectReason /*_reason*/) override { }
+
+	void ping() override { }
+
+	bool isConnected() const override { return true; }
+
+	NodeID id() const override { return m_id; }
+
+	void sealAndSend(RLPStream& _s, uint16_t /*_protocolID*/) override
+	{
+		bytes packet;
+		_s.swapOut(packet);
+		sent.push_back(move(packet));
+	}
+
+	int rating() const override { return m_rating; }
+	void addRating(int _r) override { m_rating += _r; ratings.push_back(_r); }
+
+	void addNote(string const& /*_k*/, string const& /*_v*/) override { }
+
+	PeerSessionInfo info() const override { return PeerSessionInfo{ m_id, "", "", 0, chrono::steady_clock::duration{}, {}, 0, {}, 0, SessionTraffic() }; }
+	chrono::steady_clock::time_point connectionTime() override { return chrono::steady_clock::time_point{}; }
+
+	void registerCapability(CapDesc const& _desc, shared_ptr<Capability> _p) override { m_capabilities[_desc] = _p; }
+	void registerFraming(uint16_t /*_id*/) override { }
+
+	map<CapDesc, shared_ptr<Capability>> const& capabilities() const override { return m_capabilities; }
+
+	shared_ptr<Peer> peer() const override { return shared_ptr<Peer>(); }
+
+	chrono::steady_clock::time_point lastReceived() const override { return chrono::steady_clock::time_point{}; }
+
+	ReputationManager& repMan() override { return m_repMan; }
+
+	vector<bytes> sent;		///< Packets not yet taken by the simulation.
+	vector<int> ratings;	///< Every change to the rating, in order.
+
+private:
+	NodeID m_id;
+	int m_rating = 0;
+	ReputationManager m_repMan;
+	map<CapDesc, shared_ptr<Capability>> m_capabilities;
+};
+
+/**
+ * @brief An EthereumHost, with its BlockChainSync, connected to simulated peers instead of a p2p::Host.
+ * Each peer answers requests for headers and bodies from a chain of its own, one reply at a time, each
+ * after a latency and at a rate. Requests and replies go through EthereumPeer as packets, as on the wire.
+ */
+class SyncSimulation: public EthereumHost
+{
+public:
+	using Clock = chrono::steady_clock;
+
+	SyncSimulation(BlockChain const& _chain, OverlayDB const& _db, TransactionQueue& _tq, BlockQueue& _bq):
+		EthereumHost(_chain, _db, _tq, _bq, 1)
+	{}
+
+	~SyncSimulation()
+	{
+		// Peers tell the sync they're going as they're destroyed; it mustn't find them listed.
+		auto peers = move(m_peers);
+		m_peers.clear();
+	}
+
+	/// Connects a peer serving @a _chain, which answers each request @a _latency seconds after the previous reply
+	/// and sends @a _itemsPerSecond headers or bodies a second. Requests skipping headers (skeletons) are answered
+	/// from @a _skeleton instead, if given. The peer claims @a _extraDifficulty more than @a _chain has.
+	/// @returns the peer's index.
+	unsigned addPeer(BlockChain const& _chain, double _latency, double _itemsPerSecond, BlockChain const* _skeleton = nullptr, u256 const& _extraDifficulty = 0)
+	{
+		SimulatedPeer p;
+		p.chain = &_chain;
+		p.skeleton = _skeleton ? _skeleton : &_chain;
+		p.latency = _latency;
+		p.itemsPerSecond = _itemsPerSecond;
+		p.session = make_shared<SimulatedSession>(NodeID(m_peers.size() + 1));
+		p.capability = static_pointer_cast<EthereumPeer>(newPeerCapability(p.session, UserPacket, CapDesc(EthereumPeer::name(), EthereumPeer::version()), 0));
+		p.session->sent.clear();
+		m_peers.push_back(p);
+
+		// Its status arrives straight away.
+		RLPStream s(5);
+		s << protocolVersion() << networkId() << _chain.details().totalDifficulty + _extraDifficulty << _chain.currentHash() << _chain.genesisHash();
+		p.capability->interpret(StatusPacket, RLP(s.out()));
+		return m_peers.size() - 1;
+	}
+
+	/// Runs until block @a _hash is queued for import, at most @a _timeout seconds. @returns the seconds it took, or -1.
+	double run(h256 const& _hash, double _timeout)
+	{
+		auto const start = Clock::now();
+		auto lastTick = start;
+		while (bq().blockStatus(_hash) != QueueStatus::Ready)
+		{
+			auto const now = Clock::now();
+			if (now - start > duration(_timeout))
+				return -1;
+			for (auto& p: m_peers)
+			{
+				for (auto const& packet: p.session->sent)
+					answer(p, packet, now);
+				p.session->sent.clear();
+			}
+			unsigned filling = 0;
+			for (auto const& p: m_peers)
+				filling += any_of(p.replies.begin(), p.replies.end(), [](Reply const& _r) { return _r.fillsRange; });
+			m_mostFilling = max(m_mostFilling, filling);
+			for (auto& p: m_peers)
+				while (!p.replies.empty() && p.replies.front().at <= now)
+				{
+					Reply r = move(p.replies.front());
+					p.replies.pop_front();
+					p.capability->interpret(r.packet, RLP(r.data));
+				}
+			if (now - lastTick >= chrono::seconds(1))
+			{
+				// As doWork() does.
+				lastTick = now;
+				RecursiveGuard l(x_sync);
+				m_sync->tick();
+			}
+			// After a restart the sync waits for news of a block.
+			if (status().state == SyncState::NotSynced)
+				announce(_hash);
+			this_thread::sleep_for(chrono::milliseconds(1));
+		}
+		return chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	/// @returns the number of requests peer @a _peer has answered.
+	unsigned requests(unsigned _peer) const { return m_peers.at(_peer).requests; }
+
+	/// @returns the most peers that were filling in ranges of headers at the same time.
+	unsigned mostFillingAtOnce() const { return m_mostFilling; }
+
+	/// @returns whether any header or body asked of peer @a _peer was later asked of another peer as well.
+	bool handedOn(unsigned _peer) const
+	{
+		for (auto const& r: m_peers.at(_peer).asked)
+			for (unsigned i = 0; i < m_peers.size(); ++i)
+				if (i != _peer)
+					for (auto const& later: m_peers[i].asked)
+						if (later.order > r.order && later.bodies == r.bodies && find_first_of(later.numbers.begin(), later.numbers.end(), r.numbers.begin(), r.numbers.end()) != later.numbers.end())
+							return true;
+		return false;
+	}
+
+	/// @returns every change made to the rating of peer @a _peer, in order.
+	vector<int> const& ratings(unsigned _peer) const { return m_peers.at(_peer).session->ratings; }
+
+	void foreachPeer(function<bool(shared_ptr<EthereumPeer>)> const& _f) const override
+	{
+		for (auto const& p: m_peers)
+			if (!_f(p.capability))
+				return;
+	}
+
+private:
+	struct Reply
+	{
+		Clock::time_point at;
+		unsigned packet;
+		bytes data;
+		bool fillsRange;	///< Answers a request for consecutive headers by number.
+	};
+
+	/// Headers or bodies asked of a peer, by block number.
+	struct Request
+	{
+		unsigned order;		///< Of all requests to any peer.
+		bool bodies;
+		vector<unsigned> numbers;
+	};
+
+	struct SimulatedPeer
+	{
+		BlockChain const* chain;
+		BlockChain const* skeleton;
+		double latency;
+		double itemsPerSecond;
+		shared_ptr<SimulatedSession> session;
+		shared_ptr<EthereumPeer> capability;
+		deque<Reply> replies;
+		unsigned requests = 0;
+		vector<Request> asked;	///< Skeletons and requests by hash left out.
+	};
+
+	static Clock::duration duration(double _seconds) { return chrono::duration_cast<Clock::duration>(chrono::duration<double>(_seconds)); }
+
+	/// Queues the reply of @a _p to @a _packet, sent at @a _now.
+	void answer(SimulatedPeer& _p, bytes const& _packet, Clock::time_point _now)
+	{
+		RLP r(bytesConstRef(&_packet).cropped(1));
+		pair<bytes, unsigned> reply;
+		unsigned packet;
+		bool fillsRange = false;
+		Request asked{m_requestCount++, false, {}};
+		switch (_packet[0] - UserPacket)
+		{
+		case GetBlockHeadersPacket:
+			reply = headers(r[2].toInt<unsigned>() ? *_p.skeleton : *_p.chain, r);
+			packet = BlockHeadersPacket;
+			fillsRange = r[0].size() != 32 && !r[2].toInt<unsigned>();
+			if (fillsRange)
+				for (unsigned i = 0; i < r[1].toInt<unsigned>(); ++i)
+					asked.numbers.push_back(r[0].toInt<unsigned>() + i);
+			break;
+		case GetBlockBodiesPacket:
+			reply = bodies(*_p.chain, r);
+			packet = BlockBodiesPacket;
+			asked.bodies = true;
+			for (auto const& i: r)
+				if (_p.chain->isKnown(i.toHash<h256>()))
+					asked.numbers.push_back(_p.chain->number(i.toHash<h256>()));
+			break;
+		default:
+			return;
+		}
+		++_p.requests;
+		if (!asked.numbers.empty())
+			_p.asked.push_back(move(asked));
+		auto const from = _p.replies.empty() ? _now : max(_now, _p.replies.back().at);
+		_p.replies.push_back(Reply{from + duration(_p.latency + reply.second / _p.itemsPerSecond), packet, move(reply.first), fillsRange});
+	}
+
+	/// Tells the sync of block @a _hash from the first idle peer that has it.
+	void announce(h256 const& _hash)
+	{
+		for (auto& p: m_peers)
+			if (p.replies.empty() && p.capability->m_asking == Asking::Nothing && p.chain->isKnown(_hash))
+			{
+				RLPStream s(1);
+				s.appendList(2) << _hash << p.chain->number(_hash);
+				p.capability->interpret(NewBlockHashesPacket, RLP(s.out()));
+				return;
+			}
+	}
+
+	/// @returns the headers of @a _chain that GetBlockHeaders @a _r asks for, and how many there are.
+	static pair<bytes, unsigned> headers(BlockChain const& _chain, RLP const& _r)
+	{
+		unsigned number = _chain.number() + 1;
+		if (_r[0].size() != 32)
+			number = _r[0].toInt<unsigned>();
+		else if (_chain.isKnown(_r[0].toHash<h256>()))
+			number = _chain.number(_r[0].toHash<h256>());
+		unsigned const count = _r[1].toInt<unsigned>();
+		unsigned const step = _r[2].toInt<unsigned>() + 1;
+		bool const reverse = _r[3].toInt<bool>();
+
+		vector<bytes> found;
+		while (found.size() < count && number <= _chain.number())
+		{
+			found.push_back(_chain.headerData(_chain.numberHash(number)));
+			if (reverse && number < step)
+				break;
+			number = reverse ? number - step : number + step;
+		}
+		RLPStream s(found.size());
+		for (auto const& h: found)
+			s.appendRaw(h);
+		return make_pair(s.out(), (unsigned)found.size());
+	}
+
+	/// @returns the bodies of @a _chain that GetBlockBodies @a _r asks for, and how many there are.
+	static pair<bytes, unsigned> bodies(BlockChain const& _chain, RLP const& _r)
+	{
+		vector<bytes> found;
+		for (auto const& i: _r)
+		{
+			h256 const hash = i.toHash<h256>();
+			if (!_chain.isKnown(hash))
+				continue;
+			bytes const block = _chain.block(hash);
+			RLP const b(block);
+			RLPStream body(2);
+			body.appendRaw(b[1].data()).appendRaw(b[2].data());
+			found.push_back(body.out());
+		}
+		RLPStream s(found.size());
+		for (auto const& b: found)
+			s.appendRaw(b);
+		return make_pair(s.out(), (unsigned)found.size());
+	}
+
+	vector<SimulatedPeer> m_peers;
+	unsigned m_requestCount = 0;
+	unsigned m_mostFilling = 0;
+};
+
+}
+}
+
+namespace
+{
+
+/// Adds @a _blocks empty blocks by @a _author to @a _chain, each a second after its parent, so none is in the future.
+void growChain(TestBlockChain& _chain, unsigned _blocks, Address const& _author)
+{
+	BlockChain& bc = _chain.interfaceUnsafe();
+	OverlayDB const& db = _chain.testGenesis().state().db();
+	for (unsigned i = 0; i < _blocks; ++i)
+	{
+		Block block = bc.genesisBlock(db);
+		block.setAuthor(_author);
+		block.sync(bc);
+		block.resetCurrent(0);
+		dev::eth::mine(block, bc, bc.sealEngine());
+		bc.import(block.blockData(), db);
+	}
+}
+
+/// A chain with just the genesis block to sync into, and the host syncing it.
+struct LocalNode
+{
+	LocalNode() { bq.setChain(chain.interface()); }
+
+	TestBlockChain chain;
+	TransactionQueue tq;
+	BlockQueue bq;
+	SyncSimulation host{chain.interface(), chain.testGenesis().state().db(), tq, bq};
+};
+
+class SyncSimulationFixture: public TestOutputHelper
+{
+public:
+	SyncSimulationFixture(): networkSelector(eth::Network::FrontierNoProofTest) {}
+
+	NetworkSelector networkSelector;
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(BlockChainSyncSuite, SyncSimulationFixture)
+
+BOOST_AUTO_TEST_CASE(blockChainSyncSlowPeer)
+{
+	TestBlockChain source;
+	growChain(source, 400, Address(1));
+	h256 const top = source.interface().currentHash();
+
+	// The slow peer comes last, so while it's still unmeasured it's given the third range of headers.
+	LocalNode local;
+	for (unsigned i = 0; i < 3; ++i)
+		local.host.addPeer(source.interface(), 0.02, 1000);
+	unsigned const slow = local.host.addPeer(source.interface(), 0.02, 1);
+	double const took = local.host.run(top, 60);
+	cnote << "Synced 400 headers from three fast peers and a slow one in" << took << "s";
+
+	// Its 32 headers would take it 32s; they're asked of a fast peer too once it's straggling.
+	BOOST_REQUIRE(took >= 0);
+	BOOST_CHECK(local.host.requests(slow) > 0);
+	BOOST_CHECK(local.host.handedOn(slow));
+}
+
+BOOST_AUTO_TEST_CASE(blockChainSyncScalesWithPeers)
+{
+	TestBlockChain source;
+	growChain(source, 800, Address(1));
+	h256 const top = source.interface().currentHash();
+
+	// The skeleton's four gaps let every peer fill one at once, once it has arrived.
+	unsigned const peers[2] = {1, 4};
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		LocalNode local;
+		for (unsigned j = 0; j < peers[i]; ++j)
+			local.host.addPeer(source.interface(), 0.05, 500);
+		double const took = local.host.run(top, 60);
+		cnote << "Synced 800 headers from" << peers[i] << "peers in" << took << "s";
+		BOOST_REQUIRE(took >= 0);
+		BOOST_CHECK_EQUAL(local.host.mostFillingAtOnce(), peers[i]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(blockChainSyncBadSkeleton)
+{
+	TestBlockChain source;
+	growChain(source, 600, Address(1));
+	TestBlockChain fork;
+	growChain(fork, 600, Address(2));
+	h256 const top = source.interface().currentHash();
+
+	// The best peer's skeleton comes from another chain, so the headers filling its gaps never link up with it.
+	LocalNode local;
+	unsigned const liar = local.host.addPeer(source.interface(), 0.02, 1000, &fork.interface(), 1);
+	for (unsigned i = 0; i < 3; ++i)
+		local.host.addPeer(source.interface(), 0.02, 1000);
+	double const took = local.host.run(top, 60);
+	cnote << "Synced 600 headers past a bad skeleton in" << took << "s";
+
+	// The sync restarts without asking it for a skeleton again, and it's rated down for the one it gave.
+	BOOST_REQUIRE(took >= 0);
+	BOOST_CHECK_EQUAL(count(local.host.ratings(liar).begin(), local.host.ratings(liar).end(), -10), 1);
+	for (unsigned i = 1; i < 4; ++i)
+		BOOST_CHECK_EQUAL(count(local.host.ratings(i).begin(), local.host.ratings(i).end(), -10), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
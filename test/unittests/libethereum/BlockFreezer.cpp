@@ -0,0 +1,107 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file BlockFreezer.cpp
+ * @date 2016
+ * Ancient block freezer tests.
+ */
+
+#include <libethereum/BlockChain.h>
+#include <libethereum/BlockFreezer.h>
+#include <libdevcore/TransientDirectory.h>
+#include <test/tools/libtesteth/TestHelper.h>
+#include <test/tools/libtesteth/BlockChainHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using namespace dev::test;
+
+BOOST_FIXTURE_TEST_SUITE(BlockFreezerSuite, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(appendAndReopen)
+{
+	TransientDirectory td;
+	{
+		BlockFreezer f(td.path());
+		for (unsigned i = 0; i < 100; ++i)
+		{
+			bytes b(i + 1, (byte)i);
+			bytes r(i % 3, (byte)(i + 1));
+			f.append(&b, &r);
+		}
+		f.sync();
+		BOOST_CHECK_EQUAL(f.count(), 100);
+	}
+
+	BlockFreezer f(td.path());
+	BOOST_REQUIRE_EQUAL(f.count(), 100);
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		BOOST_CHECK(f.block(i) == bytes(i + 1, (byte)i));
+		BOOST_CHECK(f.receipts(i) == bytes(i % 3, (byte)(i + 1)));
+	}
+	BOOST_CHECK(f.block(100).empty());
+}
+
+BOOST_AUTO_TEST_CASE(truncation)
+{
+	TransientDirectory td;
+	BlockFreezer f(td.path());
+	for (unsigned i = 0; i < 10; ++i)
+	{
+		bytes b(8, (byte)i);
+		f.append(&b, &b);
+	}
+	f.truncate(4);
+	BOOST_CHECK_EQUAL(f.count(), 4);
+	BOOST_CHECK(f.block(4).empty());
+
+	bytes b = { 1, 2, 3 };
+	f.append(&b, &b);
+	BOOST_CHECK_EQUAL(f.count(), 5);
+	BOOST_CHECK(f.block(3) == bytes(8, 3));
+	BOOST_CHECK(f.block(4) == b);
+}
+
+BOOST_AUTO_TEST_CASE(blockChainFallback)
+{
+	dev::test::TestBlockChain::s_sealEngineNetwork = eth::Network::FrontierTest;
+	TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
+	for (unsigned i = 1; i <= 3; ++i)
+	{
+		TestBlock block;
+		block.addTransaction(TestTransaction::defaultTransaction(i));
+		block.mine(bc);
+		bc.addBlock(block);
+	}
+
+	BlockChain& chain = bc.interfaceUnsafe();
+	h256 h = chain.numberHash(2);
+	bytes b = chain.block(h);
+	bytes r = chain.receipts(h).rlp();
+
+	chain.setFreezerDepth(1);
+	chain.freeze();
+	chain.garbageCollect(true);
+
+	BOOST_CHECK(chain.isKnown(h));
+	BOOST_CHECK(chain.block(h) == b);
+	BOOST_CHECK(chain.receipts(h).rlp() == r);
+	BOOST_CHECK_EQUAL(chain.transactions(h).size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -59,7 +59,7 @@ public:
 		m_notes[_k] = _v;
 	}
 
-	PeerSessionInfo info() const override { return PeerSessionInfo{ NodeID{}, "", "", 0, chrono::steady_clock::duration{}, {}, 0, {}, 0 }; }
+	PeerSessionInfo info() const override { return PeerSessionInfo{ NodeID{}, "", "", 0, chrono::steady_clock::duration{}, {}, 0, {}, 0, SessionTraffic() }; }
 	chrono::steady_clock::time_point connectionTime() override { return chrono::steady_clock::time_point{}; }
 
 	void registerCapability(CapDesc const& /*_desc*/, shared_ptr<Capability> /*_p*/) override { }
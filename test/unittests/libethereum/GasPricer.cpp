@@ -25,6 +25,8 @@
 #include <libethereum/ChainParams.h>
 #include <libethereum/GasPricer.h>
 #include <libethereum/BasicGasPricer.h>
+#include <libethereum/RollingGasPricer.h>
+#include <test/tools/libtesteth/BlockChainHelper.h>
 #include <test/tools/libtesteth/TestHelper.h>
 #include <test/tools/libtestutils/BlockChainLoader.h>
 
@@ -184,4 +186,50 @@ BOOST_AUTO_TEST_CASE(basicGasPricer_highGasUsage_HighestPrio)
 	u256 _expectedBid = 30000000000000;
 	dev::test::executeGasPricerTest("highGasUsage_Frontier", 30.679, 15.0, "/BlockchainTests/bcGasPricerTest/highGasUsage.json", TransactionPriority::Highest, _expectedAsk, _expectedBid, eth::Network::FrontierTest);
 }
+
+BOOST_AUTO_TEST_CASE(gasPriceSketch)
+{
+	GasPriceSketch a;
+	BOOST_CHECK_EQUAL(a.quantile(0.5), 0);
+	for (unsigned i = 1; i <= 100; ++i)
+		a.insert(u256(i) * shannon, 21000);
+	BOOST_CHECK_EQUAL(a.totalGas(), 2100000);
+	BOOST_CHECK_EQUAL(a.quantile(0), shannon);
+	BOOST_CHECK_EQUAL(a.quantile(1), 100 * shannon);
+	u256 median = a.quantile(0.5);
+	BOOST_CHECK(median >= 49 * shannon && median <= 51 * shannon);
+
+	// Heavier gas users weigh more.
+	GasPriceSketch b;
+	b.insert(1000 * shannon, 21000 * 300);
+	a += b;
+	BOOST_CHECK_EQUAL(a.quantile(0.5), 1000 * shannon);
+	a -= b;
+	BOOST_CHECK_EQUAL(a.quantile(0.5), median);
+	GasPriceSketch all = a;
+	a -= all;
+	BOOST_CHECK(a.empty());
+}
+
+BOOST_AUTO_TEST_CASE(rollingGasPricer)
+{
+	TestBlockChain::s_sealEngineNetwork = eth::Network::FrontierTest;
+	TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
+	RollingGasPricer gp(DefaultGasPrice, 12345, 2);
+	gp.update(bc.interface());
+	BOOST_CHECK_EQUAL(gp.bid(), 12345);
+
+	for (unsigned i = 1; i <= 3; ++i)
+	{
+		TestBlock block;
+		block.addTransaction(TestTransaction::defaultTransaction(i, i * 1000));
+		block.mine(bc);
+		bc.addBlock(block);
+		gp.noteChainChanged(bc.interface());
+		BOOST_CHECK_EQUAL(gp.bid(TransactionPriority::Highest), i * 1000);
+	}
+	// Only the last two blocks count.
+	BOOST_CHECK_EQUAL(gp.bid(TransactionPriority::Lowest), 2000);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,87 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file PeerSyncRate.cpp
+ * @date 2016
+ * Sync request sizing tests. Syncing from peers of different speeds is tested in BlockChainSync.cpp.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <libethereum/PeerSyncRate.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using namespace dev::test;
+
+namespace
+{
+
+PeerSyncRate::Clock::time_point at(double _seconds)
+{
+	return PeerSyncRate::Clock::time_point(chrono::duration_cast<PeerSyncRate::Clock::duration>(chrono::duration<double>(_seconds)));
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(PeerSyncRateSuite, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(peerSyncRateSizing)
+{
+	PeerSyncRate fast;
+	BOOST_CHECK_EQUAL(fast.requestSize(1024), 32);
+	BOOST_CHECK_EQUAL(fast.requestSize(10), 10);
+
+	// 1000 items per second: grows by doubling towards two seconds' worth, within the maximum.
+	double t = 0;
+	unsigned size = 0;
+	for (unsigned i = 0; i < 10; ++i)
+	{
+		size = fast.requestSize(1024);
+		fast.requested(size, at(t));
+		t += size / 1000.0;
+		fast.replied(size, at(t));
+	}
+	BOOST_CHECK_EQUAL(size, 1024);
+	BOOST_CHECK(fast.itemsPerSecond() > 900 && fast.itemsPerSecond() < 1100);
+	BOOST_CHECK_EQUAL(fast.requestSize(512), 512);
+
+	// 2 items per second: down to the minimum, and straggling once well past the expected time.
+	PeerSyncRate slow;
+	for (unsigned i = 0; i < 10; ++i)
+	{
+		size = slow.requestSize(1024);
+		slow.requested(size, at(t));
+		t += size / 2.0;
+		slow.replied(size, at(t));
+	}
+	BOOST_CHECK_EQUAL(size, 8);
+	slow.requested(8, at(t));
+	BOOST_CHECK(!slow.isStraggling(at(t + 4)));
+	BOOST_CHECK(slow.isStraggling(at(t + 13)));
+	slow.replied(8, at(t + 13));
+	BOOST_CHECK(!slow.isRequesting());
+	BOOST_CHECK(!slow.isStraggling(at(t + 100)));
+
+	// Empty replies don't count as slowness.
+	double const rate = fast.itemsPerSecond();
+	fast.requested(100, at(t));
+	fast.replied(0, at(t + 5));
+	BOOST_CHECK_EQUAL(fast.itemsPerSecond(), rate);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ServedDataCache.cpp
+ * @date 2016
+ * Served-request cache tests.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <libethereum/ServedDataCache.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using namespace dev::test;
+
+BOOST_FIXTURE_TEST_SUITE(ServedDataCacheSuite, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(servedDataCacheHits)
+{
+	ServedDataCache cache(1000);
+	unsigned made = 0;
+	auto make = [&](byte _b, size_t _size) { return [&made, _b, _size]() { ++made; return bytes(_size, _b); }; };
+
+	BOOST_CHECK(*cache.get(h256(1), make(1, 100)) == bytes(100, 1));
+	BOOST_CHECK(*cache.get(h256(1), make(9, 100)) == bytes(100, 1));
+	BOOST_CHECK_EQUAL(made, 1);
+
+	// Unknown blocks aren't remembered.
+	BOOST_CHECK(cache.get(h256(2), make(2, 0))->empty());
+	BOOST_CHECK(*cache.get(h256(2), make(2, 100)) == bytes(100, 2));
+	BOOST_CHECK_EQUAL(made, 3);
+
+	ServedDataStatus s = cache.status();
+	BOOST_CHECK_EQUAL(s.hits, 1);
+	BOOST_CHECK_EQUAL(s.misses, 3);
+	BOOST_CHECK_EQUAL(s.servedBytes, 300);
+	BOOST_CHECK_EQUAL(s.cachedBytes, 200);
+	BOOST_CHECK_EQUAL(s.cachedItems, 2);
+	BOOST_CHECK_EQUAL(s.hitRate(), 0.25);
+}
+
+BOOST_AUTO_TEST_CASE(servedDataCacheEviction)
+{
+	ServedDataCache cache(1000);
+	for (unsigned i = 0; i < 10; ++i)
+		cache.get(h256(i), [&]() { return bytes(100, i); });
+	BOOST_CHECK_EQUAL(cache.status().cachedBytes, 1000);
+
+	// Using the oldest keeps it over the next oldest.
+	cache.get(h256(0), []() { return bytes(); });
+	cache.get(h256(10), []() { return bytes(100, 10); });
+	ServedDataStatus s = cache.status();
+	BOOST_CHECK_EQUAL(s.cachedItems, 10);
+	BOOST_CHECK_EQUAL(s.cachedBytes, 1000);
+	BOOST_CHECK(*cache.get(h256(0), []() { return bytes(); }) == bytes(100, 0));
+	BOOST_CHECK(cache.get(h256(1), []() { return bytes(); })->empty());
+
+	// A fragment larger than the whole cache is served but not kept.
+	BOOST_CHECK_EQUAL(cache.get(h256(11), []() { return bytes(2000, 11); })->size(), 2000);
+	BOOST_CHECK_EQUAL(cache.status().cachedBytes, 1000);
+	BOOST_CHECK_EQUAL(cache.status().cachedItems, 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
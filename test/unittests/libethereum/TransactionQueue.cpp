@@ -21,6 +21,8 @@
  */
 
 #include <libethereum/TransactionQueue.h>
+#include <libethereum/State.h>
+#include <libdevcore/TransientDirectory.h>
 #include <test/tools/libtesteth/TestHelper.h>
 #include <test/tools/libtesteth/BlockChainHelper.h>
 
@@ -310,4 +312,149 @@ BOOST_AUTO_TEST_CASE(tqEqueue)
 	BOOST_REQUIRE(topTr.size() == 1);
 }
 
+BOOST_AUTO_TEST_CASE(tqConcurrentImport)
+{
+	unsigned const senders = 8;
+	unsigned const nonces = 50;
+	TransactionQueue tq(senders * nonces, 16);
+	Address dest = Address("0x095e7baea6a6c7c4c2dfeb977efac326af552d87");
+	vector<Transaction> txs;
+	for (unsigned s = 0; s < senders; ++s)
+	{
+		Secret sec(sha3(toString(s)));
+		for (unsigned n = 0; n < nonces; ++n)
+			txs.push_back(Transaction(0, szabo + (s * 7 + n) % 13, 25000, dest, bytes(), n, sec));
+	}
+
+	vector<thread> threads;
+	atomic<unsigned> imported(0);
+	for (unsigned t = 0; t < 4; ++t)
+		threads.emplace_back([&, t]()
+		{
+			for (size_t i = t; i < txs.size(); i += 4)
+				if (tq.import(txs[txs.size() - 1 - i]) == ImportResult::Success)
+					++imported;
+		});
+	for (auto& t: threads)
+		t.join();
+	BOOST_CHECK_EQUAL(imported, senders * nonces);
+	BOOST_CHECK_EQUAL(tq.status().current, senders * nonces);
+
+	// Each sender's transactions come out in nonce order, and each sender's lowest nonce comes first.
+	auto checkOrder = [&](u256 _lowest, size_t _count)
+	{
+		Transactions top = tq.topTransactions(senders * nonces);
+		BOOST_REQUIRE_EQUAL(top.size(), _count);
+		map<Address, u256> next;
+		for (size_t i = 0; i < top.size(); ++i)
+		{
+			Address from = top[i].from();
+			u256 expected = next.count(from) ? next[from] : _lowest;
+			BOOST_CHECK_EQUAL(top[i].nonce(), expected);
+			BOOST_CHECK(i >= senders || top[i].nonce() == _lowest);
+			next[from] = top[i].nonce() + 1;
+		}
+	};
+	checkOrder(0, senders * nonces);
+
+	// Mining the lowest nonces moves every sender's remaining transactions up.
+	for (auto const& t: txs)
+		if (t.nonce() < 10)
+			tq.dropGood(t);
+	checkOrder(10, senders * (nonces - 10));
+}
+
+BOOST_AUTO_TEST_CASE(tqJournal)
+{
+	TransientDirectory td;
+	string path = td.path() + "/transactions.journal";
+	Address dest = Address("0x095e7baea6a6c7c4c2dfeb977efac326af552d87");
+	Secret sec1(sha3("0"));
+	Secret sec2(sha3("1"));
+	Transaction tx0(0, szabo, 25000, dest, bytes(), 0, sec1);
+	Transaction tx1(0, szabo, 25000, dest, bytes(), 1, sec1);
+	Transaction tx2(0, szabo, 25000, dest, bytes(), 3, sec1);
+	Transaction tx3(0, szabo * 2, 25000, dest, bytes(), 0, sec2);
+	Transaction tx4(0, szabo * 2, 25000, dest, bytes(), 1, sec2);
+
+	{
+		TransactionQueue tq;
+		BOOST_CHECK_EQUAL(tq.openJournal(path), 0);
+		for (auto const& t: { tx0, tx1, tx2, tx3, tx4 })
+			BOOST_CHECK(tq.import(t) == ImportResult::Success);
+		tq.dropGood(tx0);
+		tq.drop(tx4.sha3());
+		tq.setFuture(tx2.sha3());
+	}
+
+	// The mined and dropped ones stay gone. Whether a transaction is future depends on the chain
+	// state, so the next sync decides that again and everything comes back as current.
+	TransactionQueue tq;
+	BOOST_CHECK_EQUAL(tq.openJournal(path), 3);
+	BOOST_CHECK_EQUAL(tq.status().current, 3);
+	BOOST_CHECK_EQUAL(tq.status().future, 0);
+	BOOST_CHECK(tq.import(tx4) == ImportResult::AlreadyInChain);
+	Transactions top = tq.topTransactions(5);
+	BOOST_REQUIRE_EQUAL(top.size(), 3);
+	BOOST_CHECK_EQUAL(top[0].sha3(), tx3.sha3());
+	BOOST_CHECK_EQUAL(top[1].sha3(), tx1.sha3());
+	BOOST_CHECK_EQUAL(top[2].sha3(), tx2.sha3());
+
+	tq.clear();
+	TransactionQueue empty;
+	BOOST_CHECK_EQUAL(empty.openJournal(path), 0);
+}
+
+BOOST_AUTO_TEST_CASE(tqSubmit)
+{
+	Address dest = Address("0x095e7baea6a6c7c4c2dfeb977efac326af552d87");
+	Secret rich(sha3("0"));
+	Secret poor(sha3("1"));
+	Transaction used(0, szabo, 25000, dest, bytes(), 0, rich);
+	Transaction good(0, szabo, 25000, dest, bytes(), 1, rich);
+	Transaction unpaid(0, szabo, 25000, dest, bytes(), 0, poor);
+
+	State state(0);
+	state.addBalance(toAddress(rich), ether);
+	state.incNonce(toAddress(rich));
+
+	TransactionQueue tq;
+	tq.setStateSnapshot(make_shared<State>(state));
+	Mutex x_results;
+	map<h256, ImportResult> results;
+	auto handler = tq.onImport([&](ImportResult _ir, h256 const& _h, h512 const&) { DEV_GUARDED(x_results) results[_h] = _ir; });
+
+	for (auto const& t: { used, good, unpaid })
+		BOOST_CHECK_EQUAL(tq.submit(t.rlp()), t.sha3());
+	BOOST_CHECK_THROW(tq.submit(bytes{ 1, 2, 3 }), Exception);
+	for (unsigned i = 0; i < 100 && results.size() < 3; ++i)
+		this_thread::sleep_for(chrono::milliseconds(50));
+
+	Guard l(x_results);
+	BOOST_REQUIRE_EQUAL(results.size(), 3);
+	BOOST_CHECK(results[used.sha3()] == ImportResult::NonceTooLow);
+	BOOST_CHECK(results[good.sha3()] == ImportResult::Success);
+	BOOST_CHECK(results[unpaid.sha3()] == ImportResult::InsufficientFunds);
+	BOOST_CHECK_EQUAL(tq.topTransactions(5).size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(tqSubmissionLimit)
+{
+	Address dest = Address("0x095e7baea6a6c7c4c2dfeb977efac326af552d87");
+	Secret sec(sha3("0"));
+	TransactionQueue tq;
+	tq.setSubmissionLimit(1, 2);
+	h512 source(1);
+	tq.submit(Transaction(0, szabo, 25000, dest, bytes(), 0, sec).rlp(), source);
+	tq.submit(Transaction(0, szabo, 25000, dest, bytes(), 1, sec).rlp(), source);
+	BOOST_CHECK_THROW(tq.submit(Transaction(0, szabo, 25000, dest, bytes(), 2, sec).rlp(), source), TransactionRateLimited);
+	// Other sources have their own allowance.
+	tq.submit(Transaction(0, szabo, 25000, dest, bytes(), 2, sec).rlp(), h512(2));
+	// Local submissions share their own, larger, one.
+	tq.setLocalSubmissionLimit(1, 5);
+	for (unsigned i = 3; i < 8; ++i)
+		tq.submit(Transaction(0, szabo, 25000, dest, bytes(), i, sec).rlp());
+	BOOST_CHECK_THROW(tq.submit(Transaction(0, szabo, 25000, dest, bytes(), 8, sec).rlp()), TransactionRateLimited);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -20,6 +20,7 @@ along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <boost/test/unit_test.hpp>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <libp2p/Common.h>
@@ -47,21 +48,40 @@ public:
 	virtual ~TestCapability() {}
 	int countReceivedMessages() { return m_cntReceivedMessages; }
 	int testSum() { return m_testSum; }
+	size_t receivedPayload() { return m_receivedPayload; }
+	uint64_t payloadSum() { return m_payloadSum; }
 	static std::string name() { return "test"; }
 	static u256 version() { return 2; }
-	static unsigned messageCount() { return UserPacket + 1; }
+	static unsigned messageCount() { return UserPacket + 2; }
 	void sendTestMessage(int _i) { RLPStream s; sealAndSend(prep(s, UserPacket, 1) << _i); }
+	void sendTestPayload(bytes&& _items) { sealAndSend(UserPacket + 1, move(_items)); }
 
 protected:
 	virtual bool interpret(unsigned _id, RLP const& _r) override;
 
 	int m_cntReceivedMessages;
 	int m_testSum;
+	std::atomic<size_t> m_receivedPayload{0};
+	std::atomic<uint64_t> m_payloadSum{0};	///< Added to before m_receivedPayload.
 };
 
 bool TestCapability::interpret(unsigned _id, RLP const& _r) 
 {
 	//cnote << "Capability::interpret(): custom message received";
+	if (_id == UserPacket + 1)
+	{
+		size_t size = 0;
+		uint64_t sum = 0;
+		for (auto const& i: _r)
+		{
+			for (byte b: i.payload())
+				sum += b;
+			size += i.payload().size();
+		}
+		m_payloadSum += sum;
+		m_receivedPayload += size;
+		return true;
+	}
 	++m_cntReceivedMessages;
 	m_testSum += _r[0].toInt();
 	BOOST_ASSERT(_id == UserPacket);
@@ -94,55 +114,82 @@ public:
 
 		return std::pair<int, int>(cnt, checksum);
 	}
-};
-
-BOOST_FIXTURE_TEST_SUITE(p2pCapability, P2PFixture)
 
-BOOST_AUTO_TEST_CASE(capability)
-{
-	if (test::Options::get().nonetwork)
-		return;
+	void sendTestPayload(NodeID const& _id, bytes&& _items)
+	{
+		for (auto i: peerSessions())
+			if (_id == i.second->id)
+				capabilityFromSession<TestCapability>(*i.first)->sendTestPayload(move(_items));
+	}
 
-	VerbosityHolder verbosityHolder(10);
-	cnote << "Testing Capability...";
+	/// @returns the payload received so far and the sum of its bytes, which is final once all is received.
+	std::pair<size_t, uint64_t> retrieveTestPayload(NodeID const& _id)
+	{
+		for (auto i: peerSessions())
+			if (_id == i.second->id)
+			{
+				auto cap = capabilityFromSession<TestCapability>(*i.first);
+				size_t received = cap->receivedPayload();
+				return std::make_pair(received, cap->payloadSum());
+			}
+		return std::make_pair(size_t(0), uint64_t(0));
+	}
+};
 
+/// Starts both hosts and connects @a _host1 to @a _host2.
+static void connectHosts(Host& _host1, Host& _host2)
+{
 	int const step = 10;
 	const char* const localhost = "127.0.0.1";
-	NetworkPreferences prefs1(localhost, 0, false);
-	NetworkPreferences prefs2(localhost, 0, false);
-	Host host1("Test", prefs1);
-	Host host2("Test", prefs2);
-	auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
-	auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
-	host1.start();	
-	host2.start();
-	auto port1 = host1.listenPort();
-	auto port2 = host2.listenPort();
+	_host1.start();
+	_host2.start();
+	auto port1 = _host1.listenPort();
+	auto port2 = _host2.listenPort();
 	BOOST_REQUIRE(port1);
-	BOOST_REQUIRE(port2);	
+	BOOST_REQUIRE(port2);
 	BOOST_REQUIRE_NE(port1, port2);
 
 	for (unsigned i = 0; i < 3000; i += step)
 	{
 		this_thread::sleep_for(chrono::milliseconds(step));
 
-		if (host1.isStarted() && host2.isStarted())
+		if (_host1.isStarted() && _host2.isStarted())
 			break;
 	}
 
-	BOOST_REQUIRE(host1.isStarted() && host2.isStarted());
-	host1.requirePeer(host2.id(), NodeIPEndpoint(bi::address::from_string(localhost), port2, port2));
+	BOOST_REQUIRE(_host1.isStarted() && _host2.isStarted());
+	_host1.requirePeer(_host2.id(), NodeIPEndpoint(bi::address::from_string(localhost), port2, port2));
 
 	// Wait for up to 12 seconds, to give the hosts time to connect to each other.
 	for (unsigned i = 0; i < 12000; i += step)
 	{
 		this_thread::sleep_for(chrono::milliseconds(step));
 
-		if ((host1.peerCount() > 0) && (host2.peerCount() > 0))
+		if ((_host1.peerCount() > 0) && (_host2.peerCount() > 0))
 			break;
 	}
 
-	BOOST_REQUIRE(host1.peerCount() > 0 && host2.peerCount() > 0);
+	BOOST_REQUIRE(_host1.peerCount() > 0 && _host2.peerCount() > 0);
+}
+
+BOOST_FIXTURE_TEST_SUITE(p2pCapability, P2PFixture)
+
+BOOST_AUTO_TEST_CASE(capability)
+{
+	if (test::Options::get().nonetwork)
+		return;
+
+	VerbosityHolder verbosityHolder(10);
+	cnote << "Testing Capability...";
+
+	const char* const localhost = "127.0.0.1";
+	NetworkPreferences prefs1(localhost, 0, false);
+	NetworkPreferences prefs2(localhost, 0, false);
+	Host host1("Test", prefs1);
+	Host host2("Test", prefs2);
+	auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+	auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
+	connectHosts(host1, host2);
 
 	int const target = 64;
 	int checksum = 0;
@@ -155,6 +202,59 @@ BOOST_AUTO_TEST_CASE(capability)
 	BOOST_REQUIRE_EQUAL(checksum, testData.second);
 }
 
+BOOST_AUTO_TEST_CASE(throughput)
+{
+	if (test::Options::get().nonetwork)
+		return;
+
+	VerbosityHolder verbosityHolder(10);
+	cnote << "Testing throughput...";
+
+	const char* const localhost = "127.0.0.1";
+	NetworkPreferences prefs1(localhost, 0, false);
+	NetworkPreferences prefs2(localhost, 0, false);
+	Host host1("Test", prefs1);
+	Host host2("Test", prefs2);
+	auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+	auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
+	connectHosts(host1, host2);
+
+	// Packets of 1 MB of items, like large BlockBodies replies, sent as slices straight into the write queue.
+	unsigned const packets = 128;
+	unsigned const itemsPerPacket = 16;
+	size_t const itemSize = 1 << 16;
+	size_t total = 0;
+	uint64_t checksum = 0;
+	auto start = chrono::steady_clock::now();
+	for (unsigned p = 0; p < packets; ++p)
+	{
+		RLPStream s;
+		bytes item(itemSize);
+		for (unsigned i = 0; i < itemsPerPacket; ++i)
+		{
+			for (size_t j = 0; j < itemSize; ++j)
+				checksum += item[j] = byte(p + i + j);
+			s.append(item);
+			total += itemSize;
+		}
+		bytes items;
+		s.swapOut(items);
+		thc2->sendTestPayload(host1.id(), move(items));
+	}
+
+	pair<size_t, uint64_t> received;
+	for (unsigned i = 0; i < 30000 && received.first < total; i += 10)
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+		received = thc1->retrieveTestPayload(host2.id());
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cnote << "Throughput:" << total / seconds / 1048576 << "MB/s," << total / 1048576 << "MB in" << seconds << "s";
+
+	BOOST_REQUIRE_EQUAL(total, received.first);
+	BOOST_REQUIRE_EQUAL(checksum, received.second);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -0,0 +1,92 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file compression.cpp
+ * @date 2016
+ * Packet compression tests.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <libdevcore/RLP.h>
+#include <libp2p/Common.h>
+#include <libp2p/Compression.h>
+#include <libp2p/Session.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+using namespace dev::test;
+
+BOOST_FIXTURE_TEST_SUITE(p2pCompression, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(compressionNegotiation)
+{
+	// We only announce version 5 if we can keep its promise of compressing.
+	BOOST_CHECK_EQUAL(c_helloProtocolVersion >= c_snappyProtocolVersion, haveSnappy());
+	BOOST_CHECK(!Session::isFramingAllowedForVersion(c_protocolVersion));
+	BOOST_CHECK(!Session::isFramingAllowedForVersion(c_snappyProtocolVersion));
+}
+
+BOOST_AUTO_TEST_CASE(compressionRoundTrip)
+{
+	if (!haveSnappy())
+		return;
+
+	// Something like a BlockBodies payload.
+	RLPStream s(64);
+	for (unsigned i = 0; i < 64; ++i)
+		s.appendList(3) << h256(i) << u256(i) * 1000000000 << bytes(100, i % 4);
+	bytes const payload = s.out();
+
+	bytes packet(1, 0x16);
+	BOOST_REQUIRE(snappyCompress(&payload, packet));
+	BOOST_CHECK_EQUAL(packet[0], 0x16);
+
+	bytes out(1, packet[0]);
+	BOOST_REQUIRE(snappyUncompress(bytesConstRef(&packet).cropped(1), c_maxUncompressedPayload, out));
+	BOOST_CHECK(bytesConstRef(&out).cropped(1).toBytes() == payload);
+
+	// Over the limit either way.
+	bytes unused;
+	bytes const huge(c_maxUncompressedPayload + 1);
+	BOOST_CHECK(!snappyUncompress(bytesConstRef(&packet).cropped(1), payload.size() - 1, unused));
+	BOOST_CHECK(!snappyCompress(&huge, unused));
+	BOOST_CHECK(unused.empty());
+}
+
+BOOST_AUTO_TEST_CASE(compressionBomb)
+{
+	if (!haveSnappy())
+		return;
+
+	// A few bytes claiming to decompress to 4GiB are refused before anything is allocated.
+	bytes bomb{0x80, 0x80, 0x80, 0x80, 0x10, 0x00, 0x00};
+	bytes out;
+	BOOST_CHECK(!snappyUncompress(&bomb, c_maxUncompressedPayload, out));
+	BOOST_CHECK(out.empty());
+
+	// Truncated and garbage input.
+	bytes payload(1000, 7);
+	bytes packet;
+	BOOST_REQUIRE(snappyCompress(&payload, packet));
+	BOOST_CHECK(!snappyUncompress(bytesConstRef(&packet).cropped(0, packet.size() - 1), c_maxUncompressedPayload, out));
+	BOOST_CHECK(out.empty());
+	bytes const garbage{0xff};
+	BOOST_CHECK(!snappyUncompress(&garbage, c_maxUncompressedPayload, out));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file handlerPool.cpp
+ * @date 2016
+ * HandlerPool tests.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <boost/test/unit_test.hpp>
+#include <libp2p/HandlerPool.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+using namespace dev::test;
+
+BOOST_FIXTURE_TEST_SUITE(p2pHandlerPool, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(handlerPoolLaneOrder)
+{
+	HandlerPool pool(4);
+	unsigned const lanes = 8;
+	unsigned const perLane = 200;
+	vector<shared_ptr<HandlerPool::Lane>> ls;
+	vector<vector<unsigned>> seen(lanes);
+	vector<atomic<unsigned>> running(lanes);
+	atomic<bool> overlapped(false);
+	atomic<unsigned> done(0);
+	for (unsigned l = 0; l < lanes; ++l)
+	{
+		ls.push_back(pool.newLane());
+		running[l] = 0;
+	}
+	for (unsigned i = 0; i < perLane; ++i)
+		for (unsigned l = 0; l < lanes; ++l)
+			pool.post(ls[l], [&, l, i]()
+			{
+				if (running[l]++)
+					overlapped = true;
+				seen[l].push_back(i);
+				--running[l];
+				++done;
+			});
+	for (unsigned i = 0; i < 1000 && done < lanes * perLane; ++i)
+		this_thread::sleep_for(chrono::milliseconds(10));
+
+	BOOST_REQUIRE_EQUAL(done, lanes * perLane);
+	BOOST_CHECK(!overlapped);
+	for (auto const& s: seen)
+		for (unsigned i = 0; i < perLane; ++i)
+			BOOST_REQUIRE_EQUAL(s[i], i);
+}
+
+BOOST_AUTO_TEST_CASE(handlerPoolDeferUntilBelow)
+{
+	HandlerPool pool(1);
+	auto lane = pool.newLane();
+	atomic<bool> release(false);
+	atomic<bool> resumed(false);
+	for (unsigned i = 0; i < 4; ++i)
+		pool.post(lane, [&]() { while (!release) this_thread::sleep_for(chrono::milliseconds(1)); });
+
+	BOOST_CHECK(!pool.deferUntilBelow(lane, 5, [&]() { resumed = true; }));
+	BOOST_CHECK(pool.deferUntilBelow(lane, 2, [&]() { resumed = true; }));
+	BOOST_CHECK(!resumed);
+
+	release = true;
+	for (unsigned i = 0; i < 1000 && !resumed; ++i)
+		this_thread::sleep_for(chrono::milliseconds(1));
+	BOOST_CHECK(resumed);
+
+	// Nothing runs once stopped.
+	pool.stop();
+	bool ran = false;
+	pool.post(lane, [&]() { ran = true; });
+	this_thread::sleep_for(chrono::milliseconds(10));
+	BOOST_CHECK(!ran);
+	BOOST_CHECK(!pool.deferUntilBelow(lane, 1, [](){}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -64,7 +64,7 @@ protected:
 struct TestNodeTable: public NodeTable
 {
 	/// Constructor
-	TestNodeTable(ba::io_service& _io, KeyPair _alias, bi::address const& _addr, uint16_t _port = 30300): NodeTable(_io, _alias, NodeIPEndpoint(_addr, _port, _port)) {}
+	TestNodeTable(ba::io_service& _io, KeyPair _alias, bi::address const& _addr, uint16_t _port = 30300, bool _enabled = true): NodeTable(_io, _alias, NodeIPEndpoint(_addr, _port, _port), _enabled) {}
 
 	static std::vector<std::pair<KeyPair,unsigned>> createTestNodes(unsigned _count)
 	{
@@ -117,7 +117,50 @@ struct TestNodeTable: public NodeTable
 	void reset()
 	{
 		Guard l(x_state);
-		for (auto& n: m_state) n.nodes.clear();
+		for (auto& n: m_state) n.clear();
+	}
+
+	/// Adds @a _count nodes with random ids, as if each had just been heard from. @returns their ids.
+	std::vector<NodeID> populateSyntheticNodes(unsigned _count)
+	{
+		std::vector<NodeID> ret;
+		bi::address ourIp = bi::address::from_string("127.0.0.1");
+		for (unsigned i = 0; i < _count; i++)
+		{
+			NodeID id = NodeID::random();
+			uint16_t port = 1024 + i % 60000;
+			DEV_GUARDED(x_nodes)
+			{
+				shared_ptr<NodeEntry> node(new NodeEntry(m_nodeHash, id, NodeIPEndpoint(ourIp, port, port)));
+				node->pending = false;
+				m_nodes[id] = node;
+			}
+			noteActiveNode(id, bi::udp::endpoint(ourIp, port));
+			ret.push_back(id);
+		}
+		return ret;
+	}
+
+	/// Nearest nodes to @a _target found by sorting the whole table.
+	std::vector<NodeID> nearestBySorting(NodeID const& _target)
+	{
+		h256 target = sha3(_target);
+		std::vector<std::pair<h256, NodeID>> all;
+		for (auto const& n: snapshot())
+			all.push_back(make_pair(n.hash ^ target, n.id));
+		sort(all.begin(), all.end());
+		std::vector<NodeID> ret;
+		for (unsigned i = 0; i < all.size() && i < s_bucketSize; i++)
+			ret.push_back(all[i].second);
+		return ret;
+	}
+
+	std::vector<NodeID> nearest(NodeID const& _target)
+	{
+		std::vector<NodeID> ret;
+		for (auto const& n: nearestNodeEntries(_target))
+			ret.push_back(n->id);
+		return ret;
 	}
 };
 
@@ -309,6 +352,36 @@ BOOST_AUTO_TEST_CASE(kademlia)
 	BOOST_REQUIRE_EQUAL(node.nodeTable->count(), 8);
 }
 
+BOOST_AUTO_TEST_CASE(nodeTableNearest)
+{
+	// Discovery disabled: evictions of the contested nodes never get to ping.
+	ba::io_service io;
+	TestNodeTable table(io, KeyPair::create(), bi::address::from_string("127.0.0.1"), 30300, false);
+	unsigned const count = 100000;
+	auto ids = table.populateSyntheticNodes(count);
+	BOOST_REQUIRE_EQUAL(table.count(), count);
+	BOOST_REQUIRE(!table.snapshot().empty());
+
+	// Exactly the nearest nodes in the table, nearest first, for targets in the table, far and random.
+	for (unsigned i = 0; i < 200; i++)
+	{
+		NodeID target = i % 2 ? NodeID::random() : ids[i * (count / 200)];
+		BOOST_REQUIRE(table.nearest(target) == table.nearestBySorting(target));
+	}
+
+	unsigned const lookups = 10000;
+	vector<NodeID> targets;
+	for (unsigned i = 0; i < lookups; i++)
+		targets.push_back(NodeID::random());
+	size_t found = 0;
+	auto start = chrono::steady_clock::now();
+	for (auto const& t: targets)
+		found += table.nearest(t).size();
+	auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	cnote << lookups << "lookups in a table of" << table.snapshot().size() << "nodes (" << count << "known):" << elapsed / lookups << "us each";
+	BOOST_CHECK_EQUAL(found, lookups * 16);
+}
+
 BOOST_AUTO_TEST_CASE(udpOnce)
 {
 	if (test::Options::get().nonetwork)
@@ -0,0 +1,121 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file peerStore.cpp
+ * @date 2016
+ * PeerStore tests.
+ */
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <libdevcore/CommonIO.h>
+#include <libdevcore/TransientDirectory.h>
+#include <libp2p/PeerStore.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+using namespace dev::test;
+
+namespace
+{
+
+struct TestPeer: public Peer
+{
+	TestPeer(NodeID const& _id, unsigned _latency, uint64_t _uptime, uint64_t _served, unsigned _sessions, unsigned _failures):
+		Peer(Node(_id, NodeIPEndpoint(bi::address::from_string("200.200.200.200"), 30303, 30303)))
+	{
+		m_latency = _latency;
+		m_uptime = _uptime;
+		m_servedBytes = _served;
+		m_sessions = _sessions;
+		m_failures = _failures;
+		m_caps.insert(make_pair("eth", 63));
+		m_score = -3;
+	}
+};
+
+shared_ptr<Peer> find(vector<shared_ptr<Peer>> const& _peers, NodeID const& _id)
+{
+	for (auto const& p: _peers)
+		if (p->id == _id)
+			return p;
+	return nullptr;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(p2pPeerStore, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(peerStoreLatestRecordWins)
+{
+	TransientDirectory dir;
+	string path = dir.path() + "/peers.rlp";
+	NodeID a = NodeID::random();
+	NodeID b = NodeID::random();
+	{
+		PeerStore store(path);
+		store.save(TestPeer(a, 100, 60, 1000, 1, 0));
+		store.save(TestPeer(b, 50, 10, 10, 1, 4));
+		store.save(TestPeer(a, 80, 3600, 1 << 30, 2, 1));
+	}
+
+	// A record cut short, as by a crash while it was written.
+	bytes data = contents(path);
+	size_t const complete = data.size();
+	RLPStream s(3);
+	s << 1 << a << bytes(100, 1);
+	data += bytesConstRef(&s.out()).cropped(0, 20).toBytes();
+	writeFile(path, data);
+
+	PeerStore store(path);
+	auto peers = store.peers();
+	BOOST_REQUIRE_EQUAL(peers.size(), 2);
+	auto pa = find(peers, a);
+	BOOST_REQUIRE(pa);
+	BOOST_CHECK_EQUAL(pa->latency(), 80);
+	BOOST_CHECK_EQUAL(pa->uptime(), 3600);
+	BOOST_CHECK_EQUAL(pa->servedBytes(), uint64_t(1) << 30);
+	BOOST_CHECK_EQUAL(pa->rating(), 0);
+	BOOST_CHECK(pa->caps().count(make_pair(string("eth"), u256(63))));
+	BOOST_CHECK_EQUAL(pa->endpoint.tcpPort, 30303);
+	auto pb = find(peers, b);
+	BOOST_REQUIRE(pb);
+	BOOST_CHECK(pa->quality() > pb->quality());
+
+	// Reopening dropped the superseded record and the cut one.
+	BOOST_CHECK(boost::filesystem::file_size(path) < complete);
+}
+
+BOOST_AUTO_TEST_CASE(peerStoreCompaction)
+{
+	TransientDirectory dir;
+	string path = dir.path() + "/peers.rlp";
+	NodeID a = NodeID::random();
+	PeerStore store(path);
+	store.save(TestPeer(a, 1000, 1000, 1000, 1000, 0));
+	size_t const record = boost::filesystem::file_size(path);
+	for (unsigned i = 0; i < 2000; ++i)
+		store.save(TestPeer(a, i, i, i, i, 0));
+	BOOST_CHECK(boost::filesystem::file_size(path) <= 300 * record);
+
+	store.rewrite(vector<shared_ptr<Peer>>());
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), 0);
+	BOOST_CHECK(PeerStore(path).peers().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -983,4 +983,51 @@ BOOST_AUTO_TEST_CASE(randomizedMultiProtocol)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(largeFrames)
+{
+	auto localEph = KeyPair::create();
+	auto remoteEph = KeyPair::create();
+	Secret localNonce = Nonce::get();
+	Secret remoteNonce = Nonce::get();
+	bytes ackCipher{0};
+	bytes authCipher{1};
+	RLPXFrameCoder encoder(true, remoteEph.pub(), remoteNonce.makeInsecure(), localEph, localNonce.makeInsecure(), &ackCipher, &authCipher);
+	RLPXFrameCoder decoder(false, localEph.pub(), localNonce.makeInsecure(), remoteEph, remoteNonce.makeInsecure(), &ackCipher, &authCipher);
+
+	// Sizes around the pieces frames are encrypted and MACed in, written both into new buffers and in place.
+	bytes const header = (RLPStream(1) << 0).out();
+	for (size_t size: {8191, 8192, 8193, 3 * 8192 + 5, 1 << 20})
+		for (bool inPlace: {false, true})
+		{
+			bytes payload(size);
+			for (size_t i = 0; i < size; ++i)
+				payload[i] = byte(i * 31 + size);
+			bytes frame;
+			if (inPlace)
+			{
+				frame.resize(RLPXFrameCoder::frameSize(size));
+				bytesRef body(frame.data() + h256::size, size);
+				bytesConstRef(&payload).copyTo(body);
+				encoder.writeFrame(&header, body, bytesRef(&frame));
+			}
+			else
+				encoder.writeFrame(0, &payload, frame);
+			BOOST_REQUIRE_EQUAL(frame.size(), RLPXFrameCoder::frameSize(size));
+
+			BOOST_REQUIRE(decoder.authAndDecryptHeader(bytesRef(frame.data(), h256::size)));
+			RLPXFrameInfo f(bytesConstRef(frame.data(), h256::size));
+			BOOST_REQUIRE_EQUAL(f.length, size);
+			BOOST_REQUIRE(decoder.authAndDecryptFrame(bytesRef(&frame).cropped(h256::size)));
+			BOOST_REQUIRE(bytesConstRef(frame.data() + h256::size, size).toBytes() == payload);
+		}
+
+	// A flipped bit anywhere in the frame fails authentication.
+	bytes payload(20000, 7);
+	bytes frame;
+	encoder.writeFrame(0, &payload, frame);
+	frame[h256::size + 12345] ^= 1;
+	BOOST_REQUIRE(decoder.authAndDecryptHeader(bytesRef(frame.data(), h256::size)));
+	BOOST_REQUIRE(!decoder.authAndDecryptFrame(bytesRef(&frame).cropped(h256::size)));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
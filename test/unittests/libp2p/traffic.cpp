@@ -0,0 +1,103 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file traffic.cpp
+ * @date 2016
+ * Traffic accounting and egress limit tests.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <libp2p/Common.h>
+#include <libp2p/RateLimiter.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+using namespace dev::test;
+
+BOOST_FIXTURE_TEST_SUITE(p2pTraffic, TestOutputHelper)
+
+BOOST_AUTO_TEST_CASE(trafficCounters)
+{
+	SessionTraffic a = SessionTraffic();
+	a.note("p2p", 2, true, 48);
+	a.note("eth", 4, false, 1000);
+	a.note("eth", 6, true, 20000);
+	a.note("eth", 6, true, 30000);
+	BOOST_CHECK_EQUAL(a.total.egressBytes, 50048);
+	BOOST_CHECK_EQUAL(a.total.egressPackets, 3);
+	BOOST_CHECK_EQUAL(a.total.ingressBytes, 1000);
+	BOOST_CHECK_EQUAL(a.packets[make_pair(string("eth"), 6u)].egressPackets, 2);
+
+	auto caps = a.capabilities();
+	BOOST_CHECK_EQUAL(caps.size(), 2);
+	BOOST_CHECK_EQUAL(caps["eth"].egressBytes, 50000);
+	BOOST_CHECK_EQUAL(caps["eth"].ingressPackets, 1);
+	BOOST_CHECK_EQUAL(caps["p2p"].egressBytes, 48);
+
+	SessionTraffic b = SessionTraffic();
+	b.note("eth", 4, false, 500);
+	b.frameCoderMicroseconds = 7;
+	b.writeQueue = 3;
+	a += b;
+	BOOST_CHECK_EQUAL(a.total.ingressBytes, 1500);
+	BOOST_CHECK_EQUAL(a.packets[make_pair(string("eth"), 4u)].ingressPackets, 2);
+	BOOST_CHECK_EQUAL(a.frameCoderMicroseconds, 7);
+	BOOST_CHECK_EQUAL(a.writeQueue, 3);
+}
+
+BOOST_AUTO_TEST_CASE(rateLimiter)
+{
+	RateLimiter unlimited;
+	RateLimiter limiter(1000);
+	RateLimiter::Clock::time_point t = RateLimiter::Clock::now();
+	unlimited.consume(1 << 30, t);
+	BOOST_CHECK(unlimited.delay(t) == RateLimiter::Clock::duration::zero());
+	BOOST_CHECK_EQUAL(unlimited.available(t), numeric_limits<size_t>::max());
+
+	// A second's worth goes out at once; a write over the allowance goes too, and holds back the next.
+	BOOST_CHECK(limiter.delay(t) == RateLimiter::Clock::duration::zero());
+	limiter.consume(600, t);
+	BOOST_CHECK(limiter.delay(t) == RateLimiter::Clock::duration::zero());
+	BOOST_CHECK_EQUAL(limiter.available(t), 400);
+	limiter.consume(900, t);
+	BOOST_CHECK_EQUAL(limiter.available(t), 0);
+	auto wait = limiter.delay(t);
+	BOOST_CHECK(wait > chrono::milliseconds(490) && wait <= chrono::milliseconds(500));
+	BOOST_CHECK(limiter.delay(t + chrono::milliseconds(500)) == RateLimiter::Clock::duration::zero());
+
+	// Idle time doesn't bank more than a second's worth.
+	t += chrono::seconds(60);
+	limiter.consume(2000, t);
+	wait = limiter.delay(t);
+	BOOST_CHECK(wait > chrono::milliseconds(990) && wait <= chrono::seconds(1));
+
+	// Over a stretch of back-to-back writes, the rate holds.
+	size_t sent = 0;
+	for (unsigned ms = 0; ms < 10000; ++ms)
+	{
+		t += chrono::milliseconds(1);
+		if (limiter.delay(t) == RateLimiter::Clock::duration::zero())
+		{
+			limiter.consume(300, t);
+			sent += 300;
+		}
+	}
+	BOOST_CHECK(sent >= 9000 && sent <= 11300);
+}
+
+BOOST_AUTO_TEST_SUITE_END()